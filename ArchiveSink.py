@@ -0,0 +1,232 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: ArchiveSink.py
+#   Version: 0.7
+######################################################
+
+import os
+import mmap
+import zlib
+import struct
+
+ZIP_FORMAT = "zip"
+TAR_FORMAT = "tar"
+
+DEX_HEADER_PREFIX_SIZE = 32  # magic, checksum and signature
+
+ZIP_LOCAL_FILE_HEADER_SIGNATURE = 0x04034b50
+ZIP_CENTRAL_DIRECTORY_SIGNATURE = 0x02014b50
+ZIP_END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50
+ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06064b50
+ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIGNATURE = 0x07064b50
+ZIP64_EXTRA_FIELD_ID = 0x0001
+ZIP_VERSION = 20
+ZIP64_VERSION = 45
+ZIP_STORED = 0
+ZIP_UTF8_FLAG = 0x0800
+# 1980-01-01 00:00, fixed so the archives are reproducible
+ZIP_DOS_TIME = 0
+ZIP_DOS_DATE = (1 << 5) | 1
+ZIP_MAX_32 = 0xFFFFFFFF
+ZIP_MAX_16 = 0xFFFF
+
+TAR_BLOCK_SIZE = 512
+TAR_NAME_SIZE = 100
+TAR_PREFIX_SIZE = 155
+
+
+def apk_dex_name(dex_index, file_name):
+    '''
+    Name of a dex inside of an APK (classes.dex, classes2.dex...).
+    '''
+    extension = os.path.splitext(file_name)[1]
+    if dex_index == 0:
+        return "classes" + extension
+    return "classes%d%s" % (dex_index + 1, extension)
+
+
+def _write_all(fd, data):
+    data_view = memoryview(data)
+    while len(data_view) > 0:
+        data_view = data_view[os.write(fd, data_view):]
+
+
+def _send_all(out_fd, in_fd, offset, size):
+    '''
+    Copy from in_fd to out_fd inside of the kernel (sendfile works
+    with files, pipes and sockets as output).
+    '''
+    while size > 0:
+        sent = os.sendfile(out_fd, in_fd, offset, size)
+        if sent == 0:
+            raise IOError("Unexpected end of input file at offset 0x%08X" % offset)
+        offset += sent
+        size -= sent
+
+
+class ArchiveSink():
+    '''
+    Write dex files in an archive on a file descriptor (a file, a pipe,
+    stdout), that can be seekable or not. Sizes and CRC are known
+    before the data is written, so nothing is buffered: the header of
+    the dex (its first 32 bytes, which can be patched) is written from
+    memory and the rest is copied from the input with sendfile.
+    '''
+
+    def __init__(self, fd):
+        self.fd = fd
+        self.position = 0
+
+    def write(self, data):
+        _write_all(self.fd, data)
+        self.position += len(data)
+
+    def send(self, in_fd, offset, size):
+        _send_all(self.fd, in_fd, offset, size)
+        self.position += size
+
+    def add_dex(self, name, in_fd, offset, size, dex_header_prefix):
+        '''
+        :param name: name of the dex inside of the archive
+        :param in_fd: file where the dex is stored
+        :param offset: offset of the dex in in_fd
+        :param size: size of the dex
+        :param dex_header_prefix: first 32 bytes of the dex to write
+        '''
+        raise NotImplementedError()
+
+    def close(self):
+        raise NotImplementedError()
+
+
+class ZipSink(ArchiveSink):
+    '''
+    Zip with stored (not compressed) entries as in an APK, zip64
+    records are written when the archive gets bigger than 4 GiB.
+    '''
+
+    def __init__(self, fd):
+        super().__init__(fd)
+        self.central_directory = []
+
+    def add_dex(self, name, in_fd, offset, size, dex_header_prefix):
+        if size < DEX_HEADER_PREFIX_SIZE or size > ZIP_MAX_32:
+            raise ValueError("Incorrect size of dex %s (%d)" % (name, size))
+
+        # crc32 over the mapped input, no copy of the dex
+        map_offset = offset - (offset % mmap.ALLOCATIONGRANULARITY)
+        dex_map = mmap.mmap(in_fd, offset - map_offset + size, mmap.MAP_SHARED, mmap.PROT_READ,
+                            offset=map_offset)
+        try:
+            dex_view = memoryview(dex_map)[offset - map_offset + DEX_HEADER_PREFIX_SIZE:offset - map_offset + size]
+            crc = zlib.crc32(dex_view, zlib.crc32(dex_header_prefix))
+            dex_view.release()
+        finally:
+            dex_map.close()
+
+        encoded_name = name.encode('utf-8')
+        local_header_offset = self.position
+
+        self.write(struct.pack('<IHHHHHIIIHH', ZIP_LOCAL_FILE_HEADER_SIGNATURE, ZIP_VERSION, ZIP_UTF8_FLAG,
+                               ZIP_STORED, ZIP_DOS_TIME, ZIP_DOS_DATE, crc, size, size, len(encoded_name), 0))
+        self.write(encoded_name)
+        self.write(dex_header_prefix)
+        self.send(in_fd, offset + DEX_HEADER_PREFIX_SIZE, size - DEX_HEADER_PREFIX_SIZE)
+
+        self.central_directory.append((encoded_name, crc, size, local_header_offset))
+
+    def close(self):
+        central_directory_offset = self.position
+
+        for encoded_name, crc, size, local_header_offset in self.central_directory:
+            extra = b''
+            version = ZIP_VERSION
+
+            if local_header_offset >= ZIP_MAX_32:
+                extra = struct.pack('<HHQ', ZIP64_EXTRA_FIELD_ID, 8, local_header_offset)
+                local_header_offset = ZIP_MAX_32
+                version = ZIP64_VERSION
+
+            self.write(struct.pack('<IHHHHHHIIIHHHHHII', ZIP_CENTRAL_DIRECTORY_SIGNATURE, version, version,
+                                   ZIP_UTF8_FLAG, ZIP_STORED, ZIP_DOS_TIME, ZIP_DOS_DATE, crc, size, size,
+                                   len(encoded_name), len(extra), 0, 0, 0, 0, local_header_offset))
+            self.write(encoded_name)
+            self.write(extra)
+
+        central_directory_size = self.position - central_directory_offset
+        number_of_entries = len(self.central_directory)
+
+        if number_of_entries >= ZIP_MAX_16 or central_directory_offset >= ZIP_MAX_32 or \
+                central_directory_size >= ZIP_MAX_32:
+            zip64_end_offset = self.position
+            self.write(struct.pack('<IQHHIIQQQQ', ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE, 44,
+                                   ZIP64_VERSION, ZIP64_VERSION, 0, 0, number_of_entries, number_of_entries,
+                                   central_directory_size, central_directory_offset))
+            self.write(struct.pack('<IIQI', ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIGNATURE, 0, zip64_end_offset, 1))
+
+            number_of_entries = min(number_of_entries, ZIP_MAX_16)
+            central_directory_offset = min(central_directory_offset, ZIP_MAX_32)
+            central_directory_size = min(central_directory_size, ZIP_MAX_32)
+
+        self.write(struct.pack('<IHHHHIIH', ZIP_END_OF_CENTRAL_DIRECTORY_SIGNATURE, 0, 0,
+                               number_of_entries, number_of_entries,
+                               central_directory_size, central_directory_offset, 0))
+
+
+class TarSink(ArchiveSink):
+    '''
+    ustar archive, each dex is a regular file entry.
+    '''
+
+    def _header(self, name, size):
+        encoded_name = name.encode('utf-8')
+        prefix = b''
+
+        if len(encoded_name) > TAR_NAME_SIZE:
+            split = encoded_name.rfind(b'/', 0, TAR_PREFIX_SIZE + 1)
+            if split <= 0 or len(encoded_name) - split - 1 > TAR_NAME_SIZE:
+                raise ValueError("Name too long for a tar archive: %s" % name)
+            prefix = encoded_name[:split]
+            encoded_name = encoded_name[split + 1:]
+
+        header = bytearray(TAR_BLOCK_SIZE)
+        header[0:len(encoded_name)] = encoded_name
+        header[100:108] = b'0000644\0'
+        header[108:116] = b'0000000\0'
+        header[116:124] = b'0000000\0'
+        header[124:136] = b'%011o\0' % size
+        header[136:148] = b'00000000000\0'
+        header[148:156] = b' ' * 8
+        header[156:157] = b'0'
+        header[257:265] = b'ustar\x0000'
+        header[345:345 + len(prefix)] = prefix
+
+        header[148:156] = b'%06o\0 ' % sum(header)
+
+        return bytes(header)
+
+    def add_dex(self, name, in_fd, offset, size, dex_header_prefix):
+        if size < DEX_HEADER_PREFIX_SIZE:
+            raise ValueError("Incorrect size of dex %s (%d)" % (name, size))
+
+        self.write(self._header(name, size))
+        self.write(dex_header_prefix)
+        self.send(in_fd, offset + DEX_HEADER_PREFIX_SIZE, size - DEX_HEADER_PREFIX_SIZE)
+
+        if size % TAR_BLOCK_SIZE != 0:
+            self.write(b'\0' * (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE))
+
+    def close(self):
+        self.write(b'\0' * (TAR_BLOCK_SIZE * 2))
+
+
+def open_sink(fd, archive_format):
+    if archive_format == ZIP_FORMAT:
+        return ZipSink(fd)
+    elif archive_format == TAR_FORMAT:
+        return TarSink(fd)
+
+    raise ValueError("Unknown archive format %s" % (archive_format))
@@ -0,0 +1,185 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: AsyncExtractor.py
+#   Version: 0.7
+######################################################
+
+import os
+import asyncio
+import threading
+from concurrent.futures import ThreadPoolExecutor
+
+from Dextripador import Extractor
+from DexStore import DexStore
+from Decompression import strip_compressed_extension
+from ArchiveSink import DEX_HEADER_PREFIX_SIZE
+from DextractorException import *
+
+# the ELF parser keeps global state, inputs are parsed one at a time
+_PARSE_EXECUTOR = ThreadPoolExecutor(max_workers=1, thread_name_prefix='dextripador_parse')
+
+STREAM_CHUNK_SIZE = 1024 * 1024
+DEFAULT_CONCURRENCY = 4
+
+
+class AsyncExtractor():
+    '''
+    asyncio interface of Extractor, parsing and file I/O run in
+    executors so the event loop is never blocked:
+
+        async with await AsyncExtractor.open(path) as extractor:
+            async for dex_entry in extractor.iter_dex():
+                await extractor.extract_dex(dex_entry, output_name)
+
+    Inputs are parsed in a single thread shared by all the instances,
+    dex files are hashed and written in the executor given (the
+    default executor of the loop if None), where the native checksum
+    kernels run without the GIL.
+    '''
+
+    def __init__(self, extractor, executor=None):
+        self.extractor = extractor
+        self.executor = executor
+        # the python checksum fallback seeks the container files
+        self.lock = threading.Lock()
+
+    @classmethod
+    async def open(cls, path_to_odex, path_to_vdex="", executor=None):
+        '''
+        Decompress (if needed) and parse an odex/oat/vdex file.
+
+        :return: AsyncExtractor
+        '''
+        def load():
+            extractor = Extractor(path_to_odex, path_to_vdex)
+            try:
+                extractor.load()
+            except Exception:
+                extractor.close()
+                raise
+            return extractor
+
+        extractor = await asyncio.get_running_loop().run_in_executor(_PARSE_EXECUTOR, load)
+        return cls(extractor, executor)
+
+    async def __aenter__(self):
+        return self
+
+    async def __aexit__(self, exc_type, exc_value, traceback):
+        self.close()
+
+    def close(self):
+        self.extractor.close()
+
+    @property
+    def dex_entries(self):
+        return self.extractor.dex_entries
+
+    async def iter_dex(self):
+        '''
+        Async generator over the DexEntry of the input (already
+        parsed, nothing is read while iterating).
+        '''
+        for dex_entry in self.extractor.dex_entries:
+            yield dex_entry
+
+    async def _run(self, function, *args):
+        def locked():
+            with self.lock:
+                return function(*args)
+
+        return await asyncio.get_running_loop().run_in_executor(self.executor, locked)
+
+    async def extract_dex(self, dex_entry, output_name="", recalculate_dex_checksum=False, store=None):
+        '''
+        :param dex_entry: DexEntry or its index
+        '''
+        dex_number = dex_entry if isinstance(dex_entry, int) else self.extractor.dex_entries.index(dex_entry)
+
+        return await self._run(self.extractor.extract_dex, dex_number, output_name, recalculate_dex_checksum, store)
+
+    async def extract_all_dex(self, recalculate_dex_checksum=False, output_directory="", store=None):
+        return await self._run(self.extractor.extract_all_dex, recalculate_dex_checksum, output_directory, store)
+
+    async def verify_dex(self, dex_number):
+        return await self._run(self.extractor.verify_dex, dex_number)
+
+    async def write_dex(self, dex_entry, writer, recalculate_dex_checksum=False, chunk_size=STREAM_CHUNK_SIZE):
+        '''
+        Stream a dex to an asyncio StreamWriter (socket, pipe...) in
+        chunks read in the executor, waiting for the writer to drain
+        after each chunk so a slow reader bounds the memory used.
+        '''
+        if isinstance(dex_entry, int):
+            dex_entry = self.extractor.dex_entries[dex_entry]
+
+        container_fd = dex_entry.container_file.fileno()
+
+        writer.write(await self._run(self.extractor.get_dex_header_prefix, dex_entry, recalculate_dex_checksum))
+
+        offset = DEX_HEADER_PREFIX_SIZE
+        while offset < dex_entry.size:
+            size = min(chunk_size, dex_entry.size - offset)
+            chunk = await self._run(os.pread, container_fd, size, dex_entry.offset + offset)
+
+            if len(chunk) != size:
+                raise OffsetOutOfBoundException("Dex %s is out of its container file" % (dex_entry.name))
+
+            writer.write(chunk)
+            await writer.drain()
+            offset += size
+
+        await writer.drain()
+
+
+async def extract_files(paths, output_directory, concurrency=DEFAULT_CONCURRENCY,
+                        recalculate_dex_checksum=False, store_directory=None, executor=None):
+    '''
+    Extract all the dex files of many inputs, each one to its own
+    directory under output_directory, with at most concurrency inputs
+    open at a time. Results are yielded as the inputs finish, a slow
+    consumer stops new inputs from being opened.
+
+    :return: async generator of tuples (path, list of written files or the exception raised)
+    '''
+    store = DexStore(store_directory) if store_directory else None
+    results = asyncio.Queue(maxsize=concurrency)
+    slots = asyncio.Semaphore(concurrency)
+
+    async def extract_file(path):
+        try:
+            input_directory = os.path.join(output_directory, strip_compressed_extension(os.path.basename(path)))
+            os.makedirs(input_directory, exist_ok=True)
+
+            async with await AsyncExtractor.open(path, executor=executor) as extractor:
+                await extractor.extract_all_dex(recalculate_dex_checksum, input_directory, store)
+                result = [os.path.join(input_directory, dex_entry.name) for dex_entry in extractor.dex_entries]
+        except Exception as e:
+            result = e
+
+        await results.put((path, result))
+        slots.release()
+
+    async def producer():
+        tasks = []
+        for path in paths:
+            await slots.acquire()
+            tasks.append(asyncio.create_task(extract_file(path)))
+        await asyncio.gather(*tasks)
+        await results.put(None)
+
+    producer_task = asyncio.create_task(producer())
+
+    try:
+        while True:
+            result = await results.get()
+            if result is None:
+                break
+            yield result
+    finally:
+        if not producer_task.done():
+            producer_task.cancel()
+        await asyncio.gather(producer_task, return_exceptions=True)
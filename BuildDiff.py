@@ -0,0 +1,278 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: BuildDiff.py
+#   Version: 0.7
+######################################################
+
+import array
+import struct
+import hashlib
+import collections
+
+from FileFormats.DEX import DEX_NO_INDEX
+from FileFormats.OAT import FOOTPRINT_OUT_OF_BOUND
+
+DIFF_SECTION = "section"
+DIFF_DEX = "dex"
+DIFF_CLASS = "class"
+DIFF_METHOD = "method"
+
+DIFF_ADDED = "ADDED"
+DIFF_REMOVED = "REMOVED"
+DIFF_CHANGED = "CHANGED"
+
+# sections without content in the file
+SHT_NOBITS = 8
+
+HASH_SIZE = 8
+HASH_BLOCK_SIZE = 1024 * 1024
+ACCESS_FLAGS_LAYOUT = struct.Struct('<I')
+# insns_size of a code_item and its offset to the instructions
+CODE_ITEM_INSNS_SIZE_OFFSET = 12
+CODE_ITEM_INSNS_OFFSET = 16
+COMPACT_DEX_MAGIC = b'cdex'
+
+Difference = collections.namedtuple('Difference', ['state', 'level', 'name', 'detail'])
+
+# method of a class: signature, access_flags, hash of its bytecode and method_idx
+ClassMethod = collections.namedtuple('ClassMethod', ['signature', 'access_flags', 'bytecode_hash', 'method_idx'])
+
+
+def content_hash(*parts):
+    content = hashlib.blake2b(digest_size=HASH_SIZE)
+    for part in parts:
+        content.update(part)
+    return content.digest()
+
+
+def section_hashes(extractor):
+    '''
+    Hash of every section of the input: the ELF sections with
+    content (when the native ELF parser keeps the file mapped),
+    else the whole oat file, and the vdex file.
+
+    :return: dictionary of section name and (size, hash)
+    '''
+    sections = {}
+
+    if extractor.oat_view is not None:
+        if extractor.elf_binary is not None:
+            for section in extractor.elf_binary.sections:
+                if section.sh_type != SHT_NOBITS and section.sh_size > 0:
+                    data = extractor.oat_view[section.sh_offset:section.sh_offset + section.sh_size]
+                    sections[section.sh_name] = (section.sh_size, content_hash(data))
+                    data.release()
+        else:
+            sections["oat"] = (len(extractor.oat_view), content_hash(extractor.oat_view))
+
+    if extractor.vdex_file is not None:
+        vdex_hash = hashlib.blake2b(digest_size=HASH_SIZE)
+        extractor.vdex_file.seek(0)
+
+        for block in iter(lambda: extractor.vdex_file.read(HASH_BLOCK_SIZE), b''):
+            vdex_hash.update(block)
+
+        sections["vdex"] = (extractor.vdex_file_size, vdex_hash.digest())
+
+    return sections
+
+
+def dex_keys(extractor):
+    '''
+    Dex files of an input by name (with the number of the same
+    name before it for repeated names), the signature of the
+    header says if a dex changed without hashing it.
+
+    :return: dictionary of name and (dex_number, signature, size)
+    '''
+    dex_files = {}
+    seen = collections.Counter()
+
+    for dex_number, dex_entry in enumerate(extractor.dex_entries):
+        name = dex_entry.name if seen[dex_entry.name] == 0 else "%s#%d" % (dex_entry.name, seen[dex_entry.name])
+        seen[dex_entry.name] += 1
+        dex_files[name] = (dex_number, bytes(dex_entry.dex_file.signature), dex_entry.size)
+
+    return dex_files
+
+
+def bytecode(dex_view, code_off):
+    '''
+    :return: instructions of the code_item at code_off (empty
+             for abstract and native methods)
+    '''
+    if code_off == 0:
+        return b''
+
+    insns_size, = struct.unpack_from('<I', dex_view, code_off + CODE_ITEM_INSNS_SIZE_OFFSET)
+    start = code_off + CODE_ITEM_INSNS_OFFSET
+
+    return bytes(dex_view[start:start + insns_size * 2])
+
+
+def class_hashes(extractor, dex_number):
+    '''
+    Hash of every class of a dex over its access flags, superclass
+    and the signature, access flags and bytecode of its methods.
+    Indexes of the dex are not hashed (they change with any other
+    class) but the bytecode refers to them, a change of the string
+    or method tables changes the classes using them. The code items
+    of compact dex files are not hashed (their layout is not parsed),
+    their methods are only compared by the compiled code.
+
+    :return: dictionary of descriptor and (hash, class_def_idx, list of ClassMethod)
+    '''
+    index = extractor.get_dex_index(dex_number)
+    dex_view = extractor.get_dex_view(dex_number)
+    class_data = index.class_data()
+    descriptors = extractor.get_class_descriptors(dex_number)
+    signatures = extractor.get_method_signatures(dex_number)
+    compact = bytes(extractor.dex_entries[dex_number].dex_file.magic[:4]) == COMPACT_DEX_MAGIC
+    classes = {}
+
+    for class_def_idx, class_def in enumerate(index.class_defs):
+        start, end = class_data.class_methods[class_def_idx], class_data.class_methods[class_def_idx + 1]
+        superclass = b''
+        methods = []
+
+        if class_def.superclass_idx != DEX_NO_INDEX:
+            superclass = index.type_descriptor(class_def.superclass_idx)
+
+        for position in range(start, end):
+            methods.append(ClassMethod(signatures[position], class_data.access_flags[position],
+                                       content_hash(b'' if compact else bytecode(dex_view, class_data.code_off[position])),
+                                       class_data.method_idx[position]))
+
+        class_hash = content_hash(ACCESS_FLAGS_LAYOUT.pack(class_def.access_flags), superclass,
+                                  *[method.signature.encode('utf-8') + ACCESS_FLAGS_LAYOUT.pack(method.access_flags) +
+                                    method.bytecode_hash for method in methods])
+
+        classes.setdefault(descriptors[class_def_idx], (class_hash, class_def_idx, methods))
+
+    dex_view.release()
+
+    return classes
+
+
+def compiled_code_hashes(extractor, descriptor, methods):
+    '''
+    Hash of the compiled code of the methods of a class, the code
+    size is read from the method header of each compiled method.
+
+    :return: list with the hash of each method (None if not compiled)
+    '''
+    if extractor.oatdata is None:
+        return [None] * len(methods)
+
+    code_offsets = extractor.get_compiled_code_index().code_offsets([(descriptor, method.method_idx)
+                                                                     for method in methods])
+    compiled = [i for i, code_offset in enumerate(code_offsets) if code_offset is not None]
+    hashes = [None] * len(methods)
+
+    columns, _ = extractor.get_method_headers(array.array('I', [code_offsets[i] for i in compiled]))
+    code_size, flags = columns[0], columns[-1]
+
+    for j, i in enumerate(compiled):
+        if flags[j] & FOOTPRINT_OUT_OF_BOUND:
+            hashes[i] = b'out_of_bound'
+            continue
+
+        code = extractor.get_compiled_code(code_offsets[i], code_size[j])
+        hashes[i] = content_hash(code)
+        code.release()
+
+    return hashes
+
+
+def diff_methods(old, new, descriptor, old_methods, new_methods):
+    old_code = dict(zip([method.signature for method in old_methods],
+                        compiled_code_hashes(old, descriptor, old_methods)))
+    new_code = dict(zip([method.signature for method in new_methods],
+                        compiled_code_hashes(new, descriptor, new_methods)))
+    old_methods = {method.signature: method for method in old_methods}
+    new_methods = {method.signature: method for method in new_methods}
+
+    for signature in sorted(old_methods.keys() - new_methods.keys()):
+        yield Difference(DIFF_REMOVED, DIFF_METHOD, signature, "")
+
+    for signature in sorted(new_methods.keys() - old_methods.keys()):
+        yield Difference(DIFF_ADDED, DIFF_METHOD, signature, "")
+
+    for signature in sorted(old_methods.keys() & new_methods.keys()):
+        changes = []
+
+        if old_methods[signature].access_flags != new_methods[signature].access_flags:
+            changes.append("access_flags")
+        if old_methods[signature].bytecode_hash != new_methods[signature].bytecode_hash:
+            changes.append("bytecode")
+        if old_code[signature] != new_code[signature]:
+            changes.append("code" if old_code[signature] is not None and new_code[signature] is not None
+                           else "compiled" if new_code[signature] is not None else "not_compiled")
+
+        if len(changes) > 0:
+            yield Difference(DIFF_CHANGED, DIFF_METHOD, signature, ",".join(changes))
+
+
+def diff_classes(old, new, old_dex_number, new_dex_number):
+    old_classes = class_hashes(old, old_dex_number)
+    new_classes = class_hashes(new, new_dex_number)
+
+    for descriptor in sorted(old_classes.keys() - new_classes.keys()):
+        yield Difference(DIFF_REMOVED, DIFF_CLASS, descriptor, "")
+
+    for descriptor in sorted(new_classes.keys() - old_classes.keys()):
+        yield Difference(DIFF_ADDED, DIFF_CLASS, descriptor, "")
+
+    for descriptor in sorted(old_classes.keys() & new_classes.keys()):
+        if old_classes[descriptor][0] == new_classes[descriptor][0]:
+            continue
+
+        yield Difference(DIFF_CHANGED, DIFF_CLASS, descriptor, "")
+        yield from diff_methods(old, new, descriptor, old_classes[descriptor][2], new_classes[descriptor][2])
+
+
+def diff_builds(old, new):
+    '''
+    Compare two loaded inputs (Extractor) from the top: sections,
+    dex files (by name and signature), classes of the changed dex
+    (by hash of their content) and methods of the changed classes
+    (bytecode and compiled code). Only the parts whose hashes
+    differ are compared in the next level.
+
+    :return: generator of Difference (state, level, name, detail)
+    '''
+    old_sections = section_hashes(old)
+    new_sections = section_hashes(new)
+
+    for name in sorted(old_sections.keys() - new_sections.keys()):
+        yield Difference(DIFF_REMOVED, DIFF_SECTION, name, "size=%d" % old_sections[name][0])
+
+    for name in sorted(new_sections.keys() - old_sections.keys()):
+        yield Difference(DIFF_ADDED, DIFF_SECTION, name, "size=%d" % new_sections[name][0])
+
+    for name in sorted(old_sections.keys() & new_sections.keys()):
+        if old_sections[name] != new_sections[name]:
+            yield Difference(DIFF_CHANGED, DIFF_SECTION, name,
+                             "size=%d->%d" % (old_sections[name][0], new_sections[name][0]))
+
+    old_dex_files = dex_keys(old)
+    new_dex_files = dex_keys(new)
+
+    for name in sorted(old_dex_files.keys() - new_dex_files.keys()):
+        yield Difference(DIFF_REMOVED, DIFF_DEX, name, "")
+
+    for name in sorted(new_dex_files.keys() - old_dex_files.keys()):
+        yield Difference(DIFF_ADDED, DIFF_DEX, name, "")
+
+    for name in sorted(old_dex_files.keys() & new_dex_files.keys()):
+        old_dex_number, old_signature, old_size = old_dex_files[name]
+        new_dex_number, new_signature, new_size = new_dex_files[name]
+
+        if old_signature == new_signature and old_size == new_size:
+            continue
+
+        yield Difference(DIFF_CHANGED, DIFF_DEX, name, "size=%d->%d" % (old_size, new_size))
+        yield from diff_classes(old, new, old_dex_number, new_dex_number)
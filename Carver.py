@@ -0,0 +1,416 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: Carver.py
+#   Version: 0.7
+######################################################
+
+import os
+import re
+import mmap
+import zlib
+import array
+import bisect
+import struct
+import collections
+
+from FileWork import *
+from DextractorException import *
+from FileFormats.DEX import DEXHeader, DEX_ENDIAN_CONSTANT, DEX_SIGNATURE_OFFSET
+from FileFormats.VDEX import VDEXFile, VDEX_MAGIC_VERSION_LAYOUT, VDEX_V006_LAYOUT, VDEX_V019_LAYOUT, \
+    VDEX_V021_LAYOUT, VDEX_DEX_SECTION_HEADER_LAYOUT, VDEX_VERSION_SECTIONS, VDEX_VERSION_BOOTCLASSPATH, \
+    VDEX_VERSION_SECTION_TABLE
+from FileFormats.OAT import OATHeader, read_method_headers, FOOTPRINT_OUT_OF_BOUND
+from FileFormats.OATHeaderLayout import OAT_METHOD_HEADER_LAYOUT_BY_VERSION
+
+try:
+    from elfparser_e.python_binding.carve import carve_scan_fd
+    USE_NATIVE_CARVE = True
+except (ImportError, OSError):
+    USE_NATIVE_CARVE = False
+
+# kinds of magics, as in elfparser_e/headers/carve.h
+CARVE_OAT = 1
+CARVE_VDEX = 2
+CARVE_DEX = 3
+CARVE_ELF = 4
+
+CARVE_KIND_NAMES = {CARVE_OAT: "oat", CARVE_VDEX: "vdex", CARVE_DEX: "dex", CARVE_ELF: "elf"}
+CARVE_EXTENSIONS = {CARVE_OAT: ".oat", CARVE_VDEX: ".vdex", CARVE_DEX: ".dex", CARVE_ELF: ".odex"}
+
+# same magics for the scan without elfparser_e, the mapping is
+# searched at once and the kernel reads it ahead. The ELF magic is
+# 7 bytes, the 8th one is only looked ahead (a magic can start at it)
+# as carve.c needs CARVE_MAGIC_SIZE bytes to check any magic
+CARVE_PATTERN = re.compile(rb'oat\n[0-9]{3}\x00|vdex[0-9]{3}\x00|dex\n0[0-9]{2}\x00|\x7fELF[\x01\x02]\x01\x01(?=.)', re.DOTALL)
+CARVE_PATTERN_KINDS = {ord('o'): CARVE_OAT, ord('v'): CARVE_VDEX, ord('d'): CARVE_DEX, 0x7f: CARVE_ELF}
+
+DEX_HEADER_SIZE = 0x70
+DEX_MAGICS = (b'dex\n', b'cdex')
+
+# e_type to e_shstrndx of the ELF header, after e_ident
+ELF_CLASS_OFFSET = 4
+ELF32_HEADER_LAYOUT = struct.Struct('<16xHHIIIIIHHHHHH')
+ELF64_HEADER_LAYOUT = struct.Struct('<16xHHIQQQIHHHHHH')
+# p_offset and p_filesz of the program headers
+ELF32_PHDR_LAYOUT = struct.Struct('<4xI4x4xI12x')
+ELF64_PHDR_LAYOUT = struct.Struct('<8xQ8x8xQ16x')
+ELF32_SHDR_SIZE = 40
+ELF64_SHDR_SIZE = 64
+
+# the parsers read random bytes of the input at the candidates, any
+# failure of them only rejects the candidate
+CARVE_ERRORS = (Exception,)
+
+# image found: kind, offset and size in the input, version, detail
+# for the report and offset of the vdex paired with an oat (or None)
+CarvedImage = collections.namedtuple('CarvedImage', ['kind', 'offset', 'size', 'version', 'detail', 'vdex'])
+
+
+def scan_magics(fd, size):
+    '''
+    :return: generator of (offset, kind, version) of the magics of
+             the first size bytes of fd, natively by windows if the
+             elfparser_e library is available
+    '''
+    if USE_NATIVE_CARVE:
+        yield from carve_scan_fd(fd, 0, size)
+        return
+
+    if size == 0:
+        return
+
+    with mmap.mmap(fd, size, access=mmap.ACCESS_READ) as input_mmap:
+        input_mmap.madvise(mmap.MADV_SEQUENTIAL)
+
+        for match in CARVE_PATTERN.finditer(input_mmap):
+            magic = match.group()
+            kind = CARVE_PATTERN_KINDS[magic[0]]
+            version = (32 if magic[ELF_CLASS_OFFSET] == 1 else 64) if kind == CARVE_ELF else int(magic[-4:-1])
+
+            yield (match.start(), kind, version)
+
+
+def vdex_image_size(vdex):
+    '''
+    Size of a vdex from its header: the sum of its sections
+    (the section table since 027).
+    '''
+    if vdex.version >= VDEX_VERSION_SECTION_TABLE:
+        return max(offset + size for offset, size in vdex.sections.values())
+
+    checksums_size = vdex.number_of_dex_files * UINTEGER_SIZE
+
+    if vdex.version < VDEX_VERSION_SECTIONS:
+        return VDEX_MAGIC_VERSION_LAYOUT.size + VDEX_V006_LAYOUT.size + checksums_size + \
+            vdex.dex_size + vdex.verifier_deps_size + vdex.quickening_info_size
+
+    size = VDEX_MAGIC_VERSION_LAYOUT.size + VDEX_V019_LAYOUT.size + checksums_size + vdex.verifier_deps_size
+
+    if vdex.version >= VDEX_VERSION_BOOTCLASSPATH:
+        size += VDEX_V021_LAYOUT.size + vdex.bootclasspath_checksums_size + vdex.class_loader_context_size
+
+    if c_string(vdex.dex_section_version) != b'000':
+        size += VDEX_DEX_SECTION_HEADER_LAYOUT.size + vdex.dex_size + vdex.dex_shared_data_size + \
+            vdex.quickening_info_size
+
+    # the dex files must be inside of it
+    return max([size] + [offset + dex_size for offset, dex_size in zip(vdex.dex_files_offsets, vdex.dex_files_sizes)])
+
+
+class Carver():
+    '''
+    Find the oat, vdex, dex and ELF (odex) images stored anywhere in a
+    raw input: a partition dump, a memory capture or a truncated file.
+
+    The input is scanned once for the magics of the four formats, and
+    every candidate is checked with the header parsers of the tool over
+    the mapping of the input. The size of an image comes from its
+    headers: file_size of a dex, the sections of a vdex, the program
+    and section headers of an ELF and the last structure (dex file,
+    class header or compiled code) of a raw oat. The candidates inside
+    of an image already found are part of it.
+
+    The oat files whose dex files are in a vdex are paired with a vdex
+    of the input by their dex checksums (or with the closest vdex
+    where their dex files are found).
+    '''
+
+    def __init__(self, path):
+        self.path = path
+        self.fd = os.open(path, os.O_RDONLY)
+        # block devices have no size in stat
+        self.size = os.lseek(self.fd, 0, os.SEEK_END)
+        self.mmap = None
+        self.view = None
+        self.candidates = []
+        self.vdex_images = collections.OrderedDict()
+        self.invalid = []
+
+        if self.size > 0:
+            self.mmap = mmap.mmap(self.fd, self.size, access=mmap.ACCESS_READ)
+            self.view = memoryview(self.mmap)
+
+    def scan(self):
+        self.candidates = list(scan_magics(self.fd, self.size))
+        return len(self.candidates)
+
+    def __dex_image(self, offset):
+        remaining = self.size - offset
+        dex = DEXHeader(MemoryFile(self.view[offset:]))
+        dex.parse_header(0, remaining)
+
+        if dex.header_size != DEX_HEADER_SIZE or dex.endian_tag != DEX_ENDIAN_CONSTANT:
+            raise IncorrectMagicException("Incorrect header size or endian tag")
+
+        if dex.file_size < DEX_HEADER_SIZE or dex.file_size > remaining:
+            raise OffsetOutOfBoundException("Dex file size (0x%08X) out of the input" % (dex.file_size))
+
+        # the tables must be inside of the dex, not only of the input
+        dex.parse_header(0, dex.file_size)
+
+        checksum = zlib.adler32(self.view[offset + DEX_SIGNATURE_OFFSET:offset + dex.file_size])
+
+        return dex.file_size, "checksum" if checksum == dex.checksum else "bad_checksum"
+
+    def __vdex_image(self, offset):
+        remaining = self.size - offset
+        vdex = VDEXFile(MemoryFile(self.view[offset:]))
+        vdex.parse_header(0, remaining)
+        vdex.parse_dex_headers(remaining)
+
+        for dex_file in vdex.dex_files:
+            if dex_file is not None and bytes(dex_file.magic[:4]) not in DEX_MAGICS:
+                raise IncorrectMagicException("Incorrect magic of a dex of the vdex")
+
+        size = vdex_image_size(vdex)
+
+        if size > remaining:
+            raise OffsetOutOfBoundException("Vdex size (0x%08X) out of the input" % (size))
+
+        return size, vdex
+
+    def __elf_image_size(self, offset):
+        '''
+        Size of an ELF from its headers, the end of the last segment
+        or of the section headers.
+        '''
+        remaining = self.size - offset
+
+        if self.view[offset + ELF_CLASS_OFFSET] == 1:
+            header_layout, phdr_layout, shdr_size = ELF32_HEADER_LAYOUT, ELF32_PHDR_LAYOUT, ELF32_SHDR_SIZE
+        else:
+            header_layout, phdr_layout, shdr_size = ELF64_HEADER_LAYOUT, ELF64_PHDR_LAYOUT, ELF64_SHDR_SIZE
+
+        (_, _, _, _, e_phoff, e_shoff, _, e_ehsize, e_phentsize, e_phnum, e_shentsize, e_shnum, _) = \
+            header_layout.unpack_from(self.view, offset)
+
+        if e_ehsize != header_layout.size or (e_phnum > 0 and e_phentsize != phdr_layout.size) or \
+                (e_shnum > 0 and e_shentsize != shdr_size):
+            raise IncorrectMagicException("Incorrect sizes of the ELF headers")
+
+        size = max(e_ehsize, e_phoff + e_phnum * e_phentsize, e_shoff + e_shnum * e_shentsize)
+
+        if e_phoff + e_phnum * e_phentsize > remaining:
+            raise OffsetOutOfBoundException("ELF program headers out of the input")
+
+        for i in range(e_phnum):
+            p_offset, p_filesz = phdr_layout.unpack_from(self.view, offset + e_phoff + i * e_phentsize)
+            size = max(size, p_offset + p_filesz)
+
+        if size > remaining:
+            raise OffsetOutOfBoundException("ELF size (0x%08X) out of the input" % (size))
+
+        return size
+
+    def __oat_header(self, base, size, oatdata_offset, vdex_offset=None, vdex_size=0):
+        '''
+        OATHeader of the oat at oatdata_offset of the image at base,
+        with the dex files of a vdex image if vdex_offset is given.
+        '''
+        oat_file = MemoryFile(self.view[base:base + size])
+        oat_file.seek(oatdata_offset, FILE_BEGIN)
+        vdex_file = None
+
+        if vdex_offset is not None:
+            vdex_file = MemoryFile(self.view[vdex_offset:vdex_offset + vdex_size])
+
+        oatdata = OATHeader(oat_file)
+        oatdata.parse_header(oatdata_offset, size, vdex_file, vdex_size)
+
+        for oat_dex_file in oatdata.OATDexFileHeaders:
+            if oat_dex_file.dex_file is not None and bytes(oat_dex_file.dex_file.magic[:4]) not in DEX_MAGICS:
+                raise IncorrectMagicException("Incorrect magic of a dex of the oat")
+
+        return oatdata
+
+    def __paired_oat_header(self, base, size, oatdata_offset):
+        '''
+        :return: tuple (OATHeader, offset of the paired vdex or None)
+        '''
+        try:
+            return self.__oat_header(base, size, oatdata_offset), None
+        except CARVE_ERRORS as error:
+            version = c_string(self.view[base + oatdata_offset + 4:base + oatdata_offset + 8])
+
+            if version not in OATHeader.VDEX_VERSIONS:
+                raise
+
+            paired = []
+
+            # the dex checksums of the vdex are the ones of the oat, else the
+            # closest vdex where the dex files of the oat are found is used
+            for vdex_offset, (vdex_size, vdex) in self.vdex_images.items():
+                try:
+                    oatdata = self.__oat_header(base, size, oatdata_offset, vdex_offset, vdex_size)
+                except CARVE_ERRORS:
+                    continue
+
+                if [oat_dex_file.dex_file_location_checksum
+                        for oat_dex_file in oatdata.OATDexFileHeaders] == list(vdex.dex_checksums):
+                    return oatdata, vdex_offset
+
+                paired.append((abs(vdex_offset - base), vdex_offset, oatdata))
+
+            if len(paired) > 0:
+                _, vdex_offset, oatdata = min(paired, key=lambda pair: pair[0])
+                return oatdata, vdex_offset
+
+            raise IncorrectMagicException("%s (no vdex of the input matches it)" % (str(error)))
+
+    def __raw_oat_size(self, offset, oatdata, vdex_offset):
+        '''
+        Size of an oat without ELF: the end of its last dex file,
+        class header or compiled method (from its method header).
+        '''
+        size = max([oatdata.executable_offset] + [oat_dex_file.next_header_offset
+                                                  for oat_dex_file in oatdata.OATDexFileHeaders])
+        code_offsets = array.array('I')
+
+        for oat_dex_file in oatdata.OATDexFileHeaders:
+            if oat_dex_file.dex_file is not None and vdex_offset is None:
+                size = max(size, oat_dex_file.dex_file_pointer + oat_dex_file.dex_file.file_size)
+
+            for oatclass_header in oat_dex_file.OATClassHeader.values():
+                size = max(size, oatclass_header.methods_offsets_offset +
+                           len(oatclass_header.methods_offsets) * UINTEGER_SIZE)
+                code_offsets.extend(oatclass_header.methods_offsets)
+
+        layout = OAT_METHOD_HEADER_LAYOUT_BY_VERSION.get(c_string(oatdata.version))
+
+        if layout is not None and len(code_offsets) > 0:
+            columns, _ = read_method_headers(self.view, offset, self.size - offset, layout, code_offsets)
+            code_size, flags = columns[0], columns[-1]
+
+            for i in range(len(code_offsets)):
+                if not flags[i] & FOOTPRINT_OUT_OF_BOUND:
+                    size = max(size, (code_offsets[i] & ~1) + code_size[i])
+
+        return size
+
+    def carve(self):
+        '''
+        Check the candidates of the scan in order of offset.
+
+        :return: list of CarvedImage, the rejected candidates are
+                 in self.invalid as (kind, offset, reason)
+        '''
+        images = []
+        image_end = 0
+        oat_offsets = [offset for offset, kind, _ in self.candidates if kind == CARVE_OAT]
+        self.vdex_images.clear()
+        self.invalid = []
+
+        # vdex are checked first, the oat files are paired with them
+        for offset, kind, version in self.candidates:
+            if kind == CARVE_VDEX:
+                try:
+                    self.vdex_images[offset] = self.__vdex_image(offset)
+                except CARVE_ERRORS as error:
+                    self.invalid.append((kind, offset, str(error)))
+
+        for offset, kind, version in self.candidates:
+            if offset < image_end:
+                continue
+
+            try:
+                vdex_offset = None
+
+                if kind == CARVE_DEX:
+                    size, detail = self.__dex_image(offset)
+                elif kind == CARVE_VDEX:
+                    if offset not in self.vdex_images:
+                        continue
+                    size, vdex = self.vdex_images[offset]
+                    detail = "%d dex" % (len([dex_size for dex_size in vdex.dex_files_sizes if dex_size > 0]))
+                elif kind == CARVE_ELF:
+                    size = self.__elf_image_size(offset)
+                    i = bisect.bisect_left(oat_offsets, offset)
+
+                    if i == len(oat_offsets) or oat_offsets[i] >= offset + size:
+                        raise OatdataNotFoundException("ELF without oatdata")
+
+                    oatdata, vdex_offset = self.__paired_oat_header(offset, size, oat_offsets[i] - offset)
+                    version = int(c_string(oatdata.version))
+                    detail = "%d dex" % (len(oatdata.OATDexFileHeaders))
+                else:
+                    oatdata, vdex_offset = self.__paired_oat_header(offset, self.size - offset, 0)
+                    size = self.__raw_oat_size(offset, oatdata, vdex_offset)
+                    detail = "%d dex" % (len(oatdata.OATDexFileHeaders))
+            except CARVE_ERRORS as error:
+                self.invalid.append((kind, offset, str(error)))
+                continue
+
+            images.append(CarvedImage(kind, offset, size, version, detail, vdex_offset))
+            image_end = offset + size
+
+        return images
+
+    def write(self, offset, size, path):
+        '''
+        Copy size bytes at offset of the input to path inside of the
+        kernel, the copy is written to a temporary name first.
+        '''
+        temporary_path = path + ".part"
+        out_fd = os.open(temporary_path, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644)
+
+        try:
+            while size > 0:
+                sent = os.sendfile(out_fd, self.fd, offset, size)
+                if sent == 0:
+                    raise IOError("Unexpected end of input file at offset 0x%08X" % offset)
+                offset += sent
+                size -= sent
+        except BaseException:
+            os.close(out_fd)
+            os.remove(temporary_path)
+            raise
+
+        os.close(out_fd)
+        os.replace(temporary_path, path)
+
+    def close(self):
+        self.vdex_images = {}
+
+        if self.view is not None:
+            self.view.release()
+            self.view = None
+
+        if self.mmap is not None:
+            try:
+                self.mmap.close()
+            except BufferError:
+                # views of the parsers are still alive (in the traceback of
+                # an exception), the mapping is closed once they are freed
+                pass
+            self.mmap = None
+
+        os.close(self.fd)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.close()
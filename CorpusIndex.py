@@ -0,0 +1,313 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: CorpusIndex.py
+#   Version: 0.7
+######################################################
+
+import os
+import mmap
+import struct
+import bisect
+import hashlib
+import tempfile
+
+from DextractorException import *
+
+CORPUS_INDEX_MAGIC = b"dxtcidx\x00"
+CORPUS_INDEX_VERSION = 1
+CORPUS_INDEX_METHODS_FLAG = 0x1
+
+CORPUS_INDEX_HEADER = struct.Struct('<8sIIIIII6Q')
+CORPUS_INDEX_FILE = struct.Struct('<QIIQ')
+CORPUS_INDEX_TERM = struct.Struct('<QIII4x')
+CORPUS_INDEX_ALIGNMENT = 8
+
+# about 1% of false positives with 10 bits per term
+BLOOM_HASHES = 7
+BLOOM_BITS_PER_TERM = 10
+BLOOM_MINIMUM_BITS = 64
+
+# separator of the class and the method in a method signature
+METHOD_SEPARATOR = "->"
+
+
+def term_hashes(term):
+    '''
+    :return: two 64 bit hashes of a term, the first one keys the
+             inverted index, both give the bits of the Bloom filters
+    '''
+    return struct.unpack('<QQ', hashlib.blake2b(term, digest_size=16).digest())
+
+
+def bloom_positions(hashes, bits):
+    first, second = hashes
+    second |= 1
+
+    return [(first + i * second) & (bits - 1) for i in range(BLOOM_HASHES)]
+
+
+def bloom_size(number_of_terms):
+    '''
+    :return: bits of a Bloom filter, a power of two with at
+             least BLOOM_BITS_PER_TERM bits per term
+    '''
+    bits = BLOOM_MINIMUM_BITS
+    while bits < number_of_terms * BLOOM_BITS_PER_TERM:
+        bits <<= 1
+
+    return bits
+
+
+def align(size):
+    return (size + CORPUS_INDEX_ALIGNMENT - 1) & ~(CORPUS_INDEX_ALIGNMENT - 1)
+
+
+class CorpusIndexWriter():
+    '''
+    Build a corpus index in memory and write it at once, the index
+    is written to a temporary file which replaces index_path.
+    '''
+
+    def __init__(self, index_path, methods=False):
+        self.index_path = index_path
+        self.methods = methods
+        self.files = []
+        self.postings = {}
+
+    def add_file(self, path, classes, methods=()):
+        '''
+        :param classes: class descriptors of every dex of the file
+        :param methods: method signatures, indexed with methods=True
+        '''
+        file_id = len(self.files)
+        terms = set(descriptor.encode('utf-8') for descriptor in classes)
+
+        for term in terms:
+            self.postings.setdefault(term, []).append(file_id)
+
+        if self.methods:
+            terms.update(signature.encode('utf-8') for signature in methods)
+
+        bits = bloom_size(len(terms))
+        bloom = bytearray(bits // 8)
+
+        for term in terms:
+            for position in bloom_positions(term_hashes(term), bits):
+                bloom[position >> 3] |= 1 << (position & 7)
+
+        self.files.append((path.encode('utf-8'), bits, bytes(bloom)))
+
+    def write(self):
+        terms = sorted((term_hashes(term)[0], term) for term in self.postings)
+        strings = bytearray()
+        postings = []
+        blooms = bytearray()
+        files_table = bytearray()
+        terms_table = bytearray()
+
+        for path, bits, bloom in self.files:
+            files_table += CORPUS_INDEX_FILE.pack(len(strings), len(path), bits, len(blooms))
+            strings += path
+            blooms += bloom
+
+        for _, term in terms:
+            term_postings = self.postings[term]
+            terms_table += CORPUS_INDEX_TERM.pack(len(strings), len(term), len(postings), len(term_postings))
+            strings += term
+            postings += term_postings
+
+        hashes_table = struct.pack('<%dQ' % len(terms), *[term_hash for term_hash, _ in terms])
+        postings_table = struct.pack('<%dI' % len(postings), *postings)
+
+        offset = CORPUS_INDEX_HEADER.size
+        offsets = []
+
+        for section in (files_table, hashes_table, terms_table, postings_table, blooms, strings):
+            offset = align(offset)
+            offsets.append(offset)
+            offset += len(section)
+
+        header = CORPUS_INDEX_HEADER.pack(CORPUS_INDEX_MAGIC, CORPUS_INDEX_VERSION,
+                                          CORPUS_INDEX_METHODS_FLAG if self.methods else 0,
+                                          len(self.files), len(terms), BLOOM_HASHES, 0, *offsets)
+
+        index_directory = os.path.dirname(os.path.abspath(self.index_path))
+        fd, temporary_path = tempfile.mkstemp(dir=index_directory)
+
+        try:
+            # mkstemp creates it only readable by its owner
+            os.fchmod(fd, 0o644)
+
+            with os.fdopen(fd, 'wb') as index_file:
+                index_file.write(header)
+
+                for section_offset, section in zip(offsets, (files_table, hashes_table, terms_table,
+                                                             postings_table, blooms, strings)):
+                    index_file.write(b'\x00' * (section_offset - index_file.tell()))
+                    index_file.write(section)
+
+            os.replace(temporary_path, self.index_path)
+        except BaseException:
+            os.remove(temporary_path)
+            raise
+
+        return len(self.files), len(terms)
+
+
+class CorpusIndex():
+    '''
+    Inverted index of the classes of a corpus of odex/oat/vdex files, to
+    know which files contain a class without opening them again. The
+    index is one file used through mmap:
+
+        header
+        files       (path, bloom filter) per indexed file
+        hashes      sorted 64 bit hashes of the terms
+        terms       (term, postings) in the order of hashes
+        postings    uint32 ids of the files with each term
+        blooms      Bloom filter of each file
+        strings     paths and terms
+
+    Class descriptors are in the inverted index. Method signatures
+    (Lcom/a/A;->foo(I)V) are only added to the Bloom filters of the
+    files, so a query for a method gives the files which may have it.
+
+    The index is used mapped in memory, nothing is read until a term
+    is looked for: a binary search in the hashes of the terms for
+    classes, a check of the Bloom filter of every file for methods.
+    '''
+
+    def __init__(self, index_path):
+        self.index_file = open(index_path, 'rb')
+        self.index_mmap = None
+        self.view = None
+        self.hashes = None
+
+        try:
+            self.index_mmap = mmap.mmap(self.index_file.fileno(), 0, access=mmap.ACCESS_READ)
+            self.view = memoryview(self.index_mmap)
+            self.__parse_header()
+        except (ValueError, struct.error, IncorrectMagicException, OffsetOutOfBoundException):
+            self.close()
+            raise
+
+    def __parse_header(self):
+        (magic, version, self.flags, self.number_of_files, self.number_of_terms, self.bloom_hashes, _,
+         self.files_offset, hashes_offset, self.terms_offset, self.postings_offset,
+         self.blooms_offset, self.strings_offset) = CORPUS_INDEX_HEADER.unpack_from(self.view, 0)
+
+        if magic != CORPUS_INDEX_MAGIC or version != CORPUS_INDEX_VERSION:
+            raise IncorrectMagicException("Not a corpus index (or not version %d)" % (CORPUS_INDEX_VERSION))
+
+        if self.bloom_hashes != BLOOM_HASHES:
+            raise IncorrectMagicException("Corpus index with %d Bloom hashes" % (self.bloom_hashes))
+
+        if self.files_offset + self.number_of_files * CORPUS_INDEX_FILE.size > len(self.view) or \
+                hashes_offset + self.number_of_terms * 8 > len(self.view) or \
+                self.terms_offset + self.number_of_terms * CORPUS_INDEX_TERM.size > len(self.view) or \
+                self.strings_offset > len(self.view):
+            raise OffsetOutOfBoundException("Tables of the corpus index out of file bound")
+
+        self.hashes = self.view[hashes_offset:hashes_offset + self.number_of_terms * 8].cast('Q')
+
+    @property
+    def has_methods(self):
+        return (self.flags & CORPUS_INDEX_METHODS_FLAG) != 0
+
+    def __string(self, offset, length):
+        offset += self.strings_offset
+
+        if offset + length > len(self.view):
+            raise OffsetOutOfBoundException("String of the corpus index out of file bound")
+
+        return self.view[offset:offset + length]
+
+    def __file(self, file_id):
+        if file_id >= self.number_of_files:
+            raise OffsetOutOfBoundException("File %d of the corpus index out of range" % (file_id))
+
+        return CORPUS_INDEX_FILE.unpack_from(self.view, self.files_offset + file_id * CORPUS_INDEX_FILE.size)
+
+    def file_path(self, file_id):
+        path_offset, path_length, _, _ = self.__file(file_id)
+        return bytes(self.__string(path_offset, path_length)).decode('utf-8')
+
+    def find_class(self, descriptor):
+        '''
+        :return: paths of the files with a class descriptor
+        '''
+        term = descriptor.encode('utf-8')
+        term_hash = term_hashes(term)[0]
+        i = bisect.bisect_left(self.hashes, term_hash)
+
+        # the same hash for several terms is possible, compare them
+        while i < self.number_of_terms and self.hashes[i] == term_hash:
+            term_offset, term_length, postings_index, postings_count = \
+                CORPUS_INDEX_TERM.unpack_from(self.view, self.terms_offset + i * CORPUS_INDEX_TERM.size)
+
+            if self.__string(term_offset, term_length) == term:
+                postings_offset = self.postings_offset + postings_index * 4
+
+                if postings_offset + postings_count * 4 > len(self.view):
+                    raise OffsetOutOfBoundException("Postings of the corpus index out of file bound")
+
+                return [self.file_path(file_id)
+                        for file_id in struct.unpack_from('<%dI' % (postings_count), self.view, postings_offset)]
+            i += 1
+
+        return []
+
+    def maybe_files(self, term):
+        '''
+        :return: paths of the files whose Bloom filter has the term,
+                 it can give files without it (false positives)
+        '''
+        hashes = term_hashes(term.encode('utf-8'))
+        paths = []
+
+        for file_id in range(self.number_of_files):
+            path_offset, path_length, bits, bloom_offset = self.__file(file_id)
+            bloom_offset += self.blooms_offset
+
+            if bits == 0 or bits & (bits - 1) != 0 or bloom_offset + bits // 8 > len(self.view):
+                raise OffsetOutOfBoundException("Bloom filter of file %d out of file bound" % (file_id))
+
+            if all(self.view[bloom_offset + (position >> 3)] & (1 << (position & 7))
+                   for position in bloom_positions(hashes, bits)):
+                paths.append(bytes(self.__string(path_offset, path_length)).decode('utf-8'))
+
+        return paths
+
+    def query(self, term):
+        '''
+        :return: tuple (exact, paths), exact is False for method
+                 signatures which are only in the Bloom filters
+        '''
+        if METHOD_SEPARATOR in term:
+            return (False, self.maybe_files(term))
+
+        return (True, self.find_class(term))
+
+    def close(self):
+        if self.hashes is not None:
+            self.hashes.release()
+            self.hashes = None
+
+        if self.view is not None:
+            self.view.release()
+            self.view = None
+
+        if self.index_mmap is not None:
+            self.index_mmap.close()
+            self.index_mmap = None
+
+        self.index_file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.close()
@@ -0,0 +1,363 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: Decompression.py
+#   Version: 0.7
+######################################################
+
+import os
+import struct
+import zlib
+import lzma
+import gzip
+import shutil
+import subprocess
+from concurrent.futures import ThreadPoolExecutor
+
+from DextractorException import *
+
+USE_ZSTANDARD = False
+USE_LZ4 = False
+
+try:
+    import zstandard
+    USE_ZSTANDARD = True
+except:
+    pass
+
+try:
+    import lz4.frame
+    USE_LZ4 = True
+except:
+    pass
+
+CHUNK_SIZE = 1024 * 1024
+
+XZ_EXTENSION = '.xz'
+GZ_EXTENSION = '.gz'
+ZSTD_EXTENSION = '.zst'
+LZ4_EXTENSION = '.lz4'
+
+COMPRESSED_EXTENSIONS = [XZ_EXTENSION, GZ_EXTENSION, ZSTD_EXTENSION, LZ4_EXTENSION]
+
+# command line tools used when the python modules are not installed
+ZSTD_TOOL = 'zstd'
+LZ4_TOOL = 'lz4'
+
+XZ_HEADER_MAGIC = b'\xfd7zXZ\x00'
+XZ_FOOTER_MAGIC = b'YZ'
+XZ_STREAM_HEADER_SIZE = 12
+XZ_STREAM_FOOTER_SIZE = 12
+XZ_INDEX_INDICATOR = 0
+
+
+class XZBlock():
+    '''
+    Block of a xz stream, it can be decompressed alone
+    wrapping it with the stream header and a one record index.
+
+    xz file format (https://tukaani.org/xz/xz-file-format.txt)
+
+        Stream {
+            Stream Header {
+                uint8_t magic[6]
+                uint8_t stream_flags[2]
+                uint32_t crc32
+            }
+            Block[] (each one padded to 4 bytes)
+            Index {
+                uint8_t indicator (0x00)
+                varint number_of_records
+                { varint unpadded_size, varint uncompressed_size }[number_of_records]
+                padding to 4 bytes
+                uint32_t crc32
+            }
+            Stream Footer {
+                uint32_t crc32
+                uint32_t backward_size (index size / 4 - 1)
+                uint8_t stream_flags[2]
+                uint8_t magic[2]
+            }
+        }
+        Stream Padding (multiple of 4 null bytes)
+    '''
+
+    def __init__(self, stream_header, offset, unpadded_size, uncompressed_offset, uncompressed_size):
+        self.stream_header = stream_header
+        self.offset = offset
+        self.unpadded_size = unpadded_size
+        self.uncompressed_offset = uncompressed_offset
+        self.uncompressed_size = uncompressed_size
+
+    def padded_size(self):
+        return (self.unpadded_size + 3) & ~3
+
+
+def _encode_varint(value):
+    encoded = bytearray()
+    while value >= 0x80:
+        encoded.append((value & 0x7F) | 0x80)
+        value >>= 7
+    encoded.append(value)
+    return bytes(encoded)
+
+
+def _decode_varint(buffer, offset):
+    value = 0
+    shift = 0
+
+    for i in range(9):
+        if offset >= len(buffer):
+            break
+        byte = buffer[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte & 0x80 == 0:
+            return value, offset
+
+    raise DecompressionException("Incorrect varint in xz index")
+
+
+def read_xz_blocks(fd, file_size):
+    '''
+    Walk the xz streams from the end of the file through their
+    footers and indexes, no block is decompressed.
+
+    :return: list of XZBlock sorted by uncompressed offset
+    '''
+    streams = []
+    position = file_size
+
+    while position > 0:
+        # skip stream padding
+        while position >= 4 and os.pread(fd, 4, position - 4) == b'\x00' * 4:
+            position -= 4
+
+        if position == 0:
+            break
+
+        if position < XZ_STREAM_HEADER_SIZE + XZ_STREAM_FOOTER_SIZE:
+            raise DecompressionException("Incorrect xz stream footer")
+
+        footer = os.pread(fd, XZ_STREAM_FOOTER_SIZE, position - XZ_STREAM_FOOTER_SIZE)
+
+        if footer[10:12] != XZ_FOOTER_MAGIC or \
+                struct.unpack('<I', footer[0:4])[0] != zlib.crc32(footer[4:10]):
+            raise DecompressionException("Incorrect xz stream footer")
+
+        index_size = (struct.unpack('<I', footer[4:8])[0] + 1) * 4
+        index_offset = position - XZ_STREAM_FOOTER_SIZE - index_size
+
+        if index_offset < XZ_STREAM_HEADER_SIZE:
+            raise DecompressionException("Incorrect xz index size")
+
+        index = os.pread(fd, index_size, index_offset)
+
+        if index[0] != XZ_INDEX_INDICATOR or \
+                struct.unpack('<I', index[-4:])[0] != zlib.crc32(index[:-4]):
+            raise DecompressionException("Incorrect xz index")
+
+        number_of_records, cursor = _decode_varint(index, 1)
+        records = []
+
+        for i in range(number_of_records):
+            unpadded_size, cursor = _decode_varint(index, cursor)
+            uncompressed_size, cursor = _decode_varint(index, cursor)
+            records.append((unpadded_size, uncompressed_size))
+
+        blocks_size = sum((unpadded_size + 3) & ~3 for unpadded_size, _ in records)
+        stream_offset = index_offset - blocks_size - XZ_STREAM_HEADER_SIZE
+
+        if stream_offset < 0:
+            raise DecompressionException("Incorrect xz blocks size")
+
+        stream_header = os.pread(fd, XZ_STREAM_HEADER_SIZE, stream_offset)
+
+        if stream_header[0:6] != XZ_HEADER_MAGIC or stream_header[6:8] != footer[8:10]:
+            raise DecompressionException("Incorrect xz stream header")
+
+        streams.append((stream_header, stream_offset, records))
+        position = stream_offset
+
+    blocks = []
+    uncompressed_offset = 0
+
+    for stream_header, stream_offset, records in reversed(streams):
+        offset = stream_offset + XZ_STREAM_HEADER_SIZE
+
+        for unpadded_size, uncompressed_size in records:
+            block = XZBlock(stream_header, offset, unpadded_size, uncompressed_offset, uncompressed_size)
+            blocks.append(block)
+            offset += block.padded_size()
+            uncompressed_offset += uncompressed_size
+
+    return blocks
+
+
+def _decompress_xz_block(fd, block):
+    '''
+    Decompress one block building a stream with only that block,
+    lzma releases the GIL so blocks run in parallel.
+    '''
+    index = bytearray(b'\x00' + _encode_varint(1) +
+                      _encode_varint(block.unpadded_size) + _encode_varint(block.uncompressed_size))
+    while len(index) % 4:
+        index.append(0)
+    index += struct.pack('<I', zlib.crc32(index))
+
+    footer = struct.pack('<I', len(index) // 4 - 1) + block.stream_header[6:8]
+    footer = struct.pack('<I', zlib.crc32(footer)) + footer + XZ_FOOTER_MAGIC
+
+    stream = block.stream_header + os.pread(fd, block.padded_size(), block.offset) + bytes(index) + footer
+
+    data = lzma.decompress(stream, format=lzma.FORMAT_XZ)
+
+    if len(data) != block.uncompressed_size:
+        raise DecompressionException("Incorrect size of xz block at offset 0x%08X" % block.offset)
+
+    return data
+
+
+def _write_chunk(fd, chunk, offset=None):
+    '''
+    Write a chunk in the current position (or at offset), chunks
+    full of zeros are not written so they are left as holes.
+    '''
+    if chunk.count(0) == len(chunk):
+        if offset is None:
+            os.lseek(fd, len(chunk), os.SEEK_CUR)
+        return
+
+    chunk_view = memoryview(chunk)
+
+    while len(chunk_view) > 0:
+        if offset is None:
+            written = os.write(fd, chunk_view)
+        else:
+            written = os.pwrite(fd, chunk_view, offset)
+            offset += written
+        chunk_view = chunk_view[written:]
+
+
+def _copy_stream(input_stream, fd):
+    written = 0
+
+    while True:
+        chunk = input_stream.read(CHUNK_SIZE)
+        if not chunk:
+            break
+
+        _write_chunk(fd, chunk)
+        written += len(chunk)
+
+    return written
+
+
+def _decompress_xz_parallel(path, fd, blocks, workers):
+    '''
+    Decompress the blocks of a multi-block xz file in a thread pool,
+    each block is written at its uncompressed offset. Only a bounded
+    number of blocks is kept in memory.
+    '''
+    total_size = blocks[-1].uncompressed_offset + blocks[-1].uncompressed_size
+    os.ftruncate(fd, total_size)
+
+    max_pending = workers * 2
+    pending = []
+
+    with open(path, 'rb') as compressed_file, ThreadPoolExecutor(max_workers=workers) as pool:
+        for block in blocks:
+            pending.append((block, pool.submit(_decompress_xz_block, compressed_file.fileno(), block)))
+
+            while len(pending) > max_pending:
+                pending_block, future = pending.pop(0)
+                _write_chunk(fd, future.result(), pending_block.uncompressed_offset)
+
+        while len(pending) > 0:
+            pending_block, future = pending.pop(0)
+            _write_chunk(fd, future.result(), pending_block.uncompressed_offset)
+
+    return total_size
+
+
+def _decompress_with_tool(tool, path, fd):
+    if shutil.which(tool) is None:
+        raise DecompressionException("Cannot decompress file %s, install the python module or the %s tool" %
+                                      (path, tool))
+
+    process = subprocess.Popen([tool, '-d', '-c', path], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    written = _copy_stream(process.stdout, fd)
+
+    if process.wait() != 0:
+        raise DecompressionException("Cannot decompress file %s (%s failed)" % (path, tool))
+
+    return written
+
+
+def is_compressed(path):
+    return any(path.endswith(extension) for extension in COMPRESSED_EXTENSIONS)
+
+
+def strip_compressed_extension(path):
+    for extension in COMPRESSED_EXTENSIONS:
+        if path.endswith(extension):
+            return path[:-len(extension)]
+
+    return path
+
+
+def decompress_to_fd(path, fd, workers=None):
+    '''
+    Decompress a .xz, .gz, .zst or .lz4 file into fd in chunks.
+    xz files with several blocks (xz -T, pixz...) are decompressed
+    in parallel with workers threads (number of CPUs by default).
+
+    :return: size of the decompressed data
+    '''
+    workers = workers or os.cpu_count() or 1
+
+    if path.endswith(XZ_EXTENSION):
+        blocks = []
+
+        with open(path, 'rb') as compressed_file:
+            try:
+                blocks = read_xz_blocks(compressed_file.fileno(), os.fstat(compressed_file.fileno()).st_size)
+            except DecompressionException:
+                # let lzma report the error while decompressing
+                blocks = []
+
+        if len(blocks) > 1:
+            written = _decompress_xz_parallel(path, fd, blocks, workers)
+        else:
+            with lzma.open(path, 'rb') as compressed_file:
+                written = _copy_stream(compressed_file, fd)
+
+    elif path.endswith(GZ_EXTENSION):
+        with gzip.open(path, 'rb') as compressed_file:
+            written = _copy_stream(compressed_file, fd)
+
+    elif path.endswith(ZSTD_EXTENSION):
+        if USE_ZSTANDARD:
+            with open(path, 'rb') as compressed_file:
+                with zstandard.ZstdDecompressor().stream_reader(compressed_file, read_size=CHUNK_SIZE) as reader:
+                    written = _copy_stream(reader, fd)
+        else:
+            written = _decompress_with_tool(ZSTD_TOOL, path, fd)
+
+    elif path.endswith(LZ4_EXTENSION):
+        if USE_LZ4:
+            with lz4.frame.open(path, 'rb') as compressed_file:
+                written = _copy_stream(compressed_file, fd)
+        else:
+            written = _decompress_with_tool(LZ4_TOOL, path, fd)
+
+    else:
+        raise DecompressionException("Unknown compression format of file %s" % (path))
+
+    # size of the file in case it ends with a hole
+    os.ftruncate(fd, written)
+
+    return written
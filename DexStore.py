@@ -0,0 +1,119 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: DexStore.py
+#   Version: 0.7
+######################################################
+
+import os
+import shutil
+import fcntl
+import tempfile
+
+# ioctl to share the extents of a file (btrfs, xfs...)
+FICLONE = 0x40049409
+
+
+def link_file(source_path, destination_path):
+    '''
+    Make destination_path have the content of source_path without
+    copying it: hardlink, or reflink if the hardlink is not possible
+    (other filesystem, link limit), copy as last option.
+    '''
+    if os.path.lexists(destination_path):
+        os.remove(destination_path)
+
+    try:
+        os.link(source_path, destination_path)
+        return
+    except OSError:
+        pass
+
+    with open(source_path, 'rb') as source_file, open(destination_path, 'wb') as destination_file:
+        try:
+            fcntl.ioctl(destination_file.fileno(), FICLONE, source_file.fileno())
+            return
+        except OSError:
+            pass
+
+        shutil.copyfileobj(source_file, destination_file)
+
+
+class DexStore():
+    '''
+    Content addressed store of dex files, every blob is stored once
+    with the name <signature>-<size>.dex and outputs are links to it.
+    Only dex files whose SHA-1 signature matches their content are
+    stored, so the signature in a dex header is enough to find its
+    blob before reading the rest of the dex.
+
+        store/
+            objects/<signature[0:2]>/<signature>-<size>.dex
+            index    (input, dex index, dex name, blob) per line
+    '''
+    OBJECTS_DIRECTORY = "objects"
+    INDEX_NAME = "index"
+
+    def __init__(self, store_directory):
+        self.store_directory = store_directory
+        self.objects_directory = os.path.join(store_directory, DexStore.OBJECTS_DIRECTORY)
+        self.index_path = os.path.join(store_directory, DexStore.INDEX_NAME)
+
+        os.makedirs(self.objects_directory, exist_ok=True)
+
+    def blob_name(self, signature, size):
+        signature = signature.hex()
+        return os.path.join(DexStore.OBJECTS_DIRECTORY, signature[0:2], "%s-%d.dex" % (signature, size))
+
+    def blob_path(self, blob_name):
+        return os.path.join(self.store_directory, blob_name)
+
+    def lookup(self, signature, size):
+        '''
+        :return: blob name of the dex or None if it is not stored
+        '''
+        blob_name = self.blob_name(signature, size)
+
+        if os.path.isfile(self.blob_path(blob_name)):
+            return blob_name
+
+        return None
+
+    def link(self, blob_name, file_name):
+        link_file(self.blob_path(blob_name), file_name)
+
+    def add(self, file_name, signature, size):
+        '''
+        Store an already written dex (its signature must be the one
+        of its content), file_name ends up linked to the blob.
+
+        :return: blob name
+        '''
+        blob_name = self.blob_name(signature, size)
+        blob_path = self.blob_path(blob_name)
+
+        os.makedirs(os.path.dirname(blob_path), exist_ok=True)
+
+        try:
+            # atomic, if other process stored it first use that one
+            os.link(file_name, blob_path)
+        except FileExistsError:
+            self.link(blob_name, file_name)
+        except OSError:
+            # no hardlinks to the store, copy it in with a rename
+            fd, temporary_path = tempfile.mkstemp(dir=os.path.dirname(blob_path))
+            os.close(fd)
+            link_file(file_name, temporary_path)
+            os.replace(temporary_path, blob_path)
+
+        return blob_name
+
+    def append_index(self, records):
+        '''
+        :param records: list of tuples (input, dex index, dex name, blob name)
+        '''
+        with open(self.index_path, 'a') as index:
+            for record in records:
+                index.write("%s\t%d\t%s\t%s\n" % record)
@@ -13,11 +13,25 @@ import ntpath
 import argparse
 import zlib
 import tempfile
-import lzma
-import gzip
+import json
+import hashlib
+import struct
+import multiprocessing
+import threading
+import collections
+import socket
+import socketserver
+import signal
+import stat
+import mmap
+import array
+from concurrent.futures import ThreadPoolExecutor, ProcessPoolExecutor, wait, FIRST_COMPLETED
 
 USE_LIEF = False
 USE_OWN_PARSER = False
+USE_NATIVE_CHECKSUM = False
+USE_NATIVE_VDEX = False
+USE_NATIVE_FOOTPRINT = False
 
 try:
     import lief.ELF
@@ -25,44 +39,192 @@ try:
 except:
     from elfparser_e.python_binding.elf import *
     USE_OWN_PARSER = True
-    
+
+try:
+    from elfparser_e.python_binding.dex_checksum import dex_checksum_fd
+    USE_NATIVE_CHECKSUM = True
+except:
+    pass
+
+try:
+    from elfparser_e.python_binding.vdex import Vdex
+    USE_NATIVE_VDEX = True
+except:
+    pass
+
+try:
+    from elfparser_e.python_binding.oat_footprint import oat_method_headers_fd
+    USE_NATIVE_FOOTPRINT = True
+except:
+    pass
 
 from FileWork import *
 from utils import *
 from DextractorException import *
-from FileFormats.OAT import OATHeader
-from struct import pack
+from Decompression import COMPRESSED_EXTENSIONS, is_compressed, strip_compressed_extension, decompress_to_fd
+from DexStore import DexStore
+from CorpusIndex import CorpusIndexWriter, CorpusIndex, METHOD_SEPARATOR
+from BuildDiff import diff_builds, DIFF_SECTION, DIFF_DEX, DIFF_CLASS, DIFF_METHOD
+from Carver import Carver, CARVE_OAT, CARVE_VDEX, CARVE_ELF, CARVE_KIND_NAMES, CARVE_EXTENSIONS
+from ArchiveSink import DEX_HEADER_PREFIX_SIZE, ZIP_FORMAT, TAR_FORMAT, apk_dex_name, open_sink
+from FileFormats.OAT import OATHeader, join_compiled_methods, CompiledCodeIndex, \
+    CodeFootprint, read_method_headers, footprint_by_class, unique_code_size, FOOTPRINT_OUT_OF_BOUND
+from FileFormats.OATHeaderLayout import OAT_METHOD_HEADER_LAYOUT_BY_VERSION
+from FileFormats.DEX import DEXHeader, calculate_dex_checksums, STRINGS_LINES, STRINGS_BINARY
+from FileFormats.VDEX import VDEXFile, VDEX_MAGIC_VALUE
+
+
+class DexEntry():
+    '''
+    Dex file found in the analyzed files, it is stored at
+    offset of container_file (the oat file or the vdex file).
+    '''
+
+    def __init__(self, name, offset, size, dex_file, container_file):
+        self.name = name
+        self.offset = offset
+        self.size = size
+        self.dex_file = dex_file
+        self.container_file = container_file
+        # set once the dex is written (not if it was linked from a store)
+        self.calculated_checksum = None
+        self.calculated_signature = None
+        self.blob = None
+        # index of the ID tables, built by Extractor.get_dex_index
+        self.index = None
+        # OATDexFileHeader of the dex (None for vdex files)
+        self.oat_dex_file = None
 
 
 class Extractor():
     DYNAMIC_SYMBOL_NAME = "oatdata"
-
-    def __init__(self, path_to_odex=""):
+    COMPRESSED_EXTENSIONS = COMPRESSED_EXTENSIONS
+    ODEX_EXTENSIONS = ['.odex', '.oat']
+    VDEX_EXTENSION = '.vdex'
+
+    def __init__(self, path_to_odex="", path_to_vdex=""):
+        '''
+        :param path_to_odex: odex/oat file to analyze, a vdex file can
+                             be given alone to extract its dex files
+        :param path_to_vdex: vdex paired with the odex, by default the
+                             sibling .vdex of the odex if it exists
+        '''
+        self.original_path_to_odex = path_to_odex
         self.path_to_odex = path_to_odex
+        self.path_to_vdex = path_to_vdex
         self.oatdata_offset = None
         self.oatdata_size = None
         self.oatdata = None
         self.oat_file = None
+        self.elf_binary = None
+        self.oat_mmap = None
+        self.oat_view = None
+        self.vdex_file = None
+        self.vdex_mmap = None
+        self.vdex_view = None
+        self.vdex_file_size = 0
+        self.vdex_dex_files = []
+        self.vdex_only = False
+        self.dex_entries = []
         self.number_of_dex_files = 0
         self.number_of_optimized_methods = 0
-        self.oat_file = None
+        self.compiled_code_index = None
         self.not_an_elf = False
+        self.closed = False
+        self.decompressed_files = []
+        self.decompressed_fds = []
+
+        if self.path_to_vdex == "":
+            self.path_to_vdex = Extractor.find_vdex(self.path_to_odex)
+
+        # Handle compressed odex and vdex files
+        self.path_to_odex = self.__decompress(self.path_to_odex, '.odex')
+
+        if self.path_to_vdex != "":
+            self.path_to_vdex = self.__decompress(self.path_to_vdex, Extractor.VDEX_EXTENSION)
+
+        if os.path.isfile(self.path_to_odex):
+            with open(self.path_to_odex, 'rb') as input_file:
+                if input_file.read(len(VDEX_MAGIC_VALUE)) == VDEX_MAGIC_VALUE:
+                    self.vdex_only = True
+                    self.path_to_vdex = self.path_to_odex
+
+    def __decompress(self, path, suffix):
+        '''
+        Decompress .xz, .gz, .zst and .lz4 files in chunks to an
+        anonymous memory file (memfd), or to a temporary file if
+        memfd is not available. Chunks full of zeros are left as holes.
+        The file is given to the parsers by its /proc/self/fd path and
+        released once the analysis is done.
+        '''
+        if not is_compressed(path):
+            return path
+
+        if hasattr(os, 'memfd_create'):
+            fd = os.memfd_create('dextripador_' + ntpath.basename(path))
+            fpath = '/proc/self/fd/%d' % (fd)
+        else:
+            fd, fpath = tempfile.mkstemp(suffix=suffix, prefix='dextripador_', dir='/tmp')
+            self.decompressed_files.append(fpath)
+        self.decompressed_fds.append(fd)
+
+        written = decompress_to_fd(path, fd)
+
+        if written == 0:
+            raise DecompressionException('Cannot decompress file {}'.format(path))
+        return fpath
 
-        # Handle compressed odex files
-        if self.path_to_odex.endswith('.xz'):
-            fd, fpath = tempfile.mkstemp(suffix='.odex', prefix='dextripador_', dir='/tmp')
-            with lzma.open(self.path_to_odex, 'rb') as odexfile:
-                written = os.write(fd, odexfile.read())
-            if written == 0:
-                raise DecompressionException('Cannot decompress file {}'.format(self.path_to_odex))
-            self.path_to_odex = fpath
-        elif self.path_to_odex.endswith('.gz'):
-            fd, fpath = tempfile.mkstemp(suffix='.odex', prefix='dextripador_', dir='/tmp')
-            with gzip.open(self.path_to_odex, 'rb') as odexfile:
-                written = os.write(fd, odexfile.read())
-            if written == 0:
-                raise DecompressionException('Cannot decompress file {}'.format(self.path_to_odex))
-            self.path_to_odex = fpath
+    def __release_decompressed(self):
+        for decompressed_fd in self.decompressed_fds:
+            os.close(decompressed_fd)
+        self.decompressed_fds = []
+
+        for decompressed_file in self.decompressed_files:
+            os.remove(decompressed_file)
+        self.decompressed_files = []
+
+    @staticmethod
+    def find_vdex(path_to_odex):
+        '''
+        Look for the vdex that goes with an odex/oat file, it is
+        stored next to it with the same name (compressed or not).
+
+        :return: path of the vdex or empty string
+        '''
+        root, extension = os.path.splitext(strip_compressed_extension(path_to_odex))
+
+        if extension not in Extractor.ODEX_EXTENSIONS:
+            return ""
+
+        for compressed_extension in [""] + Extractor.COMPRESSED_EXTENSIONS:
+            candidate = root + Extractor.VDEX_EXTENSION + compressed_extension
+            if os.path.isfile(candidate):
+                return candidate
+
+        return ""
+
+    @staticmethod
+    def dex_name_from_location(oatdexfile):
+        path_name = oatdexfile.dex_file_location_data.decode('latin-1')
+        file_name = ntpath.basename(path_name)
+
+        if '.apk' in file_name:
+            file_name = file_name.replace('.apk', '.dex')
+        else:
+            file_name = file_name + '.dex'
+
+        return file_name
+
+    @staticmethod
+    def dex_extension(dex_file, file_name):
+        '''
+        Compact dex files (cdex) are extracted as they are,
+        so they get their own extension.
+        '''
+        if bytes(dex_file.magic[:4]) == b'cdex' and file_name.endswith('.dex'):
+            return file_name[:-len('.dex')] + '.cdex'
+
+        return file_name
 
 
     def __parse_elf(self, path_to_elf):
@@ -91,12 +253,16 @@ class Extractor():
             if not elf_binary.is_elf():
                 raise NotElfFileException("Provided file %s is not an ELF" % (path_to_elf))
                 
-            for symbol in elf_binary.elf_sym:
-                if symbol.st_name == Extractor.DYNAMIC_SYMBOL_NAME:
-                    Printer.verbose2("%s Found in %s" % (Extractor.DYNAMIC_SYMBOL_NAME, path_to_elf))
-                    self.oatdata_offset = symbol.st_value
-                    self.oatdata_size = symbol.st_size
-                    break
+            symbol = elf_binary.find_symbol(Extractor.DYNAMIC_SYMBOL_NAME)
+
+            # the native Elf keeps the file mapped, it is used to read the oat
+            if hasattr(elf_binary, 'file_range'):
+                self.elf_binary = elf_binary
+
+            if symbol is not None:
+                Printer.verbose2("%s Found in %s" % (Extractor.DYNAMIC_SYMBOL_NAME, path_to_elf))
+                self.oatdata_offset = symbol.st_value
+                self.oatdata_size = symbol.st_size
             
         if self.oatdata_offset is None or self.oatdata_size is None:
             raise OatdataNotFoundException("Error, oatdata symbol not found in ELF (maybe not odex file)")
@@ -127,175 +293,1518 @@ class Extractor():
             raise OatdataNotFoundException("Error, oatdata header not found in oat file (maybe not oat file)")
 
 
-    def load(self):
-        Printer.print("Starting analysis of odex file")
+    def __load_vdex(self):
+        '''
+        Walk the headers of the vdex file to get offset and size of
+        its dex files, natively over a mapping of the file if the
+        elfparser_e library is available.
+        '''
+        Printer.verbose1("Analyzing vdex file %s" % (self.path_to_vdex))
 
-        try:
-            self.__parse_elf(self.path_to_odex)
-        except NotElfFileException:
-            self.not_an_elf = True
+        if not os.path.exists(self.path_to_vdex):
+            raise FileNotFoundError("File %s doesn't exist or is not correct" % (self.path_to_vdex))
 
-        if self.not_an_elf:
-            self.__parse_oat(self.path_to_odex)
+        self.vdex_file = open(self.path_to_vdex, 'rb')
+        self.vdex_file_size = os.path.getsize(self.path_to_vdex)
 
-        self.oat_file = open(self.path_to_odex, 'rb')
+        if USE_NATIVE_VDEX:
+            vdex = Vdex(fd=self.vdex_file.fileno())
 
-        self.oat_file.seek(self.oatdata_offset, FILE_BEGIN)
+            if not vdex.is_vdex():
+                raise IncorrectMagicException("Error, %s is not a supported vdex file" % (self.path_to_vdex))
 
-        self.oatdata = OATHeader(self.oat_file)
+            self.vdex_dex_files = [(dex.offset, dex.size) for dex in vdex.dex_files]
+        else:
+            vdex = VDEXFile(self.vdex_file)
+            vdex.parse_header(0, self.vdex_file_size)
+            self.vdex_dex_files = list(zip(vdex.dex_files_offsets, vdex.dex_files_sizes))
 
-        self.oatdata.parse_header(self.oatdata_offset, os.path.getsize(self.path_to_odex))
+        Printer.verbose1("Vdex version %03d with %d dex files" % (vdex.version, len(self.vdex_dex_files)))
 
-        self.number_of_dex_files = self.oatdata.dex_file_count.value
+    def __load_vdex_dex_entries(self):
+        root = os.path.splitext(strip_compressed_extension(ntpath.basename(self.original_path_to_odex)))[0]
 
-        for i in range(len(self.oatdata.OATDexFileHeaders)):
-            for key,oatclass_header in self.oatdata.OATDexFileHeaders[i].OATClassHeader.items():
-                self.number_of_optimized_methods += oatclass_header.compiled_methods
+        for i, (dex_offset, dex_size) in enumerate(self.vdex_dex_files):
+            if dex_size == 0:
+                Printer.verbose1("Dex %d is not stored in the vdex" % (i))
+                continue
 
-        Printer.print("Analysis done correctly")
+            if dex_offset + dex_size > self.vdex_file_size:
+                raise OffsetOutOfBoundException("Error, dex %d (0x%08X + 0x%08X) is out of bound of the vdex file" %
+                                                (i, dex_offset, dex_size))
 
-        if self.path_to_odex.startswith('/tmp/dextripador_') and    \
-                self.path_to_odex.endswith('.odex'):
-            # Remove files that were decompressed
-            os.remove(self.path_to_odex)
+            dex_file = DEXHeader(self.vdex_file)
+            dex_file.parse_header(dex_offset, self.vdex_file_size)
 
-    def get_dex_files(self):
+            file_name = root + ".dex" if i == 0 else "%s!classes%d.dex" % (root, i + 1)
 
-        Printer.print("Returning dex files")
-        dex_files = []
-        for i in range(self.number_of_dex_files):
+            self.dex_entries.append(DexEntry(Extractor.dex_extension(dex_file, file_name),
+                                             dex_offset, dex_size, dex_file, self.vdex_file))
+
+    def __load_oat_dex_entries(self):
+        dex_in_vdex = self.vdex_file is not None and \
+            c_string(self.oatdata.version) in OATHeader.VDEX_VERSIONS
+
+        for i in range(len(self.oatdata.OATDexFileHeaders)):
             actual_oatdexfile = self.oatdata.OATDexFileHeaders[i]
-            dex_files.append(actual_oatdexfile.dex_file)
+            actual_dex_file = actual_oatdexfile.dex_file
 
-        return dex_files
+            if actual_dex_file is None:
+                Printer.verbose1("Dex %d is not stored in the vdex" % (i))
+                continue
 
-    def get_dex_names(self):
+            file_name = Extractor.dex_extension(actual_dex_file, Extractor.dex_name_from_location(actual_oatdexfile))
 
-        Printer.print("Returning dex file names")
-        dex_names = []
-        for i in range(self.number_of_dex_files):
-            actual_oatdexfile = self.oatdata.OATDexFileHeaders[i]
+            if dex_in_vdex:
+                dex_offset = actual_oatdexfile.dex_file_pointer
 
-            path_name = ""
-            for i in range(actual_oatdexfile.dex_file_location_size.value):
-                path_name += chr(actual_oatdexfile.dex_file_location_data[i])
-            file_name = ntpath.basename(path_name)
+                if i < len(self.vdex_dex_files) and self.vdex_dex_files[i][0] != dex_offset:
+                    Printer.verbose1("Dex %d offset in oat (0x%08X) differs from vdex (0x%08X)" %
+                                     (i, dex_offset, self.vdex_dex_files[i][0]))
 
-            if '.apk' in file_name:
-                file_name = file_name.replace('.apk', '.dex')
+                container_file = self.vdex_file
             else:
-                file_name = file_name + '.dex'
+                dex_offset = actual_oatdexfile.dex_file_pointer + self.oatdata.oatdata_offset
+                container_file = self.oat_file
+
+            dex_entry = DexEntry(file_name, dex_offset, actual_dex_file.file_size, actual_dex_file, container_file)
+            dex_entry.oat_dex_file = actual_oatdexfile
+            self.dex_entries.append(dex_entry)
 
-            dex_names.append(file_name)
+    def load(self):
+        Printer.print("Starting analysis of odex file")
 
-        return dex_names
+        try:
+            self.__load()
+        finally:
+            # the opened oat and vdex files keep the decompressed data
+            self.__release_decompressed()
 
-    def extract_all_dex(self, recalculate_dex_checksum = False):
+        Printer.print("Analysis done correctly")
 
-        Printer.print("Extracting all the dex files")
+    def __load(self):
+        if self.vdex_only:
+            self.__load_vdex()
+            self.__load_vdex_dex_entries()
+        else:
+            try:
+                self.__parse_elf(self.path_to_odex)
+            except NotElfFileException:
+                self.not_an_elf = True
+
+            if self.not_an_elf:
+                self.__parse_oat(self.path_to_odex)
+
+            self.oat_file = open(self.path_to_odex, 'rb')
+            self.oat_view = self.__map_oat()
+
+            if self.path_to_vdex != "":
+                self.__load_vdex()
+
+            # the headers are read from the mapping, without seek and read calls
+            oat_memory_file = MemoryFile(self.oat_view)
+            oat_memory_file.seek(self.oatdata_offset, FILE_BEGIN)
+
+            self.oatdata = OATHeader(oat_memory_file)
+
+            self.oatdata.parse_header(self.oatdata_offset, os.path.getsize(self.path_to_odex),
+                                      self.vdex_file, self.vdex_file_size)
+
+            for i in range(len(self.oatdata.OATDexFileHeaders)):
+                for key,oatclass_header in self.oatdata.OATDexFileHeaders[i].OATClassHeader.items():
+                    self.number_of_optimized_methods += oatclass_header.compiled_methods
+
+            self.__load_oat_dex_entries()
+
+        self.number_of_dex_files = len(self.dex_entries)
+
+    def __map_oat(self):
+        '''
+        Read-only memoryview of the whole oat/odex file: the mapping
+        of the ELF parser if the file was parsed as an ELF, a new mapping
+        of the opened file otherwise.
+        '''
+        if self.elf_binary is not None:
+            return self.elf_binary.file_range(0, self.elf_binary.file_size)
+
+        self.oat_mmap = mmap.mmap(self.oat_file.fileno(), 0, access=mmap.ACCESS_READ)
+        return memoryview(self.oat_mmap)
+
+    def __read_container(self, dex_entry, size, offset=0):
+        '''
+        Bytes of the container of a dex, a slice of the mapping when
+        the dex is in the oat file, read from the vdex otherwise.
+        '''
+        if dex_entry.container_file is self.oat_file and self.oat_view is not None:
+            return self.oat_view[dex_entry.offset + offset:dex_entry.offset + offset + size]
+
+        return os.pread(dex_entry.container_file.fileno(), size, dex_entry.offset + offset)
+
+    def __container_view(self, dex_entry):
+        '''
+        Read-only memoryview of a dex in its container, the vdex
+        is mapped the first time one of its dex files is viewed.
+        '''
+        if dex_entry.container_file is self.oat_file:
+            view = self.oat_view
+        else:
+            if self.vdex_view is None:
+                self.vdex_mmap = mmap.mmap(self.vdex_file.fileno(), 0, access=mmap.ACCESS_READ)
+                self.vdex_view = memoryview(self.vdex_mmap)
+            view = self.vdex_view
+
+        return view[dex_entry.offset:dex_entry.offset + dex_entry.size]
+
+    def get_dex_view(self, dex_number):
+        '''
+        :return: memoryview of a dex in the mapping of its container
+        '''
+        return self.__container_view(self.dex_entries[dex_number])
+
+    def get_dex_index(self, dex_number):
+        '''
+        Index of the string, type, proto, field and method IDs,
+        class defs and map_list of a dex, built over the mapping
+        of its container without extracting the dex.
+        '''
+        dex_entry = self.dex_entries[dex_number]
+
+        if dex_entry.index is None:
+            dex_entry.index = dex_entry.dex_file.index(self.__container_view(dex_entry))
+
+        return dex_entry.index
+
+    def get_compiled_methods(self, dex_number):
+        '''
+        Compiled methods of a dex, the methods offsets of its OAT
+        classes joined with the methods of its class_data.
+
+        :return: list of CompiledMethod (class_def_idx, method_idx, code_offset)
+        '''
+        dex_entry = self.dex_entries[dex_number]
+
+        if dex_entry.oat_dex_file is None:
+            return []
+
+        return join_compiled_methods(dex_entry.oat_dex_file, self.get_dex_index(dex_number).class_data())
+
+    def get_compiled_code_index(self):
+        '''
+        CompiledCodeIndex of all the dex files of the OAT file,
+        built the first time it is asked for.
+        '''
+        if self.compiled_code_index is None:
+            self.compiled_code_index = CompiledCodeIndex()
+
+            for i, dex_entry in enumerate(self.dex_entries):
+                if dex_entry.oat_dex_file is None:
+                    continue
+
+                index = self.get_dex_index(i)
+                self.compiled_code_index.add_dex(i, dex_entry.oat_dex_file, index.class_data(),
+                                                 self.get_class_descriptors(i), len(index.method_ids))
+
+        return self.compiled_code_index
+
+    def get_code_footprint(self, dex_number):
+        '''
+        Compiled methods of a dex with the sizes of their code and
+        frames, read from the OatQuickMethodHeader before the code
+        of each one (natively, only the pages of the headers are
+        read). Can be called from several threads once the dex
+        index is built.
+
+        :return: CodeFootprint of arrays('I'), one entry per method
+        '''
+        compiled = self.get_compiled_methods(dex_number)
+        code_offsets = array.array('I', [compiled_method.code_offset for compiled_method in compiled])
+        columns, out_of_bound = self.get_method_headers(code_offsets)
+
+        return CodeFootprint(array.array('I', [compiled_method.class_def_idx for compiled_method in compiled]),
+                             array.array('I', [compiled_method.method_idx for compiled_method in compiled]),
+                             code_offsets, *columns, out_of_bound)
+
+    def get_method_headers(self, code_offsets):
+        '''
+        Read the OatQuickMethodHeader of the given code offsets.
+
+        :param code_offsets: array('I') of code offsets from oatdata.
+        :return: tuple (columns, number of methods out of bound), the
+                 columns are arrays('I') in FOOTPRINT_COLUMNS order
+        '''
+        layout = OAT_METHOD_HEADER_LAYOUT_BY_VERSION[c_string(self.oatdata.version)]
+        size = os.fstat(self.oat_file.fileno()).st_size - self.oatdata_offset
+
+        if USE_NATIVE_FOOTPRINT:
+            return oat_method_headers_fd(self.oat_file.fileno(), self.oatdata_offset, size, layout, code_offsets)
+
+        return read_method_headers(self.oat_view, self.oatdata_offset, size, layout, code_offsets)
+
+    def get_compiled_code(self, code_offset, code_size):
+        '''
+        :return: memoryview of the compiled code at code_offset
+                 (from oatdata, the Thumb bit is ignored)
+        '''
+        start = self.oatdata_offset + (code_offset & ~1)
+        return self.oat_view[start:start + code_size]
+
+    def get_code_footprints(self, workers=None):
+        '''
+        CodeFootprint of every dex, one job per dex in a thread pool
+        (the native pass releases the GIL).
+        '''
+        if self.oatdata is None:
+            return []
+
+        # the indexes are built before, they are shared by the jobs
         for i in range(self.number_of_dex_files):
-            actual_oatdexfile = self.oatdata.OATDexFileHeaders[i]
+            self.get_dex_index(i)
+
+        with ThreadPoolExecutor(max_workers=workers or os.cpu_count() or 1) as pool:
+            return list(pool.map(self.get_code_footprint, range(self.number_of_dex_files)))
+
+    def get_class_descriptors(self, dex_number):
+        '''
+        :return: descriptors of the classes defined in a dex
+        '''
+        index = self.get_dex_index(dex_number)
+        return [index.string(index.type_ids[class_def.class_idx].descriptor_idx) for class_def in index.class_defs]
+
+    def get_method_signatures(self, dex_number):
+        '''
+        Signatures of the methods defined in a dex, as in smali
+        (Lcom/a/A;->foo(ILjava/lang/String;)V).
+        '''
+        index = self.get_dex_index(dex_number)
+        dex_view = self.__container_view(self.dex_entries[dex_number])
+        descriptors = {}
+        protos = {}
+        signatures = []
+
+        def descriptor(type_idx):
+            if type_idx not in descriptors:
+                descriptors[type_idx] = index.string(index.type_ids[type_idx].descriptor_idx)
+            return descriptors[type_idx]
+
+        def proto(proto_idx):
+            if proto_idx not in protos:
+                proto_id = index.proto_ids[proto_idx]
+                parameters = ()
+
+                # type_list: uint32 size and uint16 type indexes
+                if proto_id.parameters_off != 0:
+                    size, = struct.unpack_from('<I', dex_view, proto_id.parameters_off)
+                    parameters = struct.unpack_from('<%dH' % (size), dex_view, proto_id.parameters_off + 4)
+
+                protos[proto_idx] = "(%s)%s" % ("".join(descriptor(type_idx) for type_idx in parameters),
+                                                descriptor(proto_id.return_type_idx))
+            return protos[proto_idx]
+
+        for method_idx in index.class_data().method_idx:
+            method_id = index.method_ids[method_idx]
+            signatures.append("%s->%s%s" % (descriptor(method_id.class_idx), index.string(method_id.name_idx),
+                                            proto(method_id.proto_idx)))
+
+        return signatures
+
+    def dump_strings(self, fd, binary=False):
+        '''
+        Write the string table of every dex to fd, in dex order,
+        as escaped UTF-8 lines or as length prefixed strings.
+
+        :return: number of strings written
+        '''
+        Printer.print("Dumping the strings of all the dex files")
+        return sum(self.get_dex_index(i).dump_strings(fd, binary) for i in range(len(self.dex_entries)))
 
-            actual_dex_file = actual_oatdexfile.dex_file
+    def get_dex_files(self):
 
-            # Get the name to extract
-            path_name = ""
-            for i in range(actual_oatdexfile.dex_file_location_size.value):
-                path_name += chr(actual_oatdexfile.dex_file_location_data[i])
-            file_name = ntpath.basename(path_name)
+        Printer.print("Returning dex files")
+        return [dex_entry.dex_file for dex_entry in self.dex_entries]
 
-            if '.apk' in file_name:
-                file_name = file_name.replace('.apk', '.dex')
-            else:
-                file_name = file_name + '.dex'
-                
-            # get the offset and size of the dex
-            dex_offset = actual_oatdexfile.dex_file_pointer.value + self.oatdata.oatdata_offset
-            dex_size = actual_dex_file.file_size.value
+    def get_dex_names(self):
 
-            self.oat_file.seek(dex_offset, FILE_BEGIN)
+        Printer.print("Returning dex file names")
+        return [dex_entry.name for dex_entry in self.dex_entries]
+
+    def __write_dex(self, dex_entry, file_name, recalculate_dex_checksum, store=None):
+        '''
+        Copy one dex from its container (oat or vdex) to file_name, the
+        checksum and signature are calculated in the same pass as the
+        copy, and replaced in the output if recalculate_dex_checksum is True.
+        With a DexStore the signature in the header is looked up first
+        and file_name is linked to the stored dex without copying it.
+        '''
+        dex_file = dex_entry.dex_file
+        container_file = dex_entry.container_file
+
+        if store is not None:
+            blob_name = store.lookup(bytes(dex_file.signature), dex_entry.size)
+
+            if blob_name is not None:
+                store.link(blob_name, file_name)
+                dex_entry.blob = blob_name
+                Printer.verbose1("Dex %s linked from the store (%s)" % (file_name, blob_name))
+                return
+
+        # never write through a link to a stored dex
+        if os.path.isfile(file_name) and os.stat(file_name).st_nlink > 1:
+            os.remove(file_name)
+
+        with open(file_name, 'wb') as output_file:
+            if USE_NATIVE_CHECKSUM:
+                calculated_dex_checksum, calculated_dex_signature = dex_checksum_fd(
+                    container_file.fileno(), dex_entry.offset, dex_entry.size,
+                    output_file.fileno(), recalculate_dex_checksum)
+            else:
+                dex_file_bytes = bytearray(self.__read_container(dex_entry, dex_entry.size))
+                calculated_dex_checksum, calculated_dex_signature = calculate_dex_checksums(
+                    dex_file_bytes, recalculate_dex_checksum)
+                output_file.write(dex_file_bytes)
 
-            dex_file_bytes = self.oat_file.read(dex_size)
+        dex_entry.calculated_checksum = calculated_dex_checksum
+        dex_entry.calculated_signature = calculated_dex_signature
 
-            output_file = open(file_name, 'wb')
+        Printer.verbose1("Calculated dex checksum: 0x%08X - Dex file checksum: 0x%08X" %
+                         (calculated_dex_checksum, dex_file.checksum))
+        Printer.verbose1("Calculated dex signature: %s - Dex file signature: %s" %
+                         (calculated_dex_signature.hex(), bytes(dex_file.signature).hex()))
 
+        valid_dex = calculated_dex_checksum == dex_file.checksum and \
+            calculated_dex_signature == bytes(dex_file.signature)
 
-            calculated_dex_checksum = zlib.adler32(dex_file_bytes[12:])
+        if recalculate_dex_checksum and not valid_dex:
+            Printer.verbose1("Replaced the checksum and signature")
 
-            Printer.verbose1("Calculated dex checksum: 0x%08X - Dex file checksum: 0x%08X" %
-                             (calculated_dex_checksum, c_uint(actual_dex_file.checksum.value).value))
+        if store is not None:
+            if valid_dex or recalculate_dex_checksum:
+                dex_entry.blob = store.add(file_name, calculated_dex_signature, dex_entry.size)
+            else:
+                Printer.verbose1("Dex %s does not match its checksums, not added to the store" % (file_name))
 
-            if recalculate_dex_checksum and calculated_dex_checksum != c_uint(actual_dex_file.checksum.value).value:
-                Printer.verbose1("Replacing the checksum")
-                dex_file_bytes = dex_file_bytes[:8] + pack('I',calculated_dex_checksum) + dex_file_bytes[12:]
-                Printer.verbose1("Replaced the checksum")
+    def extract_all_dex(self, recalculate_dex_checksum = False, output_directory = "", store = None):
 
-            output_file.write(dex_file_bytes)
-            output_file.close()
+        Printer.print("Extracting all the dex files")
+        for dex_entry in self.dex_entries:
+            self.__write_dex(dex_entry, os.path.join(output_directory, dex_entry.name), recalculate_dex_checksum, store)
 
         return True
 
-    def extract_dex(self, dex_number, output_name = "", recalculate_dex_checksum = False):
+    def extract_dex(self, dex_number, output_name = "", recalculate_dex_checksum = False, store = None):
 
         Printer.print("Extracting dex file %d" % dex_number)
         if dex_number >= self.number_of_dex_files or dex_number < 0:
             raise DexOutOfFoundException("Selected Dex (%d) doesn't exists" % (dex_number))
 
-        actual_oatdexfile = self.oatdata.OATDexFileHeaders[dex_number]
-
-        actual_dex_file = actual_oatdexfile.dex_file
+        dex_entry = self.dex_entries[dex_number]
 
         # Get the name to extract
         if output_name == "":
-            # Get the name to extract
-            path_name = ""
-            for i in range(actual_oatdexfile.dex_file_location_size.value):
-                path_name += chr(actual_oatdexfile.dex_file_location_data[i])
-            file_name = ntpath.basename(path_name)
-            if '.apk' in file_name:
-                file_name = file_name.replace('.apk', '.dex')
-            else:
-                file_name = file_name + '.dex'
+            file_name = dex_entry.name
         else:
             file_name = output_name
 
-        # get the offset and size of the dex
-        dex_offset = actual_oatdexfile.dex_file_pointer.value + self.oatdata.oatdata_offset
-        dex_size = actual_dex_file.file_size.value
+        self.__write_dex(dex_entry, file_name, recalculate_dex_checksum, store)
+
+        return True
+
+    def __calculate_dex_checksums(self, dex_entry, fix_checksum=False):
+        '''
+        :param fix_checksum: calculate the checksum over the new signature
+        :return: tuple (checksum, signature) calculated from the content of the dex
+        '''
+        if USE_NATIVE_CHECKSUM:
+            return dex_checksum_fd(dex_entry.container_file.fileno(), dex_entry.offset, dex_entry.size,
+                                   fix_checksum=fix_checksum)
+
+        dex_file_bytes = bytearray(self.__read_container(dex_entry, dex_entry.size))
+        return calculate_dex_checksums(dex_file_bytes, fix_checksum)
+
+    def extract_all_dex_to_sink(self, sink, recalculate_dex_checksum = False, prefix = ""):
+        '''
+        Write all the dex files in an archive (ArchiveSink) with the
+        names of an APK (classes.dex, classes2.dex...) under prefix.
+        The dex are copied from the container file to the archive, only
+        the first 32 bytes (magic, checksum, signature) go through memory.
+        '''
+        Printer.print("Extracting all the dex files to the archive")
+        for i, dex_entry in enumerate(self.dex_entries):
+            sink.add_dex(prefix + apk_dex_name(i, dex_entry.name), dex_entry.container_file.fileno(),
+                         dex_entry.offset, dex_entry.size,
+                         self.get_dex_header_prefix(dex_entry, recalculate_dex_checksum))
 
-        self.oat_file.seek(dex_offset, FILE_BEGIN)
+        return True
 
-        dex_file_bytes = self.oat_file.read(dex_size)
+    def get_dex_header_prefix(self, dex_entry, recalculate_dex_checksum = False):
+        '''
+        First 32 bytes of a dex (magic, checksum and signature), with
+        the calculated checksum and signature if recalculate_dex_checksum
+        is True. The rest of the dex can be copied as it is.
+        '''
+        header_prefix = bytes(self.__read_container(dex_entry, DEX_HEADER_PREFIX_SIZE))
 
-        output_file = open(file_name, 'wb')
+        if recalculate_dex_checksum:
+            calculated_dex_checksum, calculated_dex_signature = self.__calculate_dex_checksums(dex_entry, True)
+            fixed_header_prefix = header_prefix[0:8] + struct.pack('<I', calculated_dex_checksum) + \
+                calculated_dex_signature
 
-        calculated_dex_checksum = zlib.adler32(dex_file_bytes[12:])
+            if fixed_header_prefix != header_prefix:
+                Printer.verbose1("Replaced the checksum and signature of %s" % (dex_entry.name))
 
-        Printer.verbose1("Calculated dex checksum: 0x%08X - Dex file checksum: 0x%08X" % (
-        calculated_dex_checksum, c_uint(actual_dex_file.checksum.value).value))
+            header_prefix = fixed_header_prefix
 
-        if recalculate_dex_checksum and calculated_dex_checksum != c_uint(actual_dex_file.checksum.value).value:
-            Printer.verbose1("Replacing the checksum")
-            dex_file_bytes = dex_file_bytes[:8] + pack('I', calculated_dex_checksum) + dex_file_bytes[12:]
-            Printer.verbose1("Replaced the checksum")
+        return header_prefix
 
-        output_file.write(dex_file_bytes)
-        output_file.close()
+    def verify_dex(self, dex_number):
+        '''
+        Check checksum and signature of one dex against its header
+        without writing anything, can be called from several threads.
 
-        return True
+        :return: tuple (checksum_ok, signature_ok)
+        '''
+        if dex_number >= self.number_of_dex_files or dex_number < 0:
+            raise DexOutOfFoundException("Selected Dex (%d) doesn't exists" % (dex_number))
+
+        dex_entry = self.dex_entries[dex_number]
+        actual_dex_file = dex_entry.dex_file
+
+        calculated_dex_checksum, calculated_dex_signature = self.__calculate_dex_checksums(dex_entry)
+
+        return (calculated_dex_checksum == actual_dex_file.checksum,
+                calculated_dex_signature == bytes(actual_dex_file.signature))
+
+    def oat_checksum_state(self):
+        '''
+        State of the adler32_checksum of the oat header for --verify.
+        ART folds into it the compiled code and other parts of the
+        image in an order that changes between versions, it is not
+        recalculated until those ranges are known for every version.
+
+        :return: "n/a" if only a vdex file was analyzed, else "unchecked"
+        '''
+        return "n/a" if self.oatdata is None else "unchecked"
+
+    def close(self):
+        # the indexes and views of the mappings go before the mappings
+        for dex_entry in self.dex_entries:
+            if dex_entry.index is not None:
+                dex_entry.index.close()
+                dex_entry.index = None
+
+        for view_name in ['oat_view', 'vdex_view']:
+            if getattr(self, view_name) is not None:
+                getattr(self, view_name).release()
+                setattr(self, view_name, None)
+
+        for opened_file in [self.oat_mmap, self.vdex_mmap, self.elf_binary, self.oat_file, self.vdex_file]:
+            if opened_file is not None:
+                opened_file.close()
+
+        self.closed = True
 
     def print_all_headers(self):
-        Printer.print("Printing all the oatdata headers")
-        self.oatdata.print_header()
+        if self.oatdata is not None:
+            Printer.print("Printing all the oatdata headers")
+            self.oatdata.print_header()
+
+        if self.vdex_file is not None:
+            Printer.print("Printing the vdex header")
+            vdex = VDEXFile(self.vdex_file)
+            vdex.parse_header(0, self.vdex_file_size)
+            vdex.print_header()
 
     def print_all_dex(self):
         Printer.print("Printing all dex file headers\n\n")
         for i in range(self.number_of_dex_files):
-            actual_oatdexfile = self.oatdata.OATDexFileHeaders[i]
+            self.dex_entries[i].dex_file.print_header(num=i)
+
+def verify_files(paths, workers=None):
+    '''
+    Verify oat and dex checksums of the given files. Files are parsed
+    one after the other while the hashing of the already parsed ones
+    runs in a thread pool (the native kernels release the GIL), one
+    job per oat header and per dex file. A compact line is written
+    for each file in the given order. The oat checksum is reported as
+    unchecked (see Extractor.oat_checksum_state) and does not make a
+    file fail, the dex files are checked completely.
+
+    :return: True if every file passed
+    '''
+    workers = workers or os.cpu_count() or 1
+    max_pending = workers * 2
+    all_passed = True
+    pending = []
+
+    def report(path, extractor, dex_futures, error):
+        if error is not None:
+            sys.stdout.write("ERROR %s %s\n" % (path, error))
+            return False
+
+        oat_state = extractor.oat_checksum_state()
+        dex_names = extractor.get_dex_names()
+        failed = []
 
-            actual_dex_file = actual_oatdexfile.dex_file
+        try:
+            for i, dex_future in enumerate(dex_futures):
+                checksum_ok, signature_ok = dex_future.result()
+                if not checksum_ok or not signature_ok:
+                    reasons = []
+                    if not checksum_ok:
+                        reasons.append("checksum")
+                    if not signature_ok:
+                        reasons.append("signature")
+                    failed.append("%d:%s(%s)" % (i, dex_names[i], ",".join(reasons)))
+        finally:
+            # no verify_dex can still be using the extractor once it is closed
+            wait(dex_futures)
+            extractor.close()
+
+        passed = len(failed) == 0
+
+        sys.stdout.write("%s %s oat=%s dex=%d/%d%s\n" % (
+            "PASS" if passed else "FAIL", path, oat_state,
+            len(dex_futures) - len(failed), len(dex_futures),
+            (" bad=[%s]" % " ".join(failed)) if len(failed) > 0 else ""))
+        sys.stdout.flush()
+
+        return passed
+
+    with ThreadPoolExecutor(max_workers=workers) as pool:
+        for path in paths:
+            extractor = None
+            try:
+                extractor = Extractor(path)
+                extractor.load()
+                dex_futures = [pool.submit(extractor.verify_dex, i) for i in range(extractor.number_of_dex_files)]
+                pending.append((path, extractor, dex_futures, None))
+            except Exception as e:
+                if extractor is not None:
+                    extractor.close()
+                pending.append((path, None, None, "%s: %s" % (type(e).__name__, str(e))))
+
+            # keep a bounded number of files (and descriptors) open
+            while len(pending) > max_pending:
+                all_passed = report(*pending.pop(0)) and all_passed
+
+        while len(pending) > 0:
+            all_passed = report(*pending.pop(0)) and all_passed
+
+    return all_passed
+
+BATCH_JOURNAL_NAME = "dextripador.journal"
+BATCH_MANIFEST_NAME = "dextripador.manifest"
+BATCH_MANIFEST_VERSION = 1
+BATCH_JOURNAL_DONE = "DONE"
+BATCH_JOURNAL_ERROR = "ERROR"
+BATCH_JOURNAL_UNCHANGED = "UNCHANGED"
+BATCH_HASH_CHUNK_SIZE = 1024 * 1024
+# worker processes are replaced after this number of inputs
+# so memory kept by the parsers does not pile up
+BATCH_TASKS_PER_WORKER = 64
+# max_tasks_per_child is only in Python 3.11, before it the
+# workers live for the whole run
+BATCH_POOL_OPTIONS = {"max_tasks_per_child": BATCH_TASKS_PER_WORKER} if sys.version_info >= (3, 11) else {}
+
+
+def discover_inputs(paths):
+    '''
+    Get the inputs to analyze from files and directories (searched
+    recursively). A vdex is only taken as input if there is no odex
+    or oat next to it, otherwise it is paired with that one.
+
+    :return: sorted list of tuples (path, output name), the output
+             name is the path relative to the searched directory
+             or the absolute path for files given explicitly
+    '''
+    inputs = {}
+
+    def add_file(path_name, output_name):
+        root, extension = os.path.splitext(strip_compressed_extension(path_name))
+
+        if extension in Extractor.ODEX_EXTENSIONS:
+            inputs[path_name] = output_name
+        elif extension == Extractor.VDEX_EXTENSION:
+            for odex_extension in Extractor.ODEX_EXTENSIONS:
+                for compressed_extension in [""] + Extractor.COMPRESSED_EXTENSIONS:
+                    if os.path.isfile(root + odex_extension + compressed_extension):
+                        return
+            inputs[path_name] = output_name
+
+    for path in paths:
+        if os.path.isdir(path):
+            for directory, _, file_names in os.walk(path):
+                for file_name in file_names:
+                    path_name = os.path.join(directory, file_name)
+                    add_file(path_name, os.path.relpath(path_name, path))
+        else:
+            # files given explicitly are always analyzed
+            inputs[path] = os.path.abspath(path).lstrip('/')
+
+    return sorted(inputs.items())
+
+
+def input_identity(path, path_to_vdex=""):
+    '''
+    Identity of an input and of the vdex paired with it (the given
+    one, else its sibling vdex), enough to know without reading them
+    if they changed.
+    '''
+    path_to_vdex = path_to_vdex or Extractor.find_vdex(path)
+    input_stat = os.stat(path)
+    identity = {
+        "size": input_stat.st_size,
+        "mtime_ns": input_stat.st_mtime_ns,
+        "vdex": path_to_vdex,
+        "vdex_size": 0,
+        "vdex_mtime_ns": 0
+    }
+
+    if path_to_vdex != "":
+        vdex_stat = os.stat(path_to_vdex)
+        identity["vdex_size"] = vdex_stat.st_size
+        identity["vdex_mtime_ns"] = vdex_stat.st_mtime_ns
+
+    return identity
+
+
+def input_hash(identity, path):
+    '''
+    Hash of the content of an input and its vdex, used when sizes
+    are the same but the files were touched (new firmware unpack).
+    '''
+    input_hash = hashlib.blake2b(digest_size=16)
+
+    for file_path in [path, identity["vdex"]]:
+        if file_path == "":
+            continue
+
+        with open(file_path, 'rb') as input_file:
+            while True:
+                chunk = input_file.read(BATCH_HASH_CHUNK_SIZE)
+                if not chunk:
+                    break
+                input_hash.update(chunk)
+
+    return input_hash.hexdigest()
+
+
+def same_identity(entry, identity, compare_times=True):
+    fields = ["size", "vdex", "vdex_size"]
+
+    if compare_times:
+        fields += ["mtime_ns", "vdex_mtime_ns"]
+
+    return all(entry.get(field) == identity[field] for field in fields)
+
+
+def read_manifest(manifest_path):
+    '''
+    Manifest of an output directory, for each input (by path) its
+    identity, its output directory and the dex files written:
+
+        {"version": 1, "inputs": {path: {"size", "mtime_ns", "vdex",
+            "vdex_size", "vdex_mtime_ns", "hash", "state", "output",
+            "error", "dex": [{"name", "size", "checksum", "signature",
+            "valid", "blob"}]}}}
+
+    valid is null for dex files linked from the store (not read).
+
+    :return: dictionary of inputs
+    '''
+    if not os.path.isfile(manifest_path):
+        return {}
+
+    with open(manifest_path, 'r') as manifest_file:
+        manifest = json.load(manifest_file)
+
+    if manifest.get("version") != BATCH_MANIFEST_VERSION:
+        raise ValueError("Unsupported manifest version in %s" % (manifest_path))
+
+    return manifest["inputs"]
+
+
+def write_manifest(manifest_path, inputs):
+    # write a new file and rename so a kill never leaves half a manifest
+    temporary_path = manifest_path + ".tmp"
+
+    with open(temporary_path, 'w') as manifest_file:
+        json.dump({"version": BATCH_MANIFEST_VERSION, "inputs": inputs}, manifest_file, indent=1, sort_keys=True)
+        manifest_file.flush()
+        os.fsync(manifest_file.fileno())
+
+    os.replace(temporary_path, manifest_path)
+
+
+def read_journal(journal_path):
+    '''
+    Journal of the run in progress, one line per finished input:
+    state, path, message and its manifest entry (tab separated).
+
+    :return: dictionary of inputs already processed with their entries
+    '''
+    completed = {}
+
+    if not os.path.isfile(journal_path):
+        return completed
 
-            actual_dex_file.print_header(num=i)
+    with open(journal_path, 'r') as journal:
+        for line in journal:
+            fields = line.rstrip('\n').split('\t')
+            # last line can be incomplete if the run was killed
+            if len(fields) >= 4 and line.endswith('\n') and \
+                    fields[0] in (BATCH_JOURNAL_DONE, BATCH_JOURNAL_ERROR, BATCH_JOURNAL_UNCHANGED):
+                completed[fields[1]] = json.loads(fields[3])
+
+    return completed
+
+
+def batch_output_directory(output_directory, output_name):
+    '''
+    Each input gets its own directory named after its path,
+    so dex files with the same name do not collide.
+    '''
+    return os.path.join(output_directory, strip_compressed_extension(output_name))
+
+
+def remove_outputs(output_directory, entry):
+    '''
+    Remove the dex files written for an input and the
+    directories left empty, up to the output directory.
+    '''
+    if "output" not in entry:
+        return
+
+    input_directory = batch_output_directory(output_directory, entry["output"])
+
+    for dex in entry.get("dex", []):
+        dex_path = os.path.join(input_directory, dex["name"])
+        if os.path.isfile(dex_path):
+            os.remove(dex_path)
+
+    directory = input_directory
+    while os.path.abspath(directory) != os.path.abspath(output_directory) and os.path.isdir(directory):
+        if len(os.listdir(directory)) > 0:
+            break
+        os.rmdir(directory)
+        directory = os.path.dirname(directory)
+
+
+def _batch_worker_init(verbosity, memory_limit):
+    set_verbosity(verbosity, quiet=True)
+
+    if memory_limit:
+        import resource
+        limit = memory_limit * 1024 * 1024
+        resource.setrlimit(resource.RLIMIT_AS, (limit, limit))
+
+
+def _batch_job(path, output_name, output_directory, recalculate_dex_checksum, previous_entry, store_directory):
+    entry = {"output": output_name}
+    extractor = None
+
+    try:
+        entry.update(input_identity(path))
+
+        # touched but maybe the same content, the hash decides (inputs
+        # which failed before are always retried)
+        if previous_entry is not None and previous_entry.get("state") == "done" and \
+                same_identity(previous_entry, entry, compare_times=False):
+            entry["hash"] = input_hash(entry, path)
+
+            if entry["hash"] == previous_entry.get("hash"):
+                previous_entry.update(entry)
+                return (BATCH_JOURNAL_UNCHANGED, path, "unchanged", previous_entry)
+        else:
+            entry["hash"] = input_hash(entry, path)
+
+        if previous_entry is not None:
+            remove_outputs(output_directory, previous_entry)
+
+        extractor = Extractor(path)
+        extractor.load()
+
+        input_directory = batch_output_directory(output_directory, output_name)
+        os.makedirs(input_directory, exist_ok=True)
+        store = DexStore(store_directory) if store_directory else None
+        extractor.extract_all_dex(recalculate_dex_checksum, input_directory, store)
+
+        entry["state"] = "done"
+        entry["dex"] = []
+
+        for dex_entry in extractor.dex_entries:
+            checksum = dex_entry.dex_file.checksum
+            signature = bytes(dex_entry.dex_file.signature)
+            valid = None
+
+            if dex_entry.calculated_signature is not None:
+                valid = checksum == dex_entry.calculated_checksum and signature == dex_entry.calculated_signature
+
+                if recalculate_dex_checksum:
+                    checksum = dex_entry.calculated_checksum
+                    signature = dex_entry.calculated_signature
+
+            entry["dex"].append({
+                "name": dex_entry.name,
+                "size": dex_entry.size,
+                "checksum": "%08x" % (checksum),
+                "signature": signature.hex(),
+                "valid": valid,
+                "blob": dex_entry.blob
+            })
+
+        return (BATCH_JOURNAL_DONE, path, "dex=%d" % (extractor.number_of_dex_files), entry)
+    except Exception as e:
+        message = ("%s: %s" % (type(e).__name__, str(e))).replace('\n', ' ')
+        entry["state"] = "error"
+        entry["error"] = message
+        return (BATCH_JOURNAL_ERROR, path, message, entry)
+    finally:
+        if extractor is not None:
+            extractor.close()
+
+
+def batch_extract(paths, output_directory, journal_path=None, workers=None,
+                  recalculate_dex_checksum=False, memory_limit=None, verbosity=None, store_directory=None):
+    '''
+    Extract all the dex files of the inputs in a pool of worker
+    processes (the ELF parser is not thread safe and parsing is
+    bound to the GIL). Only 2 * workers inputs are submitted at a
+    time, and each worker can have an address space limit of
+    memory_limit MiB.
+
+    The output directory keeps a manifest of the inputs, a rerun only
+    extracts inputs which are new or whose identity changed (size,
+    modification time, content hash, paired vdex), and removes the
+    outputs of inputs which do not exist anymore. During the run
+    every finished input is appended to the journal, inputs in it are
+    skipped so an interrupted run continues where it stopped. At the
+    end the journal is merged into the manifest and removed.
+
+    With store_directory the dex files go to a DexStore shared by all
+    the inputs and the outputs are links to it.
+
+    :return: True if there were no errors
+    '''
+    workers = workers or os.cpu_count() or 1
+    max_pending = workers * 2
+    journal_path = journal_path or os.path.join(output_directory, BATCH_JOURNAL_NAME)
+    manifest_path = os.path.join(output_directory, BATCH_MANIFEST_NAME)
+    store = DexStore(store_directory) if store_directory else None
+
+    os.makedirs(output_directory, exist_ok=True)
+
+    inputs = discover_inputs(paths)
+    manifest = read_manifest(manifest_path)
+    completed = read_journal(journal_path)
+    manifest.update(completed)
+
+    counters = {BATCH_JOURNAL_DONE: 0, BATCH_JOURNAL_ERROR: 0, BATCH_JOURNAL_UNCHANGED: 0}
+    input_paths = set(path for path, _ in inputs)
+    pending_inputs = []
+
+    for path, output_name in inputs:
+        if path in completed:
+            continue
+
+        previous_entry = manifest.get(path)
+
+        if previous_entry is not None:
+            # inputs which failed in a previous run are retried
+            try:
+                if previous_entry.get("state") == "done" and same_identity(previous_entry, input_identity(path)) and \
+                        previous_entry.get("output") == output_name:
+                    counters[BATCH_JOURNAL_UNCHANGED] += 1
+                    continue
+            except OSError:
+                pass
+
+            if previous_entry.get("output") != output_name:
+                remove_outputs(output_directory, previous_entry)
+                previous_entry = None
+
+        pending_inputs.append((path, output_name, previous_entry))
+
+    # inputs deleted since the last run, entries of inputs just not
+    # given this time are kept with their outputs
+    removed = [path for path in manifest if path not in input_paths and not os.path.exists(path)]
+
+    for path in removed:
+        remove_outputs(output_directory, manifest.pop(path))
+
+    sys.stdout.write("Batch: %d inputs, %d to process, %d unchanged, %d in journal %s, %d removed\n" % (
+        len(inputs), len(pending_inputs), counters[BATCH_JOURNAL_UNCHANGED],
+        len(completed), journal_path, len(removed)))
+    sys.stdout.flush()
+
+    def record(future, journal):
+        try:
+            state, path, message, entry = future.result()
+        except Exception as e:
+            # the worker process died (killed, out of memory...), the
+            # input is not added to the manifest so it is retried
+            state, path, message, entry = BATCH_JOURNAL_ERROR, pending[future], \
+                "%s: %s" % (type(e).__name__, str(e)), None
+        counters[state] += 1
+        if entry is not None:
+            manifest[path] = entry
+            if store is not None and state == BATCH_JOURNAL_DONE:
+                store.append_index([(path, i, dex["name"], dex["blob"])
+                                    for i, dex in enumerate(entry["dex"]) if dex["blob"] is not None])
+            journal.write("%s\t%s\t%s\t%s\n" % (state, path, message, json.dumps(entry, sort_keys=True)))
+            journal.flush()
+        sys.stdout.write("%s %s %s\n" % (state, path, message))
+        sys.stdout.flush()
+
+    with open(journal_path, 'a') as journal, \
+            ProcessPoolExecutor(max_workers=workers,
+                                mp_context=multiprocessing.get_context('spawn'),
+                                initializer=_batch_worker_init,
+                                initargs=(verbosity, memory_limit),
+                                **BATCH_POOL_OPTIONS) as pool:
+        pending = {}
+
+        # finish a line left incomplete by a killed run
+        if journal.tell() > 0:
+            with open(journal_path, 'rb') as journal_file:
+                journal_file.seek(-1, os.SEEK_END)
+                if journal_file.read(1) != b'\n':
+                    journal.write('\n')
+
+        for path, output_name, previous_entry in pending_inputs:
+            future = pool.submit(_batch_job, path, output_name, output_directory,
+                                 recalculate_dex_checksum, previous_entry, store_directory)
+            pending[future] = path
+
+            if len(pending) >= max_pending:
+                done, _ = wait(pending, return_when=FIRST_COMPLETED)
+                for future in done:
+                    record(future, journal)
+                    del pending[future]
+
+        for future in list(pending):
+            record(future, journal)
+
+    write_manifest(manifest_path, manifest)
+    os.remove(journal_path)
+
+    sys.stdout.write("Batch done: %d extracted, %d unchanged, %d errors, %d removed\n" % (
+        counters[BATCH_JOURNAL_DONE], counters[BATCH_JOURNAL_UNCHANGED],
+        counters[BATCH_JOURNAL_ERROR], len(removed)))
+
+    return counters[BATCH_JOURNAL_ERROR] == 0
+
+def print_code_offsets(extractor, queries):
+    '''
+    Write the code offset of each (class descriptor, method_idx)
+    in queries, looked up in the CompiledCodeIndex of extractor.
+    '''
+    index = extractor.get_compiled_code_index()
+    queries = [(descriptor, int(method_idx, 0)) for descriptor, method_idx in queries]
+
+    for (descriptor, method_idx), code_offset in zip(queries, index.code_offsets(queries)):
+        location = index.find_class(descriptor)
+
+        if location is None:
+            sys.stdout.write("%s %d class not found\n" % (descriptor, method_idx))
+        elif code_offset is None:
+            sys.stdout.write("%s %d dex=%d class_def=%d not compiled\n" % ((descriptor, method_idx) + location))
+        else:
+            sys.stdout.write("%s %d dex=%d class_def=%d code_offset=0x%08X\n" % (
+                (descriptor, method_idx) + location + (code_offset,)))
+
+
+def print_code_footprint(extractor, top=10, workers=None):
+    '''
+    Write the compiled code of every dex of extractor (methods, code
+    bytes, code bytes without the deduplicated code, biggest frame)
+    with its biggest classes and methods, and the totals.
+    '''
+    total_methods = total_code = total_unique = 0
+
+    for dex_number, footprint in enumerate(extractor.get_code_footprints(workers)):
+        descriptors = extractor.get_class_descriptors(dex_number)
+        class_methods, class_code = footprint_by_class(footprint, len(descriptors))
+        unique = unique_code_size(footprint)
+        code = sum(footprint.code_size)
+
+        sys.stdout.write("Dex %d (%s): methods=%d code=%d unique=%d max_frame=%d out_of_bound=%d\n" % (
+            dex_number, extractor.dex_entries[dex_number].name, len(footprint.code_size), code, unique,
+            max(footprint.frame_size, default=0), footprint.out_of_bound))
+
+        for class_def_idx in sorted(range(len(descriptors)), key=lambda i: class_code[i], reverse=True)[:top]:
+            if class_code[class_def_idx] > 0:
+                sys.stdout.write("\tclass %s methods=%d code=%d\n" % (
+                    descriptors[class_def_idx], class_methods[class_def_idx], class_code[class_def_idx]))
+
+        biggest = sorted(range(len(footprint.code_size)), key=lambda i: footprint.code_size[i], reverse=True)[:top]
+
+        if len(biggest) > 0:
+            signatures = dict(zip(extractor.get_dex_index(dex_number).class_data().method_idx,
+                                  extractor.get_method_signatures(dex_number)))
+
+            for i in biggest:
+                sys.stdout.write("\tmethod %s code=%d frame=%d offset=0x%08X%s\n" % (
+                    signatures[footprint.method_idx[i]], footprint.code_size[i], footprint.frame_size[i],
+                    footprint.code_offset[i], " out_of_bound" if footprint.flags[i] & FOOTPRINT_OUT_OF_BOUND else ""))
+
+        total_methods += len(footprint.code_size)
+        total_code += code
+        total_unique += unique
+
+    sys.stdout.write("Total: methods=%d code=%d unique=%d\n" % (total_methods, total_code, total_unique))
+
+
+def _index_job(path, methods):
+    extractor = None
+
+    try:
+        extractor = Extractor(path)
+        extractor.load()
+
+        classes = []
+        signatures = []
+
+        for i in range(extractor.number_of_dex_files):
+            classes += extractor.get_class_descriptors(i)
+            if methods:
+                signatures += extractor.get_method_signatures(i)
+
+        return (path, classes, signatures, None)
+    except Exception as e:
+        return (path, None, None, ("%s: %s" % (type(e).__name__, str(e))).replace('\n', ' '))
+    finally:
+        if extractor is not None:
+            extractor.close()
+
+
+def build_corpus_index(paths, index_path, methods=False, workers=None, verbosity=None):
+    '''
+    Write a CorpusIndex of the classes (and with methods, of the
+    method signatures) of the inputs, files and directories as in
+    --batch. The inputs are parsed in a pool of worker processes,
+    a line is written for each of them.
+
+    :return: True if every input was indexed
+    '''
+    workers = workers or os.cpu_count() or 1
+    inputs = [path for path, _ in discover_inputs(paths)]
+    results = {}
+    errors = 0
+
+    with ProcessPoolExecutor(max_workers=workers,
+                             mp_context=multiprocessing.get_context('spawn'),
+                             initializer=_batch_worker_init,
+                             initargs=(verbosity, None),
+                             **BATCH_POOL_OPTIONS) as pool:
+        for path, classes, signatures, error in pool.map(_index_job, inputs, [methods] * len(inputs)):
+            if error is not None:
+                sys.stdout.write("ERROR %s %s\n" % (path, error))
+                errors += 1
+            else:
+                sys.stdout.write("INDEXED %s classes=%d%s\n" % (
+                    path, len(classes), (" methods=%d" % len(signatures)) if methods else ""))
+                results[path] = (classes, signatures)
+            sys.stdout.flush()
+
+    # file ids in path order, the same inputs give the same index
+    writer = CorpusIndexWriter(index_path, methods)
+    for path in sorted(results):
+        writer.add_file(path, *results[path])
+    number_of_files, number_of_terms = writer.write()
+
+    sys.stdout.write("Index %s: %d files, %d classes, %d errors\n" % (
+        index_path, number_of_files, number_of_terms, errors))
+
+    return errors == 0
+
+
+def query_corpus_index(index_path, terms):
+    '''
+    Write the files of a CorpusIndex with each term, FOUND for class
+    descriptors and MAYBE for the method signatures (Bloom filters).
+
+    :return: True if some file was found
+    '''
+    found = False
+
+    with CorpusIndex(index_path) as index:
+        for term in terms:
+            if METHOD_SEPARATOR in term and not index.has_methods:
+                sys.stdout.write("NOMETHODS %s\n" % (term))
+                continue
+
+            exact, paths = index.query(term)
+
+            for path in paths:
+                sys.stdout.write("%s %s %s\n" % ("FOUND" if exact else "MAYBE", term, path))
+
+            found = found or len(paths) > 0
+
+    return found
+
+
+def diff_files(old_path, new_path):
+    '''
+    Write the differences of two builds (odex/oat/vdex) from the
+    sections down to the methods, one line per difference and a
+    summary with the number of each level.
+
+    :return: True if the builds are the same
+    '''
+    extractors = []
+    differences = collections.Counter()
+
+    try:
+        for path in [old_path, new_path]:
+            try:
+                extractor = Extractor(path)
+                extractors.append(extractor)
+                extractor.load()
+            except Exception as e:
+                sys.stdout.write("ERROR %s %s: %s\n" % (path, type(e).__name__, str(e)))
+                return False
+
+        old, new = extractors
+
+        for difference in diff_builds(old, new):
+            sys.stdout.write("%s %s %s%s\n" % (difference.state, difference.level, difference.name,
+                                               " " + difference.detail if difference.detail else ""))
+            differences[difference.level] += 1
+    finally:
+        for extractor in extractors:
+            extractor.close()
+
+    sys.stdout.write("%s %s %s: %s\n" % ("SAME" if len(differences) == 0 else "DIFFERENT", old_path, new_path,
+                                         ", ".join("%d %s" % (differences[level], level)
+                                                   for level in (DIFF_SECTION, DIFF_DEX, DIFF_CLASS, DIFF_METHOD))))
+
+    return len(differences) == 0
+
+
+def carve_files(paths, output_dir):
+    '''
+    Write the oat, vdex, dex and ELF images found in raw inputs (dumps
+    of partitions or memory, truncated files) to output_dir, one line
+    per image and a summary per input. The oat and odex images are
+    loaded once written (with their vdex) and removed if they cannot
+    be analyzed.
+
+    :return: True if every input was scanned
+    '''
+    errors = 0
+
+    os.makedirs(output_dir, exist_ok=True)
+
+    for path in paths:
+        try:
+            carver = Carver(path)
+        except OSError as e:
+            sys.stdout.write("ERROR %s %s\n" % (path, str(e)))
+            errors += 1
+            continue
+
+        with carver:
+            candidates = carver.scan()
+            images = carver.carve()
+            paired = set(image.vdex for image in images if image.vdex is not None)
+            carved = 0
+
+            for image in images:
+                # a vdex paired with an oat is written next to it
+                if image.kind == CARVE_VDEX and image.offset in paired:
+                    continue
+
+                image_root = os.path.join(output_dir, "%s_%010X" % (ntpath.basename(path), image.offset))
+                image_path = image_root + CARVE_EXTENSIONS[image.kind]
+                carver.write(image.offset, image.size, image_path)
+
+                if image.vdex is not None:
+                    carver.write(image.vdex, carver.vdex_images[image.vdex][0], image_root + Extractor.VDEX_EXTENSION)
+
+                if image.kind in (CARVE_OAT, CARVE_ELF):
+                    extractor = Extractor(image_path)
+
+                    try:
+                        extractor.load()
+                    except Exception as e:
+                        os.remove(image_path)
+
+                        if image.vdex is not None:
+                            os.replace(image_root + Extractor.VDEX_EXTENSION,
+                                       os.path.join(output_dir, "%s_%010X%s" % (ntpath.basename(path), image.vdex,
+                                                                               Extractor.VDEX_EXTENSION)))
+
+                        Printer.verbose1("INVALID %s 0x%010X %s" % (CARVE_KIND_NAMES[image.kind], image.offset, str(e)))
+                        continue
+                    finally:
+                        extractor.close()
+
+                sys.stdout.write("CARVED %s 0x%010X size=%d version=%03d %s %s\n" %
+                                 (CARVE_KIND_NAMES[image.kind], image.offset, image.size, image.version,
+                                  image.detail, image_path))
+                carved += 1
+
+            for kind, offset, reason in carver.invalid:
+                Printer.verbose1("INVALID %s 0x%010X %s" % (CARVE_KIND_NAMES[kind], offset, reason))
+
+            sys.stdout.write("CARVE %s: %d images from %d candidates\n" % (path, carved, candidates))
+
+    return errors == 0
+
+
+DAEMON_CACHE_SIZE = 64
+DAEMON_OPERATIONS = ["parse", "list", "extract", "verify"]
+
+
+class ExtractorCache():
+    '''
+    Loaded extractors of the daemon by path, an entry is used while
+    the input (and its vdex) keep the same identity. The least
+    recently used extractors are closed when there are more than
+    max_entries (every one keeps its files open).
+    '''
+
+    def __init__(self, max_entries=DAEMON_CACHE_SIZE):
+        self.max_entries = max_entries
+        self.entries = collections.OrderedDict()
+        self.lock = threading.Lock()
+        # the ELF parser keeps global state, only one load at a time
+        self.load_lock = threading.Lock()
+
+    def get(self, path, path_to_vdex=""):
+        '''
+        :return: tuple (extractor, extractor lock, True if it was cached)
+        '''
+        key = (os.path.abspath(path), path_to_vdex)
+        identity = input_identity(path, path_to_vdex)
+
+        with self.lock:
+            entry = self.entries.get(key)
+            if entry is not None and entry[0] == identity:
+                self.entries.move_to_end(key)
+                return entry[1], entry[2], True
+
+        with self.load_lock:
+            extractor = Extractor(path, path_to_vdex)
+            try:
+                extractor.load()
+            except Exception:
+                extractor.close()
+                raise
+
+        with self.lock:
+            old_entry = self.entries.pop(key, None)
+            self.entries[key] = (identity, extractor, threading.Lock())
+
+            # closed once the jobs still using them are done
+            evicted = [old_entry] if old_entry is not None else []
+            while len(self.entries) > self.max_entries:
+                evicted.append(self.entries.popitem(last=False)[1])
+
+            entry = self.entries[key]
+
+        for _, evicted_extractor, evicted_lock in evicted:
+            with evicted_lock:
+                evicted_extractor.close()
+
+        return entry[1], entry[2], False
+
+    def clear(self):
+        with self.lock:
+            for _, extractor, _ in self.entries.values():
+                extractor.close()
+            self.entries.clear()
+
+
+def dex_description(index, dex_entry):
+    return {
+        "index": index,
+        "name": dex_entry.name,
+        "offset": dex_entry.offset,
+        "size": dex_entry.size,
+        "checksum": dex_entry.dex_file.checksum,
+        "signature": bytes(dex_entry.dex_file.signature).hex()
+    }
+
+
+class DaemonRequestHandler(socketserver.StreamRequestHandler):
+    '''
+    One connection of the daemon, each line is a JSON job:
+
+        {"id": any, "op": "parse"|"list"|"extract"|"verify", "path": file,
+         "vdex": file (optional), "output_directory": directory (extract),
+         "index": dex number (extract, all by default),
+         "replace_checksum": bool (extract), "store": directory (extract)}
+
+    Results are streamed as JSON lines with the id of the job, one per
+    dex for list, extract and verify, and a last one with "status"
+    ("ok" or "error"). Jobs of one connection run in order.
+    '''
+
+    def send(self, message):
+        self.wfile.write(json.dumps(message).encode() + b'\n')
+        self.wfile.flush()
+
+    def handle(self):
+        for line in self.rfile:
+            if line.strip() == b"":
+                continue
+
+            job_id = None
+
+            try:
+                job = json.loads(line)
+                job_id = job.get("id")
+                result = self.run_job(job, job_id)
+                result.update({"id": job_id, "status": "ok"})
+            except BrokenPipeError:
+                return
+            except Exception as e:
+                result = {"id": job_id, "status": "error", "error": "%s: %s" % (type(e).__name__, str(e))}
+
+            try:
+                self.send(result)
+            except BrokenPipeError:
+                return
+
+    def run_job(self, job, job_id):
+        operation = job.get("op")
+
+        if operation not in DAEMON_OPERATIONS:
+            raise ValueError("Unknown operation %s" % (operation))
+
+        if "path" not in job:
+            raise ValueError("Missing path of the input")
+
+        # the files of the extractor are not closed (evicted) during
+        # the job, and the dex entries keep the results of the last write
+        while True:
+            extractor, extractor_lock, cached = self.server.cache.get(job["path"], job.get("vdex", ""))
+            extractor_lock.acquire()
+            if not extractor.closed:
+                break
+            extractor_lock.release()
+
+        result = {"cached": cached, "number_of_dex_files": extractor.number_of_dex_files}
+
+        try:
+            if operation == "parse":
+                result["oat_version"] = None if extractor.oatdata is None else \
+                    c_string(extractor.oatdata.version).decode()
+                result["vdex"] = extractor.path_to_vdex if extractor.vdex_file is not None else None
+                result["number_of_optimized_methods"] = extractor.number_of_optimized_methods
+
+            elif operation == "list":
+                for i, dex_entry in enumerate(extractor.dex_entries):
+                    self.send({"id": job_id, "dex": dex_description(i, dex_entry)})
+
+            elif operation == "extract":
+                output_directory = job.get("output_directory", "")
+                store = self.server.get_store(job["store"]) if job.get("store") else None
+                indexes = range(extractor.number_of_dex_files) if job.get("index") is None else [job["index"]]
+
+                for i in indexes:
+                    if i >= extractor.number_of_dex_files or i < 0:
+                        raise DexOutOfFoundException("Selected Dex (%d) doesn't exists" % (i))
+
+                if output_directory != "":
+                    os.makedirs(output_directory, exist_ok=True)
+
+                for i in indexes:
+                    extractor.extract_dex(i, os.path.join(output_directory, extractor.dex_entries[i].name),
+                                          job.get("replace_checksum", False), store)
+                    dex_entry = extractor.dex_entries[i]
+                    message = {"index": i, "name": dex_entry.name,
+                               "path": os.path.join(output_directory, dex_entry.name), "blob": dex_entry.blob}
+
+                    if store is not None and dex_entry.blob is not None:
+                        store.append_index([(job["path"], i, dex_entry.name, dex_entry.blob)])
+
+                    self.send({"id": job_id, "dex": message})
+
+            elif operation == "verify":
+                pool = self.server.pool
+                dex_futures = [pool.submit(extractor.verify_dex, i) for i in range(extractor.number_of_dex_files)]
+
+                for i, dex_future in enumerate(dex_futures):
+                    checksum_ok, signature_ok = dex_future.result()
+                    self.send({"id": job_id, "dex": {"index": i, "name": extractor.dex_entries[i].name,
+                                                     "checksum_ok": checksum_ok, "signature_ok": signature_ok}})
+
+                result["oat"] = extractor.oat_checksum_state()
+
+            return result
+        finally:
+            extractor_lock.release()
+
+
+class ExtractionDaemon(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    '''
+    Daemon serving extraction jobs on a Unix socket, it keeps the
+    loaded extractors, the stores and a thread pool for the checksums
+    (the native kernels release the GIL) between jobs.
+    '''
+    daemon_threads = True
+
+    def __init__(self, socket_path, workers=None, cache_size=DAEMON_CACHE_SIZE):
+        if os.path.exists(socket_path) and stat.S_ISSOCK(os.stat(socket_path).st_mode):
+            os.remove(socket_path)
+
+        super().__init__(socket_path, DaemonRequestHandler)
+        os.chmod(socket_path, 0o600)
+
+        self.socket_path = socket_path
+        self.cache = ExtractorCache(cache_size)
+        self.pool = ThreadPoolExecutor(max_workers=workers or os.cpu_count() or 1)
+        self.stores = {}
+        self.stores_lock = threading.Lock()
+
+    def get_store(self, store_directory):
+        with self.stores_lock:
+            if store_directory not in self.stores:
+                self.stores[store_directory] = DexStore(store_directory)
+            return self.stores[store_directory]
+
+    def server_close(self):
+        super().server_close()
+        self.pool.shutdown()
+        self.cache.clear()
+        if os.path.exists(self.socket_path):
+            os.remove(self.socket_path)
+
+
+def run_daemon(socket_path, workers=None):
+    daemon = ExtractionDaemon(socket_path, workers)
+    signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+
+    sys.stdout.write("Listening on %s\n" % (socket_path))
+    sys.stdout.flush()
+
+    try:
+        daemon.serve_forever()
+    except (KeyboardInterrupt, SystemExit):
+        pass
+    finally:
+        daemon.server_close()
+
+
+def daemon_request(socket_path, job):
+    '''
+    Send one job to a running daemon.
+
+    :return: generator of the JSON messages of the job, the last one has "status"
+    '''
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as client:
+        client.connect(socket_path)
+        client.sendall(json.dumps(job).encode() + b'\n')
+        client.shutdown(socket.SHUT_WR)
+
+        with client.makefile('rb') as responses:
+            for line in responses:
+                message = json.loads(line)
+                yield message
+                if "status" in message:
+                    return
 
 verbosity_message = '''
 Verbosity level:
@@ -306,6 +1815,24 @@ Verbosity level:
     3: verbose level 3"
 '''
 
+def set_verbosity(verbosity, quiet=False):
+    '''
+    :param quiet: no messages unless some verbosity was requested
+    '''
+    SET_COMMAND_FLAG(not quiet or verbosity is not None)
+
+    if verbosity == -1:
+        SET_COMMAND_FLAG (False)
+    elif verbosity == 1:
+        SET_VERBOSE1(True)
+    elif verbosity == 2:
+        SET_VERBOSE1(True)
+        SET_VERBOSE2(True)
+    elif verbosity == 3:
+        SET_VERBOSE1(True)
+        SET_VERBOSE2(True)
+        SET_VERBOSE3(True)
+
 def main():
     extractor = None
 
@@ -316,7 +1843,7 @@ def main():
 
     parser = argparse.ArgumentParser(
         description="'Dextripador' tool for pasing Odex files and extract dex files from them.\nResearch From UC3M-COSEC & IMDEA Networks.")
-    parser.add_argument("-i", "--input", type=str, help="APK to analyze", required=True)
+    parser.add_argument("-i", "--input", type=str, nargs='+', help="Odex/oat/vdex files to analyze (plain or .xz/.gz/.zst/.lz4), the .vdex next to an odex is used automatically. With --batch also directories", default=[])
     parser.add_argument("-v", "--verbosity", type=int, help=verbosity_message)
     parser.add_argument("-o", "--output", type=str, help="Output name for the file, by default is extracted from OAT header")
     parser.add_argument("--dextripar", type=int, help="Extract one of the dex files given by index", default=-1)
@@ -324,46 +1851,163 @@ def main():
     parser.add_argument("--replace-checksum", action="store_true", help="If selected any dextripar option, replace dex checksum for calculated one")
     parser.add_argument("--print-headers", action="store_true", help="Show all the OAT headers (including dex headers)")
     parser.add_argument("--list-dexs", action="store_true", help="List all the internal dex files")
+    parser.add_argument("--verify", action="store_true", help="Check the dex checksums and signatures of all the inputs without writing any output (the oat checksum is reported as unchecked)")
+    parser.add_argument("-j", "--jobs", type=int, help="Number of worker threads used by --verify (processes for --batch), by default the number of CPUs")
+    parser.add_argument("--batch", type=str, metavar="OUTPUT_DIR", help="Extract all the dex files of every input to its own directory under OUTPUT_DIR using a pool of worker processes. A manifest in OUTPUT_DIR keeps reruns incremental")
+    parser.add_argument("--input-list", type=str, help="File with one input (file or directory) per line, added to -i")
+    parser.add_argument("--journal", type=str, help="Journal of the --batch run in progress, inputs in it are skipped when an interrupted run is resumed. By default OUTPUT_DIR/%s" % (BATCH_JOURNAL_NAME))
+    parser.add_argument("--store", type=str, help="Content addressed store of dex files (by signature and size) for the extraction options, outputs are links to it and duplicated dex are not copied again")
+    parser.add_argument("--archive", type=str, metavar="PATH", help="Write all the dex files of every input in one archive (classes.dex, classes2.dex...) instead of one file per dex, '-' writes it to stdout")
+    parser.add_argument("--archive-format", type=str, choices=[ZIP_FORMAT, TAR_FORMAT], help="Format of --archive: stored zip (as an APK) or tar. By default from the extension of PATH, tar for stdout")
+    parser.add_argument("--dump-strings", type=str, metavar="PATH", help="Write the string table of every dex of the inputs to PATH, '-' writes them to stdout")
+    parser.add_argument("--strings-format", type=str, choices=[STRINGS_LINES, STRINGS_BINARY], default=STRINGS_LINES, help="Format of --dump-strings: one UTF-8 string per line ('\\n' and '\\\\' escaped) or each string prefixed by its uint32 little endian length")
+    parser.add_argument("--code-footprint", action="store_true", help="Print the size of the compiled code of every dex (from the method headers) with its biggest classes and methods")
+    parser.add_argument("--footprint-top", type=int, default=10, help="Classes and methods listed per dex by --code-footprint")
+    parser.add_argument("--code-offset", type=str, nargs=2, action="append", metavar=("CLASS", "METHOD_IDX"), help="Print the code offset in the OAT file of the compiled method METHOD_IDX of the class descriptor CLASS, can be repeated", default=[])
+    parser.add_argument("--build-index", type=str, metavar="INDEX", help="Write an index of the classes of every input (files or directories as in --batch) to INDEX, for --query")
+    parser.add_argument("--index-methods", action="store_true", help="Add the method signatures (Lcom/a/A;->foo(I)V) to the Bloom filters of --build-index")
+    parser.add_argument("--query", type=str, metavar="INDEX", help="Print the inputs of INDEX (from --build-index) which have the classes or methods of --term, without opening them")
+    parser.add_argument("--term", type=str, nargs='+', help="Class descriptors or method signatures looked for by --query", default=[])
+    parser.add_argument("--carve", type=str, metavar="OUTPUT_DIR", help="Scan the inputs (any file: raw dumps of partitions or memory, truncated images) for oat, vdex, dex and ELF images and write every valid one to OUTPUT_DIR")
+    parser.add_argument("--diff", type=str, nargs=2, metavar=("OLD", "NEW"), help="Print the sections, dex files, classes and methods which differ between two builds (odex/oat/vdex), only the parts with different hashes are compared deeper")
+    parser.add_argument("--daemon", type=str, metavar="SOCKET", help="Serve parse, list, extract and verify jobs (JSON lines) on a Unix socket, keeping the parsed inputs loaded between jobs")
+    parser.add_argument("--worker-memory", type=int, help="Address space limit in MiB of each --batch worker process")
     parser.add_argument("--show-credits", action="store_true", help="Show credits of the tool")
     args = parser.parse_args()
 
-    SET_COMMAND_FLAG(True)
+    if args.daemon:
+        set_verbosity(args.verbosity, quiet=True)
+        run_daemon(args.daemon, args.jobs)
+        sys.exit(0)
 
-    if args.verbosity == -1:
-        SET_COMMAND_FLAG (False)
-    elif args.verbosity == 1:
-        SET_VERBOSE1(True)
-    elif args.verbosity == 2:
-        SET_VERBOSE1(True)
-        SET_VERBOSE2(True)
-    elif args.verbosity == 3:
-        SET_VERBOSE1(True)
-        SET_VERBOSE2(True)
-        SET_VERBOSE3(True)
+    if args.input_list:
+        with open(args.input_list, 'r') as input_list:
+            args.input += [line.strip() for line in input_list if line.strip() != ""]
+
+    if args.query:
+        if len(args.term) == 0:
+            parser.error("--query needs a --term")
+        sys.exit(0 if query_corpus_index(args.query, args.term) else 1)
+
+    if args.diff:
+        set_verbosity(args.verbosity, quiet=True)
+        sys.exit(0 if diff_files(*args.diff) else 1)
 
-    extractor = Extractor(args.input)
-    extractor.load()
+    if len(args.input) == 0:
+        parser.error("an input is required (-i or --input-list)")
 
-    if args.print_headers:
-        extractor.print_all_headers()
+    # keep the reports clean unless some verbosity was requested
+    set_verbosity(args.verbosity, quiet=args.verify or args.batch is not None or args.build_index is not None or
+                  args.carve is not None)
 
-    if args.list_dexs:
-        extractor.print_all_dex()
+    # messages are printed to stdout, they would break the archive or the strings
+    if args.archive == '-' or args.dump_strings == '-':
+        SET_COMMAND_FLAG(False)
 
-    if args.dextripar_all:
-        if args.replace_checksum:
-            extractor.extract_all_dex(True)
+    if args.batch:
+        if not batch_extract(args.input, args.batch, args.journal, args.jobs,
+                             args.replace_checksum, args.worker_memory, args.verbosity, args.store):
+            sys.exit(1)
+        sys.exit(0)
+
+    if args.carve:
+        if not carve_files(args.input, args.carve):
+            sys.exit(1)
+        sys.exit(0)
+
+    if args.build_index:
+        if not build_corpus_index(args.input, args.build_index, args.index_methods, args.jobs, args.verbosity):
+            sys.exit(1)
+        sys.exit(0)
+
+    if args.verify:
+        if not verify_files(args.input, args.jobs):
+            sys.exit(1)
+        sys.exit(0)
+
+    store = DexStore(args.store) if args.store else None
+    sink = None
+
+    if args.archive:
+        archive_format = args.archive_format
+
+        if archive_format is None:
+            archive_format = ZIP_FORMAT if args.archive.endswith(('.zip', '.apk', '.jar')) else TAR_FORMAT
+
+        if args.archive == '-':
+            archive_fd = sys.stdout.fileno()
         else:
-            extractor.extract_all_dex()
+            archive_fd = os.open(args.archive, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644)
+
+        sink = open_sink(archive_fd, archive_format)
+
+    strings_fd = None
+
+    if args.dump_strings:
+        if args.dump_strings == '-':
+            strings_fd = sys.stdout.fileno()
+        else:
+            strings_fd = os.open(args.dump_strings, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644)
+
+    for input_file in args.input:
+        extractor = Extractor(input_file)
 
-    if args.dextripar >= 0:
         try:
-            if args.output:
-                extractor.extract_dex(args.dextripar, args.output)
-            else:
-                extractor.extract_dex(args.dextripar, "")
-        except DexOutOfFoundException as dofe:
-            Printer.print("Error extracting dex: %s" % (str(dofe)))
+            extractor.load()
+
+            if args.print_headers:
+                extractor.print_all_headers()
+
+            if args.list_dexs:
+                extractor.print_all_dex()
+
+            if args.dextripar_all:
+                if args.replace_checksum:
+                    extractor.extract_all_dex(True, store=store)
+                else:
+                    extractor.extract_all_dex(store=store)
+
+            if args.code_footprint:
+                print_code_footprint(extractor, args.footprint_top, args.jobs)
+
+            if len(args.code_offset) > 0:
+                print_code_offsets(extractor, args.code_offset)
+
+            if strings_fd is not None:
+                extractor.dump_strings(strings_fd, args.strings_format == STRINGS_BINARY)
+
+            if sink is not None:
+                # one directory per input when several are in the same archive
+                prefix = ""
+                if len(args.input) > 1:
+                    prefix = "/".join(part for part in os.path.normpath(strip_compressed_extension(input_file)).split('/')
+                                      if part not in ("", ".", "..")) + "/"
+
+                extractor.extract_all_dex_to_sink(sink, args.replace_checksum, prefix)
+
+            if args.dextripar >= 0:
+                try:
+                    if args.output:
+                        extractor.extract_dex(args.dextripar, args.output, args.replace_checksum, store)
+                    else:
+                        extractor.extract_dex(args.dextripar, "", args.replace_checksum, store)
+                except DexOutOfFoundException as dofe:
+                    Printer.print("Error extracting dex: %s" % (str(dofe)))
+
+            if store is not None:
+                store.append_index([(input_file, i, dex_entry.name, dex_entry.blob)
+                                    for i, dex_entry in enumerate(extractor.dex_entries) if dex_entry.blob is not None])
+        finally:
+            extractor.close()
+
+    if sink is not None:
+        sink.close()
+
+        if args.archive != '-':
+            os.close(sink.fd)
+
+    if strings_fd is not None and args.dump_strings != '-':
+        os.close(strings_fd)
 
 
 if __name__ == '__main__':
@@ -9,12 +9,378 @@
 
 import os
 import sys
+import zlib
+import hashlib
+import struct
+import collections
+import array
 
 from FileWork import *
 from DextractorException import *
 
-DEX_MAGIC_TYPE = c_ubyte * 8
-DEX_SIGNATURE_TYPE = c_ubyte * 20
+USE_NATIVE_DEX_INDEX = False
+
+try:
+    from elfparser_e.python_binding._dex import DexIndex
+    USE_NATIVE_DEX_INDEX = True
+except ImportError:
+    pass
+
+DEX_MAGIC_SIZE = 8
+DEX_SIGNATURE_SIZE = 20
+
+# magic, checksum, signature and the 20 uint32 fields after them
+DEX_HEADER_LAYOUT = struct.Struct('<8sI20s20I')
+
+# offsets checked against the file size (in header order)
+DEX_HEADER_OFFSET_FIELDS = [
+    ('link_off', 'link offset'),
+    ('map_off', 'map offset'),
+    ('string_ids_off', 'string ids offset'),
+    ('type_ids_off', 'type ids offset'),
+    ('proto_ids_off', 'proto ids offset'),
+    ('field_ids_off', 'field ids offset'),
+    ('method_ids_off', 'method ids offset'),
+    ('class_defs_off', 'class defs offset'),
+    ('data_off', 'data offset'),
+]
+
+DEX_CHECKSUM_OFFSET = 8
+DEX_SIGNATURE_OFFSET = 12
+DEX_HASHED_OFFSET = 32
+
+DEX_FILE_MAGIC = b'dex\n'
+DEX_ENDIAN_CONSTANT = 0x12345678
+
+# map_list item types of the ID tables
+TYPE_STRING_ID_ITEM = 0x0001
+TYPE_TYPE_ID_ITEM = 0x0002
+TYPE_PROTO_ID_ITEM = 0x0003
+TYPE_FIELD_ID_ITEM = 0x0004
+TYPE_METHOD_ID_ITEM = 0x0005
+TYPE_CLASS_DEF_ITEM = 0x0006
+
+Dex_StringId = collections.namedtuple('Dex_StringId', ['string_data_off'])
+Dex_TypeId = collections.namedtuple('Dex_TypeId', ['descriptor_idx'])
+Dex_ProtoId = collections.namedtuple('Dex_ProtoId', ['shorty_idx', 'return_type_idx', 'parameters_off'])
+Dex_FieldId = collections.namedtuple('Dex_FieldId', ['class_idx', 'type_idx', 'name_idx'])
+Dex_MethodId = collections.namedtuple('Dex_MethodId', ['class_idx', 'proto_idx', 'name_idx'])
+Dex_ClassDef = collections.namedtuple('Dex_ClassDef', ['class_idx', 'access_flags', 'superclass_idx',
+                                                       'interfaces_off', 'source_file_idx', 'annotations_off',
+                                                       'class_data_off', 'static_values_off'])
+Dex_MapItem = collections.namedtuple('Dex_MapItem', ['type', 'size', 'offset'])
+Dex_ClassData = collections.namedtuple('Dex_ClassData', ['class_methods', 'method_idx', 'access_flags', 'code_off'])
+
+# tables of the index: name, map_list type, entry layout and entry type
+DEX_INDEX_TABLES = [
+    ('string_ids', TYPE_STRING_ID_ITEM, struct.Struct('<I'), Dex_StringId),
+    ('type_ids', TYPE_TYPE_ID_ITEM, struct.Struct('<I'), Dex_TypeId),
+    ('proto_ids', TYPE_PROTO_ID_ITEM, struct.Struct('<3I'), Dex_ProtoId),
+    ('field_ids', TYPE_FIELD_ID_ITEM, struct.Struct('<HHI'), Dex_FieldId),
+    ('method_ids', TYPE_METHOD_ID_ITEM, struct.Struct('<HHI'), Dex_MethodId),
+    ('class_defs', TYPE_CLASS_DEF_ITEM, struct.Struct('<8I'), Dex_ClassDef),
+]
+
+DEX_MAP_ITEM_LAYOUT = struct.Struct('<HxxII')
+
+# superclass_idx, source_file_idx... without value
+DEX_NO_INDEX = 0xFFFFFFFF
+
+# formats of dump_strings
+STRINGS_LINES = "lines"
+STRINGS_BINARY = "binary"
+
+
+def calculate_dex_checksums(dex_bytes, fix_checksum=False):
+    '''
+    Calculate the SHA-1 signature (bytes 32..end) and the Adler-32
+    checksum (bytes 12..end) of a dex, python version of the native
+    dex_checksum_buffer.
+
+    :param dex_bytes: bytearray with the whole dex file.
+    :param fix_checksum: patch signature and checksum in dex_bytes,
+                         the checksum is calculated over the new signature.
+    :return: tuple (checksum, signature)
+    '''
+    dex_view = memoryview(dex_bytes)
+
+    signature = hashlib.sha1(dex_view[DEX_HASHED_OFFSET:]).digest()
+
+    if fix_checksum:
+        dex_bytes[DEX_SIGNATURE_OFFSET:DEX_HASHED_OFFSET] = signature
+
+    checksum = zlib.adler32(dex_view[DEX_SIGNATURE_OFFSET:])
+
+    if fix_checksum:
+        struct.pack_into('<I', dex_bytes, DEX_CHECKSUM_OFFSET, checksum)
+
+    dex_view.release()
+
+    return checksum, signature
+
+
+def read_uleb128(buffer, offset):
+    '''
+    Decode the uleb128 (at most five bytes) at offset of buffer.
+
+    :return: tuple (value, offset after the uleb128)
+    '''
+    result = 0
+
+    for i in range(5):
+        byte = buffer[offset + i]
+        result |= (byte & 0x7f) << (7 * i)
+
+        if byte & 0x80 == 0:
+            return result, offset + i + 1
+
+    raise ValueError("uleb128 at 0x%08X is longer than five bytes" % (offset))
+
+
+def decode_mutf8(data):
+    '''
+    Decode the MUTF-8 bytes of a dex string as the native
+    mutf8_to_utf8: the two byte NUL and surrogate pairs are
+    converted, lone surrogates and incorrect bytes become
+    U+FFFD. ASCII strings are decoded at once.
+    '''
+    if data.isascii():
+        return data.decode('ascii')
+
+    chars = []
+    i = 0
+
+    while i < len(data):
+        c = data[i]
+
+        if c < 0x80:
+            code_point = c
+            i += 1
+        elif c & 0xe0 == 0xc0 and i + 1 < len(data) and data[i + 1] & 0xc0 == 0x80:
+            code_point = ((c & 0x1f) << 6) | (data[i + 1] & 0x3f)
+            i += 2
+        elif _three_bytes(data, i):
+            code_point = _three_bytes(data, i)
+            i += 3
+            low = _three_bytes(data, i)
+
+            # supplementary characters are surrogate pairs of three bytes each
+            if 0xd800 <= code_point <= 0xdbff and 0xdc00 <= low <= 0xdfff:
+                code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00)
+                i += 3
+            elif 0xd800 <= code_point <= 0xdfff:
+                code_point = 0xfffd
+        else:
+            code_point = 0xfffd
+            i += 1
+
+        chars.append(chr(code_point))
+
+    return ''.join(chars)
+
+
+def _three_bytes(data, i):
+    if i + 3 > len(data) or data[i] & 0xf0 != 0xe0 or data[i + 1] & 0xc0 != 0x80 or data[i + 2] & 0xc0 != 0x80:
+        return 0
+
+    return ((data[i] & 0x0f) << 12) | ((data[i + 1] & 0x3f) << 6) | (data[i + 2] & 0x3f)
+
+
+class DEXTableView():
+    '''
+    Lazy sequence over one table of a DEXIndex, the entries
+    are unpacked from the view of the dex when indexed.
+    '''
+
+    def __init__(self, name, view, offset, count, layout, entry_type):
+        self.name = name
+        self.offset = offset
+        self.entry_size = layout.size
+        self.data = view[offset:offset + count * layout.size]
+        self.layout = layout
+        self.entry_type = entry_type
+
+    def __len__(self):
+        return len(self.data) // self.entry_size
+
+    def __getitem__(self, key):
+        if isinstance(key, slice):
+            return [self[i] for i in range(*key.indices(len(self)))]
+
+        if key < 0:
+            key += len(self)
+
+        if key < 0 or key >= len(self):
+            raise IndexError("%s index out of range" % (self.name))
+
+        return self.entry_type._make(self.layout.unpack_from(self.data, key * self.entry_size))
+
+    def __repr__(self):
+        return "<DEXIndex %s view, %d entries>" % (self.name, len(self))
+
+
+class DEXIndex():
+    '''
+    Index of the ID tables and map_list of a dex held in a
+    buffer (a slice of the mapped oat or vdex file), python
+    version of the native _dex.DexIndex: nothing is copied,
+    the tables are views of the buffer. The raw bytes of a
+    table are in its data attribute.
+    '''
+
+    def __init__(self, buffer):
+        view = memoryview(buffer)
+        self.header = DEX_HEADER_LAYOUT.unpack_from(view)
+
+        magic, endian_tag, self.size, map_off = self.header[0], self.header[5], self.header[3], self.header[8]
+
+        if magic[:len(DEX_FILE_MAGIC)] != DEX_FILE_MAGIC:
+            raise IncorrectMagicException("Error, incorrect dex magic %s" % (c_string(magic)))
+
+        if endian_tag != DEX_ENDIAN_CONSTANT:
+            raise IncorrectMagicException("Error, unsupported endian tag 0x%08X" % (endian_tag))
+
+        if self.size < DEX_HEADER_LAYOUT.size or self.size > len(view):
+            raise OffsetOutOfBoundException("Error, dex file size (%d) is out of bound of the buffer" % (self.size))
+
+        self.view = view[:self.size]
+        # (size, offset) pairs of the ID tables in the header
+        header_tables = [self.header[i:i + 2] for i in range(9, 21, 2)]
+
+        for (name, _, layout, entry_type), (count, offset) in zip(DEX_INDEX_TABLES, header_tables):
+            setattr(self, name, self.__table(name, offset, count, layout, entry_type))
+
+        self.map_list = self.__table('map_list', map_off + 4, self.__u32(map_off) if map_off else 0,
+                                     DEX_MAP_ITEM_LAYOUT, Dex_MapItem)
+
+        # the ID tables of map_list must be the ones of the header
+        for item in self.map_list:
+            for (name, item_type, _, _), (count, offset) in zip(DEX_INDEX_TABLES, header_tables):
+                if item.type == item_type and (item.size != count or (count and item.offset != offset)):
+                    raise OffsetOutOfBoundException("Error, map_list item of %s (0x%08X, %d entries) "
+                                                    "does not match the header" % (name, item.offset, item.size))
+
+    def __u32(self, offset):
+        if offset + 4 > self.size:
+            raise OffsetOutOfBoundException("Error, map offset (0x%08X) is out of bound of the dex" % (offset))
+
+        return struct.unpack_from('<I', self.view, offset)[0]
+
+    def __table(self, name, offset, count, layout, entry_type):
+        if count and (offset > self.size or count * layout.size > self.size - offset):
+            raise OffsetOutOfBoundException("Error, %s (0x%08X, %d entries) is out of bound of the dex" %
+                                            (name, offset, count))
+
+        return DEXTableView(name, self.view, offset if count else 0, count, layout, entry_type)
+
+    def string_data(self, string_idx):
+        '''
+        Raw MUTF-8 bytes of a string, without the final NUL.
+        '''
+        try:
+            offset = self.string_ids[string_idx].string_data_off
+            utf16_size, offset = read_uleb128(self.view, offset)
+            # every UTF-16 code unit takes three bytes at most
+            data = bytes(self.view[offset:offset + 3 * utf16_size + 1])
+            return data[:data.index(b'\x00')]
+        except (ValueError, IndexError):
+            raise IndexError("string %d out of range or out of dex bound" % (string_idx))
+
+    def type_descriptor(self, type_idx):
+        return self.string_data(self.type_ids[type_idx].descriptor_idx)
+
+    def string(self, string_idx):
+        return decode_mutf8(self.string_data(string_idx))
+
+    def strings(self):
+        return [self.string(i) for i in range(len(self.string_ids))]
+
+    def dump_strings(self, fd, binary=False):
+        '''
+        Write every string to fd as UTF-8 lines ('\\n' and '\\\\'
+        escaped) or, with binary, prefixed by its uint32 length.
+
+        :return: number of strings written
+        '''
+        chunks = []
+
+        for string in self.strings():
+            if binary:
+                data = string.encode('utf-8')
+                chunks.append(struct.pack('<I', len(data)) + data)
+            else:
+                chunks.append(string.replace('\\', '\\\\').replace('\n', '\\n').encode('utf-8') + b'\n')
+
+        data = memoryview(b''.join(chunks))
+
+        while len(data) > 0:
+            data = data[os.write(fd, data):]
+
+        return len(self.string_ids)
+
+    def class_data(self):
+        '''
+        Methods of every class def in class_data order (direct
+        then virtual methods, as in OAT classes), in uint32
+        arrays: first method of each class (plus the number of
+        methods at the end), method_idx, access_flags and code_off.
+        '''
+        class_data = Dex_ClassData(array.array('I'), array.array('I'), array.array('I'), array.array('I'))
+        method_ids_size = len(self.method_ids)
+
+        try:
+            for i, class_def in enumerate(self.class_defs):
+                class_data.class_methods.append(len(class_data.method_idx))
+
+                if class_def.class_data_off == 0:
+                    continue
+
+                offset = class_def.class_data_off
+                sizes = []
+
+                for _ in range(4):
+                    value, offset = read_uleb128(self.view, offset)
+                    sizes.append(value)
+
+                # static and instance fields, two uleb128 each
+                for _ in range(2 * (sizes[0] + sizes[1])):
+                    _, offset = read_uleb128(self.view, offset)
+
+                # method indexes are differences to the previous method of the list
+                for methods in sizes[2:]:
+                    method_idx = 0
+
+                    for _ in range(methods):
+                        diff, offset = read_uleb128(self.view, offset)
+                        access_flags, offset = read_uleb128(self.view, offset)
+                        code_off, offset = read_uleb128(self.view, offset)
+                        method_idx += diff
+
+                        if method_idx >= method_ids_size:
+                            raise ValueError("method_idx %d of class %d out of method_ids" % (method_idx, i))
+
+                        class_data.method_idx.append(method_idx)
+                        class_data.access_flags.append(access_flags)
+                        class_data.code_off.append(code_off)
+        except IndexError:
+            raise ValueError("class_data of class %d out of dex bound" % (i))
+
+        class_data.class_methods.append(len(class_data.method_idx))
+
+        return class_data
+
+    def close(self):
+        for table in [self.map_list] + [getattr(self, name) for name, _, _, _ in DEX_INDEX_TABLES]:
+            table.data.release()
+
+        self.view.release()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
 
 class DEXHeader():
     '''
@@ -48,47 +414,49 @@ class DEXHeader():
 
     def __init__(self, file_pointer):
         '''
-        Initializer of DEX header parser, we will use
-        ctypes instead of using python types so we will
-        have fixed size types.
+        Initializer of DEX header parser, the header is
+        decoded with one unpack of DEX_HEADER_LAYOUT and
+        the fields are plain ints (magic and signature bytes).
 
-        :param file_pointer: integer specifying pointer offset within opened file.
+        :param file_pointer: opened file (or RecordReader) with the dex.
         '''
         self.file_p = file_pointer
+        self.reader = RecordReader.of(file_pointer)
 
-        self.magic = DEX_MAGIC_TYPE()
-        self.checksum = c_int()
-        self.signature = DEX_SIGNATURE_TYPE()
-        self.file_size = c_uint()
-        self.header_size = c_uint()
-        self.endian_tag = c_uint()
+        self.magic = bytes(DEX_MAGIC_SIZE)
+        self.checksum = 0
+        self.signature = bytes(DEX_SIGNATURE_SIZE)
+        self.file_size = 0
+        self.header_size = 0
+        self.endian_tag = 0
 
-        self.link_size = c_uint()
-        self.link_off = c_uint()
+        self.link_size = 0
+        self.link_off = 0
 
-        self.map_off = c_uint()
+        self.map_off = 0
 
-        self.string_ids_size = c_uint()
-        self.string_ids_off = c_uint()
+        self.string_ids_size = 0
+        self.string_ids_off = 0
 
-        self.type_ids_size = c_uint()
-        self.type_ids_off = c_uint()
+        self.type_ids_size = 0
+        self.type_ids_off = 0
 
-        self.proto_ids_size = c_uint()
-        self.proto_ids_off = c_uint()
+        self.proto_ids_size = 0
+        self.proto_ids_off = 0
 
-        self.field_ids_size = c_uint()
-        self.field_ids_off = c_uint()
+        self.field_ids_size = 0
+        self.field_ids_off = 0
 
-        self.method_ids_size = c_uint()
-        self.method_ids_off = c_uint()
+        self.method_ids_size = 0
+        self.method_ids_off = 0
 
-        self.class_defs_size = c_uint()
-        self.class_defs_off = c_uint()
+        self.class_defs_size = 0
+        self.class_defs_off = 0
 
-        self.data_size = c_uint()
-        self.data_off = c_uint()
+        self.data_size = 0
+        self.data_off = 0
 
+        self.offset = 0
         self.header_initialized = False
 
     def print_header(self, num = None):
@@ -110,37 +478,37 @@ class DEXHeader():
         print("==================================")
 
         sys.stdout.write("\nMagic: ")
-        for i in range(ctypes.sizeof(DEX_MAGIC_TYPE)):
+        for i in range(DEX_MAGIC_SIZE):
             sys.stdout.write("%02X " % self.magic[i])
 
-        sys.stdout.write("(%s)" % ctypes.cast(self.magic, ctypes.c_char_p).value)
+        sys.stdout.write("(%s)" % c_string(self.magic))
 
-        sys.stdout.write("\nChecksum: %d(0x%08X)" % (self.checksum.value, self.checksum.value))
+        sys.stdout.write("\nChecksum: %d(0x%08X)" % (self.checksum, self.checksum))
 
         sys.stdout.write("\nSignature: ")
-        for i in range(ctypes.sizeof(DEX_SIGNATURE_TYPE)):
+        for i in range(DEX_SIGNATURE_SIZE):
             sys.stdout.write("%02X " % self.signature[i])
 
-        sys.stdout.write("\nFile Size: %d" % self.file_size.value)
-        sys.stdout.write("\nHeader Size: %d" % self.header_size.value)
-        sys.stdout.write("\nEndian Tag: %d(0x%08X)" % (self.endian_tag.value, self.endian_tag.value))
-        sys.stdout.write("\nLink Size: %d" % (self.link_size.value))
-        sys.stdout.write("\nLink Offset: 0x%08X" % (self.link_off.value))
-        sys.stdout.write("\nMap Offset: 0x%08X" % (self.map_off.value))
-        sys.stdout.write("\nString IDS Size: %d" % (self.string_ids_size.value))
-        sys.stdout.write("\nString IDS Offset: 0x%08X" % (self.string_ids_off.value))
-        sys.stdout.write("\nType IDS Size: %d" % (self.type_ids_size.value))
-        sys.stdout.write("\nType IDS Offset: 0x%08X" % (self.type_ids_off.value))
-        sys.stdout.write("\nProto IDS Size: %d" % (self.proto_ids_size.value))
-        sys.stdout.write("\nProto IDS Offset: 0x%08X" % (self.proto_ids_off.value))
-        sys.stdout.write("\nField IDS Size: %d" % (self.field_ids_size.value))
-        sys.stdout.write("\nField IDS Offset: 0x%08X" % (self.field_ids_off.value))
-        sys.stdout.write("\nMethod IDS Size: %d" % (self.method_ids_size.value))
-        sys.stdout.write("\nMethod IDS Offset: 0x%08X" % (self.method_ids_off.value))
-        sys.stdout.write("\nClass Defs Size: %d" % (self.class_defs_size.value))
-        sys.stdout.write("\nClass Defs Offset: 0x%08X" % (self.class_defs_off.value))
-        sys.stdout.write("\nData Size: %d" % (self.data_size.value))
-        sys.stdout.write("\nData Offset: 0x%08X\n" % (self.data_off.value))
+        sys.stdout.write("\nFile Size: %d" % self.file_size)
+        sys.stdout.write("\nHeader Size: %d" % self.header_size)
+        sys.stdout.write("\nEndian Tag: %d(0x%08X)" % (self.endian_tag, self.endian_tag))
+        sys.stdout.write("\nLink Size: %d" % (self.link_size))
+        sys.stdout.write("\nLink Offset: 0x%08X" % (self.link_off))
+        sys.stdout.write("\nMap Offset: 0x%08X" % (self.map_off))
+        sys.stdout.write("\nString IDS Size: %d" % (self.string_ids_size))
+        sys.stdout.write("\nString IDS Offset: 0x%08X" % (self.string_ids_off))
+        sys.stdout.write("\nType IDS Size: %d" % (self.type_ids_size))
+        sys.stdout.write("\nType IDS Offset: 0x%08X" % (self.type_ids_off))
+        sys.stdout.write("\nProto IDS Size: %d" % (self.proto_ids_size))
+        sys.stdout.write("\nProto IDS Offset: 0x%08X" % (self.proto_ids_off))
+        sys.stdout.write("\nField IDS Size: %d" % (self.field_ids_size))
+        sys.stdout.write("\nField IDS Offset: 0x%08X" % (self.field_ids_off))
+        sys.stdout.write("\nMethod IDS Size: %d" % (self.method_ids_size))
+        sys.stdout.write("\nMethod IDS Offset: 0x%08X" % (self.method_ids_off))
+        sys.stdout.write("\nClass Defs Size: %d" % (self.class_defs_size))
+        sys.stdout.write("\nClass Defs Offset: 0x%08X" % (self.class_defs_off))
+        sys.stdout.write("\nData Size: %d" % (self.data_size))
+        sys.stdout.write("\nData Offset: 0x%08X\n" % (self.data_off))
 
     def parse_header(self, offset, file_size):
         '''
@@ -151,61 +519,44 @@ class DEXHeader():
         :param offset: offset where to start parsing the DEX header.
         :param file_size: file size used for checking offset bounds.
         '''
-        self.file_p.seek(offset, 0)
-
-        for i in range(ctypes.sizeof(DEX_MAGIC_TYPE)):
-            self.magic[i] = read_file_le(self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
-
-        self.checksum = read_file_le(self.file_p, INTEGER, INTEGER_SIZE, self.file_p.tell())
-
-        for i in range(ctypes.sizeof(DEX_SIGNATURE_TYPE)):
-            self.signature[i] = read_file_le(self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
-
-        self.file_size = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.header_size = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.endian_tag = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.link_size = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.link_off = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.link_off.value > file_size:
-            raise OffsetOutOfBoundException("Error, link offset (0x%08X) is out of bound of the file" % self.link_off.value)
-
-        self.map_off = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.map_off.value > file_size:
-            raise OffsetOutOfBoundException("Error, map offset (0x%08X) is out of bound of the file" % self.map_off.value)
-
-        self.string_ids_size = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.string_ids_off = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.string_ids_off.value > file_size:
-            raise OffsetOutOfBoundException("Error, string ids offset (0x%08X) is out of bound of the file" % self.string_ids_off.value)
-
-        self.type_ids_size = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.type_ids_off = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.type_ids_off.value > file_size:
-            raise OffsetOutOfBoundException("Error, type ids offset (0x%08X) is out of bound of the file" % self.type_ids_off.value)
-
-        self.proto_ids_size = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.proto_ids_off = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.proto_ids_off.value > file_size:
-            raise OffsetOutOfBoundException("Error, proto ids offset (0x%08X) is out of bound of the file" % self.proto_ids_off.value)
-
-        self.field_ids_size = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.field_ids_off = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.field_ids_off.value > file_size:
-            raise OffsetOutOfBoundException("Error, field ids offset (0x%08X) is out of bound of the file" % self.field_ids_off.value)
-
-        self.method_ids_size = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.method_ids_off = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.method_ids_off.value > file_size:
-            raise OffsetOutOfBoundException("Error, method ids offset (0x%08X) is out of bound of the file" % self.method_ids_off.value)
-
-        self.class_defs_size = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.class_defs_off = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.class_defs_off.value > file_size:
-            raise OffsetOutOfBoundException("Error, class defs offset (0x%08X) is out of bound of the file" % self.class_defs_off.value)
-
-        self.data_size = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.data_off = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.data_off.value > file_size:
-            raise OffsetOutOfBoundException("Error, data offset (0x%08X) is out of bound of the file" % self.data_off.value)
-
-        self.header_initialized = True
\ No newline at end of file
+        (self.magic, self.checksum, self.signature, self.file_size, self.header_size, self.endian_tag,
+         self.link_size, self.link_off, self.map_off, self.string_ids_size, self.string_ids_off,
+         self.type_ids_size, self.type_ids_off, self.proto_ids_size, self.proto_ids_off,
+         self.field_ids_size, self.field_ids_off, self.method_ids_size, self.method_ids_off,
+         self.class_defs_size, self.class_defs_off, self.data_size, self.data_off) = \
+            self.reader.unpack(DEX_HEADER_LAYOUT, offset)
+        self.offset = offset
+
+        for field, name in DEX_HEADER_OFFSET_FIELDS:
+            if getattr(self, field) > file_size:
+                raise OffsetOutOfBoundException("Error, %s (0x%08X) is out of bound of the file" %
+                                                (name, getattr(self, field)))
+
+        # the whole dex must be inside of its container, it is mapped
+        # and read up to file_size
+        if offset > file_size or self.file_size > file_size - offset:
+            raise OffsetOutOfBoundException("Error, dex file size (0x%08X) is out of bound of the file" %
+                                            (self.file_size))
+
+        self.header_initialized = True
+
+    def index(self, buffer=None):
+        '''
+        Index of the ID tables and map_list of the dex, built
+        over its bytes in place (native _dex.DexIndex when the
+        elfparser_e module is compiled, DEXIndex otherwise).
+
+        :param buffer: buffer starting with the dex, by default
+                       the view of the parsed file if it is in memory.
+        :return: DexIndex or DEXIndex
+        '''
+        if buffer is None:
+            if self.reader.buffer is None:
+                raise ValueError("Error, the dex is not in memory, give the buffer to index")
+
+            buffer = self.reader.buffer[self.offset:self.offset + self.file_size]
+
+        if USE_NATIVE_DEX_INDEX:
+            return DexIndex(buffer)
+
+        return DEXIndex(buffer)
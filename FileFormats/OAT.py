@@ -9,14 +9,45 @@
 
 import os
 import sys
+import array
+import struct
+import bisect
+import itertools
+import collections
 
 from FileWork import *
 from DextractorException import *
 from FileFormats.DEX import DEXHeader
+from FileFormats.OATHeaderLayout import *
 from utils import *
 
-OAT_MAGIC_TYPE = c_ubyte * 4
-OAT_VERSION_TYPE = c_ubyte * 4
+OAT_MAGIC_SIZE = 4
+OAT_VERSION_SIZE = 4
+
+OAT_MAGIC_VERSION_LAYOUT = struct.Struct('<4s4s')
+
+OAT_CLASS_HEADER_LAYOUT = struct.Struct('<HH')
+OAT_DEX_FILE_CHECKSUM_POINTER_LAYOUT = struct.Struct('<II')
+
+# '0'/'1' characters of a bitmap string to bytes usable as selectors
+BITMAP_SELECTORS = bytes.maketrans(b'01', b'\x00\x01')
+# and back, selectors to a bitmap string
+SELECTORS_BITMAP = bytes.maketrans(b'\x00\x01', b'01')
+
+NO_METHOD_POSITION = 0xFFFFFFFF
+
+CompiledMethod = collections.namedtuple('CompiledMethod', ['class_def_idx', 'method_idx', 'code_offset'])
+
+# flags of the methods of a code footprint
+FOOTPRINT_SHOULD_DEOPTIMIZE = 0x1
+FOOTPRINT_CODE_INFO = 0x2
+FOOTPRINT_OUT_OF_BOUND = 0x4
+
+FOOTPRINT_COLUMNS = ['code_size', 'frame_size', 'core_spill_mask', 'fp_spill_mask', 'metadata_offset', 'flags']
+
+# compiled methods of a dex with their method headers, one array('I') per column
+CodeFootprint = collections.namedtuple('CodeFootprint', ['class_def_idx', 'method_idx', 'code_offset'] +
+                                       FOOTPRINT_COLUMNS + ['out_of_bound'])
 
 
 class OATClassHeader():
@@ -56,43 +87,61 @@ class OATClassHeader():
     STATUS_INITIALIZING = 9  # Class init in progress.
     STATUS_INITIALIZED = 10  # Ready to go.
 
-    def __init__(self, file_pointer):
+    # ClassStatus of the versions since 183, indexed by status
+    STATUS_NAMES_V11 = ['STATUS_NOTREADY', 'STATUS_RETIRED', 'STATUS_ERROR_RESOLVED', 'STATUS_ERROR_UNRESOLVED',
+                        'STATUS_IDX', 'STATUS_LOADED', 'STATUS_RESOLVING', 'STATUS_RESOLVED', 'STATUS_VERIFYING',
+                        'STATUS_RETRY_VERIFICATION_AT_RUNTIME', 'STATUS_VERIFIED_NEEDS_ACCESS_CHECKS',
+                        'STATUS_VERIFIED', 'STATUS_SUPERCLASS_VALIDATED', 'STATUS_INITIALIZING',
+                        'STATUS_INITIALIZED', 'STATUS_VISIBLY_INITIALIZED']
+
+    def __init__(self, file_pointer, layout=None):
         '''
-        Initializer of OAT header parser,  here
-        we will initialize used variables, we will
-        use ctypes instead of python types to have
-        fixed size types.
+        Initializer of OAT class header parser, the
+        fields are plain ints decoded with precompiled
+        struct layouts.
 
-        :param file_pointer: integer specifying pointer offset within opened file.
+        :param file_pointer: opened file (or RecordReader) with the oat.
+        :param layout: OatHeaderLayout of the oat version (class status
+                       range and number of methods field).
         '''
         self.file_p = file_pointer
-
-        self.status = c_ushort()
-        self.type = c_ushort()
-        self.bitmap_size = c_uint()
+        self.reader = RecordReader.of(file_pointer)
+        self.status_max = layout.class_status_max if layout is not None else OATClassHeader.STATUS_INITIALIZED
+        self.has_num_methods = layout is not None and layout.class_num_methods
+
+        self.status = 0
+        self.type = 0
+        self.num_methods = 0
+        self.bitmap_size = 0
         self.bitmap = None
         self.methods_offsets = None
+        self.methods_offsets_offset = 0
 
         self.compiled_methods = 0
 
         self.header_initialized = False
 
     def parse_header(self,  offset, file_size):
-        self.file_p.seek(offset, FILE_BEGIN)
-
-        self.status = read_file_le(
-            self.file_p, USHORT, USHORT_SIZE, self.file_p.tell())
+        self.status, self.type = self.reader.unpack(OAT_CLASS_HEADER_LAYOUT, offset)
 
-        if self.status.value > OATClassHeader.STATUS_INITIALIZED:
+        if self.status > self.status_max:
             raise OATClassHeaderIncorrectStatusException(
-                "OATClassHeader status incorrect (%d)" % (self.status.value))
-
-        self.type = read_file_le(
-            self.file_p, USHORT, USHORT_SIZE, self.file_p.tell())
+                "OATClassHeader status incorrect (%d)" % (self.status))
 
-        if self.type.value > OATClassHeader.kOatClassNoneCompiled:
+        if self.type > OATClassHeader.kOatClassNoneCompiled:
             raise OATClassHeaderIncorrectTypeException(
-                "OATClassHeader type incorrect (%d)" % (self.type.value))
+                "OATClassHeader type incorrect (%d)" % (self.type))
+
+        offset += OAT_CLASS_HEADER_LAYOUT.size
+
+        # since 225 the number of methods of the class is stored
+        # (when there are compiled methods) and gives the bitmap size
+        if self.has_num_methods and self.type != OATClassHeader.kOatClassNoneCompiled:
+            self.num_methods = self.reader.unpack(UINT32_LAYOUT, offset)[0]
+            offset += UINT32_LAYOUT.size
+
+            if self.type == OATClassHeader.kOatClassAllCompiled:
+                self.compiled_methods = self.num_methods
 
         '''
         The bitmap field represents the compiled methods, each bit of
@@ -103,30 +152,57 @@ class OATClassHeader():
         If type is kOatClassNoneCompiled there's no bitmap, as there aren't
         compiled methods.
         '''
-        if self.type.value == OATClassHeader.kOatClassSomeCompiled:
-            self.bitmap_size = read_file_le(
-                self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-            self.bitmap = (c_ubyte * self.bitmap_size.value)()
-            for i in range(self.bitmap_size.value):
-                self.bitmap[i] = read_file_le(
-                    self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
+        if self.type == OATClassHeader.kOatClassSomeCompiled:
+            if self.has_num_methods:
+                # bitmap of whole uint32 words
+                self.bitmap_size = ((self.num_methods + 31) // 32) * 4
+            else:
+                self.bitmap_size = self.reader.unpack(UINT32_LAYOUT, offset)[0]
+                offset += UINT32_LAYOUT.size
+
+            self.bitmap = self.reader.read_bytes(offset, self.bitmap_size)
+            offset += self.bitmap_size
 
-                # check each byte for compiled methods
-                for shifter in range(8):
-                    if (1 << shifter) & self.bitmap[i]:
-                        self.compiled_methods += 1
+            # each set bit is a compiled method
+            self.compiled_methods = bin(int.from_bytes(self.bitmap, 'little')).count('1')
 
-        self.methods_offsets = (c_uint * self.compiled_methods)()
+        self.methods_offsets_offset = offset
+        self.methods_offsets = self.reader.unpack_array(UINTEGER, offset, self.compiled_methods)
 
         for i in range(self.compiled_methods):
-            self.methods_offsets[i] = read_file_le(
-                self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
             if self.methods_offsets[i] > file_size:
                 raise OffsetOutOfBoundException(
                     "Error, methods_offset[%d] (0x%08X) is out of bound of the file" % (i, self.methods_offsets[i]))
 
         self.header_initialized = True
 
+    def compiled_method_selectors(self, num_methods):
+        '''
+        Selectors (one byte, 0 or 1, per method in class_data
+        order) of the compiled methods of the class, from the
+        bitmap for kOatClassSomeCompiled.
+        '''
+        if self.type == OATClassHeader.kOatClassAllCompiled:
+            return b'\x01' * num_methods
+
+        if self.type != OATClassHeader.kOatClassSomeCompiled:
+            return b''
+
+        # least significant bit first
+        bits = format(int.from_bytes(self.bitmap, 'little'), 'b')[::-1]
+        return bits.encode().translate(BITMAP_SELECTORS)[:num_methods]
+
+    def all_methods_offsets(self, num_methods):
+        '''
+        Methods offsets of the class given its number of methods,
+        which kOatClassAllCompiled headers before 225 do not store.
+        '''
+        if self.type == OATClassHeader.kOatClassAllCompiled and len(self.methods_offsets) < num_methods:
+            self.methods_offsets = self.reader.unpack_array(UINTEGER, self.methods_offsets_offset, num_methods)
+            self.compiled_methods = num_methods
+
+        return self.methods_offsets
+
     def print_header(self):
 
         if not self.header_initialized:
@@ -137,56 +213,62 @@ class OATClassHeader():
         print("\t==================================")
 
         sys.stdout.write("\tStatus: %d (0x%08X)" %
-                         (self.status.value, self.status.value))
+                         (self.status, self.status))
 
-        if self.status.value == OATClassHeader.STATUS_RETIRED:
+        if self.status_max != OATClassHeader.STATUS_INITIALIZED:
+            if self.status < len(OATClassHeader.STATUS_NAMES_V11):
+                sys.stdout.write("(%s)" % OATClassHeader.STATUS_NAMES_V11[self.status])
+        elif self.status == OATClassHeader.STATUS_RETIRED:
             sys.stdout.write("(STATUS_RETIRED)")
-        elif self.status.value == OATClassHeader.STATUS_ERROR:
+        elif self.status == OATClassHeader.STATUS_ERROR:
             sys.stdout.write("(STATUS_ERROR)")
-        elif self.status.value == OATClassHeader.STATUS_NOTREADY:
+        elif self.status == OATClassHeader.STATUS_NOTREADY:
             sys.stdout.write("(STATUS_NOTREADY)")
-        elif self.status.value == OATClassHeader.STATUS_IDX:
+        elif self.status == OATClassHeader.STATUS_IDX:
             sys.stdout.write("(STATUS_IDX)")
-        elif self.status.value == OATClassHeader.STATUS_LOADED:
+        elif self.status == OATClassHeader.STATUS_LOADED:
             sys.stdout.write("(STATUS_LOADED)")
-        elif self.status.value == OATClassHeader.STATUS_RESOLVING:
+        elif self.status == OATClassHeader.STATUS_RESOLVING:
             sys.stdout.write("(STATUS_RESOLVING)")
-        elif self.status.value == OATClassHeader.STATUS_RESOLVED:
+        elif self.status == OATClassHeader.STATUS_RESOLVED:
             sys.stdout.write("(STATUS_RESOLVED)")
-        elif self.status.value == OATClassHeader.STATUS_VERIFYING:
+        elif self.status == OATClassHeader.STATUS_VERIFYING:
             sys.stdout.write("(STATUS_VERIFYING)")
-        elif self.status.value == OATClassHeader.STATUS_RETRY_VERIFICATION_AT_RUNTIME:
+        elif self.status == OATClassHeader.STATUS_RETRY_VERIFICATION_AT_RUNTIME:
             sys.stdout.write("(STATUS_RETRY_VERIFICATION_AT_RUNTIME)")
-        elif self.status.value == OATClassHeader.STATUS_VERIFYING_AT_RUNTIME:
+        elif self.status == OATClassHeader.STATUS_VERIFYING_AT_RUNTIME:
             sys.stdout.write("(STATUS_VERIFYING_AT_RUNTIME)")
-        elif self.status.value == OATClassHeader.STATUS_VERIFIED:
+        elif self.status == OATClassHeader.STATUS_VERIFIED:
             sys.stdout.write("(STATUS_VERIFIED)")
-        elif self.status.value == OATClassHeader.STATUS_INITIALIZING:
+        elif self.status == OATClassHeader.STATUS_INITIALIZING:
             sys.stdout.write("(STATUS_INITIALIZING)")
-        elif self.status.value == OATClassHeader.STATUS_INITIALIZED:
+        elif self.status == OATClassHeader.STATUS_INITIALIZED:
             sys.stdout.write("(STATUS_INITIALIZED)")
 
         sys.stdout.write('\n')
-        sys.stdout.write("\tType: %d" % (self.type.value))
+        sys.stdout.write("\tType: %d" % (self.type))
 
-        if self.type.value == OATClassHeader.kOatClassSomeCompiled:
+        if self.type == OATClassHeader.kOatClassSomeCompiled:
             sys.stdout.write("(kOatClassSomeCompiled)")
 
-            print("\n\tBitmap size: %d" % self.bitmap_size.value)
+            print("\n\tBitmap size: %d" % self.bitmap_size)
 
             sys.stdout.write("\tBitmap (in bits): ")
-            for i in range(self.bitmap_size.value):
+            for i in range(self.bitmap_size):
                 sys.stdout.write(
-                    '%s' % (bin(self.bitmap[self.bitmap_size.value - 1 - i])[2:].zfill(8)))
+                    '%s' % (bin(self.bitmap[self.bitmap_size - 1 - i])[2:].zfill(8)))
 
-        elif self.type.value == OATClassHeader.kOatClassAllCompiled:
+        elif self.type == OATClassHeader.kOatClassAllCompiled:
             sys.stdout.write("(kOatClassAllCompiled)")
 
-        elif self.type.value == OATClassHeader.kOatClassNoneCompiled:
+        elif self.type == OATClassHeader.kOatClassNoneCompiled:
             sys.stdout.write("(kOatClassNoneCompiled)")
 
         sys.stdout.write("\n")
 
+        if self.has_num_methods:
+            sys.stdout.write("\tNumber of methods: %d\n" % (self.num_methods))
+
         sys.stdout.write("\tMethods offsets: ")
         for i in range(self.compiled_methods):
             sys.stdout.write("0x%08X " % self.methods_offsets[i])
@@ -194,6 +276,326 @@ class OATClassHeader():
         sys.stdout.write('\n')
 
 
+def join_compiled_methods(oat_dex_file, class_data):
+    '''
+    Match the compiled methods of the OAT classes of a dex with
+    the methods of its class_data (decoded by DEXIndex.class_data
+    or _dex.DexIndex.class_data), a class at a time: the bitmap
+    selects the compiled methods from the method_idx array with
+    itertools.compress, and they are zipped with methods_offsets.
+
+    :param oat_dex_file: parsed OATDexFileHeader of the dex.
+    :param class_data: Dex_ClassData of the dex.
+    :return: list of CompiledMethod (class_def_idx, method_idx, code_offset)
+    '''
+    compiled = []
+    class_methods = class_data.class_methods
+    method_idx = class_data.method_idx
+
+    for class_def_idx in range(min(len(oat_dex_file.classes_offsets), len(class_methods) - 1)):
+        oat_class = oat_dex_file.OATClassHeader.get(oat_dex_file.classes_offsets[class_def_idx])
+
+        if oat_class is None:
+            continue
+
+        start, end = class_methods[class_def_idx], class_methods[class_def_idx + 1]
+        selected = itertools.compress(method_idx[start:end], oat_class.compiled_method_selectors(end - start))
+        methods_offsets = oat_class.all_methods_offsets(end - start)
+
+        compiled.extend(map(CompiledMethod._make, zip(itertools.repeat(class_def_idx), selected, methods_offsets)))
+
+    return compiled
+
+
+def read_code_info_header(buffer, offset, end):
+    '''
+    Header of a CodeInfo (since 195): a 4 bit varint per field
+    and then the bytes of the fields bigger than the varint max.
+
+    :return: list of CODE_INFO_HEADER_FIELDS values or None if
+             it is out of bound
+    '''
+    available = (end - offset) * 8
+    position = len(CODE_INFO_HEADER_FIELDS) * CODE_INFO_VARINT_BITS
+
+    if position > available:
+        return None
+
+    # the header takes 32 bytes at most, least significant bit first
+    bits = int.from_bytes(buffer[offset:min(end, offset + 32)], 'little')
+    header = [(bits >> (i * CODE_INFO_VARINT_BITS)) & ((1 << CODE_INFO_VARINT_BITS) - 1)
+              for i in range(len(CODE_INFO_HEADER_FIELDS))]
+
+    for i in range(len(header)):
+        if header[i] > CODE_INFO_VARINT_MAX:
+            size = (header[i] - CODE_INFO_VARINT_MAX) * 8
+
+            if position + size > available:
+                return None
+
+            header[i] = (bits >> position) & ((1 << size) - 1)
+            position += size
+
+    return header
+
+
+def read_method_headers(buffer, oatdata_offset, size, layout, code_offsets):
+    '''
+    Read the OatQuickMethodHeader before the code of each code
+    offset, as oat_method_headers of elfparser_e.
+
+    :param buffer: buffer with the whole oat file.
+    :param size: bytes from oatdata to the end of the file.
+    :param layout: OatMethodHeaderLayout of the oat version.
+    :return: tuple (columns, number of methods out of bound), the
+             columns are arrays('I') in FOOTPRINT_COLUMNS order
+    '''
+    columns = [array.array('I', [0]) * len(code_offsets) for _ in FOOTPRINT_COLUMNS]
+    code_size, frame_size, core_spill_mask, fp_spill_mask, metadata_offset, flags = columns
+    end = oatdata_offset + size
+    out_of_bound = 0
+
+    for i, code_offset in enumerate(code_offsets):
+        # Thumb2 code offsets have the lowest bit set
+        offset = code_offset & ~1
+
+        if offset < layout.size or offset > size:
+            flags[i] = FOOTPRINT_OUT_OF_BOUND
+            out_of_bound += 1
+            continue
+
+        fields = layout.layout.unpack_from(buffer, oatdata_offset + offset - layout.size)
+        data = fields[layout.code_size_field]
+
+        if data & METHOD_HEADER_SHOULD_DEOPTIMIZE:
+            flags[i] |= FOOTPRINT_SHOULD_DEOPTIMIZE
+
+        if layout.code_info and data & METHOD_HEADER_IS_CODE_INFO:
+            metadata_offset[i] = data & METHOD_HEADER_DATA_MASK
+            code_info = None
+
+            if metadata_offset[i] <= offset:
+                code_info = read_code_info_header(buffer, oatdata_offset + offset - metadata_offset[i], end)
+
+            if code_info is None:
+                flags[i] |= FOOTPRINT_OUT_OF_BOUND
+                out_of_bound += 1
+                continue
+
+            code_size[i] = code_info[CODE_INFO_HEADER_FIELDS.index('code_size')]
+            # uint32 as in the native reader
+            frame_size[i] = (code_info[CODE_INFO_HEADER_FIELDS.index('packed_frame_size')] *
+                             CODE_INFO_STACK_ALIGNMENT) & 0xFFFFFFFF
+            core_spill_mask[i] = code_info[CODE_INFO_HEADER_FIELDS.index('core_spill_mask')]
+            fp_spill_mask[i] = code_info[CODE_INFO_HEADER_FIELDS.index('fp_spill_mask')]
+            flags[i] |= FOOTPRINT_CODE_INFO
+        else:
+            code_size[i] = data & (METHOD_HEADER_DATA_MASK if layout.code_info else METHOD_HEADER_CODE_SIZE_MASK)
+
+            if not layout.code_info and layout.metadata_field >= 0:
+                metadata_offset[i] = fields[layout.metadata_field]
+
+            if layout.frame_size_field >= 0:
+                frame_size[i], core_spill_mask[i], fp_spill_mask[i] = \
+                    fields[layout.frame_size_field:layout.frame_size_field + 3]
+
+        if code_size[i] > size - offset:
+            flags[i] |= FOOTPRINT_OUT_OF_BOUND
+            out_of_bound += 1
+
+    return columns, out_of_bound
+
+
+def footprint_by_class(footprint, number_of_classes):
+    '''
+    :return: tuple of arrays indexed by class_def_idx, compiled
+             methods and bytes of compiled code of each class
+    '''
+    methods = array.array('I', [0]) * number_of_classes
+    code_bytes = array.array('Q', [0]) * number_of_classes
+
+    for class_def_idx, code_size in zip(footprint.class_def_idx, footprint.code_size):
+        methods[class_def_idx] += 1
+        code_bytes[class_def_idx] += code_size
+
+    return methods, code_bytes
+
+
+def unique_code_size(footprint):
+    '''
+    Bytes of compiled code of a footprint counting once the code
+    shared by several methods (deduplicated by the compiler).
+    '''
+    return sum(dict(zip([code_offset & ~1 for code_offset in footprint.code_offset], footprint.code_size)).values())
+
+
+class CompiledMethodsBitVector():
+    '''
+    Compiled methods of a dex as one bit vector over the methods of
+    its class_data (in class_data order, so a class is a range of
+    bits) with the methods offsets of every class in the same order.
+    The bit of a method gives if it is compiled and its rank (set bits
+    before it) the index of its code offset. Ranks are O(1) with the
+    number of set bits before each 64 bit word, select is a binary
+    search on them.
+    '''
+
+    def __init__(self, oat_dex_file, class_data):
+        class_methods = class_data.class_methods
+        selectors = []
+        self.methods_offsets = array.array('I')
+
+        for class_def_idx in range(len(class_methods) - 1):
+            start, end = class_methods[class_def_idx], class_methods[class_def_idx + 1]
+            oat_class = None
+
+            if class_def_idx < len(oat_dex_file.classes_offsets):
+                oat_class = oat_dex_file.OATClassHeader.get(oat_dex_file.classes_offsets[class_def_idx])
+
+            if oat_class is None:
+                selectors.append(b'\x00' * (end - start))
+                continue
+
+            class_selectors = oat_class.compiled_method_selectors(end - start).ljust(end - start, b'\x00')
+            methods_offsets = oat_class.all_methods_offsets(end - start)
+            compiled = class_selectors.count(1)
+
+            # as the zip of join_compiled_methods, selected methods without offset are not compiled
+            if compiled > len(methods_offsets):
+                class_selectors = bytearray(class_selectors)
+                for i in [i for i, selector in enumerate(class_selectors) if selector][len(methods_offsets):]:
+                    class_selectors[i] = 0
+                class_selectors = bytes(class_selectors)
+                compiled = len(methods_offsets)
+
+            selectors.append(class_selectors)
+            self.methods_offsets.extend(methods_offsets[:compiled])
+
+        selectors = b''.join(selectors)
+        self.size = len(selectors)
+
+        # least significant bit first, as the OAT bitmaps
+        bits = int(selectors[::-1].translate(SELECTORS_BITMAP) or b'0', 2)
+        self.words = array.array('Q', bits.to_bytes(((self.size + 63) // 64) * 8, 'little'))
+        self.ranks = array.array('I', [0]) * len(self.words)
+
+        rank = 0
+        for i, word in enumerate(self.words):
+            self.ranks[i] = rank
+            rank += word.bit_count()
+
+    def __len__(self):
+        return len(self.methods_offsets)
+
+    def compiled(self, position):
+        return (self.words[position >> 6] >> (position & 63)) & 1 == 1
+
+    def rank(self, position):
+        '''
+        :return: compiled methods before position
+        '''
+        return self.ranks[position >> 6] + (self.words[position >> 6] & ((1 << (position & 63)) - 1)).bit_count()
+
+    def select(self, rank):
+        '''
+        :return: position of the compiled method with the given rank
+        '''
+        if rank >= len(self.methods_offsets):
+            raise IndexError("compiled method %d out of range" % (rank))
+
+        i = bisect.bisect_right(self.ranks, rank) - 1
+        word = self.words[i]
+
+        for _ in range(rank - self.ranks[i]):
+            word &= word - 1
+
+        return i * 64 + (word & -word).bit_length() - 1
+
+    def code_offset(self, position):
+        '''
+        :return: code offset of the method at position or None
+                 if it is not compiled
+        '''
+        if position >= self.size or not self.compiled(position):
+            return None
+
+        return self.methods_offsets[self.rank(position)]
+
+
+class CompiledCodeIndex():
+    '''
+    Lookup of the compiled code of the methods of an OAT file: a
+    hash index of the class descriptors of all its dex files to
+    (dex_number, class_def_idx) and, for each dex, the position of
+    every method_idx in class_data and a CompiledMethodsBitVector.
+    A (class, method_idx) query is a few array reads.
+    '''
+
+    def __init__(self):
+        self.classes = {}
+        self.dex_files = {}
+
+    def add_dex(self, dex_number, oat_dex_file, class_data, class_descriptors, number_of_method_ids):
+        for class_def_idx, descriptor in enumerate(class_descriptors):
+            # as a class loader, the first dex with the class wins
+            self.classes.setdefault(descriptor, (dex_number, class_def_idx))
+
+        positions = array.array('I', [NO_METHOD_POSITION]) * number_of_method_ids
+        for position, method_idx in enumerate(class_data.method_idx):
+            positions[method_idx] = position
+
+        self.dex_files[dex_number] = (class_data, positions, CompiledMethodsBitVector(oat_dex_file, class_data))
+
+    def find_class(self, descriptor):
+        '''
+        :return: tuple (dex_number, class_def_idx) or None
+        '''
+        return self.classes.get(descriptor)
+
+    def code_offset(self, descriptor, method_idx):
+        '''
+        :return: code offset of a method of a class or None if the
+                 class does not define it or it is not compiled
+        '''
+        location = self.classes.get(descriptor)
+
+        if location is None:
+            return None
+
+        class_data, positions, compiled = self.dex_files[location[0]]
+
+        if method_idx >= len(positions):
+            return None
+
+        position = positions[method_idx]
+
+        # the method must be defined by this class
+        if position == NO_METHOD_POSITION or not \
+                class_data.class_methods[location[1]] <= position < class_data.class_methods[location[1] + 1]:
+            return None
+
+        return compiled.code_offset(position)
+
+    def code_offsets(self, queries):
+        '''
+        :param queries: iterable of (descriptor, method_idx)
+        :return: list of code offsets (None if not compiled)
+        '''
+        code_offset = self.code_offset
+        return [code_offset(descriptor, method_idx) for descriptor, method_idx in queries]
+
+    def compiled_method(self, dex_number, rank):
+        '''
+        :return: CompiledMethod of the compiled method with the given
+                 rank (index in the methods offsets of the dex)
+        '''
+        class_data, _, compiled = self.dex_files[dex_number]
+        position = compiled.select(rank)
+        class_def_idx = bisect.bisect_right(class_data.class_methods, position) - 1
+
+        return CompiledMethod(class_def_idx, class_data.method_idx[position], compiled.methods_offsets[rank])
+
+
 class OATDexFileHeader():
     '''
     Parser for OAT Dex File Header, this will contain a header
@@ -210,23 +612,47 @@ class OATDexFileHeader():
     This class can be an array if more than one Dex is inside of the
     oat file, but the array is not sequencial as the next structure
     is stored inside of the second classes_offsets.
+
+    Since 183 dex_file_pointer is followed by offsets from oatdata
+    (OatHeaderLayout.dex_file_fields), the class offsets are read
+    from class_offsets_offset and the next record is right after.
+
+    OATDexFileHeader (183+) {
+        ...
+        uint32 dex_file_pointer,
+        uint32 class_offsets_offset,
+        uint32 lookup_table_offset,
+        uint32 method_bss_mapping_offset,
+        uint32 type_bss_mapping_offset,
+        uint32 public_type_bss_mapping_offset,     # from 225
+        uint32 package_type_bss_mapping_offset,    # from 225
+        uint32 string_bss_mapping_offset,
+        uint32 dex_layout_sections_offset
+    }
     '''
 
     def __init__(self, file_pointer):
         self.file_p = file_pointer
-        self.oat_dex_file_header_offset = file_pointer.tell()
-        self.dex_file_location_size = c_uint()
+        self.reader = RecordReader.of(file_pointer)
+        self.oat_dex_file_header_offset = 0
+        self.dex_file_location_size = 0
         self.dex_file_location_data = None
-        self.dex_file_location_checksum = c_uint()
-        self.dex_file_pointer = c_uint()
+        self.dex_file_location_checksum = 0
+        self.dex_file_pointer = 0
         self.classes_offsets = None
 
+        # OatDexFile fields after dex_file_pointer (183+)
+        self.dex_file_fields = ()
+
         self.OATClassHeader = {}
 
         self.header_initialized = False
 
         self.dex_file = None
 
+        # offset of the next OatDexFile record (records are consecutive)
+        self.next_header_offset = 0
+
     def print_header(self):
         if not self.header_initialized:
             return
@@ -236,22 +662,29 @@ class OATDexFileHeader():
         print("==================================")
 
         sys.stdout.write("\nDex File Location Size: %d" %
-                         self.dex_file_location_size.value)
+                         self.dex_file_location_size)
         sys.stdout.write("\nDex File Location Data: ")
 
         dex_file_location_data_str = ""
 
-        for i in range(self.dex_file_location_size.value):
+        for i in range(self.dex_file_location_size):
             sys.stdout.write("%02X " % self.dex_file_location_data[i])
             dex_file_location_data_str += chr(self.dex_file_location_data[i])
 
         sys.stdout.write("(%s)" % dex_file_location_data_str)
         sys.stdout.write("\nDex File Location Checksum: %d(0x%08X)" % (
-            self.dex_file_location_checksum.value, self.dex_file_location_checksum.value))
+            self.dex_file_location_checksum, self.dex_file_location_checksum))
         sys.stdout.write("\nDex File Pointer: 0x%08X" %
-                         (self.dex_file_pointer.value))
+                         (self.dex_file_pointer))
+
+        for name in self.dex_file_fields:
+            sys.stdout.write("\n%s: 0x%08X" % (name.replace('_', ' ').capitalize(), getattr(self, name)))
+
+        if self.dex_file is None:
+            sys.stdout.write("\nDex file not stored in the vdex\n")
+            return
 
-        for i in range(self.dex_file.class_defs_size.value):
+        for i in range(self.dex_file.class_defs_size):
             sys.stdout.write("\nClass Number: %d\tClass offset: 0x%08X\n" % (
                 i, self.classes_offsets[i]))
 
@@ -262,62 +695,72 @@ class OATDexFileHeader():
 
         self.dex_file.print_header()
 
-    def parse_header(self, offset, file_size, oatdata_offset, oat_header_version):
-        self.file_p.seek(offset, FILE_BEGIN)
+    def parse_header(self, offset, file_size, oatdata_offset, oat_header_version, vdex_file=None, vdex_file_size=0):
+        '''
+        Parse the OAT Dex File Header, since version 124 the dex files
+        are stored in the vdex and dex_file_pointer is an offset from
+        its beginning, in that case vdex_file must be given.
+        '''
+        layout = OAT_HEADER_LAYOUT_BY_VERSION[oat_header_version]
+        self.oat_dex_file_header_offset = offset
 
-        self.dex_file_location_size = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
+        self.dex_file_location_size = self.reader.unpack(UINT32_LAYOUT, offset)[0]
+        offset += UINT32_LAYOUT.size
 
-        # create the data
-        self.dex_file_location_data = (
-            c_ubyte * self.dex_file_location_size.value)()
+        self.dex_file_location_data = self.reader.read_bytes(offset, self.dex_file_location_size)
+        offset += self.dex_file_location_size
 
-        # read it
-        for i in range(self.dex_file_location_size.value):
-            self.dex_file_location_data[i] = read_file_le(
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
+        self.dex_file_location_checksum, self.dex_file_pointer = \
+            self.reader.unpack(OAT_DEX_FILE_CHECKSUM_POINTER_LAYOUT, offset)
+        offset += OAT_DEX_FILE_CHECKSUM_POINTER_LAYOUT.size
 
-        self.dex_file_location_checksum = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
+        if vdex_file is not None:
+            if self.dex_file_pointer > vdex_file_size:
+                raise OffsetOutOfBoundException(
+                    "Error, dex file pointer (0x%08X) is out of bound of the vdex file" % self.dex_file_pointer)
+        elif self.dex_file_pointer > file_size or (oatdata_offset + self.dex_file_pointer) > file_size:
+            raise OffsetOutOfBoundException(
+                "Error, dex file pointer (0x%08X) is out of bound of the file" % self.dex_file_pointer)
 
-        self.dex_file_pointer = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
+        if layout.dex_file_layout is not None:
+            self.dex_file_fields = layout.dex_file_fields
+            self.__dict__.update(zip(self.dex_file_fields, self.reader.unpack(layout.dex_file_layout, offset)))
+            classes_offsets_offset = oatdata_offset + self.class_offsets_offset
+        else:
+            classes_offsets_offset = offset
 
-        if self.dex_file_pointer.value > file_size or (oatdata_offset + self.dex_file_pointer.value) > file_size:
-            raise OffsetOutOfBoundException(
-                "Error, dex file pointer (0x%08X) is out of bound of the file" % self.dex_file_pointer.value)
+        self.next_header_offset = offset + layout.dex_file_fields_size
 
-        auxiliar_offset = self.file_p.tell()
+        if vdex_file is not None and self.dex_file_pointer == 0:
+            # dex file is not in the vdex (stored in the APK)
+            self.header_initialized = True
+            return
 
         ############################################################
         # now point to dex header
-        self.file_p.seek(oatdata_offset +
-                        self.dex_file_pointer.value, FILE_BEGIN)
-        self.dex_file = DEXHeader(self.file_p)
-
-        self.dex_file.parse_header(self.file_p.tell(), file_size)
+        if vdex_file is not None:
+            self.dex_file = DEXHeader(vdex_file)
+            self.dex_file.parse_header(self.dex_file_pointer, vdex_file_size)
+        else:
+            self.dex_file = DEXHeader(self.reader)
+            self.dex_file.parse_header(oatdata_offset + self.dex_file_pointer, file_size)
         ############################################################
 
-        # again move to auxiliar offset
-        self.file_p.seek(auxiliar_offset, FILE_BEGIN)
-
         # Now as we have the class_defs_size
-        self.classes_offsets = (c_uint * self.dex_file.class_defs_size.value)()
-
-        next_header = self.file_p.tell() + 8
+        if classes_offsets_offset + self.dex_file.class_defs_size * UINTEGER_SIZE > file_size:
+            raise OffsetOutOfBoundException(
+                "Error, class offsets (0x%08X) are out of bound of the file" % classes_offsets_offset)
 
-        for i in range(self.dex_file.class_defs_size.value):
-            self.classes_offsets[i] = read_file_le(
-                self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
+        self.classes_offsets = self.reader.unpack_array(UINTEGER, classes_offsets_offset, self.dex_file.class_defs_size)
 
+        for i in range(self.dex_file.class_defs_size):
             if self.classes_offsets[i] > file_size or (oatdata_offset + self.classes_offsets[i]) > file_size:
                 continue
 
             # from dextra
             # if ( getOATVer() != '970' && getOATVer() != '570' && getOATVer() != '880' && getOATVer() != '411' )
             if oat_header_version != b"079" and oat_header_version != b"075" and oat_header_version != b"088" and oat_header_version != b"114":
-                oatclassheader = OATClassHeader(self.file_p)
-                auxiliar_offset = self.file_p.tell()
+                oatclassheader = OATClassHeader(self.reader, layout)
                 try:
                     oatclassheader.parse_header(
                         (oatdata_offset + self.classes_offsets[i]), file_size)
@@ -331,10 +774,6 @@ class OATDexFileHeader():
                     Printer.verbose2(
                         "Exception in type parsing OatClassHeader (%s)" % (str(type_exception)))
 
-                # always set previous offset
-                self.file_p.seek(auxiliar_offset, FILE_BEGIN)
-
-        self.file_p.seek(next_header, FILE_BEGIN)
         self.header_initialized = True
 
 
@@ -352,10 +791,12 @@ class OATHeader():
         uint32 instruction_set_features,
         uint32 dex_file_count,
         uint32 oat_dex_files_offset, # starting from OAT 131
+        uint32 bcp_bss_info_offset, # starting from OAT 225
         uint32 executable_offset,
         uint32 interpreter_to_interpreter_bridge_offset,
         uint32 interpreter_to_compiled_code_bridge_offset,
         uint32 jni_dlsym_lookup_offset_,
+        uint32 jni_dlsym_lookup_critical_trampoline_offset, # starting from OAT 183
         uint32 portable_imt_conflict_trampoline_offset,
         uint32 portable_resolution_trampoline_offset,
         uint32 portable_to_interpreter_bridge_offset,
@@ -363,12 +804,16 @@ class OATHeader():
         uint32 quick_imt_conflict_trampoline_offset,
         uint32 quick_resolution_trampoline_offset,
         uint32 quick_to_interpreter_bridge_offset,
+        uint32 nterp_trampoline_offset, # starting from OAT 195
         int32 image_patch_delta,
         uint32 image_file_location_oat_checksum,
         uint32 image_file_location_oat_data_begin,
         uint32 key_value_store_size,
         ubyte[key_value_store_size] key_value_store
     }
+
+    The fields of each version are described in
+    FileFormats/OATHeaderLayout.py.
     '''
 
     # CONSTANTS
@@ -383,41 +828,44 @@ class OATHeader():
 
     MAGIC_VALUE = b'oat\n'
 
-    VERSION_1 = [b'039', b'045']
-    VERSION_2 = [b'062', b'063', b'064', b'075', b'077']
-    VERSION_3 = [b'079', b'088', b'114', b'124']
-    VERSION_4 = [b'131']
-    VERSION_5 = [b'170']
+    # versions where the dex files are stored in the vdex
+    VDEX_VERSIONS = OAT_VDEX_VERSIONS
 
     def __init__(self, file_pointer):
         self.file_p = file_pointer
+        self.reader = RecordReader.of(file_pointer)
         self.oatdata_offset = self.file_p.tell()
         self.header_initialized = False
 
-        self.magic = OAT_MAGIC_TYPE()
-        self.version = OAT_VERSION_TYPE()
-        self.adler32_checksum = c_uint()
-        self.instruction_set = c_uint()
-        self.instruction_set_features = c_uint()
-        self.dex_file_count = c_uint()
-        self.oat_dex_files_offset = c_uint()
-        self.executable_offset = c_uint()
-        self.interpreter_to_interpreter_bridge_offset = c_uint()
-        self.interpreter_to_compiled_code_bridge_offset = c_uint()
-        self.jni_dlsym_lookup_offset_ = c_uint()
-        self.portable_imt_conflict_trampoline_offset = c_uint()
-        self.portable_resolution_trampoline_offset = c_uint()
-        self.portable_to_interpreter_bridge_offset = c_uint()
-        self.quick_generic_jni_trampoline_offset = c_uint()
-        self.quick_imt_conflict_trampoline_offset = c_uint()
-        self.quick_resolution_trampoline_offset = c_uint()
-        self.quick_to_interpreter_bridge_offset = c_uint()
-        self.image_patch_delta = c_int()
-        self.image_file_location_oat_checksum = c_uint()
-        self.image_file_location_oat_data_begin = c_uint()
-        self.key_value_store_size = c_uint()
+        self.magic = bytes(OAT_MAGIC_SIZE)
+        self.version = bytes(OAT_VERSION_SIZE)
+        self.adler32_checksum = 0
+        self.instruction_set = 0
+        self.instruction_set_features = 0
+        self.dex_file_count = 0
+        self.oat_dex_files_offset = 0
+        self.executable_offset = 0
+        self.interpreter_to_interpreter_bridge_offset = 0
+        self.interpreter_to_compiled_code_bridge_offset = 0
+        self.jni_dlsym_lookup_offset_ = 0
+        self.portable_imt_conflict_trampoline_offset = 0
+        self.portable_resolution_trampoline_offset = 0
+        self.portable_to_interpreter_bridge_offset = 0
+        self.quick_generic_jni_trampoline_offset = 0
+        self.quick_imt_conflict_trampoline_offset = 0
+        self.quick_resolution_trampoline_offset = 0
+        self.quick_to_interpreter_bridge_offset = 0
+        self.jni_dlsym_lookup_critical_trampoline_offset = 0
+        self.nterp_trampoline_offset = 0
+        self.bcp_bss_info_offset = 0
+        self.image_patch_delta = 0
+        self.image_file_location_oat_checksum = 0
+        self.image_file_location_oat_data_begin = 0
+        self.key_value_store_size = 0
         self.key_value_store = None  # Necessary to initialize with key_value_store_size
 
+        self.layout = None
+
         self.OATDexFileHeaders = []
 
     def print_header(self):
@@ -430,64 +878,67 @@ class OATHeader():
         print("==================================")
 
         sys.stdout.write("\nMagic: ")
-        for i in range(ctypes.sizeof(OAT_MAGIC_TYPE)):
+        for i in range(OAT_MAGIC_SIZE):
             sys.stdout.write("%02X " % self.magic[i])
 
-        sys.stdout.write("(%s)\n" % ctypes.cast(
-            self.magic, ctypes.c_char_p).value)
+        sys.stdout.write("(%s)\n" % c_string(self.magic))
 
         sys.stdout.write("Version: ")
-        for i in range(ctypes.sizeof(OAT_VERSION_TYPE)):
+        for i in range(OAT_VERSION_SIZE):
             sys.stdout.write("%02X " % self.version[i])
 
-        sys.stdout.write("(%s)" % ctypes.cast(
-            self.version, ctypes.c_char_p).value)
+        sys.stdout.write("(%s)" % c_string(self.version))
 
         sys.stdout.write("\nAdler32_checksum: %d(0x%08X)" % (
-            self.adler32_checksum.value, self.adler32_checksum.value))
+            self.adler32_checksum, self.adler32_checksum))
         sys.stdout.write("\nInstruction set: %d" %
-                         (self.instruction_set.value))
+                         (self.instruction_set))
         sys.stdout.write("\nInstruction set features: %d" %
-                         (self.instruction_set_features.value))
-        sys.stdout.write("\nDex file count: %d" % (self.dex_file_count.value))
+                         (self.instruction_set_features))
+        sys.stdout.write("\nDex file count: %d" % (self.dex_file_count))
         sys.stdout.write("\nOat dex file offset: 0x%08X" %
-                         (self.oat_dex_files_offset.value))
+                         (self.oat_dex_files_offset))
         sys.stdout.write("\nExecutable offset: 0x%08X" %
-                         (self.executable_offset.value))
+                         (self.executable_offset))
         sys.stdout.write("\nInterpreter to interpreter bridge offset: 0x%08X" % (
-            self.interpreter_to_interpreter_bridge_offset.value))
+            self.interpreter_to_interpreter_bridge_offset))
         sys.stdout.write("\nInterpreter to compiled code bridge offset: 0x%08X" % (
-            self.interpreter_to_compiled_code_bridge_offset.value))
+            self.interpreter_to_compiled_code_bridge_offset))
         sys.stdout.write("\njni dlsym lookup offset: 0x%08X" %
-                         (self.jni_dlsym_lookup_offset_.value))
+                         (self.jni_dlsym_lookup_offset_))
         sys.stdout.write(
-            "\nportable imt conflict trampoline offset: 0x%08X" % (self.portable_imt_conflict_trampoline_offset.value))
+            "\nportable imt conflict trampoline offset: 0x%08X" % (self.portable_imt_conflict_trampoline_offset))
         sys.stdout.write(
-            "\nportable resolution trampoline offset: 0x%08X" % (self.portable_resolution_trampoline_offset.value))
+            "\nportable resolution trampoline offset: 0x%08X" % (self.portable_resolution_trampoline_offset))
         sys.stdout.write(
-            "\nportable to interpreter bridge offset: 0x%08X" % (self.portable_to_interpreter_bridge_offset.value))
+            "\nportable to interpreter bridge offset: 0x%08X" % (self.portable_to_interpreter_bridge_offset))
         sys.stdout.write(
-            "\nquick generic jni trampoline offset: 0x%08X" % (self.quick_generic_jni_trampoline_offset.value))
+            "\nquick generic jni trampoline offset: 0x%08X" % (self.quick_generic_jni_trampoline_offset))
         sys.stdout.write(
-            "\nquick imt conflict trampoline offset: 0x%08X" % (self.quick_imt_conflict_trampoline_offset.value))
+            "\nquick imt conflict trampoline offset: 0x%08X" % (self.quick_imt_conflict_trampoline_offset))
         sys.stdout.write(
-            "\nquick resolution trampoline offset: 0x%08X" % (self.quick_resolution_trampoline_offset.value))
+            "\nquick resolution trampoline offset: 0x%08X" % (self.quick_resolution_trampoline_offset))
         sys.stdout.write(
-            "\nquick to interpreter bridge offset: 0x%08X" % (self.quick_to_interpreter_bridge_offset.value))
+            "\nquick to interpreter bridge offset: 0x%08X" % (self.quick_to_interpreter_bridge_offset))
+
+        # fields of the versions since 183
+        for name in ('jni_dlsym_lookup_critical_trampoline_offset', 'nterp_trampoline_offset', 'bcp_bss_info_offset'):
+            if name in self.layout.names:
+                sys.stdout.write("\n%s: 0x%08X" % (name.replace('_', ' '), getattr(self, name)))
 
         sys.stdout.write("\nimage patch delta: 0x%08X" %
-                         (self.image_patch_delta.value))
+                         (self.image_patch_delta))
         sys.stdout.write("\nimage file location oat checksum: 0x%08X" %
-                         (self.image_file_location_oat_checksum.value))
+                         (self.image_file_location_oat_checksum))
         sys.stdout.write(
-            "\nimage file location oat data begin: 0x%08X" % (self.image_file_location_oat_data_begin.value))
+            "\nimage file location oat data begin: 0x%08X" % (self.image_file_location_oat_data_begin))
 
         sys.stdout.write("\nkey value store size: %d" %
-                         (self.key_value_store_size.value))
+                         (self.key_value_store_size))
 
         key_value_store_s = ""
-        for i in range(self.key_value_store_size.value):
-            if (self.key_value_store[i] == 0x00 and i != (self.key_value_store_size.value - 1)):
+        for i in range(self.key_value_store_size):
+            if (self.key_value_store[i] == 0x00 and i != (self.key_value_store_size - 1)):
                 key_value_store_s += " "
             else:
                 key_value_store_s += chr(self.key_value_store[i])
@@ -496,345 +947,68 @@ class OATHeader():
         for i in range(len(self.OATDexFileHeaders)):
             self.OATDexFileHeaders[i].print_header()
 
-    def _parse_v1(self, offset, file_size):
-        '''
-        Parse the OAT versions [045, 039]
-        :param offset: offset where to start the analysis
-        :param file_size: size if it's necessary for offset checks
-        :return:
-        '''
-        self.file_p.seek(offset, FILE_BEGIN)
-
-        self.adler32_checksum = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.instruction_set = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.instruction_set_features = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.dex_file_count = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        # below OAT 131 oat_dex_files_offset = 0
-        self.oat_dex_files_offset = c_uint(0)
-        self.executable_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.executable_offset.value > file_size or (self.executable_offset.value + self.oatdata_offset) > file_size:
-            raise OffsetOutOfBoundException(
-                "Error, executable_offset (0x%08X) is out of bound of the file" % self.executable_offset.value)
-
-        self.interpreter_to_interpreter_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                     self.file_p.tell())
-        self.interpreter_to_compiled_code_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                       self.file_p.tell())
-        self.jni_dlsym_lookup_offset_ = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-
-        self.portable_imt_conflict_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                    self.file_p.tell())
-        self.portable_resolution_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                  self.file_p.tell())
-        self.portable_to_interpreter_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                  self.file_p.tell())
-
-        self.quick_generic_jni_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                self.file_p.tell())
-        self.quick_imt_conflict_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                 self.file_p.tell())
-        self.quick_resolution_trampoline_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.quick_to_interpreter_bridge_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-
-        self.image_patch_delta = read_file_le(
-            self.file_p, INTEGER, INTEGER_SIZE, self.file_p.tell())
-        self.image_file_location_oat_checksum = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                             self.file_p.tell())
-        self.image_file_location_oat_data_begin = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                               self.file_p.tell())
-
-        self.key_value_store_size = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.key_value_store = (c_ubyte * self.key_value_store_size.value)()
-
-        for i in range(self.key_value_store_size.value):
-            self.key_value_store[i] = read_file_le(
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
-
-    def _parse_v2(self, offset, file_size):
+    def _parse_fields(self, layout, offset, file_size):
         '''
-        Parse the OAT versions [077, 075, 063, 064, 062]
+        Parse the header fields of a version with its layout from
+        FileFormats/OATHeaderLayout.py, the fields are decoded with
+        one unpack and then the offsets are checked in order.
+        :param layout: OatHeaderLayout of the version
         :param offset: offset where to start the analysis
         :param file_size: size if it's necessary for offset checks
-        :return:
+        :return: offset after the key value store
         '''
-        self.file_p.seek(offset, FILE_BEGIN)
-
-        self.adler32_checksum = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.instruction_set = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.instruction_set_features = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.dex_file_count = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        # below OAT 131 oat_dex_files_offset = 0
-        self.oat_dex_files_offset = c_uint(0)
-        self.executable_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.executable_offset.value > file_size or (self.executable_offset.value + self.oatdata_offset) > file_size:
-            raise OffsetOutOfBoundException(
-                "Error, executable_offset (0x%08X) is out of bound of the file" % self.executable_offset.value)
-
-        self.interpreter_to_interpreter_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                     self.file_p.tell())
-        self.interpreter_to_compiled_code_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                       self.file_p.tell())
-        self.jni_dlsym_lookup_offset_ = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-
-        self.portable_imt_conflict_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                    self.file_p.tell())
-        self.portable_resolution_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                  self.file_p.tell())
-        self.portable_to_interpreter_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                  self.file_p.tell())
-
-        self.quick_generic_jni_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                self.file_p.tell())
-        self.quick_imt_conflict_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                 self.file_p.tell())
-        self.quick_resolution_trampoline_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.quick_to_interpreter_bridge_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-
-        self.key_value_store_size = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.key_value_store = (c_ubyte * self.key_value_store_size.value)()
-
-        for i in range(self.key_value_store_size.value):
-            self.key_value_store[i] = read_file_le(
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
-
-    def _parse_v3(self, offset, file_size):
-        '''
-        Parse the OAT versions [079, 088, 114]
-        :param offset: offset where to start the analysis
-        :param file_size: size if it's necessary for offset checks
-        :return:
-        '''
-        self.file_p.seek(offset, FILE_BEGIN)
-
-        self.adler32_checksum = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.instruction_set = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.instruction_set_features = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.dex_file_count = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        # below OAT 131 oat_dex_files_offset = 0
-        self.oat_dex_files_offset = c_uint(0)
-        self.executable_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.executable_offset.value > file_size or (self.executable_offset.value + self.oatdata_offset) > file_size:
-            raise OffsetOutOfBoundException(
-                "Error, executable_offset (0x%08X) is out of bound of the file" % self.executable_offset.value)
-
-        self.interpreter_to_interpreter_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                     self.file_p.tell())
-        self.interpreter_to_compiled_code_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                       self.file_p.tell())
-        self.jni_dlsym_lookup_offset_ = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-
-        self.portable_imt_conflict_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                    self.file_p.tell())
-        self.portable_resolution_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                  self.file_p.tell())
-        self.portable_to_interpreter_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                  self.file_p.tell())
-
-        self.quick_generic_jni_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                self.file_p.tell())
-        self.quick_imt_conflict_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                 self.file_p.tell())
-
-        self.image_file_location_oat_checksum = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                             self.file_p.tell())
-        self.image_file_location_oat_data_begin = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                               self.file_p.tell())
-
-        self.key_value_store_size = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.key_value_store = (c_ubyte * self.key_value_store_size.value)()
-
-        for i in range(self.key_value_store_size.value):
-            self.key_value_store[i] = read_file_le(
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
-
-    def _parse_v4(self, offset, file_size):
-        '''
-        Parse the OAT versions [131]
-        :param offset: offset where to start the analysis
-        :param file_size: size if it's necessary for offset checks
-        :return:
-        '''
-        self.file_p.seek(offset, FILE_BEGIN)
-
-        self.adler32_checksum = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.instruction_set = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.instruction_set_features = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.dex_file_count = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.oat_dex_files_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.oat_dex_files_offset.value > file_size:
-            raise OffsetOutOfBoundException(
-                "Error, oat_dex_files_offset (0x%08X) is out of bound of the file" % self.oat_dex_files_offset.value)
-        self.executable_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.executable_offset.value > file_size or (self.executable_offset.value + self.oatdata_offset) > file_size:
-            raise OffsetOutOfBoundException(
-                "Error, executable_offset (0x%08X) is out of bound of the file" % self.executable_offset.value)
-        self.interpreter_to_interpreter_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                     self.file_p.tell())
-        self.interpreter_to_compiled_code_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                       self.file_p.tell())
-        self.jni_dlsym_lookup_offset_ = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
+        self.layout = layout
+        self.__dict__.update(layout.decode(self.reader.read(offset, layout.size)))
 
-        self.quick_generic_jni_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                self.file_p.tell())
-        self.quick_imt_conflict_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                 self.file_p.tell())
+        for name, check in layout.checks:
+            value = getattr(self, name)
 
-        self.quick_resolution_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                               self.file_p.tell())
-
-        self.quick_to_interpreter_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                               self.file_p.tell())
-
-        self.image_patch_delta = read_file_le(
-            self.file_p, INTEGER, INTEGER_SIZE, self.file_p.tell())
-
-        self.image_file_location_oat_checksum = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                             self.file_p.tell())
-        self.image_file_location_oat_data_begin = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                               self.file_p.tell())
-
-        self.key_value_store_size = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-
-        print("key value store size: %d" % (self.key_value_store_size.value))
+            if value > file_size or (check == CHECK_OATDATA and (value + self.oatdata_offset) > file_size):
+                raise OffsetOutOfBoundException(
+                    "Error, %s (0x%08X) is out of bound of the file" % (name, value))
 
-        self.key_value_store = (c_ubyte * self.key_value_store_size.value)()
+        offset += layout.size
+        self.key_value_store = self.reader.read_bytes(offset, self.key_value_store_size)
 
-        for i in range(self.key_value_store_size.value):
-            self.key_value_store[i] = read_file_le(
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
+        return offset + self.key_value_store_size
 
-    def _parse_v5(self, offset, file_size):
+    def parse_header(self, offset, file_size, vdex_file=None, vdex_file_size=0):
         '''
-        Parse the OAT versions [170]
-        :param offset: offset where to start the analysis
-        :param file_size: size if it's necessary for offset checks
-        :return:
+        Parse the OAT header and the OAT Dex File Headers
+        :param offset: offset of oatdata
+        :param file_size: size of the oat file for offset checks
+        :param vdex_file: opened vdex paired with the oat file, only
+                          used for versions storing the dex in the vdex
+        :param vdex_file_size: size of the vdex file
         '''
-        self.file_p.seek(offset, FILE_BEGIN)
-
-        self.adler32_checksum = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.instruction_set = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.instruction_set_features = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.dex_file_count = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        self.oat_dex_files_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.oat_dex_files_offset.value > file_size:
-            raise OffsetOutOfBoundException(
-                "Error, oat_dex_files_offset (0x%08X) is out of bound of the file" % self.oat_dex_files_offset.value)
-        self.executable_offset = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        if self.executable_offset.value > file_size or (self.executable_offset.value + self.oatdata_offset) > file_size:
-            raise OffsetOutOfBoundException(
-                "Error, executable_offset (0x%08X) is out of bound of the file" % self.executable_offset.value)
-        self.jni_dlsym_lookup_offset_ = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-
-        self.quick_generic_jni_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                self.file_p.tell())
-        self.quick_imt_conflict_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                                 self.file_p.tell())
-
-        self.quick_resolution_trampoline_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                               self.file_p.tell())
+        self.magic, self.version = self.reader.unpack(OAT_MAGIC_VERSION_LAYOUT, offset)
 
-        self.quick_to_interpreter_bridge_offset = read_file_le(self.file_p, UINTEGER, UINTEGER_SIZE,
-                                                               self.file_p.tell())
-
-        self.key_value_store_size = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-
-        self.key_value_store = (c_ubyte * self.key_value_store_size.value)()
-
-        for i in range(self.key_value_store_size.value):
-            self.key_value_store[i] = read_file_le(
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
-
-    def parse_header(self, offset, file_size):
-        self.file_p.seek(offset, FILE_BEGIN)
-
-        for i in range(ctypes.sizeof(OAT_MAGIC_TYPE)):
-            self.magic[i] = read_file_le(
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
-
-        if ctypes.cast(self.magic, ctypes.c_char_p).value != OATHeader.MAGIC_VALUE:
+        if c_string(self.magic) != OATHeader.MAGIC_VALUE:
             raise IncorrectMagicException(
                 "Error, magic header doesn't match expected header %s" % (OATHeader.MAGIC_VALUE))
 
-        for i in range(ctypes.sizeof(OAT_VERSION_TYPE)):
-            self.version[i] = read_file_le(
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
+        version = c_string(self.version)
+        fields_offset = offset + OAT_MAGIC_VERSION_LAYOUT.size
 
-        # [045, 039]
-        if ctypes.cast(self.version, ctypes.c_char_p).value in OATHeader.VERSION_1:
-            self._parse_v1(self.file_p.tell(), file_size)
+        if version not in OAT_HEADER_LAYOUT_BY_VERSION:
+            raise UnsupportedOatVersion("OAT Version analyzed (%s) not supported" % version)
 
-        # [077, 075, 063, 064, 062]
-        elif ctypes.cast(self.version, ctypes.c_char_p).value in OATHeader.VERSION_2:
-            self._parse_v2(self.file_p.tell(), file_size)
-
-        # [079, 088, 114]
-        elif ctypes.cast(self.version, ctypes.c_char_p).value in OATHeader.VERSION_3:
-            self._parse_v3(self.file_p.tell(), file_size)
-
-        # [131]:
-        elif ctypes.cast(self.version, ctypes.c_char_p).value in OATHeader.VERSION_4:
-            self._parse_v4(self.file_p.tell(), file_size)
-        
-        # [170]:
-        elif ctypes.cast(self.version, ctypes.c_char_p).value in OATHeader.VERSION_5:
-            self._parse_v5(self.file_p.tell(), file_size)
-
-        else:
-            raise UnsupportedOatVersion("OAT Version analyzed (%s) not supported" % ctypes.cast(
-                self.version, ctypes.c_char_p).value)
+        oat_dex_file_offset = self._parse_fields(OAT_HEADER_LAYOUT_BY_VERSION[version], fields_offset, file_size)
 
+        # the OatDexFile records follow the key value store,
         # since version 131 oat_dex_file_offset
         # this was introduced inversion android-8.1.0_r1
-        if self.oat_dex_files_offset.value != 0:
-            OatDexFile = offset + self.oat_dex_files_offset.value
-            self.file_p.seek(OatDexFile, FILE_BEGIN)
-
-        for i in range(self.dex_file_count.value):
-            oatdexfileheader_aux = OATDexFileHeader(self.file_p)
-            oatdexfileheader_aux.parse_header(self.file_p.tell(
-            ), file_size, offset, ctypes.cast(self.version, ctypes.c_char_p).value)
+        if self.oat_dex_files_offset != 0:
+            oat_dex_file_offset = offset + self.oat_dex_files_offset
+
+        if version not in OATHeader.VDEX_VERSIONS:
+            vdex_file = None
+
+        for i in range(self.dex_file_count):
+            oatdexfileheader_aux = OATDexFileHeader(self.reader)
+            oatdexfileheader_aux.parse_header(oat_dex_file_offset, file_size, offset, version,
+                                              vdex_file, vdex_file_size)
+            oat_dex_file_offset = oatdexfileheader_aux.next_header_offset
             self.OATDexFileHeaders.append(oatdexfileheader_aux)
 
         self.header_initialized = True
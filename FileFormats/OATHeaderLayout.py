@@ -0,0 +1,318 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: FileFormats/OATHeaderLayout.py
+#   Version: 0.7
+######################################################
+
+'''
+Declarative layouts of the OAT header, one entry per group of
+versions sharing the same fields. Each field is (name, type, check)
+where type is a struct format character and check the bound check
+applied to its value:
+
+    CHECK_NONE      the value is not an offset
+    CHECK_FILE      offset must be inside of the file
+    CHECK_OATDATA   offset from oatdata must be inside of the file
+
+The fields go after magic and version, key_value_store_size is
+always the last one and is not part of the tables.
+
+Since 183 every layout also describes the uint32 fields of an
+OatDexFile after dex_file_pointer (offsets from oatdata of the class
+offsets, type lookup table, bss mappings and DexLayout sections), the
+records have a fixed size after the location and the class offsets
+are read from class_offsets_offset. Before 183 the class offsets are
+read right after dex_file_pointer and the record takes 8 more bytes.
+
+The Python parser compiles every layout to a struct.Struct and the
+C reader of elfparser_e (headers/oat_header_layouts.h) is generated
+from these tables with elfparser_e/gen_oat_header_layouts.py, adding
+a version is adding an entry to OAT_HEADER_LAYOUTS.
+'''
+
+import struct
+from collections import namedtuple
+
+CHECK_NONE = 0
+CHECK_FILE = 1
+CHECK_OATDATA = 2
+
+UINT32 = 'I'
+INT32 = 'i'
+
+# greatest OatClass status, ClassStatus was renumbered in Android 9
+# (kVisiblyInitialized since Android 11)
+CLASS_STATUS_MAX = 10
+CLASS_STATUS_MAX_V11 = 15
+
+# OatDexFile fields after dex_file_pointer
+OAT_DEX_FILE_FIELDS_V11 = (
+    'class_offsets_offset',
+    'lookup_table_offset',
+    'method_bss_mapping_offset',
+    'type_bss_mapping_offset',
+    'string_bss_mapping_offset',
+    'dex_layout_sections_offset',
+)
+
+OAT_DEX_FILE_FIELDS_V13 = (
+    'class_offsets_offset',
+    'lookup_table_offset',
+    'method_bss_mapping_offset',
+    'type_bss_mapping_offset',
+    'public_type_bss_mapping_offset',
+    'package_type_bss_mapping_offset',
+    'string_bss_mapping_offset',
+    'dex_layout_sections_offset',
+)
+
+# bytes after dex_file_pointer of the OatDexFile records before 183
+OAT_DEX_FILE_LEGACY_SIZE = 8
+
+OatHeaderField = namedtuple('OatHeaderField', ['name', 'type', 'check'])
+
+
+def _fields(*fields):
+    return tuple(OatHeaderField(*field) for field in fields)
+
+
+COMMON_FIELDS = _fields(
+    ('adler32_checksum', UINT32, CHECK_NONE),
+    ('instruction_set', UINT32, CHECK_NONE),
+    ('instruction_set_features', UINT32, CHECK_NONE),
+    ('dex_file_count', UINT32, CHECK_NONE),
+)
+
+
+class OatHeaderLayout():
+    '''
+    Header layout of a group of OAT versions compiled to one
+    struct.Struct, decode returns the values of the fields with a
+    single unpack.
+
+    :param name: name of the layout (used for the generated C code).
+    :param versions: OAT versions using the layout.
+    :param vdex_versions: versions of the layout storing the dex files in the vdex.
+    :param fields: fields after the COMMON_FIELDS.
+    :param dex_file_fields: OatDexFile fields after dex_file_pointer (None before 183).
+    :param class_status_max: greatest valid OatClass status.
+    :param class_num_methods: True if an OatClass stores its number of methods
+                              (and the bitmap size follows from it).
+    '''
+
+    def __init__(self, name, versions, vdex_versions, fields, dex_file_fields=None,
+                 class_status_max=CLASS_STATUS_MAX, class_num_methods=False):
+        self.name = name
+        self.versions = versions
+        self.vdex_versions = vdex_versions
+        self.dex_file_fields = dex_file_fields
+        self.class_status_max = class_status_max
+        self.class_num_methods = class_num_methods
+        self.fields = COMMON_FIELDS + fields + _fields(('key_value_store_size', UINT32, CHECK_NONE))
+
+        self.names = tuple(field.name for field in self.fields)
+        self.layout = struct.Struct('<' + ''.join(field.type for field in self.fields))
+        self.size = self.layout.size
+        self.checks = tuple((field.name, field.check) for field in self.fields if field.check != CHECK_NONE)
+
+        if dex_file_fields is not None:
+            self.dex_file_layout = struct.Struct('<%dI' % len(dex_file_fields))
+            self.dex_file_fields_size = self.dex_file_layout.size
+        else:
+            self.dex_file_layout = None
+            self.dex_file_fields_size = OAT_DEX_FILE_LEGACY_SIZE
+
+    def decode(self, buffer):
+        '''
+        Decode the fields from buffer (starting after the version).
+
+        :return: dictionary of field name and value
+        '''
+        return dict(zip(self.names, self.layout.unpack_from(buffer)))
+
+
+OAT_HEADER_LAYOUTS = (
+    OatHeaderLayout('v1', (b'039', b'045'), (), _fields(
+        ('executable_offset', UINT32, CHECK_OATDATA),
+        ('interpreter_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('interpreter_to_compiled_code_bridge_offset', UINT32, CHECK_NONE),
+        ('jni_dlsym_lookup_offset_', UINT32, CHECK_NONE),
+        ('portable_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('portable_resolution_trampoline_offset', UINT32, CHECK_NONE),
+        ('portable_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('quick_generic_jni_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_resolution_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('image_patch_delta', INT32, CHECK_NONE),
+        ('image_file_location_oat_checksum', UINT32, CHECK_NONE),
+        ('image_file_location_oat_data_begin', UINT32, CHECK_NONE),
+    )),
+    OatHeaderLayout('v2', (b'062', b'063', b'064', b'075', b'077'), (), _fields(
+        ('executable_offset', UINT32, CHECK_OATDATA),
+        ('interpreter_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('interpreter_to_compiled_code_bridge_offset', UINT32, CHECK_NONE),
+        ('jni_dlsym_lookup_offset_', UINT32, CHECK_NONE),
+        ('portable_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('portable_resolution_trampoline_offset', UINT32, CHECK_NONE),
+        ('portable_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('quick_generic_jni_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_resolution_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+    )),
+    OatHeaderLayout('v3', (b'079', b'088', b'114', b'124'), (b'124',), _fields(
+        ('executable_offset', UINT32, CHECK_OATDATA),
+        ('interpreter_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('interpreter_to_compiled_code_bridge_offset', UINT32, CHECK_NONE),
+        ('jni_dlsym_lookup_offset_', UINT32, CHECK_NONE),
+        ('portable_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('portable_resolution_trampoline_offset', UINT32, CHECK_NONE),
+        ('portable_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('quick_generic_jni_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('image_file_location_oat_checksum', UINT32, CHECK_NONE),
+        ('image_file_location_oat_data_begin', UINT32, CHECK_NONE),
+    )),
+    OatHeaderLayout('v4', (b'131',), (b'131',), _fields(
+        ('oat_dex_files_offset', UINT32, CHECK_FILE),
+        ('executable_offset', UINT32, CHECK_OATDATA),
+        ('interpreter_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('interpreter_to_compiled_code_bridge_offset', UINT32, CHECK_NONE),
+        ('jni_dlsym_lookup_offset_', UINT32, CHECK_NONE),
+        ('quick_generic_jni_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_resolution_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('image_patch_delta', INT32, CHECK_NONE),
+        ('image_file_location_oat_checksum', UINT32, CHECK_NONE),
+        ('image_file_location_oat_data_begin', UINT32, CHECK_NONE),
+    )),
+    OatHeaderLayout('v5', (b'170',), (b'170',), _fields(
+        ('oat_dex_files_offset', UINT32, CHECK_FILE),
+        ('executable_offset', UINT32, CHECK_OATDATA),
+        ('jni_dlsym_lookup_offset_', UINT32, CHECK_NONE),
+        ('quick_generic_jni_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_resolution_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+    )),
+    OatHeaderLayout('v6', (b'183',), (b'183',), _fields(
+        ('oat_dex_files_offset', UINT32, CHECK_FILE),
+        ('executable_offset', UINT32, CHECK_OATDATA),
+        ('jni_dlsym_lookup_offset_', UINT32, CHECK_NONE),
+        ('jni_dlsym_lookup_critical_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_generic_jni_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_resolution_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+    ), OAT_DEX_FILE_FIELDS_V11, CLASS_STATUS_MAX_V11),
+    OatHeaderLayout('v7', (b'195', b'199'), (b'195', b'199'), _fields(
+        ('oat_dex_files_offset', UINT32, CHECK_FILE),
+        ('executable_offset', UINT32, CHECK_OATDATA),
+        ('jni_dlsym_lookup_offset_', UINT32, CHECK_NONE),
+        ('jni_dlsym_lookup_critical_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_generic_jni_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_resolution_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('nterp_trampoline_offset', UINT32, CHECK_NONE),
+    ), OAT_DEX_FILE_FIELDS_V11, CLASS_STATUS_MAX_V11),
+    OatHeaderLayout('v8', (b'225', b'230'), (b'225', b'230'), _fields(
+        ('oat_dex_files_offset', UINT32, CHECK_FILE),
+        ('bcp_bss_info_offset', UINT32, CHECK_FILE),
+        ('executable_offset', UINT32, CHECK_OATDATA),
+        ('jni_dlsym_lookup_offset_', UINT32, CHECK_NONE),
+        ('jni_dlsym_lookup_critical_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_generic_jni_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_imt_conflict_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_resolution_trampoline_offset', UINT32, CHECK_NONE),
+        ('quick_to_interpreter_bridge_offset', UINT32, CHECK_NONE),
+        ('nterp_trampoline_offset', UINT32, CHECK_NONE),
+    ), OAT_DEX_FILE_FIELDS_V13, CLASS_STATUS_MAX_V11, True),
+)
+
+# layout of each version
+OAT_HEADER_LAYOUT_BY_VERSION = {version: layout for layout in OAT_HEADER_LAYOUTS for version in layout.versions}
+
+# versions where the dex files are stored in the vdex
+OAT_VDEX_VERSIONS = [version for layout in OAT_HEADER_LAYOUTS for version in layout.vdex_versions]
+
+# Layouts of the OatQuickMethodHeader right before the code of every
+# compiled method (code offsets are from oatdata, with the Thumb bit
+# set for Thumb2 code). The fields are uint32 and the frame info is
+# frame_size_in_bytes followed by the core and fp spill masks.
+#
+# Since 195 the header is one field, data, holding the code size or,
+# with METHOD_HEADER_IS_CODE_INFO, the offset back from the code to the
+# CodeInfo of the method, which starts with the code size and frame
+# info as interleaved varints (CODE_INFO_HEADER_FIELDS). From 170 to
+# 183 the frame info is only in the CodeInfo and is not read.
+
+METHOD_HEADER_SHOULD_DEOPTIMIZE = 0x80000000
+METHOD_HEADER_CODE_SIZE_MASK = 0x7FFFFFFF
+METHOD_HEADER_IS_CODE_INFO = 0x40000000
+METHOD_HEADER_DATA_MASK = 0x3FFFFFFF
+
+CODE_INFO_HEADER_FIELDS = (
+    'flags',
+    'code_size',
+    'packed_frame_size',
+    'core_spill_mask',
+    'fp_spill_mask',
+    'number_of_dex_registers',
+    'bit_table_flags',
+)
+CODE_INFO_VARINT_BITS = 4
+CODE_INFO_VARINT_MAX = 11
+CODE_INFO_STACK_ALIGNMENT = 16
+
+FRAME_INFO_FIELDS = ('frame_size_in_bytes', 'core_spill_mask', 'fp_spill_mask')
+
+
+class OatMethodHeaderLayout():
+    '''
+    OatQuickMethodHeader of a group of OAT versions, the index of
+    each field is given for the readers (-1 when it is missing).
+
+    :param name: name of the layout.
+    :param versions: OAT versions using the layout.
+    :param fields: names of the uint32 fields.
+    :param code_info: True if the header is the single data field.
+    '''
+
+    def __init__(self, name, versions, fields, code_info=False):
+        self.name = name
+        self.versions = versions
+        self.fields = fields
+        self.code_info = code_info
+        self.layout = struct.Struct('<%dI' % len(fields))
+        self.size = self.layout.size
+
+        self.code_size_field = self.__field_index('data' if code_info else 'code_size')
+        self.metadata_field = self.__field_index('data' if code_info else 'vmap_table_offset')
+        self.frame_size_field = self.__field_index('frame_size_in_bytes')
+
+    def __field_index(self, name):
+        return self.fields.index(name) if name in self.fields else -1
+
+
+OAT_METHOD_HEADER_LAYOUTS = (
+    OatMethodHeaderLayout('m1', (b'039', b'045', b'062', b'063', b'064'),
+                          ('mapping_table_offset', 'vmap_table_offset', 'gc_map_offset') +
+                          FRAME_INFO_FIELDS + ('code_size',)),
+    OatMethodHeaderLayout('m2', (b'075', b'077', b'079', b'088'),
+                          ('mapping_table_offset', 'vmap_table_offset') + FRAME_INFO_FIELDS + ('code_size',)),
+    OatMethodHeaderLayout('m3', (b'114', b'124'),
+                          ('vmap_table_offset',) + FRAME_INFO_FIELDS + ('code_size',)),
+    OatMethodHeaderLayout('m4', (b'131',),
+                          ('method_info_offset', 'vmap_table_offset') + FRAME_INFO_FIELDS + ('code_size',)),
+    OatMethodHeaderLayout('m5', (b'170', b'183'), ('vmap_table_offset', 'code_size')),
+    OatMethodHeaderLayout('m6', (b'195', b'199', b'225', b'230'), ('data',), code_info=True),
+)
+
+OAT_METHOD_HEADER_LAYOUT_BY_VERSION = {version: layout for layout in OAT_METHOD_HEADER_LAYOUTS
+                                       for version in layout.versions}
@@ -9,14 +9,35 @@
 
 import os
 import sys
+import struct
 
 from FileWork import *
 from DextractorException import *
 from FileFormats.DEX import DEXHeader
 
-VDEX_MAGIC_TYPE = c_ubyte * 4
-VDEX_VERIFIER_DEPS_VERSION_TYPE = c_ubyte * 4
-VDEX_DEX_SECTION_VERSION_TYPE = c_ubyte * 4
+VDEX_MAGIC_SIZE = 4
+VDEX_VERIFIER_DEPS_VERSION_SIZE = 4
+VDEX_DEX_SECTION_VERSION_SIZE = 4
+
+VDEX_MAGIC_VERSION_LAYOUT = struct.Struct('<4s4s')
+VDEX_V006_LAYOUT = struct.Struct('<4I')
+VDEX_V019_LAYOUT = struct.Struct('<4s2I')
+VDEX_V021_LAYOUT = struct.Struct('<2I')
+VDEX_DEX_SECTION_HEADER_LAYOUT = struct.Struct('<3I')
+
+VDEX_MAGIC_VALUE = b'vdex'
+
+# verifier deps version (vdex version from 027) where each layout starts
+VDEX_VERSION_SECTIONS = 19
+VDEX_VERSION_BOOTCLASSPATH = 21
+VDEX_VERSION_SECTION_TABLE = 27
+
+VDEX_CHECKSUM_SECTION = 0
+VDEX_DEX_FILE_SECTION = 1
+VDEX_VERIFIER_DEPS_SECTION = 2
+VDEX_TYPE_LOOKUP_TABLE_SECTION = 3
+
+DEX_FILE_SIZE_OFFSET = 32
 
 
 class VDEXFile():
@@ -25,29 +46,70 @@ class VDEXFile():
     we will find the DEX files after OAT version
     124 (Android 8.0).
 
-    VDEXFile {
+    v006/v010 (Android 8.x) {
+        uint8_t magic_[4]
+        uint8_t version_[4]
+        uint32_t number_of_dex_files_
+        uint32_t dex_size_
+        uint32_t verifier_deps_size_
+        uint32_t quickening_info_size_
+        uint32_t dex_checksums_[number_of_dex_files_]
+        dex files
+    }
+
+    v019/v021 (Android 9/10) {
         uint8_t magic_[4]
         uint8_t verifier_deps_version_[4]
         uint8_t dex_section_version_[4]
         uint32_t number_of_dex_files_
         uint32_t verifier_deps_size_
-        uint32_t bootclasspath_checksums_size_
-        uint32_t class_loader_context_size_
+        uint32_t bootclasspath_checksums_size_     # from v021
+        uint32_t class_loader_context_size_        # from v021
+        uint32_t dex_checksums_[number_of_dex_files_]
+        DexSectionHeader {                         # if dex_section_version_ != 000
+            uint32_t dex_size_
+            uint32_t dex_shared_data_size_
+            uint32_t quickening_info_size_
+        }
+        { uint32_t quickening_table_offset, dex file }[number_of_dex_files_]
+    }
+
+    v027 (Android 12+) {
+        uint8_t magic_[4]
+        uint8_t vdex_version_[4]
+        uint32_t number_of_sections_
+        { uint32_t kind, uint32_t offset, uint32_t size }[number_of_sections_]
     }
+
+    Dex files are 4 bytes aligned in every version.
     '''
 
     def __init__(self, file_pointer):
         self.file_p = file_pointer
+        self.reader = RecordReader.of(file_pointer)
         self.header_initialized = False
         self.dex_file = None
 
-        self.magic = VDEX_MAGIC_TYPE()
-        self.verifier_deps_version = VDEX_VERIFIER_DEPS_VERSION_TYPE()
-        self.dex_section_version = VDEX_DEX_SECTION_VERSION_TYPE()
-        self.number_of_dex_files = c_uint()
-        self.verifier_deps_size = c_uint()
-        self.bootclasspath_checksums_size = c_uint()
-        self.class_loader_context_size = c_uint()
+        self.magic = bytes(VDEX_MAGIC_SIZE)
+        self.verifier_deps_version = bytes(VDEX_VERIFIER_DEPS_VERSION_SIZE)
+        self.dex_section_version = bytes(VDEX_DEX_SECTION_VERSION_SIZE)
+        self.number_of_dex_files = 0
+        self.verifier_deps_size = 0
+        self.bootclasspath_checksums_size = 0
+        self.class_loader_context_size = 0
+
+        self.version = 0
+        self.dex_size = 0
+        self.dex_shared_data_size = 0
+        self.quickening_info_size = 0
+        self.number_of_sections = 0
+        self.sections = {}
+
+        self.dex_section_offset = 0
+        self.dex_checksums = []
+        self.dex_files_offsets = []
+        self.dex_files_sizes = []
+        self.dex_files = []
 
     def print_header(self):
         if not self.header_initialized:
@@ -59,63 +121,211 @@ class VDEXFile():
 
         sys.stdout.write("\nVDEX Magic: ")
 
-        for i in range(ctypes.sizeof(VDEX_MAGIC_TYPE)):
+        for i in range(VDEX_MAGIC_SIZE):
             sys.stdout.write("%02X " % (self.magic[i]))
 
-        sys.stdout.write("(%s)\n" % ctypes.cast(
-            self.magic, ctypes.c_char_p).value)
+        sys.stdout.write("(%s)\n" % c_string(self.magic))
 
         sys.stdout.write("\nVerifier Deps Version: ")
 
-        for i in range(ctypes.sizeof(VDEX_VERIFIER_DEPS_VERSION_TYPE)):
+        for i in range(VDEX_VERIFIER_DEPS_VERSION_SIZE):
             sys.stdout.write("%02X " % (self.verifier_deps_version[i]))
 
-        sys.stdout.write("(%s)\n" % ctypes.cast(
-            self.verifier_deps_version, ctypes.c_char_p).value)
+        sys.stdout.write("(%s)\n" % c_string(self.verifier_deps_version))
 
-        sys.stdout.write("\nDEX Section Version: ")
+        if VDEX_VERSION_SECTIONS <= self.version < VDEX_VERSION_SECTION_TABLE:
+            sys.stdout.write("\nDEX Section Version: ")
 
-        for i in range(ctypes.sizeof(VDEX_DEX_SECTION_VERSION_TYPE)):
-            sys.stdout.write("%02X " % (self.dex_section_version[i]))
+            for i in range(VDEX_DEX_SECTION_VERSION_SIZE):
+                sys.stdout.write("%02X " % (self.dex_section_version[i]))
 
-        sys.stdout.write("(%s)" % ctypes.cast(
-            self.dex_section_version, ctypes.c_char_p).value)
+            sys.stdout.write("(%s)" % c_string(self.dex_section_version))
+
+        if self.version >= VDEX_VERSION_SECTION_TABLE:
+            sys.stdout.write("\nNumber of sections: %d" %
+                             (self.number_of_sections))
+            for kind, (offset, size) in self.sections.items():
+                sys.stdout.write("\nSection %d: offset 0x%08X size %d" % (kind, offset, size))
 
         sys.stdout.write("\nNumber of DEX files: %d" %
-                         (self.number_of_dex_files.value))
+                         (self.number_of_dex_files))
 
         sys.stdout.write("\nVerifier Deps Size: %d" %
-                        (self.verifier_deps_size.value))
-        
-        sys.stdout.write("\nBootclasspath checksums size: %d" % 
-                        (self.bootclasspath_checksums_size.value))
-        
-        sys.stdout.write("\nClass Loader Context Size: %d" %
-                        (self.class_loader_context_size.value))
-        
+                        (self.verifier_deps_size))
+
+        if self.version < VDEX_VERSION_SECTIONS:
+            sys.stdout.write("\nDex Size: %d" % (self.dex_size))
+            sys.stdout.write("\nQuickening Info Size: %d" % (self.quickening_info_size))
+        elif self.version < VDEX_VERSION_SECTION_TABLE:
+            sys.stdout.write("\nBootclasspath checksums size: %d" %
+                            (self.bootclasspath_checksums_size))
+
+            sys.stdout.write("\nClass Loader Context Size: %d" %
+                            (self.class_loader_context_size))
+
+            sys.stdout.write("\nDex Size: %d" % (self.dex_size))
+            sys.stdout.write("\nDex Shared Data Size: %d" % (self.dex_shared_data_size))
+            sys.stdout.write("\nQuickening Info Size: %d" % (self.quickening_info_size))
+
+        for i in range(len(self.dex_checksums)):
+            sys.stdout.write("\nDex [%d] checksum: 0x%08X offset: 0x%08X size: %d" % (
+                i, self.dex_checksums[i], self.dex_files_offsets[i], self.dex_files_sizes[i]))
+
+        sys.stdout.write("\n")
+
+    def _read_dex_checksums(self, offset, file_size):
+        if offset + self.number_of_dex_files * UINTEGER_SIZE > file_size:
+            raise OffsetOutOfBoundException(
+                "Error, vdex dex checksums (0x%08X) are out of bound of the file" % offset)
+
+        self.dex_checksums = list(self.reader.unpack_array(UINTEGER, offset, self.number_of_dex_files))
+
+    def _walk_dex_section(self, offset, size, prefix_size, file_size):
+        '''
+        Walk the dex files of the dex section reading only
+        the file_size of each dex header.
+        '''
+        section_end = offset + size
+        cursor = offset
+
+        if section_end > file_size:
+            raise OffsetOutOfBoundException(
+                "Error, vdex dex section (0x%08X) is out of bound of the file" % offset)
+
+        self.dex_section_offset = offset
+
+        for i in range(self.number_of_dex_files):
+            if size == 0:
+                # dex files are not in the vdex (stored in the APK)
+                self.dex_files_offsets.append(0)
+                self.dex_files_sizes.append(0)
+                continue
+
+            cursor += prefix_size
+
+            if cursor + DEX_FILE_SIZE_OFFSET + UINTEGER_SIZE > section_end:
+                raise OffsetOutOfBoundException(
+                    "Error, vdex dex file %d (0x%08X) is out of bound of the dex section" % (i, cursor))
+
+            dex_size = self.reader.unpack(UINT32_LAYOUT, cursor + DEX_FILE_SIZE_OFFSET)[0]
+
+            if cursor + dex_size > section_end:
+                raise OffsetOutOfBoundException(
+                    "Error, vdex dex file %d size (%d) is out of bound of the dex section" % (i, dex_size))
+
+            self.dex_files_offsets.append(cursor)
+            self.dex_files_sizes.append(dex_size)
+
+            cursor = (cursor + dex_size + 3) & ~3
+
+    def _parse_v006(self, offset, file_size):
+        '''
+        Parse the VDEX versions [006, 010]
+        '''
+        (self.number_of_dex_files, self.dex_size, self.verifier_deps_size,
+         self.quickening_info_size) = self.reader.unpack(VDEX_V006_LAYOUT, offset)
+
+        checksums_offset = offset + VDEX_V006_LAYOUT.size
+        self._read_dex_checksums(checksums_offset, file_size)
+
+        self._walk_dex_section(checksums_offset + self.number_of_dex_files * UINTEGER_SIZE,
+                               self.dex_size, 0, file_size)
+
+    def _parse_v019(self, offset, file_size):
+        '''
+        Parse the VDEX versions [019, 021]
+        '''
+        self.dex_section_version, self.number_of_dex_files, self.verifier_deps_size = \
+            self.reader.unpack(VDEX_V019_LAYOUT, offset)
+        checksums_offset = offset + VDEX_V019_LAYOUT.size
+
+        if self.version >= VDEX_VERSION_BOOTCLASSPATH:
+            self.bootclasspath_checksums_size, self.class_loader_context_size = \
+                self.reader.unpack(VDEX_V021_LAYOUT, checksums_offset)
+            checksums_offset += VDEX_V021_LAYOUT.size
+
+        self._read_dex_checksums(checksums_offset, file_size)
+
+        dex_section_header = checksums_offset + self.number_of_dex_files * UINTEGER_SIZE
+
+        # dex section version 000 means there is no dex section
+        if c_string(self.dex_section_version) == b'000':
+            self._walk_dex_section(dex_section_header, 0, 0, file_size)
+            return
+
+        self.dex_size, self.dex_shared_data_size, self.quickening_info_size = \
+            self.reader.unpack(VDEX_DEX_SECTION_HEADER_LAYOUT, dex_section_header)
+
+        self._walk_dex_section(dex_section_header + VDEX_DEX_SECTION_HEADER_LAYOUT.size,
+                               self.dex_size, UINTEGER_SIZE, file_size)
+
+    def _parse_v027(self, offset, file_size):
+        '''
+        Parse the VDEX versions [027]
+        '''
+        self.number_of_sections = self.reader.unpack(UINT32_LAYOUT, offset)[0]
+
+        # { kind, offset, size } records read as one array
+        section_headers = self.reader.unpack_array(UINTEGER, offset + UINTEGER_SIZE,
+                                                   self.number_of_sections * 3)
+
+        for i in range(self.number_of_sections):
+            kind, section_offset, size = section_headers[i * 3:i * 3 + 3]
+
+            if section_offset + size > file_size:
+                raise OffsetOutOfBoundException(
+                    "Error, vdex section %d (0x%08X) is out of bound of the file" % (kind, section_offset))
+
+            self.sections[kind] = (section_offset, size)
+
+        if VDEX_CHECKSUM_SECTION not in self.sections:
+            raise IncorrectMagicException("Error, vdex checksum section not found")
+
+        checksums_offset, checksums_size = self.sections[VDEX_CHECKSUM_SECTION]
+        self.number_of_dex_files = checksums_size // UINTEGER_SIZE
+
+        if VDEX_VERIFIER_DEPS_SECTION in self.sections:
+            self.verifier_deps_size = self.sections[VDEX_VERIFIER_DEPS_SECTION][1]
+
+        self._read_dex_checksums(checksums_offset, file_size)
+
+        dex_section_offset, dex_section_size = self.sections.get(VDEX_DEX_FILE_SECTION, (0, 0))
+        self.dex_size = dex_section_size
+        self._walk_dex_section(dex_section_offset, dex_section_size, 0, file_size)
+
     def parse_header(self, offset, file_size):
-        self.file_p.seek(offset, FILE_BEGIN)
-
-        for i in range(ctypes.sizeof(VDEX_MAGIC_TYPE)):
-            self.magic[i] = read_file_le(
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
-        
-        for i in range(ctypes.sizeof(VDEX_VERIFIER_DEPS_VERSION_TYPE)):
-            self.verifier_deps_version[i] = read_file_le(
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
-        
-        for i in range(ctypes.sizeof(VDEX_DEX_SECTION_VERSION_TYPE)):
-            self.dex_section_version[i] = read_file_le( 
-                self.file_p, BYTE, BYTE_SIZE, self.file_p.tell())
-        
-        self.number_of_dex_files = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        
-        self.verifier_deps_size = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-        
-        self.bootclasspath_checksums_size = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
-
-        self.class_loader_context_size = read_file_le(
-            self.file_p, UINTEGER, UINTEGER_SIZE, self.file_p.tell())
\ No newline at end of file
+        self.magic, self.verifier_deps_version = self.reader.unpack(VDEX_MAGIC_VERSION_LAYOUT, offset)
+
+        if self.magic != VDEX_MAGIC_VALUE:
+            raise IncorrectMagicException(
+                "Error, magic header doesn't match expected header %s" % (VDEX_MAGIC_VALUE))
+
+        version = c_string(self.verifier_deps_version)
+
+        if not version.isdigit():
+            raise UnsupportedOatVersion("VDEX Version analyzed (%s) not supported" % version)
+
+        self.version = int(version)
+        offset += VDEX_MAGIC_VERSION_LAYOUT.size
+
+        if self.version < VDEX_VERSION_SECTIONS:
+            self._parse_v006(offset, file_size)
+        elif self.version < VDEX_VERSION_SECTION_TABLE:
+            self._parse_v019(offset, file_size)
+        else:
+            self._parse_v027(offset, file_size)
+
+        self.header_initialized = True
+
+    def parse_dex_headers(self, file_size):
+        '''
+        Parse the DEX header of every dex file stored in the vdex.
+        '''
+        for i in range(len(self.dex_files_offsets)):
+            if self.dex_files_sizes[i] == 0:
+                self.dex_files.append(None)
+                continue
+
+            dex_file = DEXHeader(self.reader)
+            dex_file.parse_header(self.dex_files_offsets[i], file_size)
+            self.dex_files.append(dex_file)
@@ -49,6 +49,12 @@ LONG_SIZE = ctypes.sizeof(c_long())
 DOUBLE = "d"
 DOUBLE_SIZE = ctypes.sizeof(c_double())
 
+# precompiled little endian layouts of single fields
+UINT16_LAYOUT = struct.Struct('<H')
+UINT32_LAYOUT = struct.Struct('<I')
+
+READ_AHEAD_SIZE = 64 * 1024
+
 def read_file(file_p, format, size, offset, endianess = '>'):
     little_endian_format = endianess + format
     file_p.seek(offset, FILE_BEGIN)
@@ -97,3 +103,102 @@ def read_string_no_modify_offset(file_p, offset):
     file_p.seek(previous_offset, 0)
 
     return return_string
+
+
+class MemoryFile():
+    '''
+    File object over a memoryview (of a mapped file), enough for the
+    parsers reading with read_file: seek, tell and read. The bytes
+    returned by read are slices of the view, not copies, and the view
+    is not exported again so releasing it releases the mapping.
+    '''
+
+    def __init__(self, buffer):
+        self.buffer = buffer
+        self.position = 0
+
+    def seek(self, offset, whence = FILE_BEGIN):
+        if whence == FILE_CURRENT:
+            offset += self.position
+        elif whence == FILE_END:
+            offset += len(self.buffer)
+
+        if offset < 0:
+            raise ValueError("negative seek position %d" % (offset))
+
+        self.position = offset
+        return self.position
+
+    def tell(self):
+        return self.position
+
+    def read(self, size = -1):
+        if size is None or size < 0:
+            size = len(self.buffer)
+
+        data = self.buffer[self.position:self.position + size]
+        self.position += len(data)
+        return data
+
+
+def c_string(buffer):
+    '''
+    Bytes of buffer up to the first null byte (as a char *).
+    '''
+    return bytes(buffer).split(b'\x00', 1)[0]
+
+
+class RecordReader():
+    '''
+    Decode little endian records at absolute offsets of a file with
+    precompiled struct.Struct layouts, one unpack_from per record and
+    plain ints as result. Over a MemoryFile the records are unpacked
+    from its view, other files are read through a read-ahead window of
+    READ_AHEAD_SIZE bytes, so consecutive records cost one read.
+    '''
+
+    def __init__(self, file_p):
+        self.file_p = file_p
+        self.buffer = file_p.buffer if isinstance(file_p, MemoryFile) else None
+        self.window = b''
+        self.window_offset = 0
+
+    @staticmethod
+    def of(file_p):
+        '''
+        Reader of a file object, a reader is returned as it is so
+        nested parsers share the window of their parent.
+        '''
+        return file_p if isinstance(file_p, RecordReader) else RecordReader(file_p)
+
+    def read(self, offset, size):
+        if self.buffer is not None:
+            data = self.buffer[offset:offset + size]
+        else:
+            start = offset - self.window_offset
+
+            if start < 0 or start + size > len(self.window):
+                self.file_p.seek(offset, FILE_BEGIN)
+                self.window = self.file_p.read(max(size, READ_AHEAD_SIZE))
+                self.window_offset = offset
+                start = 0
+
+            data = self.window[start:start + size]
+
+        if len(data) != size:
+            raise struct.error("record at 0x%08X (%d bytes) is out of the file" % (offset, size))
+
+        return data
+
+    def read_bytes(self, offset, size):
+        return bytes(self.read(offset, size))
+
+    def unpack(self, layout, offset):
+        return layout.unpack_from(self.read(offset, layout.size))
+
+    def unpack_array(self, format, offset, count):
+        '''
+        Array of count little endian values of format (struct caches
+        the compiled layout of each count).
+        '''
+        return struct.unpack_from('<%d%s' % (count, format), self.read(offset, count * struct.calcsize(format)))
@@ -0,0 +1,786 @@
+#include "elf_parser.h"
+#include "dex_checksum.h"
+#include "vdex_parser.h"
+#include "oat_parser.h"
+#include <unistd.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdarg.h>
+
+#define DEXTRIPADOR_VERSION     "0.7"
+#define OATDATA_SYMBOL          "oatdata"
+#define MAX_DEX_NAME_SIZE       4096
+#define DEX_NAME_EXTENSION      ".dex"
+#define CDEX_NAME_EXTENSION     ".cdex"
+#define CDEX_MAGIC              "cdex"
+
+static const char *odex_extensions[] = {".odex", ".oat", NULL};
+static const char *compressed_extensions[] = {".xz", ".gz", ".zst", ".lz4", NULL};
+
+/***
+ * Dex file found in an input, stored at offset of
+ * the oat file or of the vdex file.
+ */
+typedef struct dex_entry
+{
+    char     name[MAX_DEX_NAME_SIZE];
+    int      container_fd;
+    const uint8_t *header;
+    uint64_t offset;
+    uint64_t size;
+} Dex_Entry;
+
+typedef struct input_file
+{
+    const char *path;
+
+    int      fd;
+    uint8_t  *buf_ptr;
+    size_t   file_size;
+
+    int      vdex_fd;
+    Vdex_File *vdex;
+
+    int      has_oat;
+    uint64_t oatdata_offset;
+    uint64_t oatdata_size;
+    Oat_File oat;
+
+    Dex_Entry *dex_entries;
+    size_t   number_of_dex_files;
+} Input_File;
+
+enum
+{
+    OPTION_DEXTRIPAR = 256,
+    OPTION_DEXTRIPAR_ALL,
+    OPTION_REPLACE_CHECKSUM,
+    OPTION_PRINT_HEADERS,
+    OPTION_LIST_DEXS,
+    OPTION_VERIFY,
+    OPTION_SHOW_CREDITS,
+};
+
+static int verbosity = 0;
+
+static void
+usage(const char *program)
+{
+    printf("usage: %s [-h] -i INPUT [INPUT ...] [-v VERBOSITY] [-o OUTPUT] [--dextripar N] [--dextripar-all]\n"
+           "       [--replace-checksum] [--print-headers] [--list-dexs] [--verify] [--show-credits]\n\n", program);
+    printf("'Dextripador' tool for pasing Odex files and extract dex files from them (native version).\n"
+           "Research From UC3M-COSEC & IMDEA Networks.\n\n");
+    printf("\t-i, --input: odex/oat/vdex files to analyze, the .vdex next to an odex is used automatically\n");
+    printf("\t-v, --verbosity: -1 no messages, 0 only necessary messages (by default), 1 checksums\n");
+    printf("\t-o, --output: output name for the file, by default is extracted from OAT header\n");
+    printf("\t--dextripar: extract one of the dex files given by index\n");
+    printf("\t--dextripar-all: extract all the dex from the file\n");
+    printf("\t--replace-checksum: if selected any dextripar option, replace dex checksum for calculated one\n");
+    printf("\t--print-headers: show the oat header, its dex file records and the vdex header\n");
+    printf("\t--list-dexs: list all the internal dex files\n");
+    printf("\t--verify: check the dex checksums and signatures of all the inputs without writing any output (the oat checksum is reported as unchecked)\n");
+    printf("\t--show-credits: show credits of the tool\n");
+}
+
+static void
+message(const char *format, ...)
+{
+    va_list args;
+
+    if (verbosity < 0)
+        return;
+
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+static int
+ends_with(const char *string, const char *suffix)
+{
+    size_t string_size = strlen(string);
+    size_t suffix_size = strlen(suffix);
+
+    return (string_size >= suffix_size && strcmp(string + string_size - suffix_size, suffix) == 0);
+}
+
+static int
+is_compressed(const char *path)
+{
+    size_t i;
+
+    for (i = 0; compressed_extensions[i] != NULL; i++)
+    {
+        if (ends_with(path, compressed_extensions[i]))
+            return (1);
+    }
+
+    return (0);
+}
+
+static const char *
+base_name(const char *path, size_t size)
+{
+    size_t i;
+
+    for (i = size; i > 0; i--)
+    {
+        if (path[i - 1] == '/' || path[i - 1] == '\\')
+            return (path + i);
+    }
+
+    return (path);
+}
+
+/***
+ * Look for the vdex that goes with an odex/oat file, it is
+ * stored next to it with the same name.
+ *
+ * return: 0 if found in vdex_path, -1 otherwise
+ */
+static int
+find_vdex(const char *path, char *vdex_path, size_t vdex_path_size)
+{
+    const char *extension = strrchr(path, '.');
+    size_t i;
+
+    if (extension == NULL || strchr(extension, '/') != NULL)
+        return (-1);
+
+    for (i = 0; odex_extensions[i] != NULL; i++)
+    {
+        if (strcmp(extension, odex_extensions[i]) == 0)
+            break;
+    }
+
+    if (odex_extensions[i] == NULL ||
+        (size_t)snprintf(vdex_path, vdex_path_size, "%.*s.vdex", (int)(extension - path), path) >= vdex_path_size)
+        return (-1);
+
+    return (access(vdex_path, R_OK) == 0 ? 0 : -1);
+}
+
+static int
+map_file(const char *path, int *fd, uint8_t **buf_ptr, size_t *file_size)
+{
+    ssize_t size;
+
+    if ((*fd = open_file_reading(path)) < 0)
+        return (-1);
+
+    if ((size = get_file_size(*fd)) <= 0)
+    {
+        fprintf(stderr, "map_file: %s is empty\n", path);
+        return (-1);
+    }
+
+    *file_size = (size_t)size;
+
+    if ((*buf_ptr = mmap_file_read(*file_size, *fd)) == NULL)
+        return (-1);
+
+    return (0);
+}
+
+/***
+ * Look for the oatdata symbol in the dynamic symbols
+ * (and in the symbol table if it is not there).
+ */
+static int
+find_oatdata(Input_File *input)
+{
+    const char *name;
+    size_t i;
+    int    found = 0;
+
+    if (parse_elf(input->path) < 0)
+        return (-1);
+
+    for (i = 0; i < dynamic_sym_length() && !found; i++)
+    {
+        if ((name = dynamic_st_name_s(i)) != NULL && strcmp(name, OATDATA_SYMBOL) == 0)
+        {
+            input->oatdata_offset = dynamic_st_value(i);
+            input->oatdata_size = dynamic_st_size(i);
+            found = 1;
+        }
+    }
+
+    for (i = 0; i < symtab_sym_length() && !found; i++)
+    {
+        if ((name = symtab_st_name_s(i)) != NULL && strcmp(name, OATDATA_SYMBOL) == 0)
+        {
+            input->oatdata_offset = symtab_st_value(i);
+            input->oatdata_size = symtab_st_size(i);
+            found = 1;
+        }
+    }
+
+    close_everything();
+
+    if (!found)
+    {
+        fprintf(stderr, "Error, oatdata symbol not found in ELF (maybe not odex file)\n");
+        return (-1);
+    }
+
+    if (input->oatdata_offset + input->oatdata_size > input->file_size)
+    {
+        fprintf(stderr, "Error, oatdata out of the bounds of %s\n", input->path);
+        return (-1);
+    }
+
+    return (0);
+}
+
+/***
+ * Name of a dex, same as Dextripador.py: the base name of
+ * the dex location with .apk replaced by .dex (or .dex
+ * appended), .cdex for compact dex files.
+ */
+static void
+dex_name_from_location(char *name, const uint8_t *location, uint32_t location_size, const uint8_t *header)
+{
+    const char *file_name = base_name((const char *)location, location_size);
+    size_t     file_name_size = location_size - (size_t)(file_name - (const char *)location);
+    size_t     name_size = 0;
+    size_t     i;
+    int        apk_found = 0;
+
+    for (i = 0; i < file_name_size && name_size < MAX_DEX_NAME_SIZE - sizeof(CDEX_NAME_EXTENSION); i++)
+    {
+        if (i + 4 <= file_name_size && memcmp(file_name + i, ".apk", 4) == 0)
+        {
+            memcpy(name + name_size, DEX_NAME_EXTENSION, 4);
+            name_size += 4;
+            i += 3;
+            apk_found = 1;
+            continue;
+        }
+
+        name[name_size++] = file_name[i];
+    }
+
+    name[name_size] = '\0';
+
+    if (!apk_found)
+        strcat(name, DEX_NAME_EXTENSION);
+
+    if (memcmp(header, CDEX_MAGIC, 4) == 0 && ends_with(name, DEX_NAME_EXTENSION))
+        strcpy(name + strlen(name) - strlen(DEX_NAME_EXTENSION), CDEX_NAME_EXTENSION);
+}
+
+static int
+add_dex_entry(Input_File *input, const char *name, int container_fd, const uint8_t *header,
+              uint64_t offset, uint64_t size)
+{
+    Dex_Entry *dex_entry = &input->dex_entries[input->number_of_dex_files++];
+
+    snprintf(dex_entry->name, MAX_DEX_NAME_SIZE, "%s", name);
+    dex_entry->container_fd = container_fd;
+    dex_entry->header = header;
+    dex_entry->offset = offset;
+    dex_entry->size = size;
+
+    return (0);
+}
+
+static int
+load_vdex_dex_entries(Input_File *input)
+{
+    const char *file_name = base_name(input->path, strlen(input->path));
+    const char *extension = strrchr(file_name, '.');
+    char       root[MAX_DEX_NAME_SIZE];
+    char       name[MAX_DEX_NAME_SIZE + 32];
+    uint32_t   i;
+
+    snprintf(root, sizeof(root), "%.*s", extension ? (int)(extension - file_name) : (int)strlen(file_name), file_name);
+
+    if (input->vdex->number_of_dex_files > 0 &&
+        (input->dex_entries = allocate_memory(sizeof(Dex_Entry) * input->vdex->number_of_dex_files)) == NULL)
+        return (-1);
+
+    for (i = 0; i < input->vdex->number_of_dex_files; i++)
+    {
+        if (input->vdex->dex_sizes[i] == 0)
+        {
+            if (verbosity >= 1)
+                printf("Dex %u is not stored in the vdex\n", i);
+            continue;
+        }
+
+        if (i == 0)
+            snprintf(name, sizeof(name), "%s.dex", root);
+        else
+            snprintf(name, sizeof(name), "%s!classes%u.dex", root, i + 1);
+
+        if (memcmp(input->vdex->buf_ptr + input->vdex->dex_offsets[i], CDEX_MAGIC, 4) == 0)
+            strcpy(name + strlen(name) - strlen(DEX_NAME_EXTENSION), CDEX_NAME_EXTENSION);
+
+        add_dex_entry(input, name, input->vdex_fd, input->vdex->buf_ptr + input->vdex->dex_offsets[i],
+                      input->vdex->dex_offsets[i], input->vdex->dex_sizes[i]);
+    }
+
+    return (0);
+}
+
+static int
+load_oat_dex_entries(Input_File *input)
+{
+    char     name[MAX_DEX_NAME_SIZE];
+    uint32_t i;
+
+    if (input->oat.dex_file_count > 0 &&
+        (input->dex_entries = allocate_memory(sizeof(Dex_Entry) * input->oat.dex_file_count)) == NULL)
+        return (-1);
+
+    for (i = 0; i < input->oat.dex_file_count; i++)
+    {
+        Oat_Dex_File *dex_file = &input->oat.dex_files[i];
+        const uint8_t *container = dex_file->in_vdex ? input->vdex->buf_ptr : input->buf_ptr;
+
+        if (dex_file->dex_size == 0)
+        {
+            if (verbosity >= 1)
+                printf("Dex %u is not stored in the vdex\n", i);
+            continue;
+        }
+
+        dex_name_from_location(name, dex_file->location, dex_file->location_size, container + dex_file->dex_offset);
+
+        add_dex_entry(input, name, dex_file->in_vdex ? input->vdex_fd : input->fd,
+                      container + dex_file->dex_offset, dex_file->dex_offset, dex_file->dex_size);
+    }
+
+    return (0);
+}
+
+static void
+close_input(Input_File *input)
+{
+    close_oat(&input->oat);
+
+    if (input->vdex)
+        close_vdex(input->vdex);
+
+    if (input->vdex_fd >= 0)
+        close_file(input->vdex_fd);
+
+    if (input->buf_ptr)
+        munmap_memory(input->buf_ptr, input->file_size);
+
+    if (input->fd >= 0)
+        close_file(input->fd);
+
+    if (input->dex_entries)
+        free_memory(input->dex_entries);
+
+    memset(input, 0, sizeof(Input_File));
+    input->fd = -1;
+    input->vdex_fd = -1;
+}
+
+static int
+load_input(Input_File *input, const char *path)
+{
+    char vdex_path[PATH_MAX];
+    const uint8_t *vdex_ptr = NULL;
+    size_t vdex_size = 0;
+
+    memset(input, 0, sizeof(Input_File));
+    input->path = path;
+    input->fd = -1;
+    input->vdex_fd = -1;
+
+    if (is_compressed(path))
+    {
+        fprintf(stderr, "Error, compressed input %s, decompress it or use Dextripador.py\n", path);
+        return (-1);
+    }
+
+    if (map_file(path, &input->fd, &input->buf_ptr, &input->file_size) < 0)
+        return (-1);
+
+    // vdex given alone
+    if (input->file_size >= VDEX_MAGIC_SIZE && memcmp(input->buf_ptr, VDEX_MAGIC, VDEX_MAGIC_SIZE) == 0)
+    {
+        if ((input->vdex_fd = dup(input->fd)) < 0 || (input->vdex = parse_vdex_fd(input->vdex_fd)) == NULL)
+            return (-1);
+
+        return load_vdex_dex_entries(input);
+    }
+
+    input->has_oat = 1;
+
+    if (input->file_size >= SELFMAG && memcmp(input->buf_ptr, ELFMAG, SELFMAG) == 0)
+    {
+        if (find_oatdata(input) < 0)
+            return (-1);
+    }
+    else if (input->file_size >= OAT_MAGIC_SIZE && memcmp(input->buf_ptr, OAT_MAGIC, OAT_MAGIC_SIZE) == 0)
+    {
+        input->oatdata_offset = 0;
+        input->oatdata_size = input->file_size;
+    }
+    else
+    {
+        fprintf(stderr, "Error, %s is not an odex, oat or vdex file\n", path);
+        return (-1);
+    }
+
+    if (find_vdex(path, vdex_path, sizeof(vdex_path)) == 0)
+    {
+        if (verbosity >= 1)
+            printf("Analyzing vdex file %s\n", vdex_path);
+
+        if ((input->vdex_fd = open_file_reading(vdex_path)) < 0 || (input->vdex = parse_vdex_fd(input->vdex_fd)) == NULL)
+            return (-1);
+
+        vdex_ptr = input->vdex->buf_ptr;
+        vdex_size = input->vdex->file_size;
+    }
+
+    if (parse_oat_buffer(&input->oat, input->buf_ptr, input->file_size, input->oatdata_offset, vdex_ptr, vdex_size) < 0)
+        return (-1);
+
+    return load_oat_dex_entries(input);
+}
+
+/***
+ * Checksum of the dex header, the header is a copy
+ * of the file bytes without any alignment.
+ */
+static uint32_t
+header_checksum(const Dex_Entry *dex_entry)
+{
+    uint32_t checksum;
+
+    memcpy(&checksum, dex_entry->header + DEX_CHECKSUM_OFFSET, sizeof(uint32_t));
+
+    return (checksum);
+}
+
+static int
+extract_dex(Input_File *input, size_t dex_number, const char *output_name, int fix_checksum)
+{
+    Dex_Entry *dex_entry;
+    uint8_t   signature[DEX_SIGNATURE_SIZE];
+    uint32_t  checksum;
+    int       out_fd;
+    int       ret;
+    size_t    i;
+
+    if (dex_number >= input->number_of_dex_files)
+    {
+        fprintf(stderr, "Error extracting dex: Selected Dex (%zu) doesn't exists\n", dex_number);
+        return (-1);
+    }
+
+    dex_entry = &input->dex_entries[dex_number];
+
+    if (output_name == NULL)
+        output_name = dex_entry->name;
+
+    if ((out_fd = open(output_name, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+    {
+        perror("extract_dex");
+        return (-1);
+    }
+
+    ret = dex_checksum_fd(dex_entry->container_fd, dex_entry->offset, dex_entry->size, out_fd, fix_checksum,
+                          &checksum, signature);
+
+    close_file(out_fd);
+
+    if (ret < 0)
+        return (-1);
+
+    if (verbosity >= 1)
+    {
+        printf("Calculated dex checksum: 0x%08X - Dex file checksum: 0x%08X\n",
+               checksum, header_checksum(dex_entry));
+        printf("Calculated dex signature: ");
+        for (i = 0; i < DEX_SIGNATURE_SIZE; i++)
+            printf("%02x", signature[i]);
+        printf(" - Dex file signature: ");
+        for (i = 0; i < DEX_SIGNATURE_SIZE; i++)
+            printf("%02x", dex_entry->header[DEX_SIGNATURE_OFFSET + i]);
+        printf("\n");
+    }
+
+    return (0);
+}
+
+/***
+ * One line per input as Dextripador.py --verify:
+ *      PASS|FAIL path oat=unchecked|n/a dex=good/total [bad=[...]]
+ *
+ * The oat checksum is not recalculated, ART covers the
+ * compiled code and other parts of the image with it in
+ * an order that changes between versions.
+ */
+static int
+verify_input(Input_File *input)
+{
+    uint8_t  signature[DEX_SIGNATURE_SIZE];
+    uint32_t checksum;
+    size_t   i, failed = 0;
+    int      checksum_ok, signature_ok;
+    const char *oat_state = input->has_oat ? "unchecked" : "n/a";
+    char     bad[MAX_DEX_NAME_SIZE * 2] = "";
+    size_t   bad_size = 0;
+
+    for (i = 0; i < input->number_of_dex_files; i++)
+    {
+        Dex_Entry *dex_entry = &input->dex_entries[i];
+
+        if (dex_checksum_fd(dex_entry->container_fd, dex_entry->offset, dex_entry->size, -1, 0,
+                            &checksum, signature) < 0)
+            return (-1);
+
+        checksum_ok = checksum == header_checksum(dex_entry);
+        signature_ok = memcmp(signature, dex_entry->header + DEX_SIGNATURE_OFFSET, DEX_SIGNATURE_SIZE) == 0;
+
+        if (!checksum_ok || !signature_ok)
+        {
+            if (bad_size < sizeof(bad))
+                bad_size += (size_t)snprintf(bad + bad_size, sizeof(bad) - bad_size, "%s%zu:%s(%s%s%s)",
+                                             failed ? " " : "", i, dex_entry->name,
+                                             checksum_ok ? "" : "checksum",
+                                             !checksum_ok && !signature_ok ? "," : "",
+                                             signature_ok ? "" : "signature");
+            failed++;
+        }
+    }
+
+    printf("%s %s oat=%s dex=%zu/%zu", failed == 0 ? "PASS" : "FAIL",
+           input->path, oat_state, input->number_of_dex_files - failed, input->number_of_dex_files);
+
+    if (failed)
+        printf(" bad=[%s]", bad);
+
+    printf("\n");
+
+    return (failed == 0 ? 0 : 1);
+}
+
+static void
+print_dex_entries(Input_File *input)
+{
+    size_t i, j;
+
+    printf("Printing all dex files\n\n");
+
+    for (i = 0; i < input->number_of_dex_files; i++)
+    {
+        Dex_Entry *dex_entry = &input->dex_entries[i];
+
+        printf("Dex %zu: %s\n", i, dex_entry->name);
+        printf("\tMagic: %.3s %.3s\n", dex_entry->header, dex_entry->header + 4);
+        printf("\tOffset: 0x%08llX\n", (long long unsigned int)dex_entry->offset);
+        printf("\tSize: %llu\n", (long long unsigned int)dex_entry->size);
+        printf("\tChecksum: 0x%08X\n", header_checksum(dex_entry));
+        printf("\tSignature: ");
+        for (j = 0; j < DEX_SIGNATURE_SIZE; j++)
+            printf("%02x", dex_entry->header[DEX_SIGNATURE_OFFSET + j]);
+        printf("\n");
+    }
+}
+
+static void
+print_headers(Input_File *input)
+{
+    uint32_t i, j;
+
+    if (input->has_oat)
+    {
+        Oat_File *oat = &input->oat;
+
+        printf("Printing all the oatdata headers\n");
+        printf("\nMagic: %.3s\n", OAT_MAGIC);
+        printf("Version: %.3s\n", oat->version);
+        printf("Adler32_checksum: %u(0x%08X)\n", oat->adler32_checksum, oat->adler32_checksum);
+        printf("Instruction set: %u\n", oat->instruction_set);
+        printf("Instruction set features: %u\n", oat->instruction_set_features);
+        printf("Dex file count: %u\n", oat->dex_file_count);
+        printf("Oat dex file offset: 0x%08X\n", oat->oat_dex_files_offset);
+        printf("Executable offset: 0x%08X\n", oat->executable_offset);
+        printf("key value store size: %u\n", oat->key_value_store_size);
+        printf("key value store: ");
+        for (j = 0; j < oat->key_value_store_size; j++)
+            putchar(oat->key_value_store[j] == '\0' && j != oat->key_value_store_size - 1 ? ' ' : oat->key_value_store[j]);
+        printf("\n");
+
+        for (i = 0; i < oat->dex_file_count; i++)
+        {
+            Oat_Dex_File *dex_file = &oat->dex_files[i];
+
+            printf("\nDex File Location Size: %u\n", dex_file->location_size);
+            printf("Dex File Location Data: %.*s\n", (int)dex_file->location_size, dex_file->location);
+            printf("Dex File Location Checksum: %u(0x%08X)\n", dex_file->location_checksum, dex_file->location_checksum);
+            printf("Dex File Pointer: 0x%08X%s\n", dex_file->dex_file_pointer,
+                   dex_file->in_vdex && dex_file->dex_size == 0 ? " (not stored in the vdex)" : "");
+        }
+    }
+
+    if (input->vdex)
+    {
+        printf("\nPrinting the vdex header\n");
+        printf("Version: %03u\n", input->vdex->version);
+        printf("Dex section version: %03u\n", input->vdex->dex_section_version);
+        printf("Number of dex files: %u\n", input->vdex->number_of_dex_files);
+        printf("Dex section: 0x%08llX (%llu bytes)\n", (long long unsigned int)input->vdex->dex_section_offset,
+               (long long unsigned int)input->vdex->dex_section_size);
+        printf("Verifier deps: 0x%08llX (%llu bytes)\n", (long long unsigned int)input->vdex->verifier_deps_offset,
+               (long long unsigned int)input->vdex->verifier_deps_size);
+
+        for (i = 0; i < input->vdex->number_of_dex_files; i++)
+            printf("Dex %u: checksum 0x%08X offset 0x%08llX size %llu\n", i, input->vdex->dex_checksums[i],
+                   (long long unsigned int)input->vdex->dex_offsets[i], (long long unsigned int)input->vdex->dex_sizes[i]);
+    }
+
+    printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"input",            required_argument, NULL, 'i'},
+        {"verbosity",        required_argument, NULL, 'v'},
+        {"output",           required_argument, NULL, 'o'},
+        {"help",             no_argument,       NULL, 'h'},
+        {"dextripar",        required_argument, NULL, OPTION_DEXTRIPAR},
+        {"dextripar-all",    no_argument,       NULL, OPTION_DEXTRIPAR_ALL},
+        {"replace-checksum", no_argument,       NULL, OPTION_REPLACE_CHECKSUM},
+        {"print-headers",    no_argument,       NULL, OPTION_PRINT_HEADERS},
+        {"list-dexs",        no_argument,       NULL, OPTION_LIST_DEXS},
+        {"verify",           no_argument,       NULL, OPTION_VERIFY},
+        {"show-credits",     no_argument,       NULL, OPTION_SHOW_CREDITS},
+        {NULL, 0, NULL, 0}
+    };
+    const char **inputs;
+    size_t     number_of_inputs = 0;
+    const char *output_name = NULL;
+    long       dextripar = -1;
+    int        dextripar_all = 0, replace_checksum = 0, print_all_headers = 0, list_dexs = 0, verify = 0;
+    int        exit_code = 0;
+    Input_File input;
+    size_t     i, j;
+    int        c;
+
+    if ((inputs = allocate_memory(sizeof(char *) * (size_t)argc)) == NULL)
+        exit(-1);
+
+    while ((c = getopt_long(argc, argv, "i:v:o:h", long_options, NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 'i':
+            inputs[number_of_inputs++] = optarg;
+            break;
+        case 'v':
+            verbosity = atoi(optarg);
+            break;
+        case 'o':
+            output_name = optarg;
+            break;
+        case OPTION_DEXTRIPAR:
+            dextripar = strtol(optarg, NULL, 10);
+            break;
+        case OPTION_DEXTRIPAR_ALL:
+            dextripar_all = 1;
+            break;
+        case OPTION_REPLACE_CHECKSUM:
+            replace_checksum = 1;
+            break;
+        case OPTION_PRINT_HEADERS:
+            print_all_headers = 1;
+            break;
+        case OPTION_LIST_DEXS:
+            list_dexs = 1;
+            break;
+        case OPTION_VERIFY:
+            verify = 1;
+            break;
+        case OPTION_SHOW_CREDITS:
+            printf("Dextripador %s (native)\nUC3M COSEC Lab & IMDEA Networks\nhttps://androidobservatory.com\n",
+                   DEXTRIPADOR_VERSION);
+            exit(0);
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            exit(2);
+        }
+    }
+
+    // -i a b c as in Dextripador.py
+    while (optind < argc)
+        inputs[number_of_inputs++] = argv[optind++];
+
+    if (number_of_inputs == 0)
+    {
+        usage(argv[0]);
+        fprintf(stderr, "%s: error: an input is required (-i)\n", argv[0]);
+        exit(2);
+    }
+
+    // keep the reports clean unless some verbosity was requested
+    if (verify && verbosity == 0)
+        verbosity = -1;
+
+    for (i = 0; i < number_of_inputs; i++)
+    {
+        message("Starting analysis of odex file %s\n", inputs[i]);
+
+        if (load_input(&input, inputs[i]) < 0)
+        {
+            if (verify)
+                printf("ERROR %s\n", inputs[i]);
+            close_input(&input);
+            exit_code = 1;
+            continue;
+        }
+
+        message("Analysis done correctly\n");
+
+        if (verify)
+        {
+            if (verify_input(&input) != 0)
+                exit_code = 1;
+            close_input(&input);
+            continue;
+        }
+
+        if (print_all_headers)
+            print_headers(&input);
+
+        if (list_dexs)
+            print_dex_entries(&input);
+
+        if (dextripar_all)
+        {
+            message("Extracting all the dex files\n");
+            for (j = 0; j < input.number_of_dex_files; j++)
+            {
+                if (extract_dex(&input, j, NULL, replace_checksum) < 0)
+                    exit_code = 1;
+            }
+        }
+
+        if (dextripar >= 0)
+        {
+            message("Extracting dex file %ld\n", dextripar);
+            if (extract_dex(&input, (size_t)dextripar, output_name, replace_checksum) < 0)
+                exit_code = 1;
+        }
+
+        close_input(&input);
+    }
+
+    free_memory(inputs);
+
+    return (exit_code);
+}
@@ -0,0 +1,131 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: elfparser_e/gen_oat_header_layouts.py
+#   Version: 0.7
+######################################################
+
+'''
+Generate headers/oat_header_layouts.h from the OAT header layouts
+of FileFormats/OATHeaderLayout.py: a packed struct per layout, a
+reader decoding it with one memcpy (plus the bound checks of its
+fields) and the table of layouts used by src/oat_parser.c, with
+the size of the OatDexFile fields after dex_file_pointer.
+
+    python3 gen_oat_header_layouts.py > headers/oat_header_layouts.h
+'''
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+
+from FileFormats.OATHeaderLayout import *
+
+# fields of the header kept in Oat_File (headers/oat_parser.h)
+OAT_FILE_FIELDS = [
+    'adler32_checksum',
+    'instruction_set',
+    'instruction_set_features',
+    'dex_file_count',
+    'oat_dex_files_offset',
+    'executable_offset',
+    'key_value_store_size',
+]
+
+C_TYPES = {
+    UINT32: 'uint32_t',
+    INT32: 'int32_t ',
+}
+
+
+def c_versions(versions):
+    return '{' + ', '.join(['"%s"' % version.decode() for version in versions] + ['NULL']) + '}'
+
+
+def generate_layout(layout):
+    struct_name = 'Oat_Header_%s' % layout.name.upper()
+    lines = []
+
+    lines.append('typedef struct oat_header_%s' % layout.name)
+    lines.append('{')
+    for field in layout.fields:
+        lines.append('    %s %s;' % (C_TYPES[field.type], field.name))
+    lines.append('} %s;' % struct_name)
+    lines.append('')
+    lines.append('_Static_assert(sizeof(%s) == %d, "%s does not match the header layout");' %
+                 (struct_name, layout.size, struct_name))
+    lines.append('')
+
+    lines.append('static int')
+    lines.append('read_oat_header_%s(Oat_File *oat, const uint8_t *fields)' % layout.name)
+    lines.append('{')
+    lines.append('    %s header;' % struct_name)
+    lines.append('')
+    lines.append('    memcpy(&header, fields, sizeof(%s));' % struct_name)
+    lines.append('')
+
+    for field in layout.fields:
+        if field.name in OAT_FILE_FIELDS:
+            lines.append('    oat->%s = header.%s;' % (field.name, field.name))
+
+    for field in layout.fields:
+        if field.check == CHECK_NONE:
+            continue
+
+        condition = 'header.%s > oat->file_size' % field.name
+        if field.check == CHECK_OATDATA:
+            condition += ' ||\n        oat->oatdata_offset + header.%s > oat->file_size' % field.name
+
+        lines.append('')
+        lines.append('    if (%s)' % condition)
+        lines.append('    {')
+        lines.append('        fprintf(stderr, "parse_oat: %s (0x%%08X) out of file bound\\n", header.%s);' %
+                     (field.name, field.name))
+        lines.append('        return (-1);')
+        lines.append('    }')
+
+    lines.append('')
+    lines.append('    return (0);')
+    lines.append('}')
+    lines.append('')
+
+    lines.append('static const char *oat_header_%s_versions[] = %s;' % (layout.name, c_versions(layout.versions)))
+    lines.append('static const char *oat_header_%s_vdex_versions[] = %s;' %
+                 (layout.name, c_versions(layout.vdex_versions)))
+    lines.append('')
+
+    return lines
+
+
+def generate():
+    lines = [
+        '/***',
+        ' * Generated by gen_oat_header_layouts.py from',
+        ' * FileFormats/OATHeaderLayout.py, do not edit.',
+        ' *',
+        ' * Included only by src/oat_parser.c.',
+        ' */',
+        '#ifndef OAT_HEADER_LAYOUTS_H',
+        '#define OAT_HEADER_LAYOUTS_H',
+        '',
+    ]
+
+    for layout in OAT_HEADER_LAYOUTS:
+        lines += generate_layout(layout)
+
+    lines.append('static const Oat_Header_Layout oat_header_layouts[] = {')
+    for layout in OAT_HEADER_LAYOUTS:
+        lines.append('    {oat_header_%s_versions, oat_header_%s_vdex_versions, sizeof(Oat_Header_%s), %d, read_oat_header_%s},' %
+                     (layout.name, layout.name, layout.name.upper(), layout.dex_file_fields_size, layout.name))
+    lines.append('};')
+    lines.append('')
+    lines.append('#endif')
+
+    return '\n'.join(lines) + '\n'
+
+
+if __name__ == '__main__':
+    sys.stdout.write(generate())
@@ -0,0 +1,64 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifndef CARVE_H
+#define CARVE_H
+
+/***
+ * Kinds of the magics looked for, all of them are
+ * checked in CARVE_MAGIC_SIZE bytes:
+ *
+ *  oat\n + 3 digits + \0
+ *  vdex + 3 digits + \0
+ *  dex\n + 0 + 2 digits + \0
+ *  \x7fELF + class (1 or 2) + little endian + version 1
+ */
+#define CARVE_OAT                   1
+#define CARVE_VDEX                  2
+#define CARVE_DEX                   3
+#define CARVE_ELF                   4
+
+#define CARVE_MAGIC_SIZE            8
+
+/***
+ * Inputs are mapped and scanned by windows of this
+ * size (overlapped by CARVE_MAGIC_SIZE - 1 bytes).
+ */
+#define CARVE_WINDOW_SIZE           (256 * 1024 * 1024)
+
+/***
+ * Magic found, version is the number of the oat, vdex
+ * and dex versions and the ELF class (32 or 64) for ELF.
+ */
+typedef struct carve_match
+{
+    uint64_t offset;
+    uint32_t kind;
+    uint32_t version;
+} Carve_Match;
+
+/***
+ * Look for the magics starting in data[0, size), bytes
+ * up to data[available] can be read to check them.
+ * Offsets of the matches are given from base.
+ *
+ * Stops when max_matches are found, *scanned is the
+ * number of bytes checked.
+ *
+ * Return the number of matches.
+ */
+uint32_t carve_scan(const uint8_t *data, size_t size, size_t available, uint64_t base,
+                    Carve_Match *matches, uint32_t max_matches, size_t *scanned);
+
+/***
+ * Same over [offset, offset + size) of fd, mapped by
+ * windows with sequential access advice. *next is the
+ * offset to resume the scan (offset + size once done).
+ *
+ * Return the number of matches or -1.
+ */
+int64_t carve_scan_fd(int fd, uint64_t offset, uint64_t size, uint64_t window_size,
+                      Carve_Match *matches, uint32_t max_matches, uint64_t *next);
+
+#endif
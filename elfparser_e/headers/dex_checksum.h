@@ -0,0 +1,57 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "memory_management.h"
+#include "file_management.h"
+
+#ifndef DEX_CHECKSUM_H
+#define DEX_CHECKSUM_H
+
+#define DEX_CHECKSUM_OFFSET     8
+#define DEX_SIGNATURE_OFFSET    12
+#define DEX_SIGNATURE_SIZE      20
+#define DEX_HASHED_OFFSET       32
+
+/***
+ * Size of the block hashed and written at once, small
+ * enough to stay in cache between the hashing and the
+ * write of the same bytes.
+ */
+#define DEX_COPY_BLOCK_SIZE     (64 * 1024)
+
+typedef struct sha1_ctx
+{
+    uint32_t state[5];
+    uint64_t length;
+    uint8_t  block[64];
+    size_t   block_used;
+} Sha1_Ctx;
+
+/***
+ * Adler-32, vectorized when the CPU supports it
+ */
+uint32_t adler32_update(uint32_t adler, const uint8_t *buf, size_t len);
+uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t len2);
+
+/***
+ * SHA-1
+ */
+void sha1_init(Sha1_Ctx *ctx);
+void sha1_update(Sha1_Ctx *ctx, const uint8_t *buf, size_t len);
+void sha1_final(Sha1_Ctx *ctx, uint8_t digest[DEX_SIGNATURE_SIZE]);
+
+/***
+ * Dex checksums, both functions hash the body of the
+ * dex once: the SHA-1 signature covers bytes 32..end and
+ * the Adler-32 checksum covers bytes 12..end.
+ *
+ * With fix_checksum the header written (or patched) gets
+ * the calculated signature, and the returned checksum is
+ * calculated over that new signature.
+ */
+int dex_checksum_buffer(uint8_t *dex, size_t size, int fix_checksum,
+                        uint32_t *checksum, uint8_t signature[DEX_SIGNATURE_SIZE]);
+int dex_checksum_fd(int in_fd, uint64_t offset, uint64_t size, int out_fd, int fix_checksum,
+                    uint32_t *checksum, uint8_t signature[DEX_SIGNATURE_SIZE]);
+
+#endif
@@ -0,0 +1,220 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifndef DEX_INDEX_H
+#define DEX_INDEX_H
+
+#define DEX_FILE_MAGIC          "dex\n"
+#define DEX_FILE_MAGIC_SIZE     4
+#define DEX_HEADER_SIZE         0x70
+#define DEX_ENDIAN_CONSTANT     0x12345678
+
+/***
+ * map_list item types
+ */
+#define DEX_TYPE_HEADER_ITEM                0x0000
+#define DEX_TYPE_STRING_ID_ITEM             0x0001
+#define DEX_TYPE_TYPE_ID_ITEM               0x0002
+#define DEX_TYPE_PROTO_ID_ITEM              0x0003
+#define DEX_TYPE_FIELD_ID_ITEM              0x0004
+#define DEX_TYPE_METHOD_ID_ITEM             0x0005
+#define DEX_TYPE_CLASS_DEF_ITEM             0x0006
+#define DEX_TYPE_CALL_SITE_ID_ITEM          0x0007
+#define DEX_TYPE_METHOD_HANDLE_ITEM         0x0008
+#define DEX_TYPE_MAP_LIST                   0x1000
+#define DEX_TYPE_TYPE_LIST                  0x1001
+#define DEX_TYPE_ANNOTATION_SET_REF_LIST    0x1002
+#define DEX_TYPE_ANNOTATION_SET_ITEM        0x1003
+#define DEX_TYPE_CLASS_DATA_ITEM            0x2000
+#define DEX_TYPE_CODE_ITEM                  0x2001
+#define DEX_TYPE_STRING_DATA_ITEM           0x2002
+#define DEX_TYPE_DEBUG_INFO_ITEM            0x2003
+#define DEX_TYPE_ANNOTATION_ITEM            0x2004
+#define DEX_TYPE_ENCODED_ARRAY_ITEM         0x2005
+#define DEX_TYPE_ANNOTATIONS_DIRECTORY_ITEM 0x2006
+#define DEX_TYPE_HIDDENAPI_CLASS_DATA_ITEM  0xF000
+
+/***
+ * Tables of the index, the ID tables in header order
+ * and the items of map_list.
+ */
+#define DEX_TABLE_STRING_IDS    0
+#define DEX_TABLE_TYPE_IDS      1
+#define DEX_TABLE_PROTO_IDS     2
+#define DEX_TABLE_FIELD_IDS     3
+#define DEX_TABLE_METHOD_IDS    4
+#define DEX_TABLE_CLASS_DEFS    5
+#define DEX_TABLE_MAP_LIST      6
+#define DEX_NUMBER_OF_TABLES    7
+
+#define DEX_NO_INDEX            0xFFFFFFFF
+
+// continuation bits of eight uleb128 bytes
+#define ULEB128_STOP_BITS       0x8080808080808080ULL
+
+/***
+ * String dump formats: UTF-8 lines ('\n' and '\\' escaped)
+ * or UTF-8 strings prefixed by their uint32 byte length.
+ */
+#define DEX_STRINGS_LINES       0
+#define DEX_STRINGS_BINARY      1
+
+#define DEX_STRINGS_BLOCK_SIZE  (64 * 1024)
+
+typedef struct dex_header
+{
+    uint8_t  magic[8];
+    uint32_t checksum;
+    uint8_t  signature[20];
+    uint32_t file_size;
+    uint32_t header_size;
+    uint32_t endian_tag;
+    uint32_t link_size;
+    uint32_t link_off;
+    uint32_t map_off;
+    uint32_t string_ids_size;
+    uint32_t string_ids_off;
+    uint32_t type_ids_size;
+    uint32_t type_ids_off;
+    uint32_t proto_ids_size;
+    uint32_t proto_ids_off;
+    uint32_t field_ids_size;
+    uint32_t field_ids_off;
+    uint32_t method_ids_size;
+    uint32_t method_ids_off;
+    uint32_t class_defs_size;
+    uint32_t class_defs_off;
+    uint32_t data_size;
+    uint32_t data_off;
+} Dex_Header;
+
+_Static_assert(sizeof(Dex_Header) == DEX_HEADER_SIZE, "Dex_Header does not match the dex header");
+
+typedef struct dex_map_item
+{
+    uint16_t type;
+    uint16_t unused;
+    uint32_t size;
+    uint32_t offset;
+} Dex_Map_Item;
+
+typedef struct dex_string_id
+{
+    uint32_t string_data_off;
+} Dex_String_Id;
+
+typedef struct dex_type_id
+{
+    uint32_t descriptor_idx;
+} Dex_Type_Id;
+
+typedef struct dex_proto_id
+{
+    uint32_t shorty_idx;
+    uint32_t return_type_idx;
+    uint32_t parameters_off;
+} Dex_Proto_Id;
+
+typedef struct dex_field_id
+{
+    uint16_t class_idx;
+    uint16_t type_idx;
+    uint32_t name_idx;
+} Dex_Field_Id;
+
+typedef struct dex_method_id
+{
+    uint16_t class_idx;
+    uint16_t proto_idx;
+    uint32_t name_idx;
+} Dex_Method_Id;
+
+typedef struct dex_class_def
+{
+    uint32_t class_idx;
+    uint32_t access_flags;
+    uint32_t superclass_idx;
+    uint32_t interfaces_off;
+    uint32_t source_file_idx;
+    uint32_t annotations_off;
+    uint32_t class_data_off;
+    uint32_t static_values_off;
+} Dex_Class_Def;
+
+typedef struct dex_table
+{
+    uint32_t offset;
+    uint32_t count;
+    uint32_t entry_size;
+} Dex_Table;
+
+/***
+ * Index of a dex in memory (a dex inside a mapped oat or
+ * vdex file), nothing is copied or allocated: the index
+ * keeps the bounds of every table and entries are read
+ * from buf_ptr when they are asked for.
+ */
+typedef struct dex_index
+{
+    const uint8_t *buf_ptr;
+    size_t        size;
+    Dex_Header    header;
+    Dex_Table     tables[DEX_NUMBER_OF_TABLES];
+} Dex_Index;
+
+/***
+ * Index building, checks the header, the bounds of the
+ * ID tables and map_list, and that the map_list items
+ * of the ID tables agree with the header.
+ */
+int parse_dex_index(Dex_Index *index, const uint8_t *buf_ptr, size_t size);
+
+/***
+ * Entries of the tables, NULL (or -1) when the index
+ * is out of range.
+ */
+const uint8_t *dex_table_entry(const Dex_Index *index, int table, uint32_t entry);
+int dex_read_entry(const Dex_Index *index, int table, uint32_t entry, void *value);
+
+/***
+ * MUTF-8 data of a string_data_item (without the final
+ * NUL), utf16_size is the length in UTF-16 code units.
+ */
+const uint8_t *dex_string_data(const Dex_Index *index, uint32_t string_idx, uint32_t *utf16_size, size_t *length);
+const uint8_t *dex_type_descriptor(const Dex_Index *index, uint32_t type_idx, size_t *length);
+
+/***
+ * Decode the class_data_item of every class def into
+ * packed arrays given by the caller: method_idx, the
+ * access_flags and code_off of the direct and virtual
+ * methods, in class_data order (the order of the methods
+ * of OAT classes). class_methods (class_defs_size + 1
+ * entries) has the first method of each class, the last
+ * entry is the number of methods.
+ *
+ * A method is defined by one class only, so capacity
+ * can be method_ids_size.
+ */
+int dex_decode_class_data(const Dex_Index *index, uint32_t *class_methods, uint32_t *method_idx,
+                          uint32_t *access_flags, uint32_t *code_off, uint32_t capacity, uint32_t *number_of_methods);
+
+/***
+ * MUTF-8 to UTF-8 (dex_strings.c), out must have three
+ * times length bytes. The two byte NUL and the surrogate
+ * pairs are converted, lone surrogates and incorrect bytes
+ * become U+FFFD. plain_length is the length of the prefix
+ * copied as it is (ASCII without the escaped characters),
+ * checked 16 or 32 bytes at a time when the CPU can.
+ */
+size_t mutf8_plain_length(const uint8_t *data, size_t length, int escape);
+size_t mutf8_to_utf8(const uint8_t *data, size_t length, uint8_t *out, int escape);
+
+/***
+ * Write every string of string_ids, in order, to fd in
+ * one of the DEX_STRINGS_* formats.
+ */
+int dex_dump_strings(const Dex_Index *index, int fd, int format, uint32_t *number_of_strings);
+
+#endif
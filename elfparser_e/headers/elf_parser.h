@@ -146,6 +146,16 @@ int64_t     rela_r_addend(size_t header, size_t index);
 size_t      rela_32_size();
 size_t      rela_64_size();
 
+/***
+ * Mapped data
+ * Pointer and size of a file range, the
+ * bytes of a section or of a segment (NULL
+ * if out of file bound).
+ */
+const uint8_t *file_range(uint64_t offset, uint64_t size);
+const uint8_t *section_data(size_t header, uint64_t *size);
+const uint8_t *segment_data(size_t header, uint64_t *size);
+
 void close_everything();
 
 #endif
\ No newline at end of file
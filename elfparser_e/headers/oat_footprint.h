@@ -0,0 +1,86 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifndef OAT_FOOTPRINT_H
+#define OAT_FOOTPRINT_H
+
+/***
+ * OatQuickMethodHeader, see OAT_METHOD_HEADER_LAYOUTS
+ * in FileFormats/OATHeaderLayout.py
+ */
+#define METHOD_HEADER_SHOULD_DEOPTIMIZE     0x80000000
+#define METHOD_HEADER_CODE_SIZE_MASK        0x7FFFFFFF
+#define METHOD_HEADER_IS_CODE_INFO          0x40000000
+#define METHOD_HEADER_DATA_MASK             0x3FFFFFFF
+#define METHOD_HEADER_MAX_FIELDS            8
+
+/***
+ * CodeInfo header (since 195): interleaved varints, first
+ * 4 bits per field, then the fields bigger than
+ * CODE_INFO_VARINT_MAX with (value - max) bytes.
+ */
+#define CODE_INFO_HEADER_FIELDS             7
+#define CODE_INFO_CODE_SIZE                 1
+#define CODE_INFO_PACKED_FRAME_SIZE         2
+#define CODE_INFO_CORE_SPILL_MASK           3
+#define CODE_INFO_FP_SPILL_MASK             4
+#define CODE_INFO_VARINT_BITS               4
+#define CODE_INFO_VARINT_MAX                11
+#define CODE_INFO_STACK_ALIGNMENT           16
+
+/***
+ * Flags of each method
+ */
+#define FOOTPRINT_SHOULD_DEOPTIMIZE         0x1
+#define FOOTPRINT_CODE_INFO                 0x2     // sizes read from the CodeInfo
+#define FOOTPRINT_OUT_OF_BOUND              0x4     // header, CodeInfo or code out of the oat file
+
+/***
+ * Fields of the layout of an OAT version, indexes of
+ * its uint32 fields (-1 when missing), code_info for
+ * the single data field of the versions since 195.
+ */
+typedef struct oat_method_header_layout
+{
+    uint32_t size;
+    int32_t  code_size_field;
+    int32_t  metadata_field;
+    int32_t  frame_size_field;
+    int32_t  code_info;
+} Oat_Method_Header_Layout;
+
+/***
+ * Columns written for each method, all of them with
+ * room for the number of code offsets. metadata_offset
+ * is vmap_table_offset (or the CodeInfo offset) back from
+ * the code, frame fields are 0 when unknown.
+ */
+typedef struct oat_footprint_columns
+{
+    uint32_t *code_size;
+    uint32_t *frame_size;
+    uint32_t *core_spill_mask;
+    uint32_t *fp_spill_mask;
+    uint32_t *metadata_offset;
+    uint32_t *flags;
+} Oat_Footprint_Columns;
+
+/***
+ * Read the OatQuickMethodHeader of each code offset (from
+ * oatdata, size is the bytes from oatdata to the end of
+ * the file), only the bytes of the headers are touched.
+ *
+ * Return the number of methods out of bound or -1.
+ */
+int oat_method_headers(const uint8_t *oatdata, size_t size, const Oat_Method_Header_Layout *layout,
+                       const uint32_t *code_offsets, uint32_t count, Oat_Footprint_Columns *columns);
+
+/***
+ * Same over a read-only mapping of fd with random access
+ * advice, so only the pages of the headers are read.
+ */
+int oat_method_headers_fd(int fd, uint64_t oatdata_offset, uint64_t size, const Oat_Method_Header_Layout *layout,
+                          const uint32_t *code_offsets, uint32_t count, Oat_Footprint_Columns *columns);
+
+#endif
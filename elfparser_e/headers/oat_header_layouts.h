@@ -0,0 +1,448 @@
+/***
+ * Generated by gen_oat_header_layouts.py from
+ * FileFormats/OATHeaderLayout.py, do not edit.
+ *
+ * Included only by src/oat_parser.c.
+ */
+#ifndef OAT_HEADER_LAYOUTS_H
+#define OAT_HEADER_LAYOUTS_H
+
+typedef struct oat_header_v1
+{
+    uint32_t adler32_checksum;
+    uint32_t instruction_set;
+    uint32_t instruction_set_features;
+    uint32_t dex_file_count;
+    uint32_t executable_offset;
+    uint32_t interpreter_to_interpreter_bridge_offset;
+    uint32_t interpreter_to_compiled_code_bridge_offset;
+    uint32_t jni_dlsym_lookup_offset_;
+    uint32_t portable_imt_conflict_trampoline_offset;
+    uint32_t portable_resolution_trampoline_offset;
+    uint32_t portable_to_interpreter_bridge_offset;
+    uint32_t quick_generic_jni_trampoline_offset;
+    uint32_t quick_imt_conflict_trampoline_offset;
+    uint32_t quick_resolution_trampoline_offset;
+    uint32_t quick_to_interpreter_bridge_offset;
+    int32_t  image_patch_delta;
+    uint32_t image_file_location_oat_checksum;
+    uint32_t image_file_location_oat_data_begin;
+    uint32_t key_value_store_size;
+} Oat_Header_V1;
+
+_Static_assert(sizeof(Oat_Header_V1) == 76, "Oat_Header_V1 does not match the header layout");
+
+static int
+read_oat_header_v1(Oat_File *oat, const uint8_t *fields)
+{
+    Oat_Header_V1 header;
+
+    memcpy(&header, fields, sizeof(Oat_Header_V1));
+
+    oat->adler32_checksum = header.adler32_checksum;
+    oat->instruction_set = header.instruction_set;
+    oat->instruction_set_features = header.instruction_set_features;
+    oat->dex_file_count = header.dex_file_count;
+    oat->executable_offset = header.executable_offset;
+    oat->key_value_store_size = header.key_value_store_size;
+
+    if (header.executable_offset > oat->file_size ||
+        oat->oatdata_offset + header.executable_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: executable_offset (0x%08X) out of file bound\n", header.executable_offset);
+        return (-1);
+    }
+
+    return (0);
+}
+
+static const char *oat_header_v1_versions[] = {"039", "045", NULL};
+static const char *oat_header_v1_vdex_versions[] = {NULL};
+
+typedef struct oat_header_v2
+{
+    uint32_t adler32_checksum;
+    uint32_t instruction_set;
+    uint32_t instruction_set_features;
+    uint32_t dex_file_count;
+    uint32_t executable_offset;
+    uint32_t interpreter_to_interpreter_bridge_offset;
+    uint32_t interpreter_to_compiled_code_bridge_offset;
+    uint32_t jni_dlsym_lookup_offset_;
+    uint32_t portable_imt_conflict_trampoline_offset;
+    uint32_t portable_resolution_trampoline_offset;
+    uint32_t portable_to_interpreter_bridge_offset;
+    uint32_t quick_generic_jni_trampoline_offset;
+    uint32_t quick_imt_conflict_trampoline_offset;
+    uint32_t quick_resolution_trampoline_offset;
+    uint32_t quick_to_interpreter_bridge_offset;
+    uint32_t key_value_store_size;
+} Oat_Header_V2;
+
+_Static_assert(sizeof(Oat_Header_V2) == 64, "Oat_Header_V2 does not match the header layout");
+
+static int
+read_oat_header_v2(Oat_File *oat, const uint8_t *fields)
+{
+    Oat_Header_V2 header;
+
+    memcpy(&header, fields, sizeof(Oat_Header_V2));
+
+    oat->adler32_checksum = header.adler32_checksum;
+    oat->instruction_set = header.instruction_set;
+    oat->instruction_set_features = header.instruction_set_features;
+    oat->dex_file_count = header.dex_file_count;
+    oat->executable_offset = header.executable_offset;
+    oat->key_value_store_size = header.key_value_store_size;
+
+    if (header.executable_offset > oat->file_size ||
+        oat->oatdata_offset + header.executable_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: executable_offset (0x%08X) out of file bound\n", header.executable_offset);
+        return (-1);
+    }
+
+    return (0);
+}
+
+static const char *oat_header_v2_versions[] = {"062", "063", "064", "075", "077", NULL};
+static const char *oat_header_v2_vdex_versions[] = {NULL};
+
+typedef struct oat_header_v3
+{
+    uint32_t adler32_checksum;
+    uint32_t instruction_set;
+    uint32_t instruction_set_features;
+    uint32_t dex_file_count;
+    uint32_t executable_offset;
+    uint32_t interpreter_to_interpreter_bridge_offset;
+    uint32_t interpreter_to_compiled_code_bridge_offset;
+    uint32_t jni_dlsym_lookup_offset_;
+    uint32_t portable_imt_conflict_trampoline_offset;
+    uint32_t portable_resolution_trampoline_offset;
+    uint32_t portable_to_interpreter_bridge_offset;
+    uint32_t quick_generic_jni_trampoline_offset;
+    uint32_t quick_imt_conflict_trampoline_offset;
+    uint32_t image_file_location_oat_checksum;
+    uint32_t image_file_location_oat_data_begin;
+    uint32_t key_value_store_size;
+} Oat_Header_V3;
+
+_Static_assert(sizeof(Oat_Header_V3) == 64, "Oat_Header_V3 does not match the header layout");
+
+static int
+read_oat_header_v3(Oat_File *oat, const uint8_t *fields)
+{
+    Oat_Header_V3 header;
+
+    memcpy(&header, fields, sizeof(Oat_Header_V3));
+
+    oat->adler32_checksum = header.adler32_checksum;
+    oat->instruction_set = header.instruction_set;
+    oat->instruction_set_features = header.instruction_set_features;
+    oat->dex_file_count = header.dex_file_count;
+    oat->executable_offset = header.executable_offset;
+    oat->key_value_store_size = header.key_value_store_size;
+
+    if (header.executable_offset > oat->file_size ||
+        oat->oatdata_offset + header.executable_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: executable_offset (0x%08X) out of file bound\n", header.executable_offset);
+        return (-1);
+    }
+
+    return (0);
+}
+
+static const char *oat_header_v3_versions[] = {"079", "088", "114", "124", NULL};
+static const char *oat_header_v3_vdex_versions[] = {"124", NULL};
+
+typedef struct oat_header_v4
+{
+    uint32_t adler32_checksum;
+    uint32_t instruction_set;
+    uint32_t instruction_set_features;
+    uint32_t dex_file_count;
+    uint32_t oat_dex_files_offset;
+    uint32_t executable_offset;
+    uint32_t interpreter_to_interpreter_bridge_offset;
+    uint32_t interpreter_to_compiled_code_bridge_offset;
+    uint32_t jni_dlsym_lookup_offset_;
+    uint32_t quick_generic_jni_trampoline_offset;
+    uint32_t quick_imt_conflict_trampoline_offset;
+    uint32_t quick_resolution_trampoline_offset;
+    uint32_t quick_to_interpreter_bridge_offset;
+    int32_t  image_patch_delta;
+    uint32_t image_file_location_oat_checksum;
+    uint32_t image_file_location_oat_data_begin;
+    uint32_t key_value_store_size;
+} Oat_Header_V4;
+
+_Static_assert(sizeof(Oat_Header_V4) == 68, "Oat_Header_V4 does not match the header layout");
+
+static int
+read_oat_header_v4(Oat_File *oat, const uint8_t *fields)
+{
+    Oat_Header_V4 header;
+
+    memcpy(&header, fields, sizeof(Oat_Header_V4));
+
+    oat->adler32_checksum = header.adler32_checksum;
+    oat->instruction_set = header.instruction_set;
+    oat->instruction_set_features = header.instruction_set_features;
+    oat->dex_file_count = header.dex_file_count;
+    oat->oat_dex_files_offset = header.oat_dex_files_offset;
+    oat->executable_offset = header.executable_offset;
+    oat->key_value_store_size = header.key_value_store_size;
+
+    if (header.oat_dex_files_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: oat_dex_files_offset (0x%08X) out of file bound\n", header.oat_dex_files_offset);
+        return (-1);
+    }
+
+    if (header.executable_offset > oat->file_size ||
+        oat->oatdata_offset + header.executable_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: executable_offset (0x%08X) out of file bound\n", header.executable_offset);
+        return (-1);
+    }
+
+    return (0);
+}
+
+static const char *oat_header_v4_versions[] = {"131", NULL};
+static const char *oat_header_v4_vdex_versions[] = {"131", NULL};
+
+typedef struct oat_header_v5
+{
+    uint32_t adler32_checksum;
+    uint32_t instruction_set;
+    uint32_t instruction_set_features;
+    uint32_t dex_file_count;
+    uint32_t oat_dex_files_offset;
+    uint32_t executable_offset;
+    uint32_t jni_dlsym_lookup_offset_;
+    uint32_t quick_generic_jni_trampoline_offset;
+    uint32_t quick_imt_conflict_trampoline_offset;
+    uint32_t quick_resolution_trampoline_offset;
+    uint32_t quick_to_interpreter_bridge_offset;
+    uint32_t key_value_store_size;
+} Oat_Header_V5;
+
+_Static_assert(sizeof(Oat_Header_V5) == 48, "Oat_Header_V5 does not match the header layout");
+
+static int
+read_oat_header_v5(Oat_File *oat, const uint8_t *fields)
+{
+    Oat_Header_V5 header;
+
+    memcpy(&header, fields, sizeof(Oat_Header_V5));
+
+    oat->adler32_checksum = header.adler32_checksum;
+    oat->instruction_set = header.instruction_set;
+    oat->instruction_set_features = header.instruction_set_features;
+    oat->dex_file_count = header.dex_file_count;
+    oat->oat_dex_files_offset = header.oat_dex_files_offset;
+    oat->executable_offset = header.executable_offset;
+    oat->key_value_store_size = header.key_value_store_size;
+
+    if (header.oat_dex_files_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: oat_dex_files_offset (0x%08X) out of file bound\n", header.oat_dex_files_offset);
+        return (-1);
+    }
+
+    if (header.executable_offset > oat->file_size ||
+        oat->oatdata_offset + header.executable_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: executable_offset (0x%08X) out of file bound\n", header.executable_offset);
+        return (-1);
+    }
+
+    return (0);
+}
+
+static const char *oat_header_v5_versions[] = {"170", NULL};
+static const char *oat_header_v5_vdex_versions[] = {"170", NULL};
+
+typedef struct oat_header_v6
+{
+    uint32_t adler32_checksum;
+    uint32_t instruction_set;
+    uint32_t instruction_set_features;
+    uint32_t dex_file_count;
+    uint32_t oat_dex_files_offset;
+    uint32_t executable_offset;
+    uint32_t jni_dlsym_lookup_offset_;
+    uint32_t jni_dlsym_lookup_critical_trampoline_offset;
+    uint32_t quick_generic_jni_trampoline_offset;
+    uint32_t quick_imt_conflict_trampoline_offset;
+    uint32_t quick_resolution_trampoline_offset;
+    uint32_t quick_to_interpreter_bridge_offset;
+    uint32_t key_value_store_size;
+} Oat_Header_V6;
+
+_Static_assert(sizeof(Oat_Header_V6) == 52, "Oat_Header_V6 does not match the header layout");
+
+static int
+read_oat_header_v6(Oat_File *oat, const uint8_t *fields)
+{
+    Oat_Header_V6 header;
+
+    memcpy(&header, fields, sizeof(Oat_Header_V6));
+
+    oat->adler32_checksum = header.adler32_checksum;
+    oat->instruction_set = header.instruction_set;
+    oat->instruction_set_features = header.instruction_set_features;
+    oat->dex_file_count = header.dex_file_count;
+    oat->oat_dex_files_offset = header.oat_dex_files_offset;
+    oat->executable_offset = header.executable_offset;
+    oat->key_value_store_size = header.key_value_store_size;
+
+    if (header.oat_dex_files_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: oat_dex_files_offset (0x%08X) out of file bound\n", header.oat_dex_files_offset);
+        return (-1);
+    }
+
+    if (header.executable_offset > oat->file_size ||
+        oat->oatdata_offset + header.executable_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: executable_offset (0x%08X) out of file bound\n", header.executable_offset);
+        return (-1);
+    }
+
+    return (0);
+}
+
+static const char *oat_header_v6_versions[] = {"183", NULL};
+static const char *oat_header_v6_vdex_versions[] = {"183", NULL};
+
+typedef struct oat_header_v7
+{
+    uint32_t adler32_checksum;
+    uint32_t instruction_set;
+    uint32_t instruction_set_features;
+    uint32_t dex_file_count;
+    uint32_t oat_dex_files_offset;
+    uint32_t executable_offset;
+    uint32_t jni_dlsym_lookup_offset_;
+    uint32_t jni_dlsym_lookup_critical_trampoline_offset;
+    uint32_t quick_generic_jni_trampoline_offset;
+    uint32_t quick_imt_conflict_trampoline_offset;
+    uint32_t quick_resolution_trampoline_offset;
+    uint32_t quick_to_interpreter_bridge_offset;
+    uint32_t nterp_trampoline_offset;
+    uint32_t key_value_store_size;
+} Oat_Header_V7;
+
+_Static_assert(sizeof(Oat_Header_V7) == 56, "Oat_Header_V7 does not match the header layout");
+
+static int
+read_oat_header_v7(Oat_File *oat, const uint8_t *fields)
+{
+    Oat_Header_V7 header;
+
+    memcpy(&header, fields, sizeof(Oat_Header_V7));
+
+    oat->adler32_checksum = header.adler32_checksum;
+    oat->instruction_set = header.instruction_set;
+    oat->instruction_set_features = header.instruction_set_features;
+    oat->dex_file_count = header.dex_file_count;
+    oat->oat_dex_files_offset = header.oat_dex_files_offset;
+    oat->executable_offset = header.executable_offset;
+    oat->key_value_store_size = header.key_value_store_size;
+
+    if (header.oat_dex_files_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: oat_dex_files_offset (0x%08X) out of file bound\n", header.oat_dex_files_offset);
+        return (-1);
+    }
+
+    if (header.executable_offset > oat->file_size ||
+        oat->oatdata_offset + header.executable_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: executable_offset (0x%08X) out of file bound\n", header.executable_offset);
+        return (-1);
+    }
+
+    return (0);
+}
+
+static const char *oat_header_v7_versions[] = {"195", "199", NULL};
+static const char *oat_header_v7_vdex_versions[] = {"195", "199", NULL};
+
+typedef struct oat_header_v8
+{
+    uint32_t adler32_checksum;
+    uint32_t instruction_set;
+    uint32_t instruction_set_features;
+    uint32_t dex_file_count;
+    uint32_t oat_dex_files_offset;
+    uint32_t bcp_bss_info_offset;
+    uint32_t executable_offset;
+    uint32_t jni_dlsym_lookup_offset_;
+    uint32_t jni_dlsym_lookup_critical_trampoline_offset;
+    uint32_t quick_generic_jni_trampoline_offset;
+    uint32_t quick_imt_conflict_trampoline_offset;
+    uint32_t quick_resolution_trampoline_offset;
+    uint32_t quick_to_interpreter_bridge_offset;
+    uint32_t nterp_trampoline_offset;
+    uint32_t key_value_store_size;
+} Oat_Header_V8;
+
+_Static_assert(sizeof(Oat_Header_V8) == 60, "Oat_Header_V8 does not match the header layout");
+
+static int
+read_oat_header_v8(Oat_File *oat, const uint8_t *fields)
+{
+    Oat_Header_V8 header;
+
+    memcpy(&header, fields, sizeof(Oat_Header_V8));
+
+    oat->adler32_checksum = header.adler32_checksum;
+    oat->instruction_set = header.instruction_set;
+    oat->instruction_set_features = header.instruction_set_features;
+    oat->dex_file_count = header.dex_file_count;
+    oat->oat_dex_files_offset = header.oat_dex_files_offset;
+    oat->executable_offset = header.executable_offset;
+    oat->key_value_store_size = header.key_value_store_size;
+
+    if (header.oat_dex_files_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: oat_dex_files_offset (0x%08X) out of file bound\n", header.oat_dex_files_offset);
+        return (-1);
+    }
+
+    if (header.bcp_bss_info_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: bcp_bss_info_offset (0x%08X) out of file bound\n", header.bcp_bss_info_offset);
+        return (-1);
+    }
+
+    if (header.executable_offset > oat->file_size ||
+        oat->oatdata_offset + header.executable_offset > oat->file_size)
+    {
+        fprintf(stderr, "parse_oat: executable_offset (0x%08X) out of file bound\n", header.executable_offset);
+        return (-1);
+    }
+
+    return (0);
+}
+
+static const char *oat_header_v8_versions[] = {"225", "230", NULL};
+static const char *oat_header_v8_vdex_versions[] = {"225", "230", NULL};
+
+static const Oat_Header_Layout oat_header_layouts[] = {
+    {oat_header_v1_versions, oat_header_v1_vdex_versions, sizeof(Oat_Header_V1), 8, read_oat_header_v1},
+    {oat_header_v2_versions, oat_header_v2_vdex_versions, sizeof(Oat_Header_V2), 8, read_oat_header_v2},
+    {oat_header_v3_versions, oat_header_v3_vdex_versions, sizeof(Oat_Header_V3), 8, read_oat_header_v3},
+    {oat_header_v4_versions, oat_header_v4_vdex_versions, sizeof(Oat_Header_V4), 8, read_oat_header_v4},
+    {oat_header_v5_versions, oat_header_v5_vdex_versions, sizeof(Oat_Header_V5), 8, read_oat_header_v5},
+    {oat_header_v6_versions, oat_header_v6_vdex_versions, sizeof(Oat_Header_V6), 24, read_oat_header_v6},
+    {oat_header_v7_versions, oat_header_v7_vdex_versions, sizeof(Oat_Header_V7), 24, read_oat_header_v7},
+    {oat_header_v8_versions, oat_header_v8_vdex_versions, sizeof(Oat_Header_V8), 32, read_oat_header_v8},
+};
+
+#endif
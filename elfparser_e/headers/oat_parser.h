@@ -0,0 +1,81 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "memory_management.h"
+#include "file_management.h"
+
+#ifndef OAT_PARSER_H
+#define OAT_PARSER_H
+
+#define OAT_MAGIC               "oat\n"
+#define OAT_MAGIC_SIZE          4
+#define OAT_VERSION_SIZE        4
+#define OAT_HEADER_FIELDS_OFFSET 8
+
+#define OAT_DEX_FILE_HEADER_SIZE 0x70
+
+/***
+ * From 124 on the dex files are stored in the vdex and
+ * dex_file_pointer of an OatDexFile is an offset in it.
+ */
+typedef struct oat_dex_file
+{
+    const uint8_t *location;    // not null terminated, points to the mapping
+    uint32_t location_size;
+    uint32_t location_checksum;
+    uint32_t dex_file_pointer;
+
+    int      in_vdex;
+    uint64_t dex_offset;        // offset in the oat file or in the vdex
+    uint64_t dex_size;          // 0 if the dex is not stored (APK)
+} Oat_Dex_File;
+
+typedef struct oat_file
+{
+    const uint8_t *buf_ptr;
+    size_t   file_size;
+    uint64_t oatdata_offset;
+
+    char     version[OAT_VERSION_SIZE];
+    uint32_t version_number;
+
+    uint32_t adler32_checksum;
+    uint32_t instruction_set;
+    uint32_t instruction_set_features;
+    uint32_t dex_file_count;
+    uint32_t oat_dex_files_offset;
+    uint32_t executable_offset;
+    uint32_t key_value_store_size;
+    const uint8_t *key_value_store;
+
+    Oat_Dex_File *dex_files;
+} Oat_File;
+
+/***
+ * Oat header layouts, the fields after magic and version up
+ * to key_value_store_size. The table (oat_header_layouts.h)
+ * is generated from FileFormats/OATHeaderLayout.py, read
+ * decodes the fields of a version and checks its offsets.
+ */
+typedef struct oat_header_layout
+{
+    const char * const *versions;
+    const char * const *vdex_versions;
+    uint32_t   size;
+    uint32_t   dex_file_fields_size;    // OatDexFile bytes after dex_file_pointer
+    int        (*read)(Oat_File *oat, const uint8_t *fields);
+} Oat_Header_Layout;
+
+/***
+ * Oat parsing over a mapped oat/odex file, only the oat
+ * header and the OatDexFile records are read. vdex_ptr
+ * is the mapped vdex for the versions storing the dex
+ * files there (NULL if there is no vdex).
+ */
+int is_oat_version_supported(const char version[OAT_VERSION_SIZE]);
+int is_oat_version_in_vdex(const char version[OAT_VERSION_SIZE]);
+int parse_oat_buffer(Oat_File *oat, const uint8_t *buf_ptr, size_t file_size, uint64_t oatdata_offset,
+                     const uint8_t *vdex_ptr, size_t vdex_size);
+void close_oat(Oat_File *oat);
+
+#endif
@@ -0,0 +1,90 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "memory_management.h"
+#include "file_management.h"
+
+#ifndef VDEX_PARSER_H
+#define VDEX_PARSER_H
+
+#define VDEX_MAGIC              "vdex"
+#define VDEX_MAGIC_SIZE         4
+#define VDEX_VERSION_SIZE       4
+
+/***
+ * Vdex layouts, numbers are the verifier deps version
+ * (vdex version from 027 on).
+ *
+ * 006/010 (Android 8.x):
+ *      header, dex checksums, dex files
+ * 019/021 (Android 9/10):
+ *      verifier deps header, dex checksums, dex section
+ *      header, dex files each one prefixed by a quickening
+ *      table offset
+ * 027 (Android 12+):
+ *      header, section headers
+ */
+#define VDEX_VERSION_SECTIONS           19
+#define VDEX_VERSION_BOOTCLASSPATH      21
+#define VDEX_VERSION_SECTION_TABLE      27
+
+#define VDEX_V006_HEADER_SIZE           24
+#define VDEX_V019_HEADER_SIZE           20
+#define VDEX_V021_HEADER_SIZE           28
+#define VDEX_V027_HEADER_SIZE           12
+#define VDEX_DEX_SECTION_HEADER_SIZE    12
+#define VDEX_SECTION_HEADER_SIZE        12
+
+#define VDEX_CHECKSUM_SECTION           0
+#define VDEX_DEX_FILE_SECTION           1
+#define VDEX_VERIFIER_DEPS_SECTION      2
+#define VDEX_TYPE_LOOKUP_TABLE_SECTION  3
+
+#define DEX_FILE_SIZE_OFFSET            32
+
+typedef struct vdex_file
+{
+    uint8_t  *buf_ptr;
+    size_t   file_size;
+
+    uint32_t version;
+    uint32_t dex_section_version;
+    uint32_t number_of_dex_files;
+
+    uint64_t dex_section_offset;
+    uint64_t dex_section_size;
+    uint64_t verifier_deps_offset;
+    uint64_t verifier_deps_size;
+
+    uint32_t *dex_checksums;
+    uint64_t *dex_offsets;
+    uint64_t *dex_sizes;
+} Vdex_File;
+
+/***
+ * Vdex parsing, the file is mapped and the header walk
+ * only touches the headers of the dex files.
+ */
+Vdex_File *parse_vdex(const char *pathname);
+Vdex_File *parse_vdex_fd(int fd);
+int parse_vdex_buffer(Vdex_File *vdex, uint8_t *buf_ptr, size_t file_size);
+void close_vdex(Vdex_File *vdex);
+
+/***
+ * Vdex header
+ * Interesting functions for python
+ * binding.
+ */
+uint32_t vdex_version(const Vdex_File *vdex);
+uint32_t vdex_dex_section_version(const Vdex_File *vdex);
+uint32_t vdex_number_of_dex_files(const Vdex_File *vdex);
+uint64_t vdex_dex_section_offset(const Vdex_File *vdex);
+uint64_t vdex_dex_section_size(const Vdex_File *vdex);
+uint64_t vdex_verifier_deps_offset(const Vdex_File *vdex);
+uint64_t vdex_verifier_deps_size(const Vdex_File *vdex);
+
+uint32_t vdex_dex_checksum(const Vdex_File *vdex, size_t index);
+uint64_t vdex_dex_offset(const Vdex_File *vdex, size_t index);
+uint64_t vdex_dex_size(const Vdex_File *vdex, size_t index);
+
+#endif
@@ -0,0 +1,60 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+##################################################
+# elf_parser python binding
+# File: carve.py
+##################################################
+
+import os
+from ctypes import *
+
+ELF_LIB_NAME = os.path.dirname(__file__) + "/elf_parser.so"
+
+
+if not os.path.isfile(ELF_LIB_NAME):
+    raise FileNotFoundError("%s doesn't exist, did you compile elfparser_e project with make?" % ELF_LIB_NAME)
+
+ELF_LIB = CDLL(ELF_LIB_NAME)
+
+# matches returned by each call to the library
+CARVE_MATCHES_SIZE = 4096
+
+
+class Carve_Match(Structure):
+    _fields_ = [
+        ("offset", c_uint64),
+        ("kind", c_uint32),
+        ("version", c_uint32),
+    ]
+
+
+ELF_LIB.carve_scan_fd.restype = c_int64
+ELF_LIB.carve_scan_fd.argtypes = [c_int, c_uint64, c_uint64, c_uint64, POINTER(Carve_Match), c_uint32,
+                                  POINTER(c_uint64)]
+
+
+def carve_scan_fd(fd, offset, size, window_size=0):
+    '''
+    Look for the oat, vdex, dex and ELF magics in [offset, offset + size)
+    of fd, mapped by windows of window_size bytes (by default the
+    CARVE_WINDOW_SIZE of carve.h).
+
+    :return: generator of tuples (offset, kind, version) in order
+             of offset, kind is one of the CARVE_* of carve.h
+    '''
+    matches = (Carve_Match * CARVE_MATCHES_SIZE)()
+    next_offset = c_uint64()
+    end = offset + size
+
+    while offset < end:
+        count = ELF_LIB.carve_scan_fd(fd, offset, end - offset, window_size, matches, CARVE_MATCHES_SIZE,
+                                      byref(next_offset))
+
+        if count < 0:
+            raise IOError("Cannot scan the file at offset 0x%08X" % offset)
+
+        for i in range(count):
+            yield (matches[i].offset, matches[i].kind, matches[i].version)
+
+        offset = next_offset.value
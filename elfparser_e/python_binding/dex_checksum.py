@@ -0,0 +1,73 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+##################################################
+# elf_parser python binding
+# File: dex_checksum.py
+##################################################
+
+import sys
+import os
+from ctypes import *
+
+ELF_LIB_NAME = os.path.dirname(__file__) + "/elf_parser.so"
+
+
+if not os.path.isfile(ELF_LIB_NAME):
+    raise FileNotFoundError("%s doesn't exist, did you compile elfparser_e project with make?" % ELF_LIB_NAME)
+
+ELF_LIB = CDLL(ELF_LIB_NAME)
+
+DEX_SIGNATURE_SIZE = 20
+
+ELF_LIB.adler32_update.restype = c_uint32
+ELF_LIB.adler32_update.argtypes = [c_uint32, c_void_p, c_size_t]
+
+ELF_LIB.dex_checksum_buffer.restype = c_int
+ELF_LIB.dex_checksum_buffer.argtypes = [c_void_p, c_size_t, c_int, POINTER(c_uint32), POINTER(c_ubyte)]
+
+ELF_LIB.dex_checksum_fd.restype = c_int
+ELF_LIB.dex_checksum_fd.argtypes = [c_int, c_uint64, c_uint64, c_int, c_int, POINTER(c_uint32), POINTER(c_ubyte)]
+
+
+def adler32(data, adler=1):
+    '''
+    Adler-32 of a bytes-like object (vectorized in the native side).
+    '''
+    buf = (c_ubyte * len(data)).from_buffer_copy(data) if len(data) > 0 else None
+    return ELF_LIB.adler32_update(adler, buf, len(data))
+
+
+def dex_checksum_buffer(dex_buffer, fix_checksum=False):
+    '''
+    Calculate checksum and signature of a dex stored in a writable
+    buffer (bytearray), if fix_checksum is True both header fields
+    are patched in place.
+
+    :return: tuple (checksum, signature)
+    '''
+    checksum = c_uint32()
+    signature = (c_ubyte * DEX_SIGNATURE_SIZE)()
+    buf = (c_ubyte * len(dex_buffer)).from_buffer(dex_buffer)
+
+    if ELF_LIB.dex_checksum_buffer(buf, len(dex_buffer), int(fix_checksum), byref(checksum), signature) < 0:
+        raise ValueError("Cannot calculate checksums of dex buffer")
+
+    return checksum.value, bytes(signature)
+
+
+def dex_checksum_fd(in_fd, offset, size, out_fd=-1, fix_checksum=False):
+    '''
+    Calculate checksum and signature of the dex at offset of in_fd
+    in one pass, copying it to out_fd in the same pass (if given).
+    If fix_checksum is True the copy gets the calculated values.
+
+    :return: tuple (checksum, signature)
+    '''
+    checksum = c_uint32()
+    signature = (c_ubyte * DEX_SIGNATURE_SIZE)()
+
+    if ELF_LIB.dex_checksum_fd(in_fd, offset, size, out_fd, int(fix_checksum), byref(checksum), signature) < 0:
+        raise IOError("Cannot calculate checksums of dex at offset 0x%08X" % offset)
+
+    return checksum.value, bytes(signature)
@@ -8,6 +8,7 @@
 
 import sys
 import os
+import weakref
 from ctypes import *
 from enum import Enum
 
@@ -19,6 +20,22 @@ if not os.path.isfile(ELF_LIB_NAME):
 
 ELF_LIB = CDLL(ELF_LIB_NAME)
 
+ELF_LIB.file_range.restype = c_void_p
+ELF_LIB.file_range.argtypes = [c_uint64, c_uint64]
+ELF_LIB.munmap_memory.restype = c_int
+ELF_LIB.munmap_memory.argtypes = [c_void_p, c_size_t]
+
+USE_NATIVE_MODULE = False
+
+try:
+    if __package__:
+        from . import _elf
+    else:
+        import _elf
+    USE_NATIVE_MODULE = True
+except ImportError:
+    pass
+
 
 class Elf_Ehdr():
 
@@ -95,7 +112,7 @@ class Elf_Rela():
         self.r_addend = r_addend
 
 
-class Elf():
+class ElfConstants():
 
     # OS ABI CONSTANTS
     class OSABI():
@@ -388,6 +405,22 @@ class Elf():
         SHN_BEFORE = 0xff00
         SHN_AFTER = 0xff01
 
+
+class CtypesElf(ElfConstants):
+    '''
+    Elf parsed with the global parser of elf_parser.so, every
+    entry of the tables is built when the file is parsed.
+
+    The mapping of the parser is exported as read-only memoryviews
+    (file_range, section_data and segment_data). The parser keeps
+    one file, a new CtypesElf takes it over but the mapping of the
+    previous one stays until that one is closed. close() refuses to
+    unmap while a memoryview of the mapping is alive.
+    '''
+
+    # CtypesElf whose file is the one of the global parser
+    owner = None
+
     def __init__(self, path_to_elf):
         self.is_elf_ = False
         self.analyzed = False
@@ -402,12 +435,80 @@ class Elf():
         self.elf_rela = []
 
         self.path_to_elf = path_to_elf
+        self.file_size = 0
+        self.mapping = None
+        self.exports = 0
 
         self.__parse()
 
     def __del__(self):
-        if self.analyzed:
+        self.close()
+
+    def close(self):
+        if not self.analyzed:
+            return
+
+        if self.exports > 0:
+            raise BufferError("cannot close an Elf with exported buffers")
+
+        if CtypesElf.owner is self:
             ELF_LIB.close_everything()
+            CtypesElf.owner = None
+        elif self.mapping is not None:
+            # the parser moved to another file, only the mapping is left
+            ELF_LIB.munmap_memory(self.mapping, self.file_size)
+
+        self.mapping = None
+        self.analyzed = False
+
+    @property
+    def closed(self):
+        return not self.analyzed
+
+    def file_range(self, offset, size):
+        '''
+        :return: read-only memoryview of [offset, offset + size) of
+                 the mapped file, it keeps the Elf open while alive
+        '''
+        if not self.analyzed:
+            raise ValueError("operation on a closed Elf")
+
+        if offset > self.file_size or size > self.file_size - offset:
+            raise ValueError("range 0x%x-0x%x out of file bound" % (offset, offset + size))
+
+        data = (c_ubyte * size).from_address(self.mapping + offset)
+        # the Elf is kept while the memoryview (and its slices) are alive
+        data.elf = self
+        self.exports += 1
+        weakref.finalize(data, self.__release)
+
+        return memoryview(data).cast('B').toreadonly()
+
+    def __release(self):
+        self.exports -= 1
+
+    def section_data(self, section):
+        '''
+        :param section: index or name of the section
+        :return: read-only memoryview of the bytes of the section
+        '''
+        if isinstance(section, str):
+            sections = [shdr for shdr in self.elf_shdr if shdr.sh_name == section]
+            if len(sections) == 0:
+                raise KeyError("section %r not found" % (section))
+            shdr = sections[0]
+        else:
+            shdr = self.elf_shdr[section]
+
+        return self.file_range(shdr.sh_offset, 0 if shdr.sh_type == ElfConstants.ShdrType.SHT_NOBITS else shdr.sh_size)
+
+    def segment_data(self, segment):
+        '''
+        :return: read-only memoryview of the bytes of the segment in the file
+        '''
+        phdr = self.elf_phdr[segment]
+
+        return self.file_range(phdr.p_offset, phdr.p_filesz)
 
     def __parse(self):
         rel_index = 0
@@ -420,6 +521,9 @@ class Elf():
             return
 
         self.analyzed = True
+        CtypesElf.owner = self
+        self.file_size = os.path.getsize(self.path_to_elf)
+        self.mapping = ELF_LIB.file_range(0, self.file_size)
 
         e_ident = []
         for i in range(16):
@@ -577,6 +681,90 @@ class Elf():
     def print_elf_relocs_header(self):
         ELF_LIB.print_elf_rel_a()
 
+    def find_symbol(self, name):
+        for symbol in self.elf_sym:
+            if symbol.st_name == name:
+                return symbol
+        return None
+
+
+if USE_NATIVE_MODULE:
+
+    class NativeElf(ElfConstants, _elf.Elf):
+        '''
+        Elf of the _elf extension module: opening only maps the file
+        and reads the ELF header, segments, sections, symbols and
+        relocations are lazy views building their entries when
+        indexed (views of a single table export the raw bytes with
+        the buffer protocol). The elf_* attributes of CtypesElf are
+        kept as aliases of the views.
+        '''
+
+        def __init__(self, path_to_elf):
+            self.path_to_elf = path_to_elf
+
+            try:
+                super().__init__(path_to_elf)
+            except (OSError, ValueError):
+                # not analyzed, is_elf() returns False
+                pass
+
+        @property
+        def elf_ehdr(self):
+            return self.header
+
+        @property
+        def elf_phdr(self):
+            return self.segments
+
+        @property
+        def elf_shdr(self):
+            return self.sections
+
+        @property
+        def elf_sym(self):
+            return self.symbols
+
+        def __relocation_tables(self, sh_type):
+            return [table for table in self.relocations.tables
+                    if len(table) > 0 and self.sections[table.section].sh_type == sh_type]
+
+        @property
+        def elf_rel(self):
+            return self.__relocation_tables(ElfConstants.ShdrType.SHT_REL)
+
+        @property
+        def elf_rela(self):
+            return self.__relocation_tables(ElfConstants.ShdrType.SHT_RELA)
+
+        def find_symbol(self, name):
+            return self.symbols.find(name)
+
+        def __print(self, function):
+            # printing is done by the global parser
+            if self.is_elf() and ELF_LIB.parse_elf(self.path_to_elf.encode()) != -1:
+                function()
+                ELF_LIB.close_everything()
+
+        def print_elf_header(self):
+            self.__print(ELF_LIB.print_elf_ehdr)
+
+        def print_elf_program_header(self):
+            self.__print(ELF_LIB.print_elf_phdr)
+
+        def print_elf_section_header(self):
+            self.__print(ELF_LIB.print_elf_shdr)
+
+        def print_elf_symbols_header(self):
+            self.__print(ELF_LIB.print_elf_sym)
+
+        def print_elf_relocs_header(self):
+            self.__print(ELF_LIB.print_elf_rel_a)
+
+    Elf = NativeElf
+else:
+    Elf = CtypesElf
+
 if __name__ == '__main__':
     if len(sys.argv) != 2:
         print("USAGE: %s <elf_binary>" % sys.argv[0])
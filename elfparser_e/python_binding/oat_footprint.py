@@ -0,0 +1,70 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+##################################################
+# elf_parser python binding
+# File: oat_footprint.py
+##################################################
+
+import os
+import array
+from ctypes import *
+
+ELF_LIB_NAME = os.path.dirname(__file__) + "/elf_parser.so"
+
+
+if not os.path.isfile(ELF_LIB_NAME):
+    raise FileNotFoundError("%s doesn't exist, did you compile elfparser_e project with make?" % ELF_LIB_NAME)
+
+ELF_LIB = CDLL(ELF_LIB_NAME)
+
+FOOTPRINT_COLUMNS = ['code_size', 'frame_size', 'core_spill_mask', 'fp_spill_mask', 'metadata_offset', 'flags']
+
+
+class Oat_Method_Header_Layout(Structure):
+    _fields_ = [
+        ("size", c_uint32),
+        ("code_size_field", c_int32),
+        ("metadata_field", c_int32),
+        ("frame_size_field", c_int32),
+        ("code_info", c_int32),
+    ]
+
+
+class Oat_Footprint_Columns(Structure):
+    _fields_ = [(column, POINTER(c_uint32)) for column in FOOTPRINT_COLUMNS]
+
+
+ELF_LIB.oat_method_headers_fd.restype = c_int
+ELF_LIB.oat_method_headers_fd.argtypes = [c_int, c_uint64, c_uint64, POINTER(Oat_Method_Header_Layout),
+                                          POINTER(c_uint32), c_uint32, POINTER(Oat_Footprint_Columns)]
+
+
+def oat_method_headers_fd(fd, oatdata_offset, size, layout, code_offsets):
+    '''
+    Read the OatQuickMethodHeader of each code offset of the oat
+    file in fd, size is the bytes from oatdata to the end of file.
+
+    :param layout: OatMethodHeaderLayout of the oat version.
+    :param code_offsets: array('I') of code offsets from oatdata.
+    :return: tuple (columns, number of methods out of bound), the
+             columns are arrays('I') in FOOTPRINT_COLUMNS order
+    '''
+    columns = [array.array('I', [0]) * len(code_offsets) for _ in FOOTPRINT_COLUMNS]
+
+    if len(code_offsets) == 0:
+        return columns, 0
+
+    native_layout = Oat_Method_Header_Layout(layout.size, layout.code_size_field, layout.metadata_field,
+                                             layout.frame_size_field, int(layout.code_info))
+    buffers = [(c_uint32 * len(column)).from_buffer(column) for column in columns]
+    native_columns = Oat_Footprint_Columns(*[cast(buffer, POINTER(c_uint32)) for buffer in buffers])
+    offsets = (c_uint32 * len(code_offsets)).from_buffer(code_offsets)
+
+    out_of_bound = ELF_LIB.oat_method_headers_fd(fd, oatdata_offset, size, byref(native_layout),
+                                                 offsets, len(code_offsets), byref(native_columns))
+
+    if out_of_bound < 0:
+        raise IOError("Cannot read the method headers of oatdata at offset 0x%08X" % oatdata_offset)
+
+    return columns, out_of_bound
@@ -0,0 +1,108 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+##################################################
+# elf_parser python binding
+# File: vdex.py
+##################################################
+
+import sys
+import os
+from ctypes import *
+
+ELF_LIB_NAME = os.path.dirname(__file__) + "/elf_parser.so"
+
+
+if not os.path.isfile(ELF_LIB_NAME):
+    raise FileNotFoundError("%s doesn't exist, did you compile elfparser_e project with make?" % ELF_LIB_NAME)
+
+ELF_LIB = CDLL(ELF_LIB_NAME)
+
+ELF_LIB.parse_vdex.restype = c_void_p
+ELF_LIB.parse_vdex.argtypes = [c_char_p]
+ELF_LIB.parse_vdex_fd.restype = c_void_p
+ELF_LIB.parse_vdex_fd.argtypes = [c_int]
+ELF_LIB.close_vdex.restype = None
+ELF_LIB.close_vdex.argtypes = [c_void_p]
+
+for function_name, return_type in [("vdex_version", c_uint32),
+                                   ("vdex_dex_section_version", c_uint32),
+                                   ("vdex_number_of_dex_files", c_uint32),
+                                   ("vdex_dex_section_offset", c_uint64),
+                                   ("vdex_dex_section_size", c_uint64),
+                                   ("vdex_verifier_deps_offset", c_uint64),
+                                   ("vdex_verifier_deps_size", c_uint64)]:
+    getattr(ELF_LIB, function_name).restype = return_type
+    getattr(ELF_LIB, function_name).argtypes = [c_void_p]
+
+for function_name, return_type in [("vdex_dex_checksum", c_uint32),
+                                   ("vdex_dex_offset", c_uint64),
+                                   ("vdex_dex_size", c_uint64)]:
+    getattr(ELF_LIB, function_name).restype = return_type
+    getattr(ELF_LIB, function_name).argtypes = [c_void_p, c_size_t]
+
+
+class Vdex_Dex():
+
+    def __init__(self, checksum, offset, size):
+        self.checksum = checksum
+        self.offset = offset
+        self.size = size
+
+
+class Vdex():
+    '''
+    Vdex container parsed by the native walker, the file is
+    mapped and only the headers are read. Dex files without
+    data in the vdex (stored in the APK) have size 0.
+    '''
+
+    def __init__(self, path_to_vdex=None, fd=None):
+        self.is_vdex_ = False
+        self.version = 0
+        self.dex_section_version = 0
+        self.number_of_dex_files = 0
+        self.dex_section_offset = 0
+        self.dex_section_size = 0
+        self.verifier_deps_offset = 0
+        self.verifier_deps_size = 0
+        self.dex_files = []
+
+        self.path_to_vdex = path_to_vdex
+        self.vdex_ = None
+
+        if fd is not None:
+            self.vdex_ = ELF_LIB.parse_vdex_fd(fd)
+        elif path_to_vdex is not None and os.path.isfile(path_to_vdex):
+            self.vdex_ = ELF_LIB.parse_vdex(path_to_vdex.encode())
+
+        if self.vdex_:
+            self.__parse()
+
+    def __del__(self):
+        if self.vdex_:
+            ELF_LIB.close_vdex(self.vdex_)
+            self.vdex_ = None
+
+    def __parse(self):
+        self.version = ELF_LIB.vdex_version(self.vdex_)
+        self.dex_section_version = ELF_LIB.vdex_dex_section_version(self.vdex_)
+        self.number_of_dex_files = ELF_LIB.vdex_number_of_dex_files(self.vdex_)
+        self.dex_section_offset = ELF_LIB.vdex_dex_section_offset(self.vdex_)
+        self.dex_section_size = ELF_LIB.vdex_dex_section_size(self.vdex_)
+        self.verifier_deps_offset = ELF_LIB.vdex_verifier_deps_offset(self.vdex_)
+        self.verifier_deps_size = ELF_LIB.vdex_verifier_deps_size(self.vdex_)
+
+        for i in range(self.number_of_dex_files):
+            self.dex_files.append(
+                Vdex_Dex(
+                    ELF_LIB.vdex_dex_checksum(self.vdex_, i),
+                    ELF_LIB.vdex_dex_offset(self.vdex_, i),
+                    ELF_LIB.vdex_dex_size(self.vdex_, i)
+                )
+            )
+
+        self.is_vdex_ = True
+
+    def is_vdex(self):
+        return self.is_vdex_
@@ -0,0 +1,246 @@
+#include "carve.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CARVE_HAS_AVX2 1
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define CARVE_HAS_SSE2 1
+#endif
+
+#define IS_DIGIT(c)     ((c) >= '0' && (c) <= '9')
+#define DIGITS(d)       ((uint32_t)((d)[0] - '0') * 100 + (uint32_t)((d)[1] - '0') * 10 + (uint32_t)((d)[2] - '0'))
+
+/***
+ * Check the whole magic of a candidate, at least
+ * CARVE_MAGIC_SIZE bytes can be read.
+ *
+ * Return the kind (0 if it is not a magic).
+ */
+static uint32_t
+check_magic(const uint8_t *data, uint32_t *version)
+{
+    switch (data[0])
+    {
+    case 'o':
+        if (data[1] == 'a' && data[2] == 't' && data[3] == '\n' &&
+            IS_DIGIT(data[4]) && IS_DIGIT(data[5]) && IS_DIGIT(data[6]) && data[7] == '\0')
+        {
+            *version = DIGITS(data + 4);
+            return (CARVE_OAT);
+        }
+        break;
+    case 'v':
+        if (data[1] == 'd' && data[2] == 'e' && data[3] == 'x' &&
+            IS_DIGIT(data[4]) && IS_DIGIT(data[5]) && IS_DIGIT(data[6]) && data[7] == '\0')
+        {
+            *version = DIGITS(data + 4);
+            return (CARVE_VDEX);
+        }
+        break;
+    case 'd':
+        if (data[1] == 'e' && data[2] == 'x' && data[3] == '\n' &&
+            data[4] == '0' && IS_DIGIT(data[5]) && IS_DIGIT(data[6]) && data[7] == '\0')
+        {
+            *version = DIGITS(data + 4);
+            return (CARVE_DEX);
+        }
+        break;
+    case 0x7f:
+        // ELFCLASS32 or ELFCLASS64, ELFDATA2LSB, EV_CURRENT
+        if (data[1] == 'E' && data[2] == 'L' && data[3] == 'F' &&
+            (data[4] == 1 || data[4] == 2) && data[5] == 1 && data[6] == 1)
+        {
+            *version = data[4] == 1 ? 32 : 64;
+            return (CARVE_ELF);
+        }
+        break;
+    }
+
+    return (0);
+}
+
+/***
+ * Candidates: positions whose first two bytes are the
+ * ones of a magic ("oa", "vd", "de" or "\x7fE"), found
+ * 32 bytes at a time with AVX2, 16 with SSE2. They are
+ * rare, each one is checked with check_magic.
+ */
+#ifdef CARVE_HAS_AVX2
+__attribute__((target("avx2")))
+static size_t
+next_candidates_avx2(const uint8_t *data, size_t size, size_t available, size_t i, uint32_t *mask)
+{
+    const __m256i o = _mm256_set1_epi8('o'), a = _mm256_set1_epi8('a');
+    const __m256i v = _mm256_set1_epi8('v'), d = _mm256_set1_epi8('d');
+    const __m256i e = _mm256_set1_epi8('e');
+    const __m256i del = _mm256_set1_epi8(0x7f), E = _mm256_set1_epi8('E');
+    __m256i first, second, found;
+
+    for (; i < size && i + 33 <= available; i += 32)
+    {
+        first = _mm256_loadu_si256((const __m256i *)(data + i));
+        second = _mm256_loadu_si256((const __m256i *)(data + i + 1));
+
+        found = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi8(first, o), _mm256_cmpeq_epi8(second, a)),
+                            _mm256_and_si256(_mm256_cmpeq_epi8(first, v), _mm256_cmpeq_epi8(second, d))),
+            _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi8(first, d), _mm256_cmpeq_epi8(second, e)),
+                            _mm256_and_si256(_mm256_cmpeq_epi8(first, del), _mm256_cmpeq_epi8(second, E))));
+
+        if ((*mask = (uint32_t)_mm256_movemask_epi8(found)) != 0)
+            return (i);
+    }
+
+    *mask = 0;
+    return (i);
+}
+#endif
+
+#ifdef CARVE_HAS_SSE2
+static size_t
+next_candidates_sse2(const uint8_t *data, size_t size, size_t available, size_t i, uint32_t *mask)
+{
+    const __m128i o = _mm_set1_epi8('o'), a = _mm_set1_epi8('a');
+    const __m128i v = _mm_set1_epi8('v'), d = _mm_set1_epi8('d');
+    const __m128i e = _mm_set1_epi8('e');
+    const __m128i del = _mm_set1_epi8(0x7f), E = _mm_set1_epi8('E');
+    __m128i first, second, found;
+
+    for (; i < size && i + 17 <= available; i += 16)
+    {
+        first = _mm_loadu_si128((const __m128i *)(data + i));
+        second = _mm_loadu_si128((const __m128i *)(data + i + 1));
+
+        found = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi8(first, o), _mm_cmpeq_epi8(second, a)),
+                         _mm_and_si128(_mm_cmpeq_epi8(first, v), _mm_cmpeq_epi8(second, d))),
+            _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi8(first, d), _mm_cmpeq_epi8(second, e)),
+                         _mm_and_si128(_mm_cmpeq_epi8(first, del), _mm_cmpeq_epi8(second, E))));
+
+        if ((*mask = (uint32_t)_mm_movemask_epi8(found)) != 0)
+            return (i);
+    }
+
+    *mask = 0;
+    return (i);
+}
+#endif
+
+uint32_t
+carve_scan(const uint8_t *data, size_t size, size_t available, uint64_t base,
+           Carve_Match *matches, uint32_t max_matches, size_t *scanned)
+{
+    uint32_t count = 0, mask, kind, version;
+    size_t i = 0, block, candidate;
+#ifdef CARVE_HAS_AVX2
+    static int has_avx2 = -1;
+
+    if (has_avx2 < 0)
+        has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+
+    while (i < size)
+    {
+        mask = 0;
+        block = 1;
+#ifdef CARVE_HAS_AVX2
+        if (has_avx2 && (i = next_candidates_avx2(data, size, available, i, &mask), mask != 0))
+            block = 32;
+#endif
+#ifdef CARVE_HAS_SSE2
+        if (mask == 0 && (i = next_candidates_sse2(data, size, available, i, &mask), mask != 0))
+            block = 16;
+#endif
+
+        if (mask == 0)
+        {
+            // last bytes (or no SIMD), one position each time
+            if (i >= size)
+                break;
+            mask = 1;
+        }
+
+        for (; mask != 0; mask &= mask - 1)
+        {
+            candidate = i + (size_t)__builtin_ctz(mask);
+
+            if (candidate >= size)
+                break;
+
+            // resume from the first candidate not checked
+            if (count == max_matches)
+            {
+                *scanned = candidate;
+                return (count);
+            }
+
+            if (candidate + CARVE_MAGIC_SIZE <= available && (kind = check_magic(data + candidate, &version)) != 0)
+            {
+                matches[count].offset = base + candidate;
+                matches[count].kind = kind;
+                matches[count].version = version;
+                count++;
+            }
+        }
+
+        i += block;
+    }
+
+    *scanned = size;
+
+    return (count);
+}
+
+int64_t
+carve_scan_fd(int fd, uint64_t offset, uint64_t size, uint64_t window_size,
+              Carve_Match *matches, uint32_t max_matches, uint64_t *next)
+{
+    uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t end = offset + size, position = offset, window_end, available_end, map_offset;
+    uint32_t count = 0;
+    size_t map_size, scanned;
+    uint8_t *map;
+
+    if (window_size == 0)
+        window_size = CARVE_WINDOW_SIZE;
+
+    window_size = (window_size + page_size - 1) & ~(page_size - 1);
+
+    while (position < end)
+    {
+        map_offset = position & ~(page_size - 1);
+        window_end = map_offset + window_size < end ? map_offset + window_size : end;
+        // magics starting at the end of the window are checked with the next bytes
+        available_end = window_end + CARVE_MAGIC_SIZE - 1 < end ? window_end + CARVE_MAGIC_SIZE - 1 : end;
+        map_size = (size_t)(available_end - map_offset);
+
+        if ((map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, (off_t)map_offset)) == MAP_FAILED)
+        {
+            perror("carve_scan_fd");
+            return (-1);
+        }
+
+        madvise(map, map_size, MADV_SEQUENTIAL);
+
+        count += carve_scan(map + (position - map_offset), (size_t)(window_end - position),
+                            (size_t)(available_end - position), position,
+                            matches + count, max_matches - count, &scanned);
+
+        munmap(map, map_size);
+
+        position += scanned;
+
+        if (count == max_matches && position < window_end)
+            break;
+    }
+
+    *next = position;
+
+    return ((int64_t)count);
+}
@@ -0,0 +1,502 @@
+#include "dex_checksum.h"
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define ADLER32_HAS_SSSE3 1
+#endif
+
+#define ADLER32_BASE    65521U
+#define ADLER32_NMAX    5552
+
+/***
+ * Adler-32
+ */
+
+static uint32_t
+adler32_scalar(uint32_t adler, const uint8_t *buf, size_t len)
+{
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+    size_t   n;
+
+    while (len > 0)
+    {
+        n = len < ADLER32_NMAX ? len : ADLER32_NMAX;
+        len -= n;
+
+        while (n >= 8)
+        {
+            s1 += buf[0]; s2 += s1;
+            s1 += buf[1]; s2 += s1;
+            s1 += buf[2]; s2 += s1;
+            s1 += buf[3]; s2 += s1;
+            s1 += buf[4]; s2 += s1;
+            s1 += buf[5]; s2 += s1;
+            s1 += buf[6]; s2 += s1;
+            s1 += buf[7]; s2 += s1;
+            buf += 8;
+            n -= 8;
+        }
+
+        while (n--)
+        {
+            s1 += *buf++;
+            s2 += s1;
+        }
+
+        s1 %= ADLER32_BASE;
+        s2 %= ADLER32_BASE;
+    }
+
+    return (s2 << 16) | s1;
+}
+
+#ifdef ADLER32_HAS_SSSE3
+/***
+ * 32 bytes per iteration: s1 is accumulated with psadbw
+ * and s2 with the position weights (32..1) through
+ * pmaddubsw, the sums are reduced at most every NMAX bytes.
+ */
+__attribute__((target("ssse3")))
+static uint32_t
+adler32_ssse3(uint32_t adler, const uint8_t *buf, size_t len)
+{
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+    size_t   blocks = len / 32;
+    size_t   n;
+
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+
+    len -= blocks * 32;
+
+    while (blocks > 0)
+    {
+        __m128i v_ps, v_s1, v_s2;
+
+        n = ADLER32_NMAX / 32;
+        if (n > blocks)
+            n = blocks;
+        blocks -= n;
+
+        v_ps = _mm_set_epi32(0, 0, 0, s1 * (uint32_t)n);
+        v_s2 = _mm_set_epi32(0, 0, 0, s2);
+        v_s1 = _mm_setzero_si128();
+
+        do
+        {
+            const __m128i bytes1 = _mm_loadu_si128((const __m128i *)buf);
+            const __m128i bytes2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+
+            buf += 32;
+        } while (--n);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += (uint32_t)_mm_cvtsi128_si32(v_s1);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = (uint32_t)_mm_cvtsi128_si32(v_s2);
+
+        s1 %= ADLER32_BASE;
+        s2 %= ADLER32_BASE;
+    }
+
+    return adler32_scalar((s2 << 16) | s1, buf, len);
+}
+#endif
+
+uint32_t
+adler32_update(uint32_t adler, const uint8_t *buf, size_t len)
+{
+#ifdef ADLER32_HAS_SSSE3
+    static int has_ssse3 = -1;
+
+    if (has_ssse3 < 0)
+        has_ssse3 = __builtin_cpu_supports("ssse3") ? 1 : 0;
+
+    if (has_ssse3 && len >= 64)
+        return adler32_ssse3(adler, buf, len);
+#endif
+    return adler32_scalar(adler, buf, len);
+}
+
+/***
+ * Adler-32 of the concatenation of two buffers given the
+ * checksum of each one and the length of the second.
+ */
+uint32_t
+adler32_combine(uint32_t adler1, uint32_t adler2, size_t len2)
+{
+    uint32_t rem = (uint32_t)(len2 % ADLER32_BASE);
+    uint32_t sum1, sum2;
+
+    sum1 = adler1 & 0xffff;
+    sum2 = (uint32_t)(((uint64_t)rem * sum1) % ADLER32_BASE);
+    sum1 += (adler2 & 0xffff) + ADLER32_BASE - 1;
+    sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + ADLER32_BASE - rem;
+
+    if (sum1 >= ADLER32_BASE)
+        sum1 -= ADLER32_BASE;
+    if (sum1 >= ADLER32_BASE)
+        sum1 -= ADLER32_BASE;
+    if (sum2 >= (ADLER32_BASE << 1))
+        sum2 -= (ADLER32_BASE << 1);
+    if (sum2 >= ADLER32_BASE)
+        sum2 -= ADLER32_BASE;
+
+    return (sum2 << 16) | sum1;
+}
+
+/***
+ * SHA-1
+ */
+
+#define SHA1_ROL(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
+
+static void
+sha1_transform(uint32_t state[5], const uint8_t block[64])
+{
+    uint32_t w[80];
+    uint32_t a, b, c, d, e, f, k, temp;
+    int      i;
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = ((uint32_t)block[i * 4] << 24) |
+               ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) |
+               ((uint32_t)block[i * 4 + 3]);
+    }
+
+    for (i = 16; i < 80; i++)
+        w[i] = SHA1_ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+
+    for (i = 0; i < 80; i++)
+    {
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        temp = SHA1_ROL(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = SHA1_ROL(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void
+sha1_init(Sha1_Ctx *ctx)
+{
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xEFCDAB89;
+    ctx->state[2] = 0x98BADCFE;
+    ctx->state[3] = 0x10325476;
+    ctx->state[4] = 0xC3D2E1F0;
+    ctx->length = 0;
+    ctx->block_used = 0;
+}
+
+void
+sha1_update(Sha1_Ctx *ctx, const uint8_t *buf, size_t len)
+{
+    size_t to_copy;
+
+    ctx->length += len;
+
+    if (ctx->block_used > 0)
+    {
+        to_copy = 64 - ctx->block_used;
+        if (to_copy > len)
+            to_copy = len;
+
+        memcpy(ctx->block + ctx->block_used, buf, to_copy);
+        ctx->block_used += to_copy;
+        buf += to_copy;
+        len -= to_copy;
+
+        if (ctx->block_used < 64)
+            return;
+
+        sha1_transform(ctx->state, ctx->block);
+        ctx->block_used = 0;
+    }
+
+    // full blocks are hashed straight from the caller buffer
+    while (len >= 64)
+    {
+        sha1_transform(ctx->state, buf);
+        buf += 64;
+        len -= 64;
+    }
+
+    if (len > 0)
+    {
+        memcpy(ctx->block, buf, len);
+        ctx->block_used = len;
+    }
+}
+
+void
+sha1_final(Sha1_Ctx *ctx, uint8_t digest[DEX_SIGNATURE_SIZE])
+{
+    uint64_t bit_length = ctx->length * 8;
+    int      i;
+
+    ctx->block[ctx->block_used++] = 0x80;
+
+    if (ctx->block_used > 56)
+    {
+        memset(ctx->block + ctx->block_used, 0, 64 - ctx->block_used);
+        sha1_transform(ctx->state, ctx->block);
+        ctx->block_used = 0;
+    }
+
+    memset(ctx->block + ctx->block_used, 0, 56 - ctx->block_used);
+
+    for (i = 0; i < 8; i++)
+        ctx->block[56 + i] = (uint8_t)(bit_length >> (56 - i * 8));
+
+    sha1_transform(ctx->state, ctx->block);
+
+    for (i = 0; i < 5; i++)
+    {
+        digest[i * 4]     = (uint8_t)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)(ctx->state[i]);
+    }
+}
+
+/***
+ * Dex checksums
+ */
+
+static int
+write_all(int fd, const uint8_t *buf, size_t len)
+{
+    ssize_t written;
+
+    while (len > 0)
+    {
+        if ((written = write(fd, buf, len)) < 0)
+        {
+            perror("write_all");
+            return (-1);
+        }
+
+        buf += written;
+        len -= (size_t)written;
+    }
+
+    return (0);
+}
+
+static void
+store_checksum(uint8_t *header, uint32_t checksum)
+{
+    header[DEX_CHECKSUM_OFFSET]     = (uint8_t)(checksum);
+    header[DEX_CHECKSUM_OFFSET + 1] = (uint8_t)(checksum >> 8);
+    header[DEX_CHECKSUM_OFFSET + 2] = (uint8_t)(checksum >> 16);
+    header[DEX_CHECKSUM_OFFSET + 3] = (uint8_t)(checksum >> 24);
+}
+
+int
+dex_checksum_buffer(uint8_t *dex, size_t size, int fix_checksum,
+                    uint32_t *checksum, uint8_t signature[DEX_SIGNATURE_SIZE])
+{
+    Sha1_Ctx sha1;
+    uint32_t adler_body = 1;
+    uint32_t adler_header;
+    size_t   offset, block;
+
+    if (dex == NULL || size < DEX_HASHED_OFFSET)
+    {
+        fprintf(stderr, "dex_checksum_buffer: incorrect dex buffer\n");
+        return (-1);
+    }
+
+    sha1_init(&sha1);
+
+    for (offset = DEX_HASHED_OFFSET; offset < size; offset += block)
+    {
+        block = size - offset < DEX_COPY_BLOCK_SIZE ? size - offset : DEX_COPY_BLOCK_SIZE;
+
+        adler_body = adler32_update(adler_body, dex + offset, block);
+        sha1_update(&sha1, dex + offset, block);
+    }
+
+    sha1_final(&sha1, signature);
+
+    if (fix_checksum)
+        memcpy(dex + DEX_SIGNATURE_OFFSET, signature, DEX_SIGNATURE_SIZE);
+
+    adler_header = adler32_update(1, dex + DEX_SIGNATURE_OFFSET, DEX_SIGNATURE_SIZE);
+    *checksum = adler32_combine(adler_header, adler_body, size - DEX_HASHED_OFFSET);
+
+    if (fix_checksum)
+        store_checksum(dex, *checksum);
+
+    return (0);
+}
+
+/***
+ * Check that [offset, offset + size) is inside of the
+ * file, a range out of it would raise SIGBUS when the
+ * mapping is read.
+ */
+static int
+check_file_range(int fd, uint64_t offset, uint64_t size, const char *caller)
+{
+    ssize_t file_size;
+
+    if ((file_size = get_file_size(fd)) < 0)
+        return (-1);
+
+    if (offset > (uint64_t)file_size || size > (uint64_t)file_size - offset)
+    {
+        fprintf(stderr, "%s: range 0x%llx + 0x%llx out of file bound (0x%llx)\n", caller,
+                (long long unsigned int)offset, (long long unsigned int)size, (long long unsigned int)file_size);
+        return (-1);
+    }
+
+    return (0);
+}
+
+/***
+ * Hash the dex at offset of in_fd and copy it to out_fd
+ * (if out_fd >= 0). The body is hashed and written block
+ * by block from the mapping so each byte is read once,
+ * the header is patched at the end with pwrite. When the
+ * output cannot seek (pipes) the whole body is hashed
+ * before writing anything.
+ */
+int
+dex_checksum_fd(int in_fd, uint64_t offset, uint64_t size, int out_fd, int fix_checksum,
+                uint32_t *checksum, uint8_t signature[DEX_SIGNATURE_SIZE])
+{
+    uint8_t  *mapping;
+    uint8_t  *dex;
+    uint8_t  header[DEX_HASHED_OFFSET];
+    Sha1_Ctx sha1;
+    uint32_t adler_body = 1;
+    uint32_t adler_header;
+    uint64_t current, block;
+    off_t    header_position = -1;
+    int      streaming;
+    int      ret = -1;
+
+    if (size < DEX_HASHED_OFFSET)
+    {
+        fprintf(stderr, "dex_checksum_fd: dex size too small (%llu)\n", (long long unsigned int)size);
+        return (-1);
+    }
+
+    if (check_file_range(in_fd, offset, size, "dex_checksum_fd") < 0)
+        return (-1);
+
+    if ((mapping = mmap_file_read((size_t)(offset + size), in_fd)) == NULL)
+        return (-1);
+
+    dex = mapping + offset;
+    madvise(mapping + (offset & ~(uint64_t)4095), (size_t)(size + (offset & 4095)), MADV_SEQUENTIAL);
+
+    memcpy(header, dex, DEX_HASHED_OFFSET);
+
+    streaming = out_fd >= 0 && (header_position = lseek(out_fd, 0, SEEK_CUR)) >= 0;
+
+    if (streaming && write_all(out_fd, header, DEX_HASHED_OFFSET) < 0)
+        goto end;
+
+    sha1_init(&sha1);
+
+    for (current = DEX_HASHED_OFFSET; current < size; current += block)
+    {
+        block = size - current < DEX_COPY_BLOCK_SIZE ? size - current : DEX_COPY_BLOCK_SIZE;
+
+        adler_body = adler32_update(adler_body, dex + current, (size_t)block);
+        sha1_update(&sha1, dex + current, (size_t)block);
+
+        if (streaming && write_all(out_fd, dex + current, (size_t)block) < 0)
+            goto end;
+    }
+
+    sha1_final(&sha1, signature);
+
+    if (fix_checksum)
+        memcpy(header + DEX_SIGNATURE_OFFSET, signature, DEX_SIGNATURE_SIZE);
+
+    adler_header = adler32_update(1, header + DEX_SIGNATURE_OFFSET, DEX_SIGNATURE_SIZE);
+    *checksum = adler32_combine(adler_header, adler_body, (size_t)(size - DEX_HASHED_OFFSET));
+
+    if (fix_checksum)
+        store_checksum(header, *checksum);
+
+    if (streaming)
+    {
+        if (fix_checksum &&
+            pwrite(out_fd, header + DEX_CHECKSUM_OFFSET, DEX_HASHED_OFFSET - DEX_CHECKSUM_OFFSET,
+                   header_position + DEX_CHECKSUM_OFFSET) < 0)
+        {
+            perror("dex_checksum_fd");
+            goto end;
+        }
+    }
+    else if (out_fd >= 0)
+    {
+        if (write_all(out_fd, header, DEX_HASHED_OFFSET) < 0 ||
+            write_all(out_fd, dex + DEX_HASHED_OFFSET, (size_t)(size - DEX_HASHED_OFFSET)) < 0)
+            goto end;
+    }
+
+    ret = 0;
+
+end:
+    munmap_memory(mapping, (size_t)(offset + size));
+    return (ret);
+}
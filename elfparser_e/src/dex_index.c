@@ -0,0 +1,375 @@
+#include "dex_index.h"
+
+static const uint16_t table_types[DEX_NUMBER_OF_TABLES] = {
+    DEX_TYPE_STRING_ID_ITEM, DEX_TYPE_TYPE_ID_ITEM, DEX_TYPE_PROTO_ID_ITEM, DEX_TYPE_FIELD_ID_ITEM,
+    DEX_TYPE_METHOD_ID_ITEM, DEX_TYPE_CLASS_DEF_ITEM, DEX_TYPE_MAP_LIST,
+};
+
+static const uint32_t table_entry_sizes[DEX_NUMBER_OF_TABLES] = {
+    sizeof(Dex_String_Id), sizeof(Dex_Type_Id), sizeof(Dex_Proto_Id), sizeof(Dex_Field_Id),
+    sizeof(Dex_Method_Id), sizeof(Dex_Class_Def), sizeof(Dex_Map_Item),
+};
+
+static const char *table_names[DEX_NUMBER_OF_TABLES] = {
+    "string_ids", "type_ids", "proto_ids", "field_ids", "method_ids", "class_defs", "map_list",
+};
+
+static uint32_t
+read_u32(const uint8_t *buf_ptr, uint64_t offset)
+{
+    uint32_t value;
+
+    memcpy(&value, buf_ptr + offset, sizeof(uint32_t));
+
+    return (value);
+}
+
+/***
+ * uleb128 of at most five bytes, returns the number of
+ * bytes read or 0 if it is longer or goes past end.
+ *
+ * With eight bytes in the buffer it is decoded without
+ * branches per byte: the first byte without continuation
+ * bit gives the length, the bytes after it are masked out
+ * and the 7-bit groups are packed with shifts.
+ */
+static inline size_t
+read_uleb128(const uint8_t *ptr, const uint8_t *end, uint32_t *value)
+{
+    uint32_t result = 0;
+    uint64_t word, stops;
+    size_t   i, length;
+
+    if (end - ptr >= (ptrdiff_t)sizeof(uint64_t))
+    {
+        memcpy(&word, ptr, sizeof(uint64_t));
+        stops = ~word & ULEB128_STOP_BITS;
+        length = stops != 0 ? (size_t)(__builtin_ctzll(stops) >> 3) + 1 : 8;
+
+        if (length > 5)
+            return (0);
+
+        word &= ~0ULL >> (64 - 8 * length);
+        *value = (uint32_t)((word & 0x7f) | ((word >> 1) & 0x3f80) | ((word >> 2) & 0x1fc000) |
+                            ((word >> 3) & 0xfe00000) | ((word >> 4) & 0x7f0000000ULL));
+
+        return (length);
+    }
+
+    for (i = 0; i < 5 && ptr + i < end; i++)
+    {
+        result |= (uint32_t)(ptr[i] & 0x7f) << (7 * i);
+
+        if ((ptr[i] & 0x80) == 0)
+        {
+            *value = result;
+            return (i + 1);
+        }
+    }
+
+    return (0);
+}
+
+static inline const uint8_t *
+next_uleb128(const uint8_t *ptr, const uint8_t *end, uint32_t *value)
+{
+    size_t length;
+
+    if ((length = read_uleb128(ptr, end, value)) == 0)
+        return (NULL);
+
+    return (ptr + length);
+}
+
+/***
+ * Skip count uleb128 values (the fields of class_data), the
+ * last bytes of the values are counted eight bytes at once.
+ */
+static const uint8_t *
+skip_uleb128(const uint8_t *ptr, const uint8_t *end, uint64_t count)
+{
+    uint64_t word, stops, found;
+
+    while (count > 0 && end - ptr >= (ptrdiff_t)sizeof(uint64_t))
+    {
+        memcpy(&word, ptr, sizeof(uint64_t));
+        stops = ~word & ULEB128_STOP_BITS;
+        found = (uint64_t)__builtin_popcountll(stops);
+
+        if (found < count)
+        {
+            count -= found;
+            ptr += sizeof(uint64_t);
+            continue;
+        }
+
+        // the value ends in this word, drop the stops before it
+        while (--count > 0)
+            stops &= stops - 1;
+
+        return (ptr + (__builtin_ctzll(stops) >> 3) + 1);
+    }
+
+    for (; count > 0 && ptr < end; ptr++)
+    {
+        if ((*ptr & 0x80) == 0)
+            count--;
+    }
+
+    return (count == 0 ? ptr : NULL);
+}
+
+static int
+set_table(Dex_Index *index, int table, uint32_t offset, uint32_t count)
+{
+    uint32_t entry_size = table_entry_sizes[table];
+
+    if (count != 0 && ((uint64_t)offset > index->size ||
+                       (uint64_t)count * entry_size > index->size - offset))
+    {
+        fprintf(stderr, "parse_dex_index: %s (0x%08X, %u entries) out of dex bound\n",
+                table_names[table], offset, count);
+        return (-1);
+    }
+
+    index->tables[table].offset = count != 0 ? offset : 0;
+    index->tables[table].count = count;
+    index->tables[table].entry_size = entry_size;
+
+    return (0);
+}
+
+static int
+parse_map_list(Dex_Index *index)
+{
+    const Dex_Header *header = &index->header;
+    uint32_t header_values[DEX_TABLE_MAP_LIST][2] = {
+        {header->string_ids_off, header->string_ids_size}, {header->type_ids_off, header->type_ids_size},
+        {header->proto_ids_off, header->proto_ids_size}, {header->field_ids_off, header->field_ids_size},
+        {header->method_ids_off, header->method_ids_size}, {header->class_defs_off, header->class_defs_size},
+    };
+    Dex_Map_Item item;
+    uint32_t i;
+    int table;
+
+    if (header->map_off == 0)
+        return (set_table(index, DEX_TABLE_MAP_LIST, 0, 0));
+
+    if ((uint64_t)header->map_off + sizeof(uint32_t) > index->size)
+    {
+        fprintf(stderr, "parse_dex_index: map_off (0x%08X) out of dex bound\n", header->map_off);
+        return (-1);
+    }
+
+    if (set_table(index, DEX_TABLE_MAP_LIST, header->map_off + sizeof(uint32_t),
+                  read_u32(index->buf_ptr, header->map_off)) < 0)
+        return (-1);
+
+    // the ID tables of map_list must be the ones of the header
+    for (i = 0; i < index->tables[DEX_TABLE_MAP_LIST].count; i++)
+    {
+        dex_read_entry(index, DEX_TABLE_MAP_LIST, i, &item);
+
+        for (table = 0; table < DEX_TABLE_MAP_LIST; table++)
+        {
+            if (item.type != table_types[table])
+                continue;
+
+            if (item.size != header_values[table][1] || (item.size != 0 && item.offset != header_values[table][0]))
+            {
+                fprintf(stderr, "parse_dex_index: map_list item of %s (0x%08X, %u entries) does not match the header\n",
+                        table_names[table], item.offset, item.size);
+                return (-1);
+            }
+        }
+    }
+
+    return (0);
+}
+
+int
+parse_dex_index(Dex_Index *index, const uint8_t *buf_ptr, size_t size)
+{
+    Dex_Header *header = &index->header;
+
+    memset(index, 0, sizeof(Dex_Index));
+
+    if (size < DEX_HEADER_SIZE)
+    {
+        fprintf(stderr, "parse_dex_index: dex too small (%zu bytes)\n", size);
+        return (-1);
+    }
+
+    memcpy(header, buf_ptr, DEX_HEADER_SIZE);
+
+    if (memcmp(header->magic, DEX_FILE_MAGIC, DEX_FILE_MAGIC_SIZE) != 0)
+    {
+        fprintf(stderr, "parse_dex_index: incorrect dex magic\n");
+        return (-1);
+    }
+
+    if (header->endian_tag != DEX_ENDIAN_CONSTANT)
+    {
+        fprintf(stderr, "parse_dex_index: unsupported endian tag (0x%08X)\n", header->endian_tag);
+        return (-1);
+    }
+
+    if (header->file_size < DEX_HEADER_SIZE || header->file_size > size)
+    {
+        fprintf(stderr, "parse_dex_index: file_size (%u) out of buffer bound\n", header->file_size);
+        return (-1);
+    }
+
+    // the buffer can be the whole container, the dex ends at file_size
+    index->buf_ptr = buf_ptr;
+    index->size = header->file_size;
+
+    if (set_table(index, DEX_TABLE_STRING_IDS, header->string_ids_off, header->string_ids_size) < 0 ||
+        set_table(index, DEX_TABLE_TYPE_IDS, header->type_ids_off, header->type_ids_size) < 0 ||
+        set_table(index, DEX_TABLE_PROTO_IDS, header->proto_ids_off, header->proto_ids_size) < 0 ||
+        set_table(index, DEX_TABLE_FIELD_IDS, header->field_ids_off, header->field_ids_size) < 0 ||
+        set_table(index, DEX_TABLE_METHOD_IDS, header->method_ids_off, header->method_ids_size) < 0 ||
+        set_table(index, DEX_TABLE_CLASS_DEFS, header->class_defs_off, header->class_defs_size) < 0)
+        return (-1);
+
+    return (parse_map_list(index));
+}
+
+const uint8_t *
+dex_table_entry(const Dex_Index *index, int table, uint32_t entry)
+{
+    const Dex_Table *dex_table;
+
+    if (table < 0 || table >= DEX_NUMBER_OF_TABLES)
+        return (NULL);
+
+    dex_table = &index->tables[table];
+
+    if (entry >= dex_table->count)
+        return (NULL);
+
+    return (index->buf_ptr + dex_table->offset + (size_t)entry * dex_table->entry_size);
+}
+
+int
+dex_read_entry(const Dex_Index *index, int table, uint32_t entry, void *value)
+{
+    const uint8_t *entry_ptr;
+
+    if ((entry_ptr = dex_table_entry(index, table, entry)) == NULL)
+        return (-1);
+
+    memcpy(value, entry_ptr, index->tables[table].entry_size);
+
+    return (0);
+}
+
+const uint8_t *
+dex_string_data(const Dex_Index *index, uint32_t string_idx, uint32_t *utf16_size, size_t *length)
+{
+    const uint8_t *data, *end = index->buf_ptr + index->size, *nul;
+    Dex_String_Id string_id;
+    size_t uleb_size;
+
+    if (dex_read_entry(index, DEX_TABLE_STRING_IDS, string_idx, &string_id) < 0 ||
+        string_id.string_data_off >= index->size)
+        return (NULL);
+
+    data = index->buf_ptr + string_id.string_data_off;
+
+    if ((uleb_size = read_uleb128(data, end, utf16_size)) == 0)
+        return (NULL);
+
+    data += uleb_size;
+
+    if ((nul = memchr(data, '\0', (size_t)(end - data))) == NULL)
+        return (NULL);
+
+    *length = (size_t)(nul - data);
+
+    return (data);
+}
+
+const uint8_t *
+dex_type_descriptor(const Dex_Index *index, uint32_t type_idx, size_t *length)
+{
+    Dex_Type_Id type_id;
+    uint32_t utf16_size;
+
+    if (dex_read_entry(index, DEX_TABLE_TYPE_IDS, type_idx, &type_id) < 0)
+        return (NULL);
+
+    return (dex_string_data(index, type_id.descriptor_idx, &utf16_size, length));
+}
+
+int
+dex_decode_class_data(const Dex_Index *index, uint32_t *class_methods, uint32_t *method_idx,
+                      uint32_t *access_flags, uint32_t *code_off, uint32_t capacity, uint32_t *number_of_methods)
+{
+    const uint8_t *ptr, *end = index->buf_ptr + index->size;
+    uint32_t sizes[4], count = 0, idx, diff, i, j, list;
+    Dex_Class_Def class_def;
+
+    for (i = 0; i < index->tables[DEX_TABLE_CLASS_DEFS].count; i++)
+    {
+        class_methods[i] = count;
+        dex_read_entry(index, DEX_TABLE_CLASS_DEFS, i, &class_def);
+
+        if (class_def.class_data_off == 0)
+            continue;
+
+        if (class_def.class_data_off >= index->size)
+        {
+            fprintf(stderr, "decode_class_data: class_data_off (0x%08X) of class %u out of dex bound\n",
+                    class_def.class_data_off, i);
+            return (-1);
+        }
+
+        // static fields, instance fields, direct methods and virtual methods
+        ptr = index->buf_ptr + class_def.class_data_off;
+
+        for (j = 0; j < 4 && ptr != NULL; j++)
+            ptr = next_uleb128(ptr, end, &sizes[j]);
+
+        if (ptr != NULL)
+            ptr = skip_uleb128(ptr, end, 2 * ((uint64_t)sizes[0] + sizes[1]));
+
+        // method indexes are differences to the previous method of the list
+        for (list = 2; list < 4 && ptr != NULL; list++)
+        {
+            for (j = 0, idx = 0; j < sizes[list] && ptr != NULL; j++, count++)
+            {
+                if (count >= capacity)
+                {
+                    fprintf(stderr, "decode_class_data: class %u has more methods than method_ids\n", i);
+                    return (-1);
+                }
+
+                if ((ptr = next_uleb128(ptr, end, &diff)) == NULL ||
+                    (ptr = next_uleb128(ptr, end, &access_flags[count])) == NULL ||
+                    (ptr = next_uleb128(ptr, end, &code_off[count])) == NULL)
+                    break;
+
+                idx += diff;
+                method_idx[count] = idx;
+
+                if (idx >= index->tables[DEX_TABLE_METHOD_IDS].count)
+                {
+                    fprintf(stderr, "decode_class_data: method_idx %u of class %u out of method_ids\n", idx, i);
+                    return (-1);
+                }
+            }
+        }
+
+        if (ptr == NULL)
+        {
+            fprintf(stderr, "decode_class_data: class_data of class %u out of dex bound\n", i);
+            return (-1);
+        }
+    }
+
+    class_methods[index->tables[DEX_TABLE_CLASS_DEFS].count] = count;
+    *number_of_methods = count;
+
+    return (0);
+}
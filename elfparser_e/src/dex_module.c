@@ -0,0 +1,929 @@
+/***
+ * _dex: CPython extension module of elfparser_e.
+ *
+ * A DexIndex is built over any object with the buffer
+ * protocol holding a dex (usually a memoryview slice of
+ * the mapped oat or vdex file), the buffer is kept while
+ * the index lives and nothing is copied. It cannot be
+ * closed while a call reads it without the GIL. Only the header
+ * and map_list are checked when the index is created
+ * (with the GIL released), the ID tables are exposed as
+ * lazy sequence views which build their entries when they
+ * are indexed, and export their raw bytes with the buffer
+ * protocol.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include "dex_index.h"
+
+static const char *view_names[DEX_NUMBER_OF_TABLES] = {
+    "string_ids", "type_ids", "proto_ids", "field_ids", "method_ids", "class_defs", "map_list",
+};
+
+typedef struct
+{
+    PyObject_HEAD
+    Py_buffer   buffer;         // dex bytes, buffer.obj is NULL once closed
+    int         analyzed;
+    Dex_Index   index;
+    Py_ssize_t  exports;        // buffers exported by the views
+    Py_ssize_t  in_use;         // calls reading the buffer without the GIL
+    PyObject   *views[DEX_NUMBER_OF_TABLES];
+} DexIndexObject;
+
+typedef struct
+{
+    PyObject_HEAD
+    DexIndexObject *dex;
+    int             kind;
+} DexTableViewObject;
+
+static PyTypeObject DexIndexType;
+static PyTypeObject DexTableViewType;
+
+static PyTypeObject Dex_HeaderType;
+static PyTypeObject Dex_StringIdType;
+static PyTypeObject Dex_TypeIdType;
+static PyTypeObject Dex_ProtoIdType;
+static PyTypeObject Dex_FieldIdType;
+static PyTypeObject Dex_MethodIdType;
+static PyTypeObject Dex_ClassDefType;
+static PyTypeObject Dex_MapItemType;
+static PyTypeObject Dex_ClassDataType;
+
+static PyStructSequence_Field header_fields[] = {
+    {"magic", NULL}, {"checksum", NULL}, {"signature", NULL}, {"file_size", NULL},
+    {"header_size", NULL}, {"endian_tag", NULL}, {"link_size", NULL}, {"link_off", NULL},
+    {"map_off", NULL}, {"string_ids_size", NULL}, {"string_ids_off", NULL}, {"type_ids_size", NULL},
+    {"type_ids_off", NULL}, {"proto_ids_size", NULL}, {"proto_ids_off", NULL}, {"field_ids_size", NULL},
+    {"field_ids_off", NULL}, {"method_ids_size", NULL}, {"method_ids_off", NULL}, {"class_defs_size", NULL},
+    {"class_defs_off", NULL}, {"data_size", NULL}, {"data_off", NULL}, {NULL}
+};
+
+static PyStructSequence_Field string_id_fields[] = {
+    {"string_data_off", NULL}, {NULL}
+};
+
+static PyStructSequence_Field type_id_fields[] = {
+    {"descriptor_idx", NULL}, {NULL}
+};
+
+static PyStructSequence_Field proto_id_fields[] = {
+    {"shorty_idx", NULL}, {"return_type_idx", NULL}, {"parameters_off", NULL}, {NULL}
+};
+
+static PyStructSequence_Field field_id_fields[] = {
+    {"class_idx", NULL}, {"type_idx", NULL}, {"name_idx", NULL}, {NULL}
+};
+
+static PyStructSequence_Field method_id_fields[] = {
+    {"class_idx", NULL}, {"proto_idx", NULL}, {"name_idx", NULL}, {NULL}
+};
+
+static PyStructSequence_Field class_def_fields[] = {
+    {"class_idx", NULL}, {"access_flags", NULL}, {"superclass_idx", NULL}, {"interfaces_off", NULL},
+    {"source_file_idx", NULL}, {"annotations_off", NULL}, {"class_data_off", NULL},
+    {"static_values_off", NULL}, {NULL}
+};
+
+static PyStructSequence_Field map_item_fields[] = {
+    {"type", NULL}, {"size", NULL}, {"offset", NULL}, {NULL}
+};
+
+static PyStructSequence_Field class_data_fields[] = {
+    {"class_methods", NULL}, {"method_idx", NULL}, {"access_flags", NULL}, {"code_off", NULL}, {NULL}
+};
+
+static PyStructSequence_Desc header_desc = {"_dex.Dex_Header", "Dex header", header_fields, 23};
+static PyStructSequence_Desc string_id_desc = {"_dex.Dex_StringId", "string_id_item", string_id_fields, 1};
+static PyStructSequence_Desc type_id_desc = {"_dex.Dex_TypeId", "type_id_item", type_id_fields, 1};
+static PyStructSequence_Desc proto_id_desc = {"_dex.Dex_ProtoId", "proto_id_item", proto_id_fields, 3};
+static PyStructSequence_Desc field_id_desc = {"_dex.Dex_FieldId", "field_id_item", field_id_fields, 3};
+static PyStructSequence_Desc method_id_desc = {"_dex.Dex_MethodId", "method_id_item", method_id_fields, 3};
+static PyStructSequence_Desc class_def_desc = {"_dex.Dex_ClassDef", "class_def_item", class_def_fields, 8};
+static PyStructSequence_Desc map_item_desc = {"_dex.Dex_MapItem", "map_item of map_list", map_item_fields, 3};
+static PyStructSequence_Desc class_data_desc = {"_dex.Dex_ClassData", "methods of every class_data_item",
+                                                class_data_fields, 4};
+
+static PyObject *
+new_entry(PyTypeObject *type, const char *format, ...)
+{
+    PyObject *values, *entry;
+    Py_ssize_t i;
+    va_list args;
+
+    va_start(args, format);
+    values = Py_VaBuildValue(format, args);
+    va_end(args);
+
+    if (values == NULL)
+        return (NULL);
+
+    if ((entry = PyStructSequence_New(type)) == NULL)
+    {
+        Py_DECREF(values);
+        return (NULL);
+    }
+
+    for (i = 0; i < PyTuple_GET_SIZE(values); i++)
+    {
+        PyObject *value = PyTuple_GET_ITEM(values, i);
+
+        Py_INCREF(value);
+        PyStructSequence_SET_ITEM(entry, i, value);
+    }
+
+    Py_DECREF(values);
+
+    return (entry);
+}
+
+static PyObject *
+table_entry(DexIndexObject *dex, int kind, uint32_t index)
+{
+    const Dex_Index *dex_index = &dex->index;
+    Dex_String_Id string_id;
+    Dex_Type_Id type_id;
+    Dex_Proto_Id proto_id;
+    Dex_Field_Id field_id;
+    Dex_Method_Id method_id;
+    Dex_Class_Def class_def;
+    Dex_Map_Item map_item;
+
+    switch (kind)
+    {
+    case DEX_TABLE_STRING_IDS:
+        dex_read_entry(dex_index, kind, index, &string_id);
+        return (new_entry(&Dex_StringIdType, "(I)", string_id.string_data_off));
+    case DEX_TABLE_TYPE_IDS:
+        dex_read_entry(dex_index, kind, index, &type_id);
+        return (new_entry(&Dex_TypeIdType, "(I)", type_id.descriptor_idx));
+    case DEX_TABLE_PROTO_IDS:
+        dex_read_entry(dex_index, kind, index, &proto_id);
+        return (new_entry(&Dex_ProtoIdType, "(III)", proto_id.shorty_idx, proto_id.return_type_idx,
+                          proto_id.parameters_off));
+    case DEX_TABLE_FIELD_IDS:
+        dex_read_entry(dex_index, kind, index, &field_id);
+        return (new_entry(&Dex_FieldIdType, "(HHI)", field_id.class_idx, field_id.type_idx, field_id.name_idx));
+    case DEX_TABLE_METHOD_IDS:
+        dex_read_entry(dex_index, kind, index, &method_id);
+        return (new_entry(&Dex_MethodIdType, "(HHI)", method_id.class_idx, method_id.proto_idx,
+                          method_id.name_idx));
+    case DEX_TABLE_CLASS_DEFS:
+        dex_read_entry(dex_index, kind, index, &class_def);
+        return (new_entry(&Dex_ClassDefType, "(IIIIIIII)", class_def.class_idx, class_def.access_flags,
+                          class_def.superclass_idx, class_def.interfaces_off, class_def.source_file_idx,
+                          class_def.annotations_off, class_def.class_data_off, class_def.static_values_off));
+    default:
+        dex_read_entry(dex_index, kind, index, &map_item);
+        return (new_entry(&Dex_MapItemType, "(HII)", map_item.type, map_item.size, map_item.offset));
+    }
+}
+
+static int
+check_open(DexIndexObject *dex)
+{
+    if (!dex->analyzed || dex->buffer.obj == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, dex->analyzed ? "operation on a closed DexIndex" : "DexIndex not initialized");
+        return (-1);
+    }
+
+    return (0);
+}
+
+/***
+ * Table views
+ */
+static PyObject *
+new_view(DexIndexObject *dex, int kind)
+{
+    DexTableViewObject *view;
+
+    if ((view = PyObject_GC_New(DexTableViewObject, &DexTableViewType)) == NULL)
+        return (NULL);
+
+    Py_INCREF(dex);
+    view->dex = dex;
+    view->kind = kind;
+    PyObject_GC_Track(view);
+
+    return ((PyObject *)view);
+}
+
+// the DexIndex keeps its views, views keep their DexIndex
+static int
+view_traverse(DexTableViewObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->dex);
+
+    return (0);
+}
+
+static int
+view_clear(DexTableViewObject *self)
+{
+    Py_CLEAR(self->dex);
+
+    return (0);
+}
+
+static void
+view_dealloc(DexTableViewObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    view_clear(self);
+    PyObject_GC_Del(self);
+}
+
+static Py_ssize_t
+view_length(DexTableViewObject *self)
+{
+    return ((Py_ssize_t)self->dex->index.tables[self->kind].count);
+}
+
+static PyObject *
+view_item(DexTableViewObject *self, Py_ssize_t index)
+{
+    if (index < 0 || index >= view_length(self))
+    {
+        PyErr_Format(PyExc_IndexError, "%s index out of range", view_names[self->kind]);
+        return (NULL);
+    }
+
+    if (check_open(self->dex) < 0)
+        return (NULL);
+
+    return (table_entry(self->dex, self->kind, (uint32_t)index));
+}
+
+// slices build a list with the entries
+static PyObject *
+view_subscript(DexTableViewObject *self, PyObject *key)
+{
+    Py_ssize_t index, start, stop, step, length, i;
+    PyObject *list, *entry;
+
+    if (PyIndex_Check(key))
+    {
+        if ((index = PyNumber_AsSsize_t(key, PyExc_IndexError)) == -1 && PyErr_Occurred())
+            return (NULL);
+
+        if (index < 0)
+            index += view_length(self);
+
+        return (view_item(self, index));
+    }
+
+    if (!PySlice_Check(key))
+    {
+        PyErr_Format(PyExc_TypeError, "%s indices must be integers or slices", view_names[self->kind]);
+        return (NULL);
+    }
+
+    if (PySlice_Unpack(key, &start, &stop, &step) < 0)
+        return (NULL);
+
+    length = PySlice_AdjustIndices(view_length(self), &start, &stop, step);
+
+    if ((list = PyList_New(length)) == NULL)
+        return (NULL);
+
+    for (i = 0; i < length; i++, start += step)
+    {
+        if ((entry = view_item(self, start)) == NULL)
+        {
+            Py_DECREF(list);
+            return (NULL);
+        }
+
+        PyList_SET_ITEM(list, i, entry);
+    }
+
+    return (list);
+}
+
+static PyObject *
+view_get_offset(DexTableViewObject *self, void *closure)
+{
+    return (PyLong_FromUnsignedLong(self->dex->index.tables[self->kind].offset));
+}
+
+static PyObject *
+view_get_entry_size(DexTableViewObject *self, void *closure)
+{
+    return (PyLong_FromUnsignedLong(self->dex->index.tables[self->kind].entry_size));
+}
+
+static PyObject *
+view_repr(DexTableViewObject *self)
+{
+    return (PyUnicode_FromFormat("<DexIndex %s view, %zd entries>", view_names[self->kind], view_length(self)));
+}
+
+// raw bytes of the table, a slice of the buffer of the DexIndex
+static int
+view_getbuffer(DexTableViewObject *self, Py_buffer *buffer, int flags)
+{
+    const Dex_Table *table = &self->dex->index.tables[self->kind];
+
+    if (check_open(self->dex) < 0)
+    {
+        buffer->obj = NULL;
+        return (-1);
+    }
+
+    if (PyBuffer_FillInfo(buffer, (PyObject *)self, (void *)(self->dex->index.buf_ptr + table->offset),
+                          (Py_ssize_t)table->count * table->entry_size, 1, flags) < 0)
+        return (-1);
+
+    self->dex->exports++;
+
+    return (0);
+}
+
+static void
+view_releasebuffer(DexTableViewObject *self, Py_buffer *buffer)
+{
+    self->dex->exports--;
+}
+
+static PySequenceMethods view_as_sequence = {
+    .sq_length = (lenfunc)view_length,
+    .sq_item = (ssizeargfunc)view_item,
+};
+
+static PyMappingMethods view_as_mapping = {
+    .mp_length = (lenfunc)view_length,
+    .mp_subscript = (binaryfunc)view_subscript,
+};
+
+static PyBufferProcs view_as_buffer = {
+    .bf_getbuffer = (getbufferproc)view_getbuffer,
+    .bf_releasebuffer = (releasebufferproc)view_releasebuffer,
+};
+
+static PyGetSetDef view_getset[] = {
+    {"offset", (getter)view_get_offset, NULL, "offset of the table in the dex", NULL},
+    {"entry_size", (getter)view_get_entry_size, NULL, "size of the raw entries", NULL},
+    {NULL}
+};
+
+static PyTypeObject DexTableViewType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_dex.DexTableView",
+    .tp_doc = "Lazy sequence over a dex table, entries are built when indexed",
+    .tp_basicsize = sizeof(DexTableViewObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_SEQUENCE | Py_TPFLAGS_HAVE_GC,
+    .tp_dealloc = (destructor)view_dealloc,
+    .tp_traverse = (traverseproc)view_traverse,
+    .tp_clear = (inquiry)view_clear,
+    .tp_repr = (reprfunc)view_repr,
+    .tp_as_sequence = &view_as_sequence,
+    .tp_as_mapping = &view_as_mapping,
+    .tp_as_buffer = &view_as_buffer,
+    .tp_getset = view_getset,
+};
+
+/***
+ * DexIndex
+ */
+static int
+dex_init(DexIndexObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"buffer", NULL};
+    Py_buffer buffer;
+    PyObject *source;
+    int ret, i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &source))
+        return (-1);
+
+    if (self->analyzed)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "DexIndex already initialized");
+        return (-1);
+    }
+
+    if (PyObject_GetBuffer(source, &buffer, PyBUF_SIMPLE) < 0)
+        return (-1);
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = parse_dex_index(&self->index, buffer.buf, (size_t)buffer.len);
+    Py_END_ALLOW_THREADS
+
+    if (ret < 0)
+    {
+        PyBuffer_Release(&buffer);
+        PyErr_SetString(PyExc_ValueError, "incorrect dex, the index cannot be built");
+        return (-1);
+    }
+
+    self->buffer = buffer;
+    self->analyzed = 1;
+
+    for (i = 0; i < DEX_NUMBER_OF_TABLES; i++)
+        Py_CLEAR(self->views[i]);
+
+    return (0);
+}
+
+static int
+dex_traverse(DexIndexObject *self, visitproc visit, void *arg)
+{
+    int i;
+
+    for (i = 0; i < DEX_NUMBER_OF_TABLES; i++)
+        Py_VISIT(self->views[i]);
+
+    return (0);
+}
+
+static int
+dex_clear(DexIndexObject *self)
+{
+    int i;
+
+    for (i = 0; i < DEX_NUMBER_OF_TABLES; i++)
+        Py_CLEAR(self->views[i]);
+
+    return (0);
+}
+
+static void
+dex_dealloc(DexIndexObject *self)
+{
+    PyTypeObject *type = Py_TYPE(self);
+
+    PyObject_GC_UnTrack(self);
+    dex_clear(self);
+
+    if (self->buffer.obj != NULL)
+        PyBuffer_Release(&self->buffer);
+
+    type->tp_free((PyObject *)self);
+}
+
+static PyObject *
+dex_close(DexIndexObject *self, PyObject *unused)
+{
+    if (self->exports > 0)
+    {
+        PyErr_SetString(PyExc_BufferError, "cannot close a DexIndex with exported buffers");
+        return (NULL);
+    }
+
+    if (self->in_use > 0)
+    {
+        PyErr_SetString(PyExc_BufferError, "cannot close a DexIndex in use by another thread");
+        return (NULL);
+    }
+
+    if (self->buffer.obj != NULL)
+        PyBuffer_Release(&self->buffer);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+dex_enter(DexIndexObject *self, PyObject *unused)
+{
+    Py_INCREF(self);
+
+    return ((PyObject *)self);
+}
+
+static PyObject *
+dex_exit(DexIndexObject *self, PyObject *args)
+{
+    return (dex_close(self, NULL));
+}
+
+static PyObject *
+dex_get_header(DexIndexObject *self, void *closure)
+{
+    const Dex_Header *header = &self->index.header;
+
+    if (!self->analyzed)
+        Py_RETURN_NONE;
+
+    return (new_entry(&Dex_HeaderType, "(y#Iy#IIIIIIIIIIIIIIIIIII)",
+                      (const char *)header->magic, (Py_ssize_t)sizeof(header->magic), header->checksum,
+                      (const char *)header->signature, (Py_ssize_t)sizeof(header->signature),
+                      header->file_size, header->header_size, header->endian_tag, header->link_size,
+                      header->link_off, header->map_off, header->string_ids_size, header->string_ids_off,
+                      header->type_ids_size, header->type_ids_off, header->proto_ids_size,
+                      header->proto_ids_off, header->field_ids_size, header->field_ids_off,
+                      header->method_ids_size, header->method_ids_off, header->class_defs_size,
+                      header->class_defs_off, header->data_size, header->data_off));
+}
+
+static PyObject *
+dex_get_view(DexIndexObject *self, void *closure)
+{
+    int kind = (int)(intptr_t)closure;
+
+    if (self->views[kind] == NULL && check_open(self) < 0)
+        return (NULL);
+
+    if (self->views[kind] == NULL && (self->views[kind] = new_view(self, kind)) == NULL)
+        return (NULL);
+
+    Py_INCREF(self->views[kind]);
+
+    return (self->views[kind]);
+}
+
+static PyObject *
+dex_get_closed(DexIndexObject *self, void *closure)
+{
+    return (PyBool_FromLong(self->analyzed && self->buffer.obj == NULL));
+}
+
+static PyObject *
+dex_get_size(DexIndexObject *self, void *closure)
+{
+    return (PyLong_FromSize_t(self->index.size));
+}
+
+static PyObject *
+string_bytes(const uint8_t *data, size_t length, const char *kind, unsigned long index)
+{
+    if (data == NULL)
+    {
+        PyErr_Format(PyExc_IndexError, "%s %lu out of range or out of dex bound", kind, index);
+        return (NULL);
+    }
+
+    return (PyBytes_FromStringAndSize((const char *)data, (Py_ssize_t)length));
+}
+
+/***
+ * Raw MUTF-8 bytes of a string (or of the descriptor of a
+ * type), read from the string_data_item in place.
+ */
+static PyObject *
+dex_string_data_method(DexIndexObject *self, PyObject *arg)
+{
+    const uint8_t *data = NULL;
+    unsigned long string_idx;
+    uint32_t utf16_size;
+    size_t length = 0;
+
+    if ((string_idx = PyLong_AsUnsignedLong(arg)) == (unsigned long)-1 && PyErr_Occurred())
+        return (NULL);
+
+    if (check_open(self) < 0)
+        return (NULL);
+
+    if (string_idx <= UINT32_MAX)
+        data = dex_string_data(&self->index, (uint32_t)string_idx, &utf16_size, &length);
+
+    return (string_bytes(data, length, "string", string_idx));
+}
+
+static PyObject *
+dex_type_descriptor_method(DexIndexObject *self, PyObject *arg)
+{
+    const uint8_t *data = NULL;
+    unsigned long type_idx;
+    size_t length = 0;
+
+    if ((type_idx = PyLong_AsUnsignedLong(arg)) == (unsigned long)-1 && PyErr_Occurred())
+        return (NULL);
+
+    if (check_open(self) < 0)
+        return (NULL);
+
+    if (type_idx <= UINT32_MAX)
+        data = dex_type_descriptor(&self->index, (uint32_t)type_idx, &length);
+
+    return (string_bytes(data, length, "type", type_idx));
+}
+
+/***
+ * Decoded strings, ASCII strings are copied to the new
+ * str without decoding.
+ */
+static PyObject *
+string_object(const uint8_t *data, size_t length, uint8_t **scratch, size_t *scratch_size)
+{
+    PyObject *string;
+    uint8_t *new_scratch;
+
+    if (mutf8_plain_length(data, length, 0) == length)
+    {
+        if ((string = PyUnicode_New((Py_ssize_t)length, 127)) != NULL)
+            memcpy(PyUnicode_DATA(string), data, length);
+
+        return (string);
+    }
+
+    if (3 * length > *scratch_size)
+    {
+        if ((new_scratch = PyMem_Realloc(*scratch, 3 * length)) == NULL)
+            return (PyErr_NoMemory());
+
+        *scratch = new_scratch;
+        *scratch_size = 3 * length;
+    }
+
+    return (PyUnicode_DecodeUTF8((const char *)*scratch, (Py_ssize_t)mutf8_to_utf8(data, length, *scratch, 0),
+                                 "strict"));
+}
+
+static PyObject *
+dex_string_method(DexIndexObject *self, PyObject *arg)
+{
+    const uint8_t *data = NULL;
+    unsigned long string_idx;
+    uint8_t *scratch = NULL;
+    size_t length = 0, scratch_size = 0;
+    uint32_t utf16_size;
+    PyObject *string;
+
+    if ((string_idx = PyLong_AsUnsignedLong(arg)) == (unsigned long)-1 && PyErr_Occurred())
+        return (NULL);
+
+    if (check_open(self) < 0)
+        return (NULL);
+
+    if (string_idx <= UINT32_MAX)
+        data = dex_string_data(&self->index, (uint32_t)string_idx, &utf16_size, &length);
+
+    if (data == NULL)
+        return (string_bytes(data, length, "string", string_idx));
+
+    string = string_object(data, length, &scratch, &scratch_size);
+    PyMem_Free(scratch);
+
+    return (string);
+}
+
+static PyObject *
+dex_strings(DexIndexObject *self, PyObject *unused)
+{
+    uint32_t i, count, utf16_size;
+    uint8_t *scratch = NULL;
+    size_t length, scratch_size = 0;
+    const uint8_t *data;
+    PyObject *list, *string;
+
+    if (check_open(self) < 0)
+        return (NULL);
+
+    count = self->index.tables[DEX_TABLE_STRING_IDS].count;
+
+    if ((list = PyList_New(count)) == NULL)
+        return (NULL);
+
+    for (i = 0; i < count; i++)
+    {
+        if ((data = dex_string_data(&self->index, i, &utf16_size, &length)) == NULL)
+            string = string_bytes(data, length, "string", i);
+        else
+            string = string_object(data, length, &scratch, &scratch_size);
+
+        if (string == NULL)
+        {
+            Py_CLEAR(list);
+            break;
+        }
+
+        PyList_SET_ITEM(list, i, string);
+    }
+
+    PyMem_Free(scratch);
+
+    return (list);
+}
+
+/***
+ * Write every string to fd (without the GIL), as escaped
+ * lines or prefixed by their uint32 length with binary.
+ */
+static PyObject *
+dex_dump_strings_method(DexIndexObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"fd", "binary", NULL};
+    uint32_t number_of_strings = 0;
+    int fd, binary = 0, ret;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|p:dump_strings", kwlist, &fd, &binary))
+        return (NULL);
+
+    if (check_open(self) < 0)
+        return (NULL);
+
+    self->in_use++;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dex_dump_strings(&self->index, fd, binary ? DEX_STRINGS_BINARY : DEX_STRINGS_LINES, &number_of_strings);
+    Py_END_ALLOW_THREADS
+    self->in_use--;
+
+    if (ret < 0)
+    {
+        PyErr_Format(PyExc_OSError, "strings cannot be dumped (%u written)", number_of_strings);
+        return (NULL);
+    }
+
+    return (PyLong_FromUnsignedLong(number_of_strings));
+}
+
+static PyObject *
+uint32_array(PyObject *bytes)
+{
+    PyObject *view, *array;
+
+    if (bytes == NULL || (view = PyMemoryView_FromObject(bytes)) == NULL)
+        return (NULL);
+
+    array = PyObject_CallMethod(view, "cast", "s", "I");
+    Py_DECREF(view);
+
+    return (array);
+}
+
+/***
+ * Methods of every class def in class_data order, decoded
+ * in one call (without the GIL) into packed uint32 arrays:
+ * memoryviews of format 'I' with the first method of each
+ * class (plus the number of methods at the end), method_idx,
+ * access_flags and code_off of each method.
+ */
+static PyObject *
+dex_class_data(DexIndexObject *self, PyObject *unused)
+{
+    uint32_t classes, capacity, number_of_methods = 0;
+    PyObject *arrays[4] = {NULL, NULL, NULL, NULL}, *class_data = NULL;
+    uint32_t *pointers[4];
+    int i, ret;
+
+    if (check_open(self) < 0)
+        return (NULL);
+
+    classes = self->index.tables[DEX_TABLE_CLASS_DEFS].count;
+    capacity = self->index.tables[DEX_TABLE_METHOD_IDS].count;
+
+    for (i = 0; i < 4; i++)
+    {
+        arrays[i] = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)(i == 0 ? classes + 1ULL : capacity) * sizeof(uint32_t));
+        if (arrays[i] == NULL)
+            goto end;
+
+        pointers[i] = (uint32_t *)PyBytes_AS_STRING(arrays[i]);
+    }
+
+    self->in_use++;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dex_decode_class_data(&self->index, pointers[0], pointers[1], pointers[2], pointers[3], capacity,
+                                &number_of_methods);
+    Py_END_ALLOW_THREADS
+    self->in_use--;
+
+    if (ret < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "incorrect class_data, the methods cannot be decoded");
+        goto end;
+    }
+
+    for (i = 1; i < 4; i++)
+    {
+        if (_PyBytes_Resize(&arrays[i], (Py_ssize_t)number_of_methods * sizeof(uint32_t)) < 0)
+            goto end;
+    }
+
+    if ((class_data = PyStructSequence_New(&Dex_ClassDataType)) == NULL)
+        goto end;
+
+    for (i = 0; i < 4; i++)
+    {
+        PyObject *array = uint32_array(arrays[i]);
+
+        if (array == NULL)
+        {
+            Py_CLEAR(class_data);
+            goto end;
+        }
+
+        PyStructSequence_SET_ITEM(class_data, i, array);
+    }
+
+end:
+    for (i = 0; i < 4; i++)
+        Py_XDECREF(arrays[i]);
+
+    return (class_data);
+}
+
+static PyMethodDef dex_methods[] = {
+    {"close", (PyCFunction)dex_close, METH_NOARGS, "release the buffer of the dex"},
+    {"__enter__", (PyCFunction)dex_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)dex_exit, METH_VARARGS, NULL},
+    {"string_data", (PyCFunction)dex_string_data_method, METH_O, "string_data(string_idx) -> MUTF-8 bytes"},
+    {"type_descriptor", (PyCFunction)dex_type_descriptor_method, METH_O, "type_descriptor(type_idx) -> MUTF-8 bytes"},
+    {"string", (PyCFunction)dex_string_method, METH_O, "string(string_idx) -> decoded str"},
+    {"strings", (PyCFunction)dex_strings, METH_NOARGS, "strings() -> list of every decoded string"},
+    {"dump_strings", (PyCFunction)(void (*)(void))dex_dump_strings_method, METH_VARARGS | METH_KEYWORDS,
+     "dump_strings(fd, binary=False) -> number of strings written"},
+    {"class_data", (PyCFunction)dex_class_data, METH_NOARGS, "class_data() -> Dex_ClassData of uint32 arrays"},
+    {NULL}
+};
+
+static PyGetSetDef dex_getset[] = {
+    {"header", (getter)dex_get_header, NULL, "dex header", NULL},
+    {"string_ids", (getter)dex_get_view, NULL, "string_id_item table", (void *)DEX_TABLE_STRING_IDS},
+    {"type_ids", (getter)dex_get_view, NULL, "type_id_item table", (void *)DEX_TABLE_TYPE_IDS},
+    {"proto_ids", (getter)dex_get_view, NULL, "proto_id_item table", (void *)DEX_TABLE_PROTO_IDS},
+    {"field_ids", (getter)dex_get_view, NULL, "field_id_item table", (void *)DEX_TABLE_FIELD_IDS},
+    {"method_ids", (getter)dex_get_view, NULL, "method_id_item table", (void *)DEX_TABLE_METHOD_IDS},
+    {"class_defs", (getter)dex_get_view, NULL, "class_def_item table", (void *)DEX_TABLE_CLASS_DEFS},
+    {"map_list", (getter)dex_get_view, NULL, "items of map_list", (void *)DEX_TABLE_MAP_LIST},
+    {"size", (getter)dex_get_size, NULL, "size of the dex (file_size of the header)", NULL},
+    {"closed", (getter)dex_get_closed, NULL, NULL, NULL},
+    {NULL}
+};
+
+static PyTypeObject DexIndexType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_dex.DexIndex",
+    .tp_doc = "DexIndex(buffer): index of the dex in buffer with lazy views of its tables",
+    .tp_basicsize = sizeof(DexIndexObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)dex_init,
+    .tp_dealloc = (destructor)dex_dealloc,
+    .tp_traverse = (traverseproc)dex_traverse,
+    .tp_clear = (inquiry)dex_clear,
+    .tp_methods = dex_methods,
+    .tp_getset = dex_getset,
+};
+
+static struct PyModuleDef dex_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "_dex",
+    .m_doc = "Native dex index of elfparser_e",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC
+PyInit__dex(void)
+{
+    struct { PyTypeObject *type; PyStructSequence_Desc *desc; } entry_types[] = {
+        {&Dex_HeaderType, &header_desc}, {&Dex_StringIdType, &string_id_desc}, {&Dex_TypeIdType, &type_id_desc},
+        {&Dex_ProtoIdType, &proto_id_desc}, {&Dex_FieldIdType, &field_id_desc},
+        {&Dex_MethodIdType, &method_id_desc}, {&Dex_ClassDefType, &class_def_desc},
+        {&Dex_MapItemType, &map_item_desc}, {&Dex_ClassDataType, &class_data_desc},
+    };
+    struct { const char *name; long value; } constants[] = {
+        {"TYPE_HEADER_ITEM", DEX_TYPE_HEADER_ITEM}, {"TYPE_STRING_ID_ITEM", DEX_TYPE_STRING_ID_ITEM},
+        {"TYPE_TYPE_ID_ITEM", DEX_TYPE_TYPE_ID_ITEM}, {"TYPE_PROTO_ID_ITEM", DEX_TYPE_PROTO_ID_ITEM},
+        {"TYPE_FIELD_ID_ITEM", DEX_TYPE_FIELD_ID_ITEM}, {"TYPE_METHOD_ID_ITEM", DEX_TYPE_METHOD_ID_ITEM},
+        {"TYPE_CLASS_DEF_ITEM", DEX_TYPE_CLASS_DEF_ITEM}, {"TYPE_CALL_SITE_ID_ITEM", DEX_TYPE_CALL_SITE_ID_ITEM},
+        {"TYPE_METHOD_HANDLE_ITEM", DEX_TYPE_METHOD_HANDLE_ITEM}, {"TYPE_MAP_LIST", DEX_TYPE_MAP_LIST},
+        {"TYPE_TYPE_LIST", DEX_TYPE_TYPE_LIST}, {"TYPE_ANNOTATION_SET_REF_LIST", DEX_TYPE_ANNOTATION_SET_REF_LIST},
+        {"TYPE_ANNOTATION_SET_ITEM", DEX_TYPE_ANNOTATION_SET_ITEM}, {"TYPE_CLASS_DATA_ITEM", DEX_TYPE_CLASS_DATA_ITEM},
+        {"TYPE_CODE_ITEM", DEX_TYPE_CODE_ITEM}, {"TYPE_STRING_DATA_ITEM", DEX_TYPE_STRING_DATA_ITEM},
+        {"TYPE_DEBUG_INFO_ITEM", DEX_TYPE_DEBUG_INFO_ITEM}, {"TYPE_ANNOTATION_ITEM", DEX_TYPE_ANNOTATION_ITEM},
+        {"TYPE_ENCODED_ARRAY_ITEM", DEX_TYPE_ENCODED_ARRAY_ITEM},
+        {"TYPE_ANNOTATIONS_DIRECTORY_ITEM", DEX_TYPE_ANNOTATIONS_DIRECTORY_ITEM},
+        {"TYPE_HIDDENAPI_CLASS_DATA_ITEM", DEX_TYPE_HIDDENAPI_CLASS_DATA_ITEM},
+        {"NO_INDEX", DEX_NO_INDEX},
+    };
+    PyObject *module;
+    size_t i;
+
+    if (PyType_Ready(&DexIndexType) < 0 || PyType_Ready(&DexTableViewType) < 0)
+        return (NULL);
+
+    if ((module = PyModule_Create(&dex_module)) == NULL)
+        return (NULL);
+
+    for (i = 0; i < sizeof(entry_types) / sizeof(entry_types[0]); i++)
+    {
+        if (entry_types[i].type->tp_name == NULL &&
+            PyStructSequence_InitType2(entry_types[i].type, entry_types[i].desc) < 0)
+            goto error;
+
+        if (PyModule_AddObjectRef(module, strchr(entry_types[i].desc->name, '.') + 1,
+                                  (PyObject *)entry_types[i].type) < 0)
+            goto error;
+    }
+
+    for (i = 0; i < sizeof(constants) / sizeof(constants[0]); i++)
+    {
+        if (PyModule_AddIntConstant(module, constants[i].name, constants[i].value) < 0)
+            goto error;
+    }
+
+    if (PyModule_AddObjectRef(module, "DexIndex", (PyObject *)&DexIndexType) < 0 ||
+        PyModule_AddObjectRef(module, "DexTableView", (PyObject *)&DexTableViewType) < 0)
+        goto error;
+
+    return (module);
+
+error:
+    Py_DECREF(module);
+    return (NULL);
+}
@@ -0,0 +1,312 @@
+#include "dex_index.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STRINGS_HAS_AVX2 1
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define STRINGS_HAS_SSE2 1
+#endif
+
+#define UNICODE_REPLACEMENT_CHARACTER   0xFFFD
+
+/***
+ * Plain runs: bytes copied as they are from MUTF-8 to
+ * UTF-8, ASCII (without '\n' and '\\' when escaping).
+ * Strings are checked 32 bytes at a time with AVX2, 16
+ * with SSE2, and the rest byte by byte.
+ */
+#define IS_SPECIAL(c, escape)   ((c) >= 0x80 || ((escape) && ((c) == '\n' || (c) == '\\')))
+
+#ifdef STRINGS_HAS_AVX2
+__attribute__((target("avx2")))
+static size_t
+plain_run_avx2(const uint8_t *data, size_t length, int escape)
+{
+    const __m256i newline = _mm256_set1_epi8('\n'), backslash = _mm256_set1_epi8('\\');
+    uint32_t mask;
+    __m256i chars;
+    size_t i;
+
+    for (i = 0; i + 32 <= length; i += 32)
+    {
+        chars = _mm256_loadu_si256((const __m256i *)(data + i));
+        mask = (uint32_t)_mm256_movemask_epi8(chars);
+
+        if (escape)
+            mask |= (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chars, newline),
+                                                                   _mm256_cmpeq_epi8(chars, backslash)));
+
+        if (mask != 0)
+            return (i + (size_t)__builtin_ctz(mask));
+    }
+
+    return (i);
+}
+#endif
+
+#ifdef STRINGS_HAS_SSE2
+static size_t
+plain_run_sse2(const uint8_t *data, size_t length, int escape)
+{
+    const __m128i newline = _mm_set1_epi8('\n'), backslash = _mm_set1_epi8('\\');
+    uint32_t mask;
+    __m128i chars;
+    size_t i;
+
+    for (i = 0; i + 16 <= length; i += 16)
+    {
+        chars = _mm_loadu_si128((const __m128i *)(data + i));
+        mask = (uint32_t)_mm_movemask_epi8(chars);
+
+        if (escape)
+            mask |= (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, newline),
+                                                             _mm_cmpeq_epi8(chars, backslash)));
+
+        if (mask != 0)
+            return (i + (size_t)__builtin_ctz(mask));
+    }
+
+    return (i);
+}
+#endif
+
+size_t
+mutf8_plain_length(const uint8_t *data, size_t length, int escape)
+{
+    size_t i = 0;
+#ifdef STRINGS_HAS_AVX2
+    static int has_avx2 = -1;
+
+    if (has_avx2 < 0)
+        has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+
+    if (has_avx2 && length >= 32)
+        i = plain_run_avx2(data, length, escape);
+#endif
+#ifdef STRINGS_HAS_SSE2
+    // the blocks before i are plain, stop at a special byte
+    if (length - i >= 16 && !IS_SPECIAL(data[i], escape))
+        i += plain_run_sse2(data + i, length - i, escape);
+#endif
+
+    while (i < length && !IS_SPECIAL(data[i], escape))
+        i++;
+
+    return (i);
+}
+
+static size_t
+put_utf8(uint8_t *out, uint32_t code_point, int escape)
+{
+    if (escape && (code_point == '\n' || code_point == '\\'))
+    {
+        out[0] = '\\';
+        out[1] = code_point == '\n' ? 'n' : '\\';
+        return (2);
+    }
+
+    if (code_point < 0x80)
+    {
+        out[0] = (uint8_t)code_point;
+        return (1);
+    }
+
+    if (code_point < 0x800)
+    {
+        out[0] = (uint8_t)(0xc0 | (code_point >> 6));
+        out[1] = (uint8_t)(0x80 | (code_point & 0x3f));
+        return (2);
+    }
+
+    if (code_point < 0x10000)
+    {
+        out[0] = (uint8_t)(0xe0 | (code_point >> 12));
+        out[1] = (uint8_t)(0x80 | ((code_point >> 6) & 0x3f));
+        out[2] = (uint8_t)(0x80 | (code_point & 0x3f));
+        return (3);
+    }
+
+    out[0] = (uint8_t)(0xf0 | (code_point >> 18));
+    out[1] = (uint8_t)(0x80 | ((code_point >> 12) & 0x3f));
+    out[2] = (uint8_t)(0x80 | ((code_point >> 6) & 0x3f));
+    out[3] = (uint8_t)(0x80 | (code_point & 0x3f));
+    return (4);
+}
+
+// three byte MUTF-8 sequence at data (a UTF-16 code unit), 0 if there is none
+static uint32_t
+read_three_bytes(const uint8_t *data, size_t length)
+{
+    if (length < 3 || (data[0] & 0xf0) != 0xe0 || (data[1] & 0xc0) != 0x80 || (data[2] & 0xc0) != 0x80)
+        return (0);
+
+    return (((uint32_t)(data[0] & 0x0f) << 12) | ((uint32_t)(data[1] & 0x3f) << 6) | (data[2] & 0x3f));
+}
+
+size_t
+mutf8_to_utf8(const uint8_t *data, size_t length, uint8_t *out, int escape)
+{
+    size_t i = 0, o = 0, run;
+    uint32_t code_point, low;
+    uint8_t c;
+
+    while (i < length)
+    {
+        run = mutf8_plain_length(data + i, length - i, escape);
+        memcpy(out + o, data + i, run);
+        i += run;
+        o += run;
+
+        if (i == length)
+            break;
+
+        c = data[i];
+
+        if (c < 0x80)
+        {
+            // '\n' or '\\' to escape
+            code_point = c;
+            i++;
+        }
+        else if ((c & 0xe0) == 0xc0 && i + 1 < length && (data[i + 1] & 0xc0) == 0x80)
+        {
+            // also the two byte NUL (0xC0 0x80) of MUTF-8
+            code_point = ((uint32_t)(c & 0x1f) << 6) | (data[i + 1] & 0x3f);
+            i += 2;
+        }
+        else if ((code_point = read_three_bytes(data + i, length - i)) != 0)
+        {
+            i += 3;
+
+            // supplementary characters are surrogate pairs of three bytes each
+            if (code_point >= 0xd800 && code_point <= 0xdbff &&
+                (low = read_three_bytes(data + i, length - i)) >= 0xdc00 && low <= 0xdfff)
+            {
+                code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+                i += 3;
+            }
+            else if (code_point >= 0xd800 && code_point <= 0xdfff)
+                code_point = UNICODE_REPLACEMENT_CHARACTER;
+        }
+        else
+        {
+            code_point = UNICODE_REPLACEMENT_CHARACTER;
+            i++;
+        }
+
+        o += put_utf8(out + o, code_point, escape);
+    }
+
+    return (o);
+}
+
+/***
+ * Bulk dump
+ */
+static int
+write_all(int fd, const uint8_t *buf, size_t len)
+{
+    ssize_t written;
+
+    while (len > 0)
+    {
+        if ((written = write(fd, buf, len)) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            perror("dex_dump_strings");
+            return (-1);
+        }
+
+        buf += written;
+        len -= (size_t)written;
+    }
+
+    return (0);
+}
+
+int
+dex_dump_strings(const Dex_Index *index, int fd, int format, uint32_t *number_of_strings)
+{
+    size_t size = DEX_STRINGS_BLOCK_SIZE, used = 0, length, needed, decoded;
+    int escape = format == DEX_STRINGS_LINES;
+    const uint8_t *data;
+    uint8_t *buf, *new_buf;
+    uint32_t utf16_size, i;
+    int ret = 0;
+
+    if ((buf = malloc(size)) == NULL)
+    {
+        perror("dex_dump_strings");
+        return (-1);
+    }
+
+    for (i = 0; i < index->tables[DEX_TABLE_STRING_IDS].count; i++)
+    {
+        if ((data = dex_string_data(index, i, &utf16_size, &length)) == NULL)
+        {
+            fprintf(stderr, "dex_dump_strings: string %u out of dex bound\n", i);
+            ret = -1;
+            break;
+        }
+
+        // UTF-8 takes three times the MUTF-8 bytes at most, plus the length or the newline
+        needed = 3 * length + sizeof(uint32_t);
+
+        if (used + needed > size)
+        {
+            if (write_all(fd, buf, used) < 0)
+            {
+                ret = -1;
+                break;
+            }
+
+            used = 0;
+        }
+
+        // strings longer than a block get a buffer of their size
+        if (needed > size)
+        {
+            if ((new_buf = realloc(buf, needed)) == NULL)
+            {
+                perror("dex_dump_strings");
+                ret = -1;
+                break;
+            }
+
+            buf = new_buf;
+            size = needed;
+        }
+
+        if (escape)
+        {
+            used += mutf8_to_utf8(data, length, buf + used, 1);
+            buf[used++] = '\n';
+        }
+        else
+        {
+            decoded = mutf8_to_utf8(data, length, buf + used + sizeof(uint32_t), 0);
+            buf[used]     = (uint8_t)(decoded);
+            buf[used + 1] = (uint8_t)(decoded >> 8);
+            buf[used + 2] = (uint8_t)(decoded >> 16);
+            buf[used + 3] = (uint8_t)(decoded >> 24);
+            used += sizeof(uint32_t) + decoded;
+        }
+    }
+
+    if (ret == 0 && write_all(fd, buf, used) < 0)
+        ret = -1;
+
+    free(buf);
+
+    *number_of_strings = i;
+
+    return (ret);
+}
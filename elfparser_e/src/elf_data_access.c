@@ -15,6 +15,9 @@ extern uint64_t dynsym_num;
 extern uint64_t symtab_num;
 extern size_t  rel_sections;
 extern size_t  rela_sections;
+
+extern uint8_t *buf_ptr;
+extern size_t buf_ptr_size;
 /***
  * Elf header
  * Interesting functions for python
@@ -907,4 +910,53 @@ size_t
 rela_64_size()
 {
     return sizeof(Elf64_Rela);
-}
\ No newline at end of file
+}
+
+/***
+ * Mapped data
+ * Pointers to the parsed file mapping, valid
+ * until close_everything is called.
+ */
+const uint8_t *
+file_range(uint64_t offset, uint64_t size)
+{
+    if (buf_ptr == NULL ||
+        offset > buf_ptr_size ||
+        size > buf_ptr_size - offset)
+    {
+        return (NULL);
+    }
+
+    return (buf_ptr + offset);
+}
+
+const uint8_t *
+section_data(size_t header, uint64_t *size)
+{
+    if (elf_ehdr == NULL ||
+        elf_shdr == NULL ||
+        header >= elf_ehdr->e_shnum)
+    {
+        return (NULL);
+    }
+
+    // no bytes in the file
+    *size = elf_shdr[header].sh_type == SHT_NOBITS ? 0 : elf_shdr[header].sh_size;
+
+    return (file_range(elf_shdr[header].sh_offset, *size));
+}
+
+const uint8_t *
+segment_data(size_t header, uint64_t *size)
+{
+    if (elf_ehdr == NULL ||
+        elf_phdr == NULL ||
+        header >= elf_ehdr->e_phnum)
+    {
+        return (NULL);
+    }
+
+    *size = elf_phdr[header].p_filesz;
+
+    return (file_range(elf_phdr[header].p_offset, *size));
+}
@@ -0,0 +1,1392 @@
+/***
+ * _elf: CPython extension module of elfparser_e.
+ *
+ * The file is mapped when an Elf is created and only the
+ * ELF header is read (with the GIL released), the tables
+ * are exposed as lazy sequence views which build their
+ * entries from the mapping when they are indexed. Views
+ * with a single table support the buffer protocol to get
+ * the raw table bytes, the mapping is not released while
+ * a buffer is exported or while a call reads it without
+ * the GIL. The Elf itself exports the whole
+ * mapping (file_range, section_data and segment_data are
+ * slices of it).
+ *
+ * Every Elf has its own mapping, the global state of
+ * elf_parser.c is not used.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "elf_generic_types.h"
+
+#define ELF_VIEW_SEGMENTS       0
+#define ELF_VIEW_SECTIONS       1
+#define ELF_VIEW_SYMBOLS        2
+#define ELF_VIEW_RELOCATIONS    3
+#define ELF_NUMBER_OF_VIEWS     4
+
+static const char *view_names[ELF_NUMBER_OF_VIEWS] = {"segments", "sections", "symbols", "relocations"};
+
+typedef struct
+{
+    PyObject_HEAD
+    uint8_t    *buf_ptr;
+    size_t      file_size;
+    int         is_64_bit;
+    int         analyzed;
+    Elf_Ehdr    ehdr;
+    Py_ssize_t  exports;        // buffers exported by the views
+    Py_ssize_t  in_use;         // calls reading the mapping without the GIL
+    PyObject   *path;
+    PyObject   *views[ELF_NUMBER_OF_VIEWS];
+} ElfObject;
+
+/***
+ * A table in the file: program headers, section headers,
+ * a symbol table or a relocation section. Views chain one
+ * or more tables (.dynsym and .symtab for the symbols).
+ */
+typedef struct
+{
+    uint64_t    offset;
+    Py_ssize_t  count;
+    Py_ssize_t  first;          // index of the first entry in the view
+    size_t      entry_size;
+    uint32_t    section;        // section of the table (0 for headers)
+    uint32_t    link;           // string table of symbol tables
+    uint32_t    type;           // SHT_* of the section
+} Elf_Table;
+
+typedef struct
+{
+    PyObject_HEAD
+    ElfObject  *elf;
+    int         kind;
+    Py_ssize_t  length;
+    Py_ssize_t  number_of_tables;
+    Elf_Table  *tables;
+} ElfTableViewObject;
+
+static PyTypeObject ElfType;
+static PyTypeObject ElfTableViewType;
+
+static PyTypeObject Elf_EhdrType;
+static PyTypeObject Elf_PhdrType;
+static PyTypeObject Elf_ShdrType;
+static PyTypeObject Elf_SymType;
+static PyTypeObject Elf_RelType;
+static PyTypeObject Elf_RelaType;
+
+static PyStructSequence_Field ehdr_fields[] = {
+    {"e_ident", NULL}, {"e_type", NULL}, {"e_machine", NULL}, {"e_version", NULL},
+    {"e_entry", NULL}, {"e_phoff", NULL}, {"e_shoff", NULL}, {"e_flags", NULL},
+    {"e_ehsize", NULL}, {"e_phentsize", NULL}, {"e_phnum", NULL}, {"e_shentsize", NULL},
+    {"e_shnum", NULL}, {"e_shstrndx", NULL}, {NULL}
+};
+
+static PyStructSequence_Field phdr_fields[] = {
+    {"p_type", NULL}, {"p_flags", NULL}, {"p_offset", NULL}, {"p_vaddr", NULL},
+    {"p_paddr", NULL}, {"p_filesz", NULL}, {"p_memsz", NULL}, {"p_align", NULL}, {NULL}
+};
+
+static PyStructSequence_Field shdr_fields[] = {
+    {"sh_name_offset", NULL}, {"sh_name", NULL}, {"sh_type", NULL}, {"sh_flags", NULL},
+    {"sh_addr", NULL}, {"sh_offset", NULL}, {"sh_size", NULL}, {"sh_link", NULL},
+    {"sh_info", NULL}, {"sh_addralign", NULL}, {"sh_entsize", NULL}, {NULL}
+};
+
+static PyStructSequence_Field sym_fields[] = {
+    {"st_name_offset", NULL}, {"st_name", NULL}, {"st_info", NULL}, {"st_other", NULL},
+    {"st_shndx", NULL}, {"st_value", NULL}, {"st_size", NULL}, {NULL}
+};
+
+static PyStructSequence_Field rel_fields[] = {
+    {"r_offset", NULL}, {"r_info", NULL}, {NULL}
+};
+
+static PyStructSequence_Field rela_fields[] = {
+    {"r_offset", NULL}, {"r_info", NULL}, {"r_addend", NULL}, {NULL}
+};
+
+static PyStructSequence_Desc ehdr_desc = {"_elf.Elf_Ehdr", "ELF header", ehdr_fields, 14};
+static PyStructSequence_Desc phdr_desc = {"_elf.Elf_Phdr", "Program header", phdr_fields, 8};
+static PyStructSequence_Desc shdr_desc = {"_elf.Elf_Shdr", "Section header", shdr_fields, 11};
+static PyStructSequence_Desc sym_desc = {"_elf.Elf_Sym", "Symbol", sym_fields, 7};
+static PyStructSequence_Desc rel_desc = {"_elf.Elf_Rel", "Relocation", rel_fields, 2};
+static PyStructSequence_Desc rela_desc = {"_elf.Elf_Rela", "Relocation with addend", rela_fields, 3};
+
+/***
+ * Mapping and header parsing, called without the GIL.
+ * Returns 0, -1 with errno set or -2 for a file which
+ * is not a correct ELF (error describes the problem).
+ */
+static int
+map_elf(const char *pathname, uint8_t **buf_ptr, size_t *file_size, Elf_Ehdr *ehdr, int *is_64_bit,
+        const char **error)
+{
+    struct stat st;
+    uint8_t *buf;
+    size_t size;
+    uint64_t phdr_size, shdr_size;
+    int fd;
+
+    if ((fd = open(pathname, O_RDONLY | O_CLOEXEC)) < 0)
+        return (-1);
+
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return (-1);
+    }
+
+    size = (size_t)st.st_size;
+
+    if (size < EI_NIDENT)
+    {
+        close(fd);
+        *error = "file too small to be an ELF";
+        return (-2);
+    }
+
+    buf = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (buf == MAP_FAILED)
+        return (-1);
+
+    *error = NULL;
+
+    if (memcmp(buf, ELFMAG, SELFMAG) != 0)
+        *error = "elf incorrect header";
+    else if (buf[EI_CLASS] == ELFCLASS32 && size >= sizeof(Elf32_Ehdr))
+    {
+        Elf32_Ehdr elf32_ehdr;
+
+        memcpy(&elf32_ehdr, buf, sizeof(Elf32_Ehdr));
+        memcpy(ehdr->e_ident, elf32_ehdr.e_ident, EI_NIDENT);
+        ehdr->e_type = elf32_ehdr.e_type;
+        ehdr->e_machine = elf32_ehdr.e_machine;
+        ehdr->e_version = elf32_ehdr.e_version;
+        ehdr->e_entry = elf32_ehdr.e_entry;
+        ehdr->e_phoff = elf32_ehdr.e_phoff;
+        ehdr->e_shoff = elf32_ehdr.e_shoff;
+        ehdr->e_flags = elf32_ehdr.e_flags;
+        ehdr->e_ehsize = elf32_ehdr.e_ehsize;
+        ehdr->e_phentsize = elf32_ehdr.e_phentsize;
+        ehdr->e_phnum = elf32_ehdr.e_phnum;
+        ehdr->e_shentsize = elf32_ehdr.e_shentsize;
+        ehdr->e_shnum = elf32_ehdr.e_shnum;
+        ehdr->e_shstrndx = elf32_ehdr.e_shstrndx;
+        *is_64_bit = 0;
+    }
+    else if (buf[EI_CLASS] == ELFCLASS64 && size >= sizeof(Elf64_Ehdr))
+    {
+        memcpy(ehdr, buf, sizeof(Elf64_Ehdr));
+        *is_64_bit = 1;
+    }
+    else
+        *error = "elf class not supported or truncated header";
+
+    if (*error == NULL)
+    {
+        phdr_size = (uint64_t)ehdr->e_phnum * (*is_64_bit ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr));
+        shdr_size = (uint64_t)ehdr->e_shnum * (*is_64_bit ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr));
+
+        if (ehdr->e_phnum != 0 && (ehdr->e_phoff > size || phdr_size > size - ehdr->e_phoff))
+            *error = "program header out of file bound";
+        else if (ehdr->e_shnum != 0 && (ehdr->e_shoff > size || shdr_size > size - ehdr->e_shoff))
+            *error = "section header out of file bound";
+    }
+
+    if (*error != NULL)
+    {
+        munmap(buf, size);
+        return (-2);
+    }
+
+    *buf_ptr = buf;
+    *file_size = size;
+
+    return (0);
+}
+
+/***
+ * Access to the mapped tables, entries are copied
+ * to the generic structures (mapping is unaligned).
+ */
+static int
+read_shdr(ElfObject *elf, size_t index, Elf_Shdr *shdr)
+{
+    if (index >= elf->ehdr.e_shnum)
+        return (-1);
+
+    if (elf->is_64_bit)
+    {
+        Elf64_Shdr elf64_shdr;
+
+        memcpy(&elf64_shdr, elf->buf_ptr + elf->ehdr.e_shoff + index * sizeof(Elf64_Shdr), sizeof(Elf64_Shdr));
+        shdr->sh_name = elf64_shdr.sh_name;
+        shdr->sh_type = elf64_shdr.sh_type;
+        shdr->sh_flags = elf64_shdr.sh_flags;
+        shdr->sh_addr = elf64_shdr.sh_addr;
+        shdr->sh_offset = elf64_shdr.sh_offset;
+        shdr->sh_size = elf64_shdr.sh_size;
+        shdr->sh_link = elf64_shdr.sh_link;
+        shdr->sh_info = elf64_shdr.sh_info;
+        shdr->sh_addralign = elf64_shdr.sh_addralign;
+        shdr->sh_entsize = elf64_shdr.sh_entsize;
+    }
+    else
+    {
+        Elf32_Shdr elf32_shdr;
+
+        memcpy(&elf32_shdr, elf->buf_ptr + elf->ehdr.e_shoff + index * sizeof(Elf32_Shdr), sizeof(Elf32_Shdr));
+        shdr->sh_name = elf32_shdr.sh_name;
+        shdr->sh_type = elf32_shdr.sh_type;
+        shdr->sh_flags = elf32_shdr.sh_flags;
+        shdr->sh_addr = elf32_shdr.sh_addr;
+        shdr->sh_offset = elf32_shdr.sh_offset;
+        shdr->sh_size = elf32_shdr.sh_size;
+        shdr->sh_link = elf32_shdr.sh_link;
+        shdr->sh_info = elf32_shdr.sh_info;
+        shdr->sh_addralign = elf32_shdr.sh_addralign;
+        shdr->sh_entsize = elf32_shdr.sh_entsize;
+    }
+
+    return (0);
+}
+
+static void
+read_phdr(ElfObject *elf, const uint8_t *entry, Elf_Phdr *phdr)
+{
+    if (elf->is_64_bit)
+    {
+        Elf64_Phdr elf64_phdr;
+
+        memcpy(&elf64_phdr, entry, sizeof(Elf64_Phdr));
+        phdr->p_type = elf64_phdr.p_type;
+        phdr->p_flags = elf64_phdr.p_flags;
+        phdr->p_offset = elf64_phdr.p_offset;
+        phdr->p_vaddr = elf64_phdr.p_vaddr;
+        phdr->p_paddr = elf64_phdr.p_paddr;
+        phdr->p_filesz = elf64_phdr.p_filesz;
+        phdr->p_memsz = elf64_phdr.p_memsz;
+        phdr->p_align = elf64_phdr.p_align;
+    }
+    else
+    {
+        Elf32_Phdr elf32_phdr;
+
+        memcpy(&elf32_phdr, entry, sizeof(Elf32_Phdr));
+        phdr->p_type = elf32_phdr.p_type;
+        phdr->p_flags = elf32_phdr.p_flags;
+        phdr->p_offset = elf32_phdr.p_offset;
+        phdr->p_vaddr = elf32_phdr.p_vaddr;
+        phdr->p_paddr = elf32_phdr.p_paddr;
+        phdr->p_filesz = elf32_phdr.p_filesz;
+        phdr->p_memsz = elf32_phdr.p_memsz;
+        phdr->p_align = elf32_phdr.p_align;
+    }
+}
+
+static void
+read_sym(ElfObject *elf, const uint8_t *entry, Elf_Sym *sym)
+{
+    if (elf->is_64_bit)
+    {
+        Elf64_Sym elf64_sym;
+
+        memcpy(&elf64_sym, entry, sizeof(Elf64_Sym));
+        sym->st_name = elf64_sym.st_name;
+        sym->st_info = elf64_sym.st_info;
+        sym->st_other = elf64_sym.st_other;
+        sym->st_shndx = elf64_sym.st_shndx;
+        sym->st_value = elf64_sym.st_value;
+        sym->st_size = elf64_sym.st_size;
+    }
+    else
+    {
+        Elf32_Sym elf32_sym;
+
+        memcpy(&elf32_sym, entry, sizeof(Elf32_Sym));
+        sym->st_name = elf32_sym.st_name;
+        sym->st_info = elf32_sym.st_info;
+        sym->st_other = elf32_sym.st_other;
+        sym->st_shndx = elf32_sym.st_shndx;
+        sym->st_value = elf32_sym.st_value;
+        sym->st_size = elf32_sym.st_size;
+    }
+}
+
+static void
+read_rela(ElfObject *elf, const uint8_t *entry, uint32_t type, Elf_Rela *rela)
+{
+    rela->r_addend = 0;
+
+    if (elf->is_64_bit)
+    {
+        Elf64_Rela elf64_rela;
+
+        memcpy(&elf64_rela, entry, type == SHT_RELA ? sizeof(Elf64_Rela) : sizeof(Elf64_Rel));
+        rela->r_offset = elf64_rela.r_offset;
+        rela->r_info = elf64_rela.r_info;
+        if (type == SHT_RELA)
+            rela->r_addend = elf64_rela.r_addend;
+    }
+    else
+    {
+        Elf32_Rela elf32_rela;
+
+        memcpy(&elf32_rela, entry, type == SHT_RELA ? sizeof(Elf32_Rela) : sizeof(Elf32_Rel));
+        rela->r_offset = elf32_rela.r_offset;
+        rela->r_info = elf32_rela.r_info;
+        if (type == SHT_RELA)
+            rela->r_addend = elf32_rela.r_addend;
+    }
+}
+
+/***
+ * String of a string table section, NULL if the section
+ * or the offset are not correct (name set to its length).
+ */
+static const char *
+get_string(ElfObject *elf, uint32_t section, uint32_t offset, size_t *length)
+{
+    Elf_Shdr strtab;
+    const char *string;
+
+    if (read_shdr(elf, section, &strtab) < 0)
+        return (NULL);
+
+    if (strtab.sh_offset > elf->file_size || strtab.sh_size > elf->file_size - strtab.sh_offset ||
+        offset >= strtab.sh_size)
+        return (NULL);
+
+    string = (const char *)elf->buf_ptr + strtab.sh_offset + offset;
+    *length = strnlen(string, strtab.sh_size - offset);
+
+    return (string);
+}
+
+static PyObject *
+string_object(ElfObject *elf, uint32_t section, uint32_t offset)
+{
+    const char *string;
+    size_t length;
+
+    if ((string = get_string(elf, section, offset, &length)) == NULL)
+        return (PyUnicode_FromString(""));
+
+    return (PyUnicode_DecodeUTF8(string, (Py_ssize_t)length, "replace"));
+}
+
+static PyObject *
+new_entry(PyTypeObject *type, const char *format, ...)
+{
+    PyObject *values, *entry;
+    Py_ssize_t i;
+    va_list args;
+
+    va_start(args, format);
+    values = Py_VaBuildValue(format, args);
+    va_end(args);
+
+    if (values == NULL)
+        return (NULL);
+
+    if ((entry = PyStructSequence_New(type)) == NULL)
+    {
+        Py_DECREF(values);
+        return (NULL);
+    }
+
+    for (i = 0; i < PyTuple_GET_SIZE(values); i++)
+    {
+        PyObject *value = PyTuple_GET_ITEM(values, i);
+
+        Py_INCREF(value);
+        PyStructSequence_SET_ITEM(entry, i, value);
+    }
+
+    Py_DECREF(values);
+
+    return (entry);
+}
+
+static PyObject *
+section_entry(ElfObject *elf, size_t index)
+{
+    Elf_Shdr shdr;
+
+    if (read_shdr(elf, index, &shdr) < 0)
+    {
+        PyErr_SetString(PyExc_IndexError, "section index out of range");
+        return (NULL);
+    }
+
+    return (new_entry(&Elf_ShdrType, "(INIKKKKIIKK)",
+                      shdr.sh_name, string_object(elf, elf->ehdr.e_shstrndx, shdr.sh_name), shdr.sh_type,
+                      (unsigned long long)shdr.sh_flags, (unsigned long long)shdr.sh_addr,
+                      (unsigned long long)shdr.sh_offset, (unsigned long long)shdr.sh_size,
+                      shdr.sh_link, shdr.sh_info, (unsigned long long)shdr.sh_addralign,
+                      (unsigned long long)shdr.sh_entsize));
+}
+
+static PyObject *
+table_entry(ElfTableViewObject *view, const Elf_Table *table, Py_ssize_t index)
+{
+    ElfObject *elf = view->elf;
+    const uint8_t *entry = elf->buf_ptr + table->offset + (size_t)index * table->entry_size;
+    Elf_Phdr phdr;
+    Elf_Sym sym;
+    Elf_Rela rela;
+
+    switch (view->kind)
+    {
+    case ELF_VIEW_SEGMENTS:
+        read_phdr(elf, entry, &phdr);
+        return (new_entry(&Elf_PhdrType, "(IIKKKKKK)",
+                          phdr.p_type, phdr.p_flags, (unsigned long long)phdr.p_offset,
+                          (unsigned long long)phdr.p_vaddr, (unsigned long long)phdr.p_paddr,
+                          (unsigned long long)phdr.p_filesz, (unsigned long long)phdr.p_memsz,
+                          (unsigned long long)phdr.p_align));
+    case ELF_VIEW_SECTIONS:
+        return (section_entry(elf, (size_t)index));
+    case ELF_VIEW_SYMBOLS:
+        read_sym(elf, entry, &sym);
+        return (new_entry(&Elf_SymType, "(INBBHKK)",
+                          sym.st_name, string_object(elf, table->link, sym.st_name), sym.st_info,
+                          sym.st_other, sym.st_shndx, (unsigned long long)sym.st_value,
+                          (unsigned long long)sym.st_size));
+    default:
+        read_rela(elf, entry, table->type, &rela);
+        if (table->type == SHT_RELA)
+            return (new_entry(&Elf_RelaType, "(KKL)", (unsigned long long)rela.r_offset,
+                              (unsigned long long)rela.r_info, (long long)rela.r_addend));
+        return (new_entry(&Elf_RelType, "(KK)", (unsigned long long)rela.r_offset,
+                          (unsigned long long)rela.r_info));
+    }
+}
+
+/***
+ * Table views
+ */
+static int
+add_table(Elf_Table **tables, Py_ssize_t *number_of_tables, Py_ssize_t *length, const Elf_Table *table)
+{
+    Elf_Table *new_tables;
+
+    new_tables = PyMem_Realloc(*tables, sizeof(Elf_Table) * (*number_of_tables + 1));
+    if (new_tables == NULL)
+    {
+        PyErr_NoMemory();
+        return (-1);
+    }
+
+    *tables = new_tables;
+    new_tables[*number_of_tables] = *table;
+    new_tables[*number_of_tables].first = *length;
+    *length += table->count;
+    (*number_of_tables)++;
+
+    return (0);
+}
+
+static int
+section_table(ElfObject *elf, uint32_t section, const Elf_Shdr *shdr, size_t entry_size, Elf_Table *table)
+{
+    if (shdr->sh_offset > elf->file_size || shdr->sh_size > elf->file_size - shdr->sh_offset)
+    {
+        PyErr_Format(PyExc_ValueError, "section %u out of file bound", section);
+        return (-1);
+    }
+
+    table->offset = shdr->sh_offset;
+    table->count = (Py_ssize_t)(shdr->sh_size / entry_size);
+    table->entry_size = entry_size;
+    table->section = section;
+    table->link = shdr->sh_link;
+    table->type = shdr->sh_type;
+
+    return (0);
+}
+
+static PyObject *
+new_view(ElfObject *elf, int kind, Elf_Table *tables, Py_ssize_t number_of_tables, Py_ssize_t length)
+{
+    ElfTableViewObject *view;
+
+    if ((view = PyObject_GC_New(ElfTableViewObject, &ElfTableViewType)) == NULL)
+    {
+        PyMem_Free(tables);
+        return (NULL);
+    }
+
+    Py_INCREF(elf);
+    view->elf = elf;
+    view->kind = kind;
+    view->tables = tables;
+    view->number_of_tables = number_of_tables;
+    view->length = length;
+    PyObject_GC_Track(view);
+
+    return ((PyObject *)view);
+}
+
+/***
+ * Build the view of a kind, only the section headers are
+ * read (to find the tables), not the entries.
+ */
+static PyObject *
+build_view(ElfObject *elf, int kind)
+{
+    Elf_Table *tables = NULL;
+    Py_ssize_t number_of_tables = 0, length = 0;
+    Elf_Table table;
+    Elf_Shdr shdr;
+    uint32_t types[2] = {SHT_DYNSYM, SHT_SYMTAB};
+    size_t i, j;
+
+    memset(&table, 0, sizeof(Elf_Table));
+
+    if (!elf->analyzed)
+        return (new_view(elf, kind, NULL, 0, 0));
+
+    switch (kind)
+    {
+    case ELF_VIEW_SEGMENTS:
+        table.offset = elf->ehdr.e_phoff;
+        table.count = elf->ehdr.e_phnum;
+        table.entry_size = elf->is_64_bit ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+        if (add_table(&tables, &number_of_tables, &length, &table) < 0)
+            return (NULL);
+        break;
+    case ELF_VIEW_SECTIONS:
+        table.offset = elf->ehdr.e_shoff;
+        table.count = elf->ehdr.e_shnum;
+        table.entry_size = elf->is_64_bit ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr);
+        if (add_table(&tables, &number_of_tables, &length, &table) < 0)
+            return (NULL);
+        break;
+    case ELF_VIEW_SYMBOLS:
+        // same order as elf_parser: .dynsym then .symtab
+        for (j = 0; j < 2; j++)
+        {
+            for (i = 0; i < elf->ehdr.e_shnum; i++)
+            {
+                read_shdr(elf, i, &shdr);
+
+                if (shdr.sh_type != types[j])
+                    continue;
+
+                if (section_table(elf, i, &shdr, elf->is_64_bit ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym), &table) < 0 ||
+                    add_table(&tables, &number_of_tables, &length, &table) < 0)
+                {
+                    PyMem_Free(tables);
+                    return (NULL);
+                }
+                break;
+            }
+        }
+        break;
+    case ELF_VIEW_RELOCATIONS:
+        for (i = 0; i < elf->ehdr.e_shnum; i++)
+        {
+            read_shdr(elf, i, &shdr);
+
+            if (shdr.sh_type == SHT_REL)
+                j = elf->is_64_bit ? sizeof(Elf64_Rel) : sizeof(Elf32_Rel);
+            else if (shdr.sh_type == SHT_RELA)
+                j = elf->is_64_bit ? sizeof(Elf64_Rela) : sizeof(Elf32_Rela);
+            else
+                continue;
+
+            if (section_table(elf, i, &shdr, j, &table) < 0 ||
+                add_table(&tables, &number_of_tables, &length, &table) < 0)
+            {
+                PyMem_Free(tables);
+                return (NULL);
+            }
+        }
+        break;
+    }
+
+    return (new_view(elf, kind, tables, number_of_tables, length));
+}
+
+static int
+check_open(ElfObject *elf)
+{
+    if (elf->analyzed && elf->buf_ptr == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, "operation on a closed Elf");
+        return (-1);
+    }
+
+    return (0);
+}
+
+// the Elf keeps its views, views keep their Elf
+static int
+view_traverse(ElfTableViewObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->elf);
+
+    return (0);
+}
+
+static int
+view_clear(ElfTableViewObject *self)
+{
+    Py_CLEAR(self->elf);
+
+    return (0);
+}
+
+static void
+view_dealloc(ElfTableViewObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    view_clear(self);
+    PyMem_Free(self->tables);
+    PyObject_GC_Del(self);
+}
+
+static Py_ssize_t
+view_length(ElfTableViewObject *self)
+{
+    return (self->length);
+}
+
+static const Elf_Table *
+find_table(ElfTableViewObject *self, Py_ssize_t index)
+{
+    Py_ssize_t low = 0, high = self->number_of_tables - 1, middle;
+
+    // tables are sorted by first entry, empty ones are skipped
+    while (low < high)
+    {
+        middle = (low + high + 1) / 2;
+
+        if (self->tables[middle].first <= index)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    while (self->tables[low].count == 0)
+        low++;
+
+    return (&self->tables[low]);
+}
+
+static PyObject *
+view_item(ElfTableViewObject *self, Py_ssize_t index)
+{
+    const Elf_Table *table;
+
+    if (index < 0 || index >= self->length)
+    {
+        PyErr_Format(PyExc_IndexError, "%s index out of range", view_names[self->kind]);
+        return (NULL);
+    }
+
+    if (check_open(self->elf) < 0)
+        return (NULL);
+
+    table = find_table(self, index);
+
+    return (table_entry(self, table, index - table->first));
+}
+
+// slices build a list with the entries
+static PyObject *
+view_subscript(ElfTableViewObject *self, PyObject *key)
+{
+    Py_ssize_t index, start, stop, step, length, i;
+    PyObject *list, *entry;
+
+    if (PyIndex_Check(key))
+    {
+        if ((index = PyNumber_AsSsize_t(key, PyExc_IndexError)) == -1 && PyErr_Occurred())
+            return (NULL);
+
+        if (index < 0)
+            index += self->length;
+
+        return (view_item(self, index));
+    }
+
+    if (!PySlice_Check(key))
+    {
+        PyErr_Format(PyExc_TypeError, "%s indices must be integers or slices", view_names[self->kind]);
+        return (NULL);
+    }
+
+    if (PySlice_Unpack(key, &start, &stop, &step) < 0)
+        return (NULL);
+
+    length = PySlice_AdjustIndices(self->length, &start, &stop, step);
+
+    if ((list = PyList_New(length)) == NULL)
+        return (NULL);
+
+    for (i = 0; i < length; i++, start += step)
+    {
+        if ((entry = view_item(self, start)) == NULL)
+        {
+            Py_DECREF(list);
+            return (NULL);
+        }
+
+        PyList_SET_ITEM(list, i, entry);
+    }
+
+    return (list);
+}
+
+/***
+ * Entry with the given name (sections and symbols), the
+ * string tables are compared in place without creating
+ * the entries, returns None if not found.
+ */
+static PyObject *
+view_find(ElfTableViewObject *self, PyObject *arg)
+{
+    const char *name, *string;
+    Py_ssize_t name_length, i, found = -1;
+    const Elf_Table *table = NULL;
+    ElfObject *elf = self->elf;
+    size_t length;
+    Elf_Shdr shdr;
+    Elf_Sym sym;
+    Py_ssize_t t;
+
+    if (self->kind != ELF_VIEW_SECTIONS && self->kind != ELF_VIEW_SYMBOLS)
+    {
+        PyErr_Format(PyExc_TypeError, "%s have no names", view_names[self->kind]);
+        return (NULL);
+    }
+
+    if ((name = PyUnicode_AsUTF8AndSize(arg, &name_length)) == NULL)
+        return (NULL);
+
+    if (check_open(elf) < 0)
+        return (NULL);
+
+    elf->in_use++;
+    Py_BEGIN_ALLOW_THREADS
+    for (t = 0; t < self->number_of_tables && found < 0; t++)
+    {
+        table = &self->tables[t];
+
+        for (i = 0; i < table->count; i++)
+        {
+            if (self->kind == ELF_VIEW_SECTIONS)
+            {
+                read_shdr(elf, i, &shdr);
+                string = get_string(elf, elf->ehdr.e_shstrndx, shdr.sh_name, &length);
+            }
+            else
+            {
+                read_sym(elf, elf->buf_ptr + table->offset + (size_t)i * table->entry_size, &sym);
+                string = get_string(elf, table->link, sym.st_name, &length);
+            }
+
+            if (string != NULL && length == (size_t)name_length && memcmp(string, name, length) == 0)
+            {
+                found = i;
+                break;
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS
+    elf->in_use--;
+
+    if (found < 0)
+        Py_RETURN_NONE;
+
+    return (table_entry(self, table, found));
+}
+
+static PyObject *
+view_get_tables(ElfTableViewObject *self, void *closure)
+{
+    PyObject *tuple, *view;
+    Elf_Table *table;
+    Py_ssize_t t;
+
+    if ((tuple = PyTuple_New(self->number_of_tables)) == NULL)
+        return (NULL);
+
+    for (t = 0; t < self->number_of_tables; t++)
+    {
+        if ((table = PyMem_Malloc(sizeof(Elf_Table))) == NULL)
+        {
+            Py_DECREF(tuple);
+            return (PyErr_NoMemory());
+        }
+
+        *table = self->tables[t];
+        table->first = 0;
+
+        if ((view = new_view(self->elf, self->kind, table, 1, table->count)) == NULL)
+        {
+            Py_DECREF(tuple);
+            return (NULL);
+        }
+
+        PyTuple_SET_ITEM(tuple, t, view);
+    }
+
+    return (tuple);
+}
+
+static PyObject *
+view_get_section(ElfTableViewObject *self, void *closure)
+{
+    if (self->number_of_tables != 1 || self->kind == ELF_VIEW_SEGMENTS || self->kind == ELF_VIEW_SECTIONS)
+        Py_RETURN_NONE;
+
+    return (PyLong_FromUnsignedLong(self->tables[0].section));
+}
+
+static PyObject *
+view_get_entry_size(ElfTableViewObject *self, void *closure)
+{
+    if (self->number_of_tables != 1)
+        Py_RETURN_NONE;
+
+    return (PyLong_FromSize_t(self->tables[0].entry_size));
+}
+
+static PyObject *
+view_repr(ElfTableViewObject *self)
+{
+    return (PyUnicode_FromFormat("<Elf %s view, %zd entries in %zd tables>",
+                                 view_names[self->kind], self->length, self->number_of_tables));
+}
+
+/***
+ * Raw bytes of the table, only for views of a single table
+ * (use .tables to get them one by one).
+ */
+static int
+view_getbuffer(ElfTableViewObject *self, Py_buffer *buffer, int flags)
+{
+    static char empty[1];
+    const Elf_Table *table;
+    void *buf = empty;
+    Py_ssize_t size = 0;
+
+    if (check_open(self->elf) < 0)
+    {
+        buffer->obj = NULL;
+        return (-1);
+    }
+
+    if (self->number_of_tables > 1)
+    {
+        PyErr_Format(PyExc_BufferError, "%s view is not contiguous, use its tables", view_names[self->kind]);
+        buffer->obj = NULL;
+        return (-1);
+    }
+
+    if (self->number_of_tables == 1)
+    {
+        table = &self->tables[0];
+        buf = self->elf->buf_ptr + table->offset;
+        size = table->count * (Py_ssize_t)table->entry_size;
+    }
+
+    if (PyBuffer_FillInfo(buffer, (PyObject *)self, buf, size, 1, flags) < 0)
+        return (-1);
+
+    self->elf->exports++;
+
+    return (0);
+}
+
+static void
+view_releasebuffer(ElfTableViewObject *self, Py_buffer *buffer)
+{
+    self->elf->exports--;
+}
+
+static PySequenceMethods view_as_sequence = {
+    .sq_length = (lenfunc)view_length,
+    .sq_item = (ssizeargfunc)view_item,
+};
+
+static PyMappingMethods view_as_mapping = {
+    .mp_length = (lenfunc)view_length,
+    .mp_subscript = (binaryfunc)view_subscript,
+};
+
+static PyBufferProcs view_as_buffer = {
+    .bf_getbuffer = (getbufferproc)view_getbuffer,
+    .bf_releasebuffer = (releasebufferproc)view_releasebuffer,
+};
+
+static PyMethodDef view_methods[] = {
+    {"find", (PyCFunction)view_find, METH_O, "find(name) -> first entry with that name or None"},
+    {NULL}
+};
+
+static PyGetSetDef view_getset[] = {
+    {"tables", (getter)view_get_tables, NULL, "views of each table of the view", NULL},
+    {"section", (getter)view_get_section, NULL, "section of the table (symbols and relocations)", NULL},
+    {"entry_size", (getter)view_get_entry_size, NULL, "size of the raw entries", NULL},
+    {NULL}
+};
+
+static PyTypeObject ElfTableViewType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_elf.ElfTableView",
+    .tp_doc = "Lazy sequence over ELF tables, entries are built when indexed",
+    .tp_basicsize = sizeof(ElfTableViewObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_SEQUENCE | Py_TPFLAGS_HAVE_GC,
+    .tp_dealloc = (destructor)view_dealloc,
+    .tp_traverse = (traverseproc)view_traverse,
+    .tp_clear = (inquiry)view_clear,
+    .tp_repr = (reprfunc)view_repr,
+    .tp_as_sequence = &view_as_sequence,
+    .tp_as_mapping = &view_as_mapping,
+    .tp_as_buffer = &view_as_buffer,
+    .tp_methods = view_methods,
+    .tp_getset = view_getset,
+};
+
+/***
+ * Elf
+ */
+static void
+unmap_elf(ElfObject *self)
+{
+    if (self->buf_ptr != NULL)
+        munmap(self->buf_ptr, self->file_size);
+
+    self->buf_ptr = NULL;
+}
+
+static int
+elf_init(ElfObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"path", NULL};
+    PyObject *path = NULL;
+    const char *error = NULL;
+    uint8_t *buf_ptr = NULL;
+    size_t file_size = 0;
+    Elf_Ehdr ehdr;
+    int is_64_bit = 0, ret, i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", kwlist, PyUnicode_FSConverter, &path))
+        return (-1);
+
+    if (self->analyzed)
+    {
+        Py_DECREF(path);
+        PyErr_SetString(PyExc_RuntimeError, "Elf already initialized");
+        return (-1);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = map_elf(PyBytes_AS_STRING(path), &buf_ptr, &file_size, &ehdr, &is_64_bit, &error);
+    Py_END_ALLOW_THREADS
+
+    if (ret == -1)
+    {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        Py_DECREF(path);
+        return (-1);
+    }
+
+    if (ret == -2)
+    {
+        PyErr_Format(PyExc_ValueError, "%s: %s", PyBytes_AS_STRING(path), error);
+        Py_DECREF(path);
+        return (-1);
+    }
+
+    self->buf_ptr = buf_ptr;
+    self->file_size = file_size;
+    self->ehdr = ehdr;
+    self->is_64_bit = is_64_bit;
+    self->analyzed = 1;
+    self->path = PyUnicode_DecodeFSDefaultAndSize(PyBytes_AS_STRING(path), PyBytes_GET_SIZE(path));
+    Py_DECREF(path);
+
+    for (i = 0; i < ELF_NUMBER_OF_VIEWS; i++)
+        Py_CLEAR(self->views[i]);
+
+    return (self->path == NULL ? -1 : 0);
+}
+
+static int
+elf_traverse(ElfObject *self, visitproc visit, void *arg)
+{
+    int i;
+
+    for (i = 0; i < ELF_NUMBER_OF_VIEWS; i++)
+        Py_VISIT(self->views[i]);
+
+    return (0);
+}
+
+static int
+elf_clear(ElfObject *self)
+{
+    int i;
+
+    for (i = 0; i < ELF_NUMBER_OF_VIEWS; i++)
+        Py_CLEAR(self->views[i]);
+
+    return (0);
+}
+
+static void
+elf_dealloc(ElfObject *self)
+{
+    PyTypeObject *type = Py_TYPE(self);
+
+    PyObject_GC_UnTrack(self);
+    elf_clear(self);
+    unmap_elf(self);
+    Py_CLEAR(self->path);
+    type->tp_free((PyObject *)self);
+}
+
+static PyObject *
+elf_close(ElfObject *self, PyObject *unused)
+{
+    if (self->exports > 0)
+    {
+        PyErr_SetString(PyExc_BufferError, "cannot close an Elf with exported buffers");
+        return (NULL);
+    }
+
+    if (self->in_use > 0)
+    {
+        PyErr_SetString(PyExc_BufferError, "cannot close an Elf in use by another thread");
+        return (NULL);
+    }
+
+    unmap_elf(self);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+elf_enter(ElfObject *self, PyObject *unused)
+{
+    Py_INCREF(self);
+
+    return ((PyObject *)self);
+}
+
+static PyObject *
+elf_exit(ElfObject *self, PyObject *args)
+{
+    return (elf_close(self, NULL));
+}
+
+static PyObject *
+elf_is_elf(ElfObject *self, PyObject *unused)
+{
+    return (PyBool_FromLong(self->analyzed));
+}
+
+static PyObject *
+elf_is_32_bit(ElfObject *self, PyObject *unused)
+{
+    return (PyBool_FromLong(self->analyzed && !self->is_64_bit));
+}
+
+static PyObject *
+elf_is_64_bit(ElfObject *self, PyObject *unused)
+{
+    return (PyBool_FromLong(self->analyzed && self->is_64_bit));
+}
+
+static PyObject *
+elf_get_header(ElfObject *self, void *closure)
+{
+    const Elf_Ehdr *ehdr = &self->ehdr;
+
+    if (!self->analyzed)
+        Py_RETURN_NONE;
+
+    return (new_entry(&Elf_EhdrType, "(y#HHIKKKIHHHHHH)",
+                      (const char *)ehdr->e_ident, (Py_ssize_t)EI_NIDENT, ehdr->e_type, ehdr->e_machine,
+                      ehdr->e_version, (unsigned long long)ehdr->e_entry, (unsigned long long)ehdr->e_phoff,
+                      (unsigned long long)ehdr->e_shoff, ehdr->e_flags, ehdr->e_ehsize, ehdr->e_phentsize,
+                      ehdr->e_phnum, ehdr->e_shentsize, ehdr->e_shnum, ehdr->e_shstrndx));
+}
+
+static PyObject *
+elf_get_view(ElfObject *self, void *closure)
+{
+    int kind = (int)(intptr_t)closure;
+
+    if (self->views[kind] == NULL && check_open(self) < 0)
+        return (NULL);
+
+    if (self->views[kind] == NULL && (self->views[kind] = build_view(self, kind)) == NULL)
+        return (NULL);
+
+    Py_INCREF(self->views[kind]);
+
+    return (self->views[kind]);
+}
+
+/***
+ * Mapped data: read-only memoryviews of the mapping, the
+ * Elf cannot be closed while one of them is alive.
+ */
+static int
+elf_getbuffer(ElfObject *self, Py_buffer *buffer, int flags)
+{
+    if (!self->analyzed || check_open(self) < 0)
+    {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_BufferError, "Elf not analyzed");
+        buffer->obj = NULL;
+        return (-1);
+    }
+
+    if (PyBuffer_FillInfo(buffer, (PyObject *)self, self->buf_ptr, (Py_ssize_t)self->file_size, 1, flags) < 0)
+        return (-1);
+
+    self->exports++;
+
+    return (0);
+}
+
+static void
+elf_releasebuffer(ElfObject *self, Py_buffer *buffer)
+{
+    self->exports--;
+}
+
+static PyObject *
+elf_memoryview(ElfObject *self, uint64_t offset, uint64_t size)
+{
+    PyObject *view, *range;
+
+    if (self->analyzed && (offset > self->file_size || size > self->file_size - offset))
+    {
+        PyErr_Format(PyExc_ValueError, "range 0x%llx-0x%llx out of file bound",
+                     (unsigned long long)offset, (unsigned long long)(offset + size));
+        return (NULL);
+    }
+
+    if ((view = PyMemoryView_FromObject((PyObject *)self)) == NULL)
+        return (NULL);
+
+    range = PySequence_GetSlice(view, (Py_ssize_t)offset, (Py_ssize_t)(offset + size));
+    Py_DECREF(view);
+
+    return (range);
+}
+
+static PyObject *
+elf_file_range(ElfObject *self, PyObject *args)
+{
+    unsigned long long offset, size;
+
+    if (!PyArg_ParseTuple(args, "KK:file_range", &offset, &size))
+        return (NULL);
+
+    return (elf_memoryview(self, offset, size));
+}
+
+static PyObject *
+elf_section_data(ElfObject *self, PyObject *arg)
+{
+    const char *name, *string;
+    Py_ssize_t name_length;
+    size_t index, length;
+    Elf_Shdr shdr;
+
+    if (!self->analyzed || check_open(self) < 0)
+    {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_ValueError, "Elf not analyzed");
+        return (NULL);
+    }
+
+    // section index or name
+    if (PyUnicode_Check(arg))
+    {
+        if ((name = PyUnicode_AsUTF8AndSize(arg, &name_length)) == NULL)
+            return (NULL);
+
+        for (index = 0; index < self->ehdr.e_shnum; index++)
+        {
+            read_shdr(self, index, &shdr);
+            string = get_string(self, self->ehdr.e_shstrndx, shdr.sh_name, &length);
+
+            if (string != NULL && length == (size_t)name_length && memcmp(string, name, length) == 0)
+                break;
+        }
+
+        if (index == self->ehdr.e_shnum)
+        {
+            PyErr_Format(PyExc_KeyError, "section %R not found", arg);
+            return (NULL);
+        }
+    }
+    else
+    {
+        if ((index = PyLong_AsSize_t(arg)) == (size_t)-1 && PyErr_Occurred())
+            return (NULL);
+
+        if (read_shdr(self, index, &shdr) < 0)
+        {
+            PyErr_SetString(PyExc_IndexError, "section index out of range");
+            return (NULL);
+        }
+    }
+
+    // no bytes in the file
+    if (shdr.sh_type == SHT_NOBITS)
+        shdr.sh_size = 0;
+
+    return (elf_memoryview(self, shdr.sh_offset, shdr.sh_size));
+}
+
+static PyObject *
+elf_segment_data(ElfObject *self, PyObject *arg)
+{
+    size_t index, entry_size;
+    Elf_Phdr phdr;
+
+    if (!self->analyzed || check_open(self) < 0)
+    {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_ValueError, "Elf not analyzed");
+        return (NULL);
+    }
+
+    if ((index = PyLong_AsSize_t(arg)) == (size_t)-1 && PyErr_Occurred())
+        return (NULL);
+
+    if (index >= self->ehdr.e_phnum)
+    {
+        PyErr_SetString(PyExc_IndexError, "segment index out of range");
+        return (NULL);
+    }
+
+    entry_size = self->is_64_bit ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+    read_phdr(self, self->buf_ptr + self->ehdr.e_phoff + index * entry_size, &phdr);
+
+    return (elf_memoryview(self, phdr.p_offset, phdr.p_filesz));
+}
+
+static PyObject *
+elf_get_closed(ElfObject *self, void *closure)
+{
+    return (PyBool_FromLong(self->analyzed && self->buf_ptr == NULL));
+}
+
+static PyMemberDef elf_members[] = {
+    {"path", T_OBJECT, offsetof(ElfObject, path), READONLY, "path of the file"},
+    {"file_size", T_PYSSIZET, offsetof(ElfObject, file_size), READONLY, "size of the file"},
+    {NULL}
+};
+
+static PyMethodDef elf_methods[] = {
+    {"close", (PyCFunction)elf_close, METH_NOARGS, "unmap the file"},
+    {"__enter__", (PyCFunction)elf_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)elf_exit, METH_VARARGS, NULL},
+    {"file_range", (PyCFunction)elf_file_range, METH_VARARGS, "file_range(offset, size) -> read-only memoryview"},
+    {"section_data", (PyCFunction)elf_section_data, METH_O, "section_data(index or name) -> read-only memoryview"},
+    {"segment_data", (PyCFunction)elf_segment_data, METH_O, "segment_data(index) -> read-only memoryview"},
+    {"is_elf", (PyCFunction)elf_is_elf, METH_NOARGS, NULL},
+    {"is_32_bit", (PyCFunction)elf_is_32_bit, METH_NOARGS, NULL},
+    {"is_64_bit", (PyCFunction)elf_is_64_bit, METH_NOARGS, NULL},
+    {NULL}
+};
+
+static PyGetSetDef elf_getset[] = {
+    {"header", (getter)elf_get_header, NULL, "ELF header", NULL},
+    {"segments", (getter)elf_get_view, NULL, "program headers", (void *)ELF_VIEW_SEGMENTS},
+    {"sections", (getter)elf_get_view, NULL, "section headers", (void *)ELF_VIEW_SECTIONS},
+    {"symbols", (getter)elf_get_view, NULL, ".dynsym and .symtab symbols", (void *)ELF_VIEW_SYMBOLS},
+    {"relocations", (getter)elf_get_view, NULL, "entries of every SHT_REL and SHT_RELA section", (void *)ELF_VIEW_RELOCATIONS},
+    {"closed", (getter)elf_get_closed, NULL, NULL, NULL},
+    {NULL}
+};
+
+static PyBufferProcs elf_as_buffer = {
+    .bf_getbuffer = (getbufferproc)elf_getbuffer,
+    .bf_releasebuffer = (releasebufferproc)elf_releasebuffer,
+};
+
+static PyTypeObject ElfType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_elf.Elf",
+    .tp_doc = "Elf(path): mapped ELF file with lazy views of its tables",
+    .tp_basicsize = sizeof(ElfObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)elf_init,
+    .tp_dealloc = (destructor)elf_dealloc,
+    .tp_traverse = (traverseproc)elf_traverse,
+    .tp_clear = (inquiry)elf_clear,
+    .tp_methods = elf_methods,
+    .tp_members = elf_members,
+    .tp_getset = elf_getset,
+    .tp_as_buffer = &elf_as_buffer,
+};
+
+static struct PyModuleDef elf_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "_elf",
+    .m_doc = "Native binding of elfparser_e",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC
+PyInit__elf(void)
+{
+    struct { PyTypeObject *type; PyStructSequence_Desc *desc; } entry_types[] = {
+        {&Elf_EhdrType, &ehdr_desc}, {&Elf_PhdrType, &phdr_desc}, {&Elf_ShdrType, &shdr_desc},
+        {&Elf_SymType, &sym_desc}, {&Elf_RelType, &rel_desc}, {&Elf_RelaType, &rela_desc},
+    };
+    PyObject *module;
+    size_t i;
+
+    if (PyType_Ready(&ElfType) < 0 || PyType_Ready(&ElfTableViewType) < 0)
+        return (NULL);
+
+    if ((module = PyModule_Create(&elf_module)) == NULL)
+        return (NULL);
+
+    for (i = 0; i < sizeof(entry_types) / sizeof(entry_types[0]); i++)
+    {
+        if (entry_types[i].type->tp_name == NULL &&
+            PyStructSequence_InitType2(entry_types[i].type, entry_types[i].desc) < 0)
+            goto error;
+
+        if (PyModule_AddObjectRef(module, strchr(entry_types[i].desc->name, '.') + 1,
+                                  (PyObject *)entry_types[i].type) < 0)
+            goto error;
+    }
+
+    if (PyModule_AddObjectRef(module, "Elf", (PyObject *)&ElfType) < 0 ||
+        PyModule_AddObjectRef(module, "ElfTableView", (PyObject *)&ElfTableViewType) < 0)
+        goto error;
+
+    return (module);
+
+error:
+    Py_DECREF(module);
+    return (NULL);
+}
@@ -1708,4 +1708,22 @@ close_everything()
 
     if (buf_ptr)
         munmap_memory(buf_ptr, buf_ptr_size);
+
+    // ready to parse another file
+    elf_ehdr = NULL;
+    elf_phdr = NULL;
+    elf_shdr = NULL;
+    elf_dynsym = NULL;
+    elf_symtab = NULL;
+    elf_rel = NULL;
+    elf_rela = NULL;
+    buf_ptr = NULL;
+    buf_ptr_size = 0;
+    StringTable = NULL;
+    SymbolStringTable = NULL;
+    DynSymbolStringTable = NULL;
+    dynsym_num = 0;
+    symtab_num = 0;
+    rel_sections = 0;
+    rela_sections = 0;
 }
\ No newline at end of file
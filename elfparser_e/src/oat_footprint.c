@@ -0,0 +1,164 @@
+#include "oat_footprint.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+typedef struct bit_reader
+{
+    const uint8_t *data;
+    size_t        size_in_bits;
+    size_t        position;
+} Bit_Reader;
+
+// bits are read from the least significant bit of each byte
+static int
+read_bits(Bit_Reader *reader, uint32_t bits, uint32_t *value)
+{
+    uint32_t i;
+
+    if (bits > 32 || reader->position + bits > reader->size_in_bits)
+        return (-1);
+
+    *value = 0;
+
+    for (i = 0; i < bits; i++, reader->position++)
+        *value |= (uint32_t)((reader->data[reader->position >> 3] >> (reader->position & 7)) & 1) << i;
+
+    return (0);
+}
+
+static int
+read_code_info_header(const uint8_t *data, size_t size, uint32_t header[CODE_INFO_HEADER_FIELDS])
+{
+    Bit_Reader reader = {data, size * 8, 0};
+    int i;
+
+    for (i = 0; i < CODE_INFO_HEADER_FIELDS; i++)
+    {
+        if (read_bits(&reader, CODE_INFO_VARINT_BITS, &header[i]) < 0)
+            return (-1);
+    }
+
+    for (i = 0; i < CODE_INFO_HEADER_FIELDS; i++)
+    {
+        if (header[i] > CODE_INFO_VARINT_MAX &&
+            read_bits(&reader, (header[i] - CODE_INFO_VARINT_MAX) * 8, &header[i]) < 0)
+            return (-1);
+    }
+
+    return (0);
+}
+
+int
+oat_method_headers(const uint8_t *oatdata, size_t size, const Oat_Method_Header_Layout *layout,
+                   const uint32_t *code_offsets, uint32_t count, Oat_Footprint_Columns *columns)
+{
+    uint32_t fields[METHOD_HEADER_MAX_FIELDS], code_info[CODE_INFO_HEADER_FIELDS];
+    uint32_t i, offset, data, code_info_offset;
+    int out_of_bound = 0;
+
+    if (layout->size > sizeof(fields) || layout->code_size_field < 0 ||
+        layout->code_size_field >= (int32_t)(layout->size / sizeof(uint32_t)))
+    {
+        fprintf(stderr, "oat_method_headers: incorrect method header layout\n");
+        return (-1);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        // Thumb2 code offsets have the lowest bit set
+        offset = code_offsets[i] & ~1u;
+
+        columns->code_size[i] = 0;
+        columns->frame_size[i] = 0;
+        columns->core_spill_mask[i] = 0;
+        columns->fp_spill_mask[i] = 0;
+        columns->metadata_offset[i] = 0;
+        columns->flags[i] = 0;
+
+        if (offset < layout->size || offset > size)
+        {
+            columns->flags[i] = FOOTPRINT_OUT_OF_BOUND;
+            out_of_bound++;
+            continue;
+        }
+
+        memcpy(fields, oatdata + offset - layout->size, layout->size);
+        data = fields[layout->code_size_field];
+
+        if (data & METHOD_HEADER_SHOULD_DEOPTIMIZE)
+            columns->flags[i] |= FOOTPRINT_SHOULD_DEOPTIMIZE;
+
+        if (layout->code_info && (data & METHOD_HEADER_IS_CODE_INFO))
+        {
+            code_info_offset = data & METHOD_HEADER_DATA_MASK;
+            columns->metadata_offset[i] = code_info_offset;
+
+            if (code_info_offset > offset ||
+                read_code_info_header(oatdata + offset - code_info_offset, size - (offset - code_info_offset), code_info) < 0)
+            {
+                columns->flags[i] |= FOOTPRINT_OUT_OF_BOUND;
+                out_of_bound++;
+                continue;
+            }
+
+            columns->code_size[i] = code_info[CODE_INFO_CODE_SIZE];
+            columns->frame_size[i] = code_info[CODE_INFO_PACKED_FRAME_SIZE] * CODE_INFO_STACK_ALIGNMENT;
+            columns->core_spill_mask[i] = code_info[CODE_INFO_CORE_SPILL_MASK];
+            columns->fp_spill_mask[i] = code_info[CODE_INFO_FP_SPILL_MASK];
+            columns->flags[i] |= FOOTPRINT_CODE_INFO;
+        }
+        else
+        {
+            columns->code_size[i] = data & (layout->code_info ? METHOD_HEADER_DATA_MASK : METHOD_HEADER_CODE_SIZE_MASK);
+
+            if (!layout->code_info && layout->metadata_field >= 0)
+                columns->metadata_offset[i] = fields[layout->metadata_field];
+
+            if (layout->frame_size_field >= 0)
+            {
+                columns->frame_size[i] = fields[layout->frame_size_field];
+                columns->core_spill_mask[i] = fields[layout->frame_size_field + 1];
+                columns->fp_spill_mask[i] = fields[layout->frame_size_field + 2];
+            }
+        }
+
+        if (columns->code_size[i] > size - offset)
+        {
+            columns->flags[i] |= FOOTPRINT_OUT_OF_BOUND;
+            out_of_bound++;
+        }
+    }
+
+    return (out_of_bound);
+}
+
+int
+oat_method_headers_fd(int fd, uint64_t oatdata_offset, uint64_t size, const Oat_Method_Header_Layout *layout,
+                      const uint32_t *code_offsets, uint32_t count, Oat_Footprint_Columns *columns)
+{
+    uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t map_offset = oatdata_offset & ~(page_size - 1);
+    size_t map_size = (size_t)(oatdata_offset - map_offset + size);
+    uint8_t *map;
+    int ret;
+
+    if (size == 0)
+        return (oat_method_headers(NULL, 0, layout, code_offsets, count, columns));
+
+    if ((map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, (off_t)map_offset)) == MAP_FAILED)
+    {
+        perror("oat_method_headers_fd");
+        return (-1);
+    }
+
+    // headers are spread over the code, no read ahead
+    madvise(map, map_size, MADV_RANDOM);
+
+    ret = oat_method_headers(map + (oatdata_offset - map_offset), (size_t)size, layout, code_offsets, count, columns);
+
+    munmap(map, map_size);
+
+    return (ret);
+}
@@ -0,0 +1,223 @@
+#include "oat_parser.h"
+#include "oat_header_layouts.h"
+
+static uint32_t
+read_u32(const uint8_t *buf_ptr, uint64_t offset)
+{
+    uint32_t value;
+
+    memcpy(&value, buf_ptr + offset, sizeof(uint32_t));
+
+    return (value);
+}
+
+static int
+version_in(const char version[OAT_VERSION_SIZE], const char * const *versions)
+{
+    size_t i;
+
+    for (i = 0; versions[i] != NULL; i++)
+    {
+        if (memcmp(version, versions[i], OAT_VERSION_SIZE - 1) == 0 && version[OAT_VERSION_SIZE - 1] == '\0')
+            return (1);
+    }
+
+    return (0);
+}
+
+static const Oat_Header_Layout *
+get_header_layout(const char version[OAT_VERSION_SIZE])
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(oat_header_layouts) / sizeof(oat_header_layouts[0]); i++)
+    {
+        if (version_in(version, oat_header_layouts[i].versions))
+            return (&oat_header_layouts[i]);
+    }
+
+    return (NULL);
+}
+
+int
+is_oat_version_supported(const char version[OAT_VERSION_SIZE])
+{
+    return (get_header_layout(version) != NULL);
+}
+
+int
+is_oat_version_in_vdex(const char version[OAT_VERSION_SIZE])
+{
+    const Oat_Header_Layout *layout = get_header_layout(version);
+
+    return (layout != NULL && version_in(version, layout->vdex_versions));
+}
+
+/***
+ * Read the OatDexFile records, they are consecutive:
+ *
+ *      uint32 dex_file_location_size
+ *      ubyte[dex_file_location_size] dex_file_location_data
+ *      uint32 dex_file_location_checksum
+ *      uint32 dex_file_pointer
+ *      uint32[] offsets of the version (class offsets, lookup
+ *               table, bss mappings, ...), dex_file_fields_size
+ */
+static int
+parse_oat_dex_files(Oat_File *oat, const Oat_Header_Layout *layout, uint64_t cursor,
+                    const uint8_t *vdex_ptr, size_t vdex_size)
+{
+    const uint8_t *container;
+    size_t   container_size;
+    uint32_t i;
+    // without vdex the dex files are looked for in the oat file
+    int      in_vdex = is_oat_version_in_vdex(oat->version) && vdex_ptr != NULL;
+
+    container = in_vdex ? vdex_ptr : oat->buf_ptr;
+    container_size = in_vdex ? vdex_size : oat->file_size;
+
+    for (i = 0; i < oat->dex_file_count; i++)
+    {
+        Oat_Dex_File *dex_file = &oat->dex_files[i];
+
+        if (cursor + 4 > oat->file_size)
+        {
+            fprintf(stderr, "parse_oat: oat dex file %u out of file bound\n", i);
+            return (-1);
+        }
+
+        dex_file->location_size = read_u32(oat->buf_ptr, cursor);
+        cursor += 4;
+
+        if (cursor + dex_file->location_size + 8 + layout->dex_file_fields_size > oat->file_size)
+        {
+            fprintf(stderr, "parse_oat: oat dex file %u location out of file bound\n", i);
+            return (-1);
+        }
+
+        dex_file->location = oat->buf_ptr + cursor;
+        cursor += dex_file->location_size;
+
+        dex_file->location_checksum = read_u32(oat->buf_ptr, cursor);
+        dex_file->dex_file_pointer = read_u32(oat->buf_ptr, cursor + 4);
+        cursor += 8 + layout->dex_file_fields_size;
+
+        dex_file->in_vdex = in_vdex;
+        dex_file->dex_offset = in_vdex ? dex_file->dex_file_pointer :
+                               oat->oatdata_offset + dex_file->dex_file_pointer;
+        dex_file->dex_size = 0;
+
+        // dex file is not in the vdex (stored in the APK)
+        if (in_vdex && dex_file->dex_file_pointer == 0)
+            continue;
+
+        if (dex_file->dex_offset + OAT_DEX_FILE_HEADER_SIZE > container_size)
+        {
+            fprintf(stderr, "parse_oat: dex file pointer (0x%08X) out of file bound\n", dex_file->dex_file_pointer);
+            return (-1);
+        }
+
+        dex_file->dex_size = read_u32(container, dex_file->dex_offset + 32);
+
+        if (dex_file->dex_offset + dex_file->dex_size > container_size)
+        {
+            fprintf(stderr, "parse_oat: dex file %u size (%u) out of file bound\n", i, (unsigned int)dex_file->dex_size);
+            return (-1);
+        }
+    }
+
+    return (0);
+}
+
+int
+parse_oat_buffer(Oat_File *oat, const uint8_t *buf_ptr, size_t file_size, uint64_t oatdata_offset,
+                 const uint8_t *vdex_ptr, size_t vdex_size)
+{
+    const Oat_Header_Layout *layout;
+    const uint8_t *oatdata;
+    uint64_t cursor;
+
+    memset(oat, 0, sizeof(Oat_File));
+
+    oat->buf_ptr = buf_ptr;
+    oat->file_size = file_size;
+    oat->oatdata_offset = oatdata_offset;
+
+    if (oatdata_offset + OAT_HEADER_FIELDS_OFFSET > file_size)
+    {
+        fprintf(stderr, "parse_oat: oatdata out of file bound\n");
+        return (-1);
+    }
+
+    oatdata = buf_ptr + oatdata_offset;
+
+    if (memcmp(oatdata, OAT_MAGIC, OAT_MAGIC_SIZE) != 0)
+    {
+        fprintf(stderr, "parse_oat: incorrect oat magic\n");
+        return (-1);
+    }
+
+    memcpy(oat->version, oatdata + OAT_MAGIC_SIZE, OAT_VERSION_SIZE);
+    oat->version_number = (uint32_t)strtoul(oat->version, NULL, 10);
+
+    if ((layout = get_header_layout(oat->version)) == NULL)
+    {
+        fprintf(stderr, "parse_oat: oat version %.3s not supported\n", oat->version);
+        return (-1);
+    }
+
+    cursor = oatdata_offset + OAT_HEADER_FIELDS_OFFSET;
+
+    if (cursor + layout->size > file_size)
+    {
+        fprintf(stderr, "parse_oat: oat header out of file bound\n");
+        return (-1);
+    }
+
+    if (layout->read(oat, buf_ptr + cursor) < 0)
+        return (-1);
+
+    cursor += layout->size;
+
+    if (cursor + oat->key_value_store_size > file_size)
+    {
+        fprintf(stderr, "parse_oat: key value store out of file bound\n");
+        return (-1);
+    }
+
+    oat->key_value_store = buf_ptr + cursor;
+    cursor += oat->key_value_store_size;
+
+    // since 131 the OatDexFile records are not after the header
+    if (oat->oat_dex_files_offset != 0)
+        cursor = oatdata_offset + oat->oat_dex_files_offset;
+
+    if (oat->dex_file_count == 0)
+        return (0);
+
+    // every OatDexFile takes at least 20 bytes, avoid huge allocations from corrupted counts
+    if ((uint64_t)oat->dex_file_count * 20 > file_size)
+    {
+        fprintf(stderr, "parse_oat: dex file count (%u) out of file bound\n", oat->dex_file_count);
+        return (-1);
+    }
+
+    if ((oat->dex_files = allocate_memory(sizeof(Oat_Dex_File) * oat->dex_file_count)) == NULL)
+        return (-1);
+
+    memset(oat->dex_files, 0, sizeof(Oat_Dex_File) * oat->dex_file_count);
+
+    return parse_oat_dex_files(oat, layout, cursor, vdex_ptr, vdex_size);
+}
+
+void
+close_oat(Oat_File *oat)
+{
+    if (oat == NULL)
+        return;
+
+    if (oat->dex_files)
+        free_memory(oat->dex_files);
+
+    oat->dex_files = NULL;
+}
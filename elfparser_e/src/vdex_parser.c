@@ -0,0 +1,455 @@
+#include "vdex_parser.h"
+
+static uint32_t
+read_u32(const uint8_t *buf_ptr, uint64_t offset)
+{
+    uint32_t value;
+
+    memcpy(&value, buf_ptr + offset, sizeof(uint32_t));
+
+    return (value);
+}
+
+static uint32_t
+read_version(const uint8_t *version)
+{
+    uint32_t value = 0;
+    int      i;
+
+    for (i = 0; i < VDEX_VERSION_SIZE && version[i] != '\0'; i++)
+    {
+        if (version[i] < '0' || version[i] > '9')
+            return (0);
+
+        value = value * 10 + (version[i] - '0');
+    }
+
+    return (value);
+}
+
+static int
+allocate_dex_tables(Vdex_File *vdex, size_t file_size)
+{
+    if (vdex->number_of_dex_files == 0)
+        return (0);
+
+    // every checksum takes four bytes, avoid huge allocations from corrupted counts
+    if ((uint64_t)vdex->number_of_dex_files * 4 > file_size)
+    {
+        fprintf(stderr, "parse_vdex: number of dex files (%u) out of file bound\n", vdex->number_of_dex_files);
+        return (-1);
+    }
+
+    vdex->dex_checksums = allocate_memory(sizeof(uint32_t) * vdex->number_of_dex_files);
+    vdex->dex_offsets = allocate_memory(sizeof(uint64_t) * vdex->number_of_dex_files);
+    vdex->dex_sizes = allocate_memory(sizeof(uint64_t) * vdex->number_of_dex_files);
+
+    if (vdex->dex_checksums == NULL || vdex->dex_offsets == NULL || vdex->dex_sizes == NULL)
+        return (-1);
+
+    memset(vdex->dex_offsets, 0, sizeof(uint64_t) * vdex->number_of_dex_files);
+    memset(vdex->dex_sizes, 0, sizeof(uint64_t) * vdex->number_of_dex_files);
+
+    return (0);
+}
+
+static int
+read_dex_checksums(Vdex_File *vdex, uint64_t offset)
+{
+    uint32_t i;
+
+    if (offset + (uint64_t)vdex->number_of_dex_files * 4 > vdex->file_size)
+    {
+        fprintf(stderr, "parse_vdex: dex checksums out of file bound\n");
+        return (-1);
+    }
+
+    for (i = 0; i < vdex->number_of_dex_files; i++)
+        vdex->dex_checksums[i] = read_u32(vdex->buf_ptr, offset + (uint64_t)i * 4);
+
+    return (0);
+}
+
+/***
+ * Walk the dex files of the dex section, each dex is
+ * 4 bytes aligned and optionally prefixed by prefix_size
+ * bytes (quickening table offset). Only file_size is read
+ * from each dex header.
+ */
+static int
+walk_dex_section(Vdex_File *vdex, size_t prefix_size)
+{
+    uint64_t cursor = vdex->dex_section_offset;
+    uint64_t section_end = vdex->dex_section_offset + vdex->dex_section_size;
+    uint64_t dex_size;
+    uint32_t i;
+
+    if (section_end > vdex->file_size)
+    {
+        fprintf(stderr, "parse_vdex: dex section out of file bound\n");
+        return (-1);
+    }
+
+    for (i = 0; i < vdex->number_of_dex_files && vdex->dex_section_size > 0; i++)
+    {
+        cursor += prefix_size;
+
+        if (cursor + DEX_FILE_SIZE_OFFSET + 4 > section_end)
+        {
+            fprintf(stderr, "parse_vdex: dex file %u out of dex section bound\n", i);
+            return (-1);
+        }
+
+        dex_size = read_u32(vdex->buf_ptr, cursor + DEX_FILE_SIZE_OFFSET);
+
+        if (cursor + dex_size > section_end)
+        {
+            fprintf(stderr, "parse_vdex: dex file %u size (%llu) out of dex section bound\n", i, (long long unsigned int)dex_size);
+            return (-1);
+        }
+
+        vdex->dex_offsets[i] = cursor;
+        vdex->dex_sizes[i] = dex_size;
+
+        cursor = (cursor + dex_size + 3) & ~(uint64_t)3;
+    }
+
+    return (0);
+}
+
+static int
+parse_vdex_v006(Vdex_File *vdex)
+{
+    uint64_t checksums_offset = VDEX_V006_HEADER_SIZE;
+
+    if (vdex->file_size < VDEX_V006_HEADER_SIZE)
+    {
+        fprintf(stderr, "parse_vdex: vdex header out of file bound\n");
+        return (-1);
+    }
+
+    vdex->number_of_dex_files = read_u32(vdex->buf_ptr, 8);
+    vdex->dex_section_size = read_u32(vdex->buf_ptr, 12);
+    vdex->verifier_deps_size = read_u32(vdex->buf_ptr, 16);
+
+    if (allocate_dex_tables(vdex, vdex->file_size) < 0 || read_dex_checksums(vdex, checksums_offset) < 0)
+        return (-1);
+
+    vdex->dex_section_offset = checksums_offset + (uint64_t)vdex->number_of_dex_files * 4;
+    vdex->verifier_deps_offset = vdex->dex_section_offset + vdex->dex_section_size;
+
+    return walk_dex_section(vdex, 0);
+}
+
+static int
+parse_vdex_v019(Vdex_File *vdex)
+{
+    uint64_t header_size;
+    uint64_t dex_section_header;
+
+    header_size = vdex->version >= VDEX_VERSION_BOOTCLASSPATH ? VDEX_V021_HEADER_SIZE : VDEX_V019_HEADER_SIZE;
+
+    if (vdex->file_size < header_size)
+    {
+        fprintf(stderr, "parse_vdex: vdex header out of file bound\n");
+        return (-1);
+    }
+
+    vdex->dex_section_version = read_version(vdex->buf_ptr + 8);
+    vdex->number_of_dex_files = read_u32(vdex->buf_ptr, 12);
+    vdex->verifier_deps_size = read_u32(vdex->buf_ptr, 16);
+
+    if (allocate_dex_tables(vdex, vdex->file_size) < 0 || read_dex_checksums(vdex, header_size) < 0)
+        return (-1);
+
+    dex_section_header = header_size + (uint64_t)vdex->number_of_dex_files * 4;
+
+    // dex section version 000 means there is no dex section
+    if (vdex->dex_section_version == 0)
+    {
+        vdex->verifier_deps_offset = dex_section_header;
+        return (0);
+    }
+
+    if (dex_section_header + VDEX_DEX_SECTION_HEADER_SIZE > vdex->file_size)
+    {
+        fprintf(stderr, "parse_vdex: dex section header out of file bound\n");
+        return (-1);
+    }
+
+    vdex->dex_section_offset = dex_section_header + VDEX_DEX_SECTION_HEADER_SIZE;
+    vdex->dex_section_size = read_u32(vdex->buf_ptr, dex_section_header);
+    // verifier deps follow dex files and the shared data of compact dex files
+    vdex->verifier_deps_offset = vdex->dex_section_offset + vdex->dex_section_size +
+                                 read_u32(vdex->buf_ptr, dex_section_header + 4);
+
+    return walk_dex_section(vdex, sizeof(uint32_t));
+}
+
+static int
+parse_vdex_v027(Vdex_File *vdex)
+{
+    uint32_t number_of_sections;
+    uint64_t section_header;
+    uint32_t kind, offset, size;
+    uint32_t i;
+    int      checksums_found = 0;
+    uint64_t checksums_offset = 0;
+
+    if (vdex->file_size < VDEX_V027_HEADER_SIZE)
+    {
+        fprintf(stderr, "parse_vdex: vdex header out of file bound\n");
+        return (-1);
+    }
+
+    number_of_sections = read_u32(vdex->buf_ptr, 8);
+
+    if (VDEX_V027_HEADER_SIZE + (uint64_t)number_of_sections * VDEX_SECTION_HEADER_SIZE > vdex->file_size)
+    {
+        fprintf(stderr, "parse_vdex: section headers out of file bound\n");
+        return (-1);
+    }
+
+    for (i = 0; i < number_of_sections; i++)
+    {
+        section_header = VDEX_V027_HEADER_SIZE + (uint64_t)i * VDEX_SECTION_HEADER_SIZE;
+        kind = read_u32(vdex->buf_ptr, section_header);
+        offset = read_u32(vdex->buf_ptr, section_header + 4);
+        size = read_u32(vdex->buf_ptr, section_header + 8);
+
+        if ((uint64_t)offset + size > vdex->file_size)
+        {
+            fprintf(stderr, "parse_vdex: section %u out of file bound\n", i);
+            return (-1);
+        }
+
+        switch (kind)
+        {
+        case VDEX_CHECKSUM_SECTION:
+            checksums_found = 1;
+            checksums_offset = offset;
+            vdex->number_of_dex_files = size / 4;
+            break;
+        case VDEX_DEX_FILE_SECTION:
+            vdex->dex_section_offset = offset;
+            vdex->dex_section_size = size;
+            break;
+        case VDEX_VERIFIER_DEPS_SECTION:
+            vdex->verifier_deps_offset = offset;
+            vdex->verifier_deps_size = size;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (!checksums_found)
+    {
+        fprintf(stderr, "parse_vdex: checksum section not found\n");
+        return (-1);
+    }
+
+    if (allocate_dex_tables(vdex, vdex->file_size) < 0 || read_dex_checksums(vdex, checksums_offset) < 0)
+        return (-1);
+
+    return walk_dex_section(vdex, 0);
+}
+
+int
+parse_vdex_buffer(Vdex_File *vdex, uint8_t *buf_ptr, size_t file_size)
+{
+    if (vdex == NULL || buf_ptr == NULL)
+    {
+        fprintf(stderr, "parse_vdex_buffer: cannot parse null buffer\n");
+        return (-1);
+    }
+
+    vdex->buf_ptr = buf_ptr;
+    vdex->file_size = file_size;
+
+    if (file_size < VDEX_MAGIC_SIZE + VDEX_VERSION_SIZE || memcmp(buf_ptr, VDEX_MAGIC, VDEX_MAGIC_SIZE) != 0)
+    {
+        fprintf(stderr, "parse_vdex_buffer: vdex incorrect header\n");
+        return (-1);
+    }
+
+    vdex->version = read_version(buf_ptr + VDEX_MAGIC_SIZE);
+
+    if (vdex->version == 0)
+    {
+        fprintf(stderr, "parse_vdex_buffer: vdex version not supported\n");
+        return (-1);
+    }
+    else if (vdex->version < VDEX_VERSION_SECTIONS)
+    {
+        return parse_vdex_v006(vdex);
+    }
+    else if (vdex->version < VDEX_VERSION_SECTION_TABLE)
+    {
+        return parse_vdex_v019(vdex);
+    }
+
+    return parse_vdex_v027(vdex);
+}
+
+Vdex_File *
+parse_vdex_fd(int fd)
+{
+    Vdex_File *vdex;
+    ssize_t   file_size;
+
+    if ((file_size = get_file_size(fd)) <= 0)
+        return (NULL);
+
+    if ((vdex = allocate_memory(sizeof(Vdex_File))) == NULL)
+        return (NULL);
+
+    memset(vdex, 0, sizeof(Vdex_File));
+
+    if ((vdex->buf_ptr = mmap_file_read((size_t)file_size, fd)) == NULL)
+    {
+        free_memory(vdex);
+        return (NULL);
+    }
+
+    if (parse_vdex_buffer(vdex, vdex->buf_ptr, (size_t)file_size) < 0)
+    {
+        close_vdex(vdex);
+        return (NULL);
+    }
+
+    return (vdex);
+}
+
+Vdex_File *
+parse_vdex(const char *pathname)
+{
+    Vdex_File *vdex;
+    int       fd;
+
+    if ((fd = open_file_reading(pathname)) < 0)
+        return (NULL);
+
+    // the mapping stays valid after closing the descriptor
+    vdex = parse_vdex_fd(fd);
+
+    close_file(fd);
+
+    return (vdex);
+}
+
+void
+close_vdex(Vdex_File *vdex)
+{
+    if (vdex == NULL)
+        return;
+
+    if (vdex->dex_checksums)
+        free_memory(vdex->dex_checksums);
+
+    if (vdex->dex_offsets)
+        free_memory(vdex->dex_offsets);
+
+    if (vdex->dex_sizes)
+        free_memory(vdex->dex_sizes);
+
+    if (vdex->buf_ptr)
+        munmap_memory(vdex->buf_ptr, vdex->file_size);
+
+    free_memory(vdex);
+}
+
+/***
+ * Vdex header
+ * Interesting functions for python
+ * binding.
+ */
+uint32_t
+vdex_version(const Vdex_File *vdex)
+{
+    if (vdex == NULL)
+        return (0);
+
+    return (vdex->version);
+}
+
+uint32_t
+vdex_dex_section_version(const Vdex_File *vdex)
+{
+    if (vdex == NULL)
+        return (0);
+
+    return (vdex->dex_section_version);
+}
+
+uint32_t
+vdex_number_of_dex_files(const Vdex_File *vdex)
+{
+    if (vdex == NULL)
+        return (0);
+
+    return (vdex->number_of_dex_files);
+}
+
+uint64_t
+vdex_dex_section_offset(const Vdex_File *vdex)
+{
+    if (vdex == NULL)
+        return (0);
+
+    return (vdex->dex_section_offset);
+}
+
+uint64_t
+vdex_dex_section_size(const Vdex_File *vdex)
+{
+    if (vdex == NULL)
+        return (0);
+
+    return (vdex->dex_section_size);
+}
+
+uint64_t
+vdex_verifier_deps_offset(const Vdex_File *vdex)
+{
+    if (vdex == NULL)
+        return (0);
+
+    return (vdex->verifier_deps_offset);
+}
+
+uint64_t
+vdex_verifier_deps_size(const Vdex_File *vdex)
+{
+    if (vdex == NULL)
+        return (0);
+
+    return (vdex->verifier_deps_size);
+}
+
+uint32_t
+vdex_dex_checksum(const Vdex_File *vdex, size_t index)
+{
+    if (vdex == NULL || index >= vdex->number_of_dex_files)
+        return (uint32_t)(-1);
+
+    return (vdex->dex_checksums[index]);
+}
+
+uint64_t
+vdex_dex_offset(const Vdex_File *vdex, size_t index)
+{
+    if (vdex == NULL || index >= vdex->number_of_dex_files)
+        return (uint64_t)(-1);
+
+    return (vdex->dex_offsets[index]);
+}
+
+uint64_t
+vdex_dex_size(const Vdex_File *vdex, size_t index)
+{
+    if (vdex == NULL || index >= vdex->number_of_dex_files)
+        return (uint64_t)(-1);
+
+    return (vdex->dex_sizes[index]);
+}
@@ -0,0 +1,372 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: tests/fixtures.py
+#   Version: 0.7
+######################################################
+
+'''
+Generators of the small dex, vdex, oat and ELF (odex) files used by
+the tests, only the structures read by the tool are filled in.
+'''
+
+import os
+import sys
+import struct
+import zlib
+import hashlib
+
+# the modules of the tool are imported from the root of the repository
+ROOT_DIRECTORY = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+if ROOT_DIRECTORY not in sys.path:
+    sys.path.insert(0, ROOT_DIRECTORY)
+
+DEX_HEADER_SIZE = 0x70
+DEX_CHECKSUM_OFFSET = 8
+DEX_SIGNATURE_OFFSET = 12
+DEX_SIGNED_DATA_OFFSET = 32
+DEX_CLASS_DEFS_SIZE_OFFSET = 0x60
+
+ACC_PUBLIC = 0x1
+ACC_STATIC = 0x8
+
+# locations of the two dex files of every fixture
+DEX_LOCATIONS = ['/system/app/Foo/Foo.apk', '/system/app/Foo/Foo.apk!classes2.dex']
+
+# uint32 fields of the oat header after magic, version, adler32_checksum,
+# instruction_set, instruction_set_features_offset and dex_file_count:
+# (number of fields, index of executable_offset, index of oat_dex_files_offset)
+OAT_HEADER_FIELDS = {
+    '088': (11, 0, None),
+    '124': (11, 0, None),
+    '131': (12, 1, 0),
+    '170': (7, 1, 0),
+    '183': (8, 1, 0),
+    '195': (9, 1, 0),
+    '199': (9, 1, 0),
+    '225': (10, 2, 0),
+    '230': (10, 2, 0),
+}
+OAT_EXECUTABLE_OFFSET = 0x1000
+# OatDexFile fields after dex_file_pointer since 183
+OAT_DEX_FILE_FIELDS = {'183': 6, '195': 6, '199': 6, '225': 8, '230': 8}
+# OatClass type kOatClassSomeCompiled and status, before and since 225
+OAT_CLASS_HEADER = {'183': (11, 1), '195': (11, 1), '199': (11, 1), '225': (15, 1), '230': (15, 1)}
+
+VDEX_SECTION_CHECKSUMS = 0
+VDEX_SECTION_DEX = 1
+VDEX_SECTION_VERIFIER_DEPS = 2
+VDEX_SECTION_TYPE_LOOKUP = 3
+
+
+def uleb128(value):
+    encoded = bytearray()
+
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+
+        if value == 0:
+            encoded.append(byte)
+            return bytes(encoded)
+
+        encoded.append(byte | 0x80)
+
+
+def align_offset(offset, alignment=4):
+    return offset + (-offset % alignment)
+
+
+def align(data, alignment=4):
+    return data + b'\0' * (align_offset(len(data), alignment) - len(data))
+
+
+def make_dex(strings, classes, valid=True):
+    '''
+    Dex of version 035 whose methods all have the proto ()V.
+
+    :param strings: extra strings of the string table.
+    :param classes: list of (descriptor, [(method name, access flags)]).
+    :param valid: False to leave checksum and signature unset.
+    '''
+    strings = sorted(set(strings) | {'V', 'Ljava/lang/Object;'} |
+                     {descriptor for descriptor, _ in classes} |
+                     {name for _, methods in classes for name, _ in methods})
+    string_index = {string: i for i, string in enumerate(strings)}
+    types = [string for string in strings if string.startswith('L') or string == 'V']
+    type_index = {descriptor: i for i, descriptor in enumerate(types)}
+    methods = sorted((type_index[descriptor], string_index[name])
+                     for descriptor, class_methods in classes for name, _ in class_methods)
+    method_index = {method: i for i, method in enumerate(methods)}
+
+    string_ids_offset = DEX_HEADER_SIZE
+    type_ids_offset = string_ids_offset + 4 * len(strings)
+    proto_ids_offset = type_ids_offset + 4 * len(types)
+    method_ids_offset = proto_ids_offset + 12
+    class_defs_offset = method_ids_offset + 8 * len(methods)
+    data_offset = class_defs_offset + 32 * len(classes)
+
+    data = bytearray()
+    string_data_offsets = []
+    for string in strings:
+        string_data_offsets.append(data_offset + len(data))
+        data += uleb128(len(string)) + string.encode() + b'\0'
+    data = align(data)
+
+    class_data_offsets = []
+    for descriptor, class_methods in classes:
+        class_data_offsets.append(data_offset + len(data))
+        encoded = sorted((method_index[(type_index[descriptor], string_index[name])], access_flags)
+                         for name, access_flags in class_methods)
+        direct = [method for method in encoded if method[1] & ACC_STATIC]
+        virtual = [method for method in encoded if not method[1] & ACC_STATIC]
+        data += uleb128(0) + uleb128(0) + uleb128(len(direct)) + uleb128(len(virtual))
+        for group in (direct, virtual):
+            previous = 0
+            for index, access_flags in group:
+                data += uleb128(index - previous) + uleb128(access_flags) + uleb128(0)
+                previous = index
+    data = align(data)
+
+    map_offset = data_offset + len(data)
+    items = [(0x0000, 1, 0), (0x0001, len(strings), string_ids_offset), (0x0002, len(types), type_ids_offset),
+             (0x0003, 1, proto_ids_offset)]
+    if len(methods) > 0:
+        items.append((0x0005, len(methods), method_ids_offset))
+    if len(classes) > 0:
+        items.append((0x0006, len(classes), class_defs_offset))
+    items.append((0x2002, len(strings), string_data_offsets[0]))
+    if len(classes) > 0:
+        items.append((0x2000, len(classes), class_data_offsets[0]))
+    items.append((0x1000, 1, map_offset))
+    data += struct.pack('<I', len(items)) + b''.join(struct.pack('<HHII', item_type, 0, size, offset)
+                                                     for item_type, size, offset in items)
+
+    body = b''.join(struct.pack('<I', offset) for offset in string_data_offsets)
+    body += b''.join(struct.pack('<I', string_index[descriptor]) for descriptor in types)
+    body += struct.pack('<III', string_index['V'], type_index['V'], 0)
+    body += b''.join(struct.pack('<HHI', class_index, 0, name_index) for class_index, name_index in methods)
+    for (descriptor, _), class_data_offset in zip(classes, class_data_offsets):
+        body += struct.pack('<IIIIIIII', type_index[descriptor], ACC_PUBLIC, type_index['Ljava/lang/Object;'],
+                            0, 0xffffffff, 0, class_data_offset, 0)
+
+    file_size = data_offset + len(data)
+    header = b'dex\n035\0' + b'\0' * 24
+    header += struct.pack('<IIIIII', file_size, DEX_HEADER_SIZE, 0x12345678, 0, 0, map_offset)
+    header += struct.pack('<IIIIIIIIIIIIII', len(strings), string_ids_offset, len(types), type_ids_offset,
+                          1, proto_ids_offset, 0, 0, len(methods), method_ids_offset,
+                          len(classes), class_defs_offset, len(data), data_offset)
+
+    dex = bytearray(header + body + data)
+
+    if valid:
+        fix_dex(dex)
+
+    return bytes(dex)
+
+
+def fix_dex(dex):
+    '''
+    Set signature and checksum of a dex (bytearray) from its content.
+    '''
+    dex[DEX_SIGNATURE_OFFSET:DEX_SIGNED_DATA_OFFSET] = hashlib.sha1(dex[DEX_SIGNED_DATA_OFFSET:]).digest()
+    dex[DEX_CHECKSUM_OFFSET:DEX_SIGNATURE_OFFSET] = struct.pack('<I', zlib.adler32(dex[DEX_SIGNATURE_OFFSET:]))
+
+
+def dex_is_valid(dex):
+    dex = bytes(dex)
+
+    return dex[DEX_SIGNATURE_OFFSET:DEX_SIGNED_DATA_OFFSET] == hashlib.sha1(dex[DEX_SIGNED_DATA_OFFSET:]).digest() and \
+        struct.unpack_from('<I', dex, DEX_CHECKSUM_OFFSET)[0] == zlib.adler32(dex[DEX_SIGNATURE_OFFSET:])
+
+
+def make_dex_files():
+    '''
+    :return: the two dex files of the fixtures, the second one has
+             neither checksum nor signature
+    '''
+    return [make_dex(['hello', 'world'], [('Lcom/a/A;', [('foo', ACC_PUBLIC), ('bar', ACC_STATIC)])]),
+            make_dex(['other'], [('Lcom/b/B;', [('baz', ACC_PUBLIC)])], valid=False)]
+
+
+def make_vdex(version, dex_files, with_dex=True):
+    '''
+    Vdex of version 006, 010, 019, 021 or 027.
+
+    :return: tuple (vdex, offsets of the dex files in it)
+    '''
+    checksums = b''.join(dex[DEX_CHECKSUM_OFFSET:DEX_SIGNATURE_OFFSET] for dex in dex_files)
+    dex_offsets = []
+
+    if int(version) < 19:
+        # magic, version, number_of_dex_files, dex_size, verifier_deps_size, quickening_info_size
+        header_size = 24 + len(checksums)
+        dex_section = bytearray()
+        for dex in dex_files:
+            dex_offsets.append(header_size + len(dex_section))
+            dex_section = align(dex_section + dex)
+        header = b'vdex' + version.encode() + b'\0' + struct.pack('<IIII', len(dex_files), len(dex_section), 16, 0)
+        return bytes(header + checksums + dex_section + b'\0' * 16), dex_offsets
+
+    if int(version) < 27:
+        header = b'vdex' + version.encode() + b'\0' + (b'002\0' if with_dex else b'000\0')
+        header += struct.pack('<II', len(dex_files), 16)
+        if int(version) >= 21:
+            # bootclasspath checksums and class loader context sizes
+            header += struct.pack('<II', 0, 0)
+        header += checksums
+
+        if not with_dex:
+            return bytes(header + b'\0' * 16), [0] * len(dex_files)
+
+        # dex section header: dex_size, dex_shared_data_size, quickening_info_size
+        dex_section = bytearray()
+        for dex in dex_files:
+            # quickening offset before every dex
+            dex_section += struct.pack('<I', 0)
+            dex_offsets.append(len(header) + 12 + len(dex_section))
+            dex_section = align(dex_section + dex)
+        header += struct.pack('<III', len(dex_section), 0, 0)
+        return bytes(header + dex_section + b'\0' * 16), dex_offsets
+
+    # section table since 027
+    number_of_sections = 4
+    checksums_offset = 12 + 12 * number_of_sections
+    dex_section_offset = checksums_offset + len(align(checksums))
+    dex_section = bytearray()
+    for dex in dex_files if with_dex else []:
+        dex_offsets.append(dex_section_offset + len(dex_section))
+        dex_section = align(dex_section + dex)
+    verifier_deps_offset = dex_section_offset + len(dex_section)
+
+    vdex = bytearray(b'vdex027\0' + struct.pack('<I', number_of_sections))
+    vdex += struct.pack('<III', VDEX_SECTION_CHECKSUMS, checksums_offset, len(checksums))
+    vdex += struct.pack('<III', VDEX_SECTION_DEX, dex_section_offset if with_dex else 0, len(dex_section))
+    vdex += struct.pack('<III', VDEX_SECTION_VERIFIER_DEPS, verifier_deps_offset, 16)
+    vdex += struct.pack('<III', VDEX_SECTION_TYPE_LOOKUP, 0, 0)
+    vdex += align(checksums) + dex_section + b'\0' * 16
+
+    return bytes(vdex), dex_offsets if with_dex else [0] * len(dex_files)
+
+
+def make_oat(version, dex_files, dex_offsets=None):
+    '''
+    Raw oat (oatdata without ELF) with the dex files after the
+    OatDexFile records, or in a vdex at dex_offsets. Since 183 the
+    dex files are always in the vdex and every class has an OatClass
+    with two compiled methods.
+    '''
+    field_count, executable_index, dex_files_index = OAT_HEADER_FIELDS[version]
+    fields = [0] * field_count
+    fields[executable_index] = OAT_EXECUTABLE_OFFSET
+    key_value_store = b'classpath\0\0'
+
+    oat = bytearray(b'oat\n' + version.encode() + b'\0')
+    oat += struct.pack('<IIII', 0, 1, 0, len(dex_files)) + b''.join(struct.pack('<I', field) for field in fields)
+    oat += struct.pack('<I', len(key_value_store)) + key_value_store
+
+    # before oat_dex_files_offset the records follow the key-value store
+    if dex_files_index is not None:
+        oat = align(oat)
+        struct.pack_into('<I', oat, 24 + 4 * dex_files_index, len(oat))
+
+    record_fields = OAT_DEX_FILE_FIELDS.get(version, 2)
+    records_size = sum(12 + len(location) + 4 * record_fields for location in DEX_LOCATIONS[:len(dex_files)])
+    embedded = dex_offsets is None
+
+    if embedded:
+        dex_offsets = []
+        offset = align_offset(len(oat) + records_size)
+        for dex in dex_files:
+            dex_offsets.append(offset)
+            offset += len(align(dex))
+
+    record_offsets = []
+    for location, dex, dex_offset in zip(DEX_LOCATIONS, dex_files, dex_offsets):
+        oat += struct.pack('<I', len(location)) + location.encode() + dex[DEX_CHECKSUM_OFFSET:DEX_SIGNATURE_OFFSET]
+        oat += struct.pack('<I', dex_offset)
+        record_offsets.append(len(oat))
+        # class offsets out of the file, the classes are not read
+        oat += b'\xff' * 8 if version not in OAT_DEX_FILE_FIELDS else b'\0' * (4 * record_fields)
+
+    if version in OAT_DEX_FILE_FIELDS:
+        class_type, class_status = OAT_CLASS_HEADER[version]
+
+        for k, dex in enumerate(dex_files):
+            class_defs_size = struct.unpack_from('<I', dex, DEX_CLASS_DEFS_SIZE_OFFSET)[0]
+            class_offsets_offset = len(oat)
+            # class_offsets_offset and lookup_table_offset
+            struct.pack_into('<II', oat, record_offsets[k], class_offsets_offset, 0x40 + k)
+            oat += b'\0' * (4 * class_defs_size)
+
+            for i in range(class_defs_size):
+                struct.pack_into('<I', oat, class_offsets_offset + 4 * i, len(oat))
+                if version in ('225', '230'):
+                    # number of methods instead of the bitmap size
+                    oat += struct.pack('<HHI', class_type, class_status, 3)
+                else:
+                    oat += struct.pack('<HHI', class_type, class_status, 4)
+                # methods 0 and 2 compiled
+                oat += struct.pack('<III', 0b101, OAT_EXECUTABLE_OFFSET, OAT_EXECUTABLE_OFFSET + 8)
+    elif embedded:
+        for dex, dex_offset in zip(dex_files, dex_offsets):
+            oat += b'\0' * (dex_offset - len(oat)) + align(dex)
+
+    # room for the compiled code at executable_offset
+    oat += b'\0' * OAT_EXECUTABLE_OFFSET
+    struct.pack_into('<I', oat, 8, zlib.adler32(bytes(oat)))
+
+    return bytes(oat)
+
+
+def make_elf(oat):
+    '''
+    ELF64 odex holding an oat in .rodata and the oatdata symbol.
+    '''
+    dynstr = b'\0oatdata\0oatexec\0'
+    shstrtab = b'\0.dynstr\0.dynsym\0.rodata\0.shstrtab\0'
+    dynstr_offset = 64
+    dynsym_offset = align_offset(dynstr_offset + len(dynstr), 8)
+    # null symbol and oatdata
+    dynsym_size = 2 * 24
+    rodata_offset = align_offset(dynsym_offset + dynsym_size, 4096)
+    shstrtab_offset = align_offset(rodata_offset + len(oat), 8)
+    section_headers_offset = align_offset(shstrtab_offset + len(shstrtab), 8)
+    dynsym = b'\0' * 24 + struct.pack('<IBBHQQ', 1, 0x11, 0, 3, rodata_offset, len(oat))
+
+    def section_header(name, section_type, flags, offset, size, link, info, alignment, entry_size):
+        return struct.pack('<IIQQQQIIQQ', name, section_type, flags, offset if flags else 0, offset, size,
+                           link, info, alignment, entry_size)
+
+    section_headers = section_header(0, 0, 0, 0, 0, 0, 0, 0, 0)
+    section_headers += section_header(1, 3, 2, dynstr_offset, len(dynstr), 0, 0, 1, 0)
+    section_headers += section_header(9, 11, 2, dynsym_offset, len(dynsym), 1, 1, 8, 24)
+    section_headers += section_header(17, 1, 2, rodata_offset, len(oat), 0, 0, 4096, 0)
+    section_headers += section_header(25, 3, 0, shstrtab_offset, len(shstrtab), 0, 0, 1, 0)
+
+    elf = bytearray(section_headers_offset + len(section_headers))
+    elf[0:64] = b'\x7fELF\x02\x01\x01' + b'\0' * 9 + \
+        struct.pack('<HHIQQQIHHHHHH', 3, 183, 1, 0, 0, section_headers_offset, 0, 64, 56, 0, 64, 5, 4)
+    elf[dynstr_offset:dynstr_offset + len(dynstr)] = dynstr
+    elf[dynsym_offset:dynsym_offset + len(dynsym)] = dynsym
+    elf[rodata_offset:rodata_offset + len(oat)] = oat
+    elf[shstrtab_offset:shstrtab_offset + len(shstrtab)] = shstrtab
+    elf[section_headers_offset:] = section_headers
+
+    return bytes(elf)
+
+
+def write_file(directory, name, data):
+    path = os.path.join(directory, name)
+
+    with open(path, 'wb') as output_file:
+        output_file.write(data)
+
+    return path
+
+
+def read_file(path):
+    with open(path, 'rb') as input_file:
+        return input_file.read()
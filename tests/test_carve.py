@@ -0,0 +1,86 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: tests/test_carve.py
+#   Version: 0.7
+######################################################
+
+import os
+import tempfile
+import unittest
+from unittest import mock
+
+from fixtures import *
+
+import Carver
+
+ELF_IDENT = b'\x7fELF\x02\x01\x01'
+
+
+class CarveTest(unittest.TestCase):
+    '''
+    Carving of an input where the magics follow each other: an ELF
+    ident whose 8th byte starts a dex, then a vdex and a raw oat.
+    '''
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.dex_files = make_dex_files()
+        self.vdex, _ = make_vdex('027', self.dex_files)
+        self.oat = make_oat('131', self.dex_files)
+
+        junk = bytes(range(256)) * 4
+        self.elf_offset = len(junk)
+        self.dex_offset = self.elf_offset + len(ELF_IDENT)
+        self.vdex_offset = self.dex_offset + len(self.dex_files[0])
+        self.oat_offset = self.vdex_offset + len(self.vdex)
+
+        self.path = write_file(self.directory.name, 'dump.bin',
+                               junk + ELF_IDENT + self.dex_files[0] + self.vdex + self.oat + junk)
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def carve(self, native):
+        with mock.patch.object(Carver, 'USE_NATIVE_CARVE', native):
+            with Carver.Carver(self.path) as carver:
+                carver.scan()
+                images = carver.carve()
+
+                # the carved dex and vdex are the bytes of the fixtures
+                dex_path = os.path.join(self.directory.name, 'carved.dex')
+                vdex_path = os.path.join(self.directory.name, 'carved.vdex')
+                carver.write(images[0].offset, images[0].size, dex_path)
+                carver.write(images[1].offset, images[1].size, vdex_path)
+
+                return carver.candidates, images, carver.invalid, read_file(dex_path), read_file(vdex_path)
+
+    def check_images(self, candidates, images, invalid, dex, vdex):
+        self.assertEqual(candidates[:3], [(self.elf_offset, Carver.CARVE_ELF, 64),
+                                          (self.dex_offset, Carver.CARVE_DEX, 35),
+                                          (self.vdex_offset, Carver.CARVE_VDEX, 27)])
+        self.assertIn((self.oat_offset, Carver.CARVE_OAT, 131), candidates)
+
+        self.assertEqual([(image.kind, image.offset, image.version) for image in images],
+                         [(Carver.CARVE_DEX, self.dex_offset, 35),
+                          (Carver.CARVE_VDEX, self.vdex_offset, 27),
+                          (Carver.CARVE_OAT, self.oat_offset, 131)])
+        self.assertEqual([(kind, offset) for kind, offset, _ in invalid], [(Carver.CARVE_ELF, self.elf_offset)])
+        self.assertEqual(dex, self.dex_files[0])
+        self.assertEqual(vdex, self.vdex)
+
+    def test_fallback_scan(self):
+        self.check_images(*self.carve(native=False))
+
+    @unittest.skipUnless(Carver.USE_NATIVE_CARVE, "elfparser_e is not built")
+    def test_native_scan(self):
+        native = self.carve(native=True)
+
+        self.check_images(*native)
+        self.assertEqual(native, self.carve(native=False))
+
+
+if __name__ == '__main__':
+    unittest.main()
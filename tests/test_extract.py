@@ -0,0 +1,112 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: tests/test_extract.py
+#   Version: 0.7
+######################################################
+
+import os
+import tempfile
+import unittest
+from unittest import mock
+
+from fixtures import *
+
+import Dextripador
+from elfparser_e.python_binding.elf import CtypesElf
+
+
+class ExtractTest(unittest.TestCase):
+    '''
+    Extraction of the dex files of raw oat files and ELF odex files,
+    with the dex files in the oat or in the vdex next to it.
+    '''
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.dex_files = make_dex_files()
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def write(self, name, data):
+        return write_file(self.directory.name, name, data)
+
+    def extract(self, path, recalculate_dex_checksum=False):
+        '''
+        :return: the extracted dex files of path, in order
+        '''
+        output_directory = tempfile.mkdtemp(dir=self.directory.name)
+        extractor = Dextripador.Extractor(path)
+
+        try:
+            extractor.load()
+            extractor.extract_all_dex(recalculate_dex_checksum, output_directory)
+            names = [dex_entry.name for dex_entry in extractor.dex_entries]
+        finally:
+            extractor.close()
+
+        return [read_file(os.path.join(output_directory, name)) for name in names]
+
+    def test_raw_oat(self):
+        for version in ('088', '131', '170'):
+            with self.subTest(version=version):
+                path = self.write('raw%s.oat' % version, make_oat(version, self.dex_files))
+                self.assertEqual(self.extract(path), self.dex_files)
+
+    def test_elf_odex(self):
+        for version in ('088', '131', '170'):
+            with self.subTest(version=version):
+                path = self.write('elf%s.odex' % version, make_elf(make_oat(version, self.dex_files)))
+                self.assertEqual(self.extract(path), self.dex_files)
+
+    def test_elf_odex_ctypes(self):
+        # the mapping of the global ELF parser instead of the _elf module
+        path = self.write('ctypes.odex', make_elf(make_oat('088', self.dex_files)))
+
+        with mock.patch.object(Dextripador, 'Elf', CtypesElf):
+            self.assertEqual(self.extract(path), self.dex_files)
+
+    def test_elf_odex_with_vdex(self):
+        vdex, dex_offsets = make_vdex('021', self.dex_files)
+        self.write('paired.vdex', vdex)
+        path = self.write('paired.odex', make_elf(make_oat('170', self.dex_files, dex_offsets)))
+
+        self.assertEqual(self.extract(path), self.dex_files)
+
+    def test_replace_checksum(self):
+        path = self.write('replace.oat', make_oat('131', self.dex_files))
+        dex_files = self.extract(path, recalculate_dex_checksum=True)
+
+        for dex, original in zip(dex_files, self.dex_files):
+            self.assertTrue(dex_is_valid(dex))
+            self.assertEqual(dex[DEX_SIGNED_DATA_OFFSET:], original[DEX_SIGNED_DATA_OFFSET:])
+
+        # only the header of the dex without checksum changes
+        self.assertEqual(dex_files[0], self.dex_files[0])
+        self.assertNotEqual(dex_files[1], self.dex_files[1])
+
+    def test_oat_header_183_and_later(self):
+        for version, vdex_version in (('183', '021'), ('195', '027'), ('199', '027'), ('225', '027'), ('230', '027')):
+            with self.subTest(version=version):
+                vdex, dex_offsets = make_vdex(vdex_version, self.dex_files)
+                self.write('new%s.vdex' % version, vdex)
+                path = self.write('new%s.odex' % version, make_elf(make_oat(version, self.dex_files, dex_offsets)))
+
+                extractor = Dextripador.Extractor(path)
+                try:
+                    extractor.load()
+                    self.assertEqual(bytes(extractor.oatdata.version), version.encode() + b'\0')
+                    # two compiled methods in the OatClass of each dex
+                    self.assertEqual(extractor.number_of_optimized_methods, 4)
+                    self.assertEqual(extractor.get_class_descriptors(1), ['Lcom/b/B;'])
+                finally:
+                    extractor.close()
+
+                self.assertEqual(self.extract(path), self.dex_files)
+
+
+if __name__ == '__main__':
+    unittest.main()
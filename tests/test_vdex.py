@@ -0,0 +1,82 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: tests/test_vdex.py
+#   Version: 0.7
+######################################################
+
+import tempfile
+import unittest
+
+from fixtures import *
+
+import Dextripador
+
+# every vdex layout with an oat version using it
+VDEX_VERSIONS = (('006', '124'), ('010', '131'), ('019', '131'), ('021', '170'), ('027', '170'))
+
+
+class VdexTest(unittest.TestCase):
+    '''
+    The dex files of each vdex layout, for a vdex analyzed alone and
+    for the vdex paired with its odex.
+    '''
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.dex_files = make_dex_files()
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def load(self, path):
+        '''
+        :return: the dex files in the mapping of the container, the
+                 headers of the vdex and of the oat (None for a vdex)
+        '''
+        extractor = Dextripador.Extractor(path)
+
+        try:
+            extractor.load()
+            dex_files = [bytes(extractor.get_dex_view(i)) for i in range(extractor.number_of_dex_files)]
+            return dex_files, extractor.vdex_file is not None, extractor.oatdata
+        finally:
+            extractor.close()
+
+    def test_vdex_alone(self):
+        for version, _ in VDEX_VERSIONS:
+            with self.subTest(version=version):
+                vdex, _ = make_vdex(version, self.dex_files)
+                dex_files, has_vdex, oatdata = self.load(write_file(self.directory.name, 'v%s.vdex' % version, vdex))
+
+                self.assertEqual(dex_files, self.dex_files)
+                self.assertTrue(has_vdex)
+                self.assertIsNone(oatdata)
+
+    def test_vdex_paired_with_odex(self):
+        for version, oat_version in VDEX_VERSIONS:
+            with self.subTest(version=version):
+                vdex, dex_offsets = make_vdex(version, self.dex_files)
+                write_file(self.directory.name, 'p%s.vdex' % version, vdex)
+                path = write_file(self.directory.name, 'p%s.odex' % version,
+                                  make_oat(oat_version, self.dex_files, dex_offsets))
+
+                dex_files, has_vdex, oatdata = self.load(path)
+
+                self.assertEqual(dex_files, self.dex_files)
+                self.assertTrue(has_vdex)
+                self.assertEqual(bytes(oatdata.version), oat_version.encode() + b'\0')
+
+    def test_vdex_without_dex_section(self):
+        for version in ('019', '027'):
+            with self.subTest(version=version):
+                vdex, _ = make_vdex(version, self.dex_files, with_dex=False)
+                dex_files, _, _ = self.load(write_file(self.directory.name, 'n%s.vdex' % version, vdex))
+
+                self.assertEqual(dex_files, [])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,102 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+######################################################
+#   Dextripador
+#   File: tests/test_verify.py
+#   Version: 0.7
+######################################################
+
+import io
+import os
+import struct
+import tempfile
+import contextlib
+import subprocess
+import unittest
+
+from fixtures import *
+
+import Dextripador
+
+NATIVE_DEXTRIPADOR = os.path.join(ROOT_DIRECTORY, "elfparser_e", "out", "dextripador")
+
+
+class VerifyTest(unittest.TestCase):
+    '''
+    --verify of untouched and tampered inputs, with the Python tool
+    and with the native one of elfparser_e.
+    '''
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.dex_files = make_dex_files()
+        second_dex = bytearray(self.dex_files[1])
+        fix_dex(second_dex)
+        self.dex_files[1] = bytes(second_dex)
+
+        self.good = write_file(self.directory.name, 'good.odex', make_elf(make_oat('131', self.dex_files)))
+
+        # a byte of the data of the second dex changed after it was signed
+        tampered = bytearray(make_oat('131', self.dex_files))
+        tampered[tampered.find(self.dex_files[1]) + len(self.dex_files[1]) - 1] ^= 0xff
+        self.tampered = write_file(self.directory.name, 'tampered.oat', bytes(tampered))
+
+        vdex, _ = make_vdex('027', self.dex_files)
+        self.vdex = write_file(self.directory.name, 'alone.vdex', vdex)
+
+        # file_size of the first dex past the end of the file
+        truncated = bytearray(make_oat('131', self.dex_files))
+        struct.pack_into('<I', truncated, truncated.find(self.dex_files[0]) + 0x20, 0x10000000)
+        self.truncated = write_file(self.directory.name, 'truncated.oat', bytes(truncated))
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def verify(self, paths):
+        output = io.StringIO()
+
+        with contextlib.redirect_stdout(output):
+            passed = Dextripador.verify_files(paths, workers=2)
+
+        return passed, output.getvalue().splitlines()
+
+    def test_good_inputs(self):
+        passed, lines = self.verify([self.good, self.vdex])
+
+        self.assertTrue(passed)
+        self.assertEqual(lines, ["PASS %s oat=unchecked dex=2/2" % self.good,
+                                 "PASS %s oat=n/a dex=2/2" % self.vdex])
+
+    def test_tampered_input(self):
+        passed, lines = self.verify([self.good, self.tampered])
+
+        self.assertFalse(passed)
+        self.assertEqual(lines[0], "PASS %s oat=unchecked dex=2/2" % self.good)
+        self.assertEqual(lines[1], "FAIL %s oat=unchecked dex=1/2 bad=[1:Foo.dex!classes2.dex(checksum,signature)]" %
+                         self.tampered)
+
+    def test_dex_out_of_file(self):
+        passed, lines = self.verify([self.truncated])
+
+        self.assertFalse(passed)
+        self.assertTrue(lines[0].startswith("ERROR %s OffsetOutOfBoundException" % self.truncated))
+
+    @unittest.skipUnless(os.path.isfile(NATIVE_DEXTRIPADOR), "elfparser_e is not built")
+    def test_native_verify(self):
+        def native_verify(path):
+            result = subprocess.run([NATIVE_DEXTRIPADOR, "--verify", "-i", path], stdout=subprocess.PIPE,
+                                    stderr=subprocess.DEVNULL)
+            return result.returncode, result.stdout.decode().splitlines()
+
+        self.assertEqual(native_verify(self.good), (0, ["PASS %s oat=unchecked dex=2/2" % self.good]))
+        self.assertEqual(native_verify(self.vdex), (0, ["PASS %s oat=n/a dex=2/2" % self.vdex]))
+
+        returncode, lines = native_verify(self.tampered)
+        self.assertNotEqual(returncode, 0)
+        self.assertEqual(lines, ["FAIL %s oat=unchecked dex=1/2 bad=[1:Foo.dex!classes2.dex(checksum,signature)]" %
+                                 self.tampered])
+
+
+if __name__ == '__main__':
+    unittest.main()